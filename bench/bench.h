@@ -0,0 +1,204 @@
+// SPDX-FileCopyrightText: 2024 Guilherme Puida Moreira <guilherme@puida.xyz>
+// SPDX-License-Identifier: BSD-3-Clause
+
+// helpers shared by the benchmarks. each benchmark reads the file given as
+// its first argument, or generates a logistics-like problem when there is
+// none, so they can run without any external data.
+
+#ifndef BENCH_H_
+#define BENCH_H_
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define BENCH_RUNS 15
+
+static inline uint64_t
+bench_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// the domain of the generated problems.
+#define BENCH_DOMAIN \
+    "(define (domain logistics)\n" \
+    "  (:requirements :typing)\n" \
+    "  (:types truck location)\n" \
+    "  (:predicates (at ?t - truck ?l - location) (connected ?a ?b - location))\n" \
+    "  (:action drive\n" \
+    "    :parameters (?t - truck ?from ?to - location)\n" \
+    "    :precondition (and (at ?t ?from) (connected ?from ?to))\n" \
+    "    :effect (and (not (at ?t ?from)) (at ?t ?to))))\n"
+
+// writes a problem with `object_count` locations and roughly
+// `object_count * 8` :init atoms.
+static inline char *
+bench_generate_problem(size_t object_count, size_t *length)
+{
+    size_t capacity = 1024 + object_count * 8 * 48;
+    char *source = malloc(capacity);
+    if (source == NULL)
+        return NULL;
+
+    size_t n = 0;
+    n += sprintf(source + n, "(define (problem bench) (:domain logistics)\n  (:objects");
+    for (size_t i = 0; i < object_count; ++i)
+        n += sprintf(source + n, " loc%zu", i);
+    n += sprintf(source + n, " - location\n   ");
+    for (size_t i = 0; i < 64; ++i)
+        n += sprintf(source + n, " truck%zu", i);
+    n += sprintf(source + n, " - truck)\n  (:init\n");
+
+    for (size_t i = 0; i < object_count; ++i) {
+        for (size_t j = 1; j <= 7; ++j)
+            n += sprintf(source + n, "    (connected loc%zu loc%zu)\n",
+                i, (i + j * 7919) % object_count);
+        n += sprintf(source + n, "    (at truck%zu loc%zu) ; start\n", i % 64, i);
+    }
+
+    n += sprintf(source + n, "  )\n  (:goal (and (at truck0 loc1))))\n");
+
+    *length = n;
+    return source;
+}
+
+static inline char *
+bench_load_input(int argc, char **argv, size_t *length)
+{
+    if (argc < 2)
+        return bench_generate_problem(200000, length);
+
+    FILE *file = fopen(argv[1], "r");
+    if (file == NULL) {
+        fprintf(stderr, "couldn't open %s\n", argv[1]);
+        return NULL;
+    }
+
+    fseek(file, 0, SEEK_END);
+    long file_size = ftell(file);
+    rewind(file);
+
+    char *source = malloc(file_size + 1);
+    if (source == NULL) {
+        fclose(file);
+        return NULL;
+    }
+
+    *length = fread(source, 1, file_size, file);
+    source[*length] = 0;
+    fclose(file);
+
+    return source;
+}
+
+// the ipc logistics domain, for the benchmarks that take a domain along with
+// the problem. trucks never leave their city, so most of the loads and
+// drives of its problems are unreachable.
+#define BENCH_LOGISTICS_DOMAIN \
+    "(define (domain logistics)\n" \
+    "  (:requirements :strips :typing)\n" \
+    "  (:types truck airplane - vehicle package vehicle - physobj\n" \
+    "          airport location - place city place physobj - object)\n" \
+    "  (:predicates (in-city ?loc - place ?city - city) (at ?obj - physobj ?loc - place)\n" \
+    "               (in ?pkg - package ?veh - vehicle))\n" \
+    "  (:action load-truck\n" \
+    "    :parameters (?pkg - package ?truck - truck ?loc - place)\n" \
+    "    :precondition (and (at ?truck ?loc) (at ?pkg ?loc))\n" \
+    "    :effect (and (not (at ?pkg ?loc)) (in ?pkg ?truck)))\n" \
+    "  (:action load-airplane\n" \
+    "    :parameters (?pkg - package ?airplane - airplane ?loc - place)\n" \
+    "    :precondition (and (at ?pkg ?loc) (at ?airplane ?loc))\n" \
+    "    :effect (and (not (at ?pkg ?loc)) (in ?pkg ?airplane)))\n" \
+    "  (:action unload-truck\n" \
+    "    :parameters (?pkg - package ?truck - truck ?loc - place)\n" \
+    "    :precondition (and (at ?truck ?loc) (in ?pkg ?truck))\n" \
+    "    :effect (and (not (in ?pkg ?truck)) (at ?pkg ?loc)))\n" \
+    "  (:action unload-airplane\n" \
+    "    :parameters (?pkg - package ?airplane - airplane ?loc - place)\n" \
+    "    :precondition (and (in ?pkg ?airplane) (at ?airplane ?loc))\n" \
+    "    :effect (and (not (in ?pkg ?airplane)) (at ?pkg ?loc)))\n" \
+    "  (:action drive-truck\n" \
+    "    :parameters (?truck - truck ?loc-from - place ?loc-to - place ?city - city)\n" \
+    "    :precondition (and (at ?truck ?loc-from) (in-city ?loc-from ?city) (in-city ?loc-to ?city))\n" \
+    "    :effect (and (not (at ?truck ?loc-from)) (at ?truck ?loc-to)))\n" \
+    "  (:action fly-airplane\n" \
+    "    :parameters (?airplane - airplane ?loc-from - airport ?loc-to - airport)\n" \
+    "    :precondition (at ?airplane ?loc-from)\n" \
+    "    :effect (and (not (at ?airplane ?loc-from)) (at ?airplane ?loc-to))))\n"
+
+#define BENCH_LOGISTICS_CITIES 40
+#define BENCH_LOGISTICS_LOCATIONS 6
+#define BENCH_LOGISTICS_AIRPLANES 8
+
+// writes a problem of BENCH_LOGISTICS_DOMAIN with `package_count` packages.
+// there is one truck per city, and the first location of each city is its
+// airport.
+static inline char *
+bench_generate_logistics(int package_count)
+{
+    const int cities = BENCH_LOGISTICS_CITIES;
+    const int locations = BENCH_LOGISTICS_LOCATIONS;
+    const int airplanes = BENCH_LOGISTICS_AIRPLANES;
+
+    char *source = malloc((size_t)cities * locations * 64 + (size_t)package_count * 64 + 4096);
+    if (source == NULL)
+        return NULL;
+
+    size_t n = sprintf(source, "(define (problem logistics-bench) (:domain logistics)\n  (:objects\n");
+    for (int c = 0; c < cities; ++c)
+        n += sprintf(source + n, "    city%d - city truck%d - truck airport%d - airport\n", c, c, c);
+    for (int c = 0; c < cities; ++c)
+        for (int l = 1; l < locations; ++l)
+            n += sprintf(source + n, "    loc%d-%d - location\n", c, l);
+
+    n += sprintf(source + n, "   ");
+    for (int a = 0; a < airplanes; ++a)
+        n += sprintf(source + n, " plane%d", a);
+    n += sprintf(source + n, " - airplane\n   ");
+    for (int p = 0; p < package_count; ++p)
+        n += sprintf(source + n, " pkg%d", p);
+    n += sprintf(source + n, " - package)\n  (:init\n");
+
+    for (int c = 0; c < cities; ++c) {
+        n += sprintf(source + n, "    (in-city airport%d city%d) (at truck%d airport%d)\n", c, c, c, c);
+        for (int l = 1; l < locations; ++l)
+            n += sprintf(source + n, "    (in-city loc%d-%d city%d)\n", c, l, c);
+    }
+
+    for (int a = 0; a < airplanes; ++a)
+        n += sprintf(source + n, "    (at plane%d airport%d)\n", a, a * cities / airplanes);
+    for (int p = 0; p < package_count; ++p)
+        n += sprintf(source + n, "    (at pkg%d loc%d-%d)\n", p, p % cities, p % (locations - 1) + 1);
+
+    n += sprintf(source + n, "  )\n  (:goal (and (at pkg0 loc1-1))))\n");
+    return source;
+}
+
+// reads a whole file, or returns NULL.
+static inline char *
+bench_read_file(const char *file_name)
+{
+    FILE *file = fopen(file_name, "r");
+    if (file == NULL) {
+        fprintf(stderr, "couldn't open %s\n", file_name);
+        return NULL;
+    }
+
+    fseek(file, 0, SEEK_END);
+    long file_size = ftell(file);
+    rewind(file);
+
+    char *source = file_size >= 0 ? malloc(file_size + 1) : NULL;
+    if (source != NULL)
+        source[fread(source, 1, file_size, file)] = 0;
+
+    fclose(file);
+    return source;
+}
+
+#endif // BENCH_H_
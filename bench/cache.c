@@ -0,0 +1,90 @@
+// SPDX-FileCopyrightText: 2024 Guilherme Puida Moreira <guilherme@puida.xyz>
+// SPDX-License-Identifier: BSD-3-Clause
+
+// measures what a tool with a result cache does for a file it has seen:
+// hashing the file and finding its result, in a cache that holds as many
+// results as a large archive. the time is set against tokenizing the file,
+// which is what the cache saves.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "pddlp.h"
+
+#include "bench.h"
+
+#define ENTRIES 100000
+
+int
+main(int argc, char **argv)
+{
+    size_t length;
+    char *source = bench_load_input(argc, argv, &length);
+    if (source == NULL)
+        return -1;
+
+    // the cache is never saved, so the file doesn't have to exist.
+    struct pddlp_error error;
+    struct pddlp_cache *cache = pddlp_open_cache("bench-cache.missing", &error);
+    if (cache == NULL)
+        return -1;
+
+    for (uint64_t i = 0; i < ENTRIES; ++i) {
+        uint64_t counts[2] = { i, 0 };
+        if (!pddlp_cache_store(cache, i * 0x9e3779b97f4a7c15u, PDDLP_CACHE_TOKENS, counts, sizeof(counts)))
+            return -1;
+    }
+
+    uint64_t hash = 0;
+    uint64_t hash_best = UINT64_MAX;
+    uint64_t token_count = 0;
+    uint64_t scan_best = UINT64_MAX;
+
+    for (int run = 0; run < BENCH_RUNS; ++run) {
+        uint64_t start = bench_now();
+        struct pddlp_hasher hasher;
+        pddlp_hasher_init(&hasher, 0);
+        pddlp_hasher_update(&hasher, source, length);
+        hash = pddlp_hasher_digest(&hasher);
+        uint64_t elapsed = bench_now() - start;
+        if (elapsed < hash_best)
+            hash_best = elapsed;
+
+        start = bench_now();
+        struct pddlp_tokenizer tokenizer;
+        pddlp_init_tokenizer(&tokenizer, source);
+        token_count = 0;
+        while (pddlp_scan_token(&tokenizer).token_type != PDDLP_TOKEN_EOF)
+            token_count++;
+        elapsed = bench_now() - start;
+        if (elapsed < scan_best)
+            scan_best = elapsed;
+    }
+
+    uint64_t counts[2] = { token_count, 0 };
+    if (!pddlp_cache_store(cache, hash, PDDLP_CACHE_TOKENS, counts, sizeof(counts)))
+        return -1;
+
+    // lookups of results that are there and of ones that aren't.
+    uint32_t size;
+    uint64_t found = 0;
+    uint64_t start = bench_now();
+    for (uint64_t i = 0; i < 2 * ENTRIES; ++i)
+        found += pddlp_cache_find(cache, i * 0x9e3779b97f4a7c15u, PDDLP_CACHE_TOKENS, &size) != NULL;
+    uint64_t find = bench_now() - start;
+
+    const uint64_t *cached = pddlp_cache_find(cache, hash, PDDLP_CACHE_TOKENS, &size);
+    if (cached == NULL || cached[0] != token_count || found != ENTRIES) {
+        fprintf(stderr, "the cache lost a result\n");
+        return -1;
+    }
+
+    printf("tokenize: %zu bytes, %" PRIu64 " tokens, %.2f ms, %.0f MB/s\n", length, token_count, scan_best / 1e6,
+        length / (scan_best / 1e3));
+    printf("hash: %.2f ms, %.0f MB/s, %.1fx faster than tokenizing\n", hash_best / 1e6,
+        length / (hash_best / 1e3), (double)scan_best / hash_best);
+    printf("find: %d entries, %.1f ns/lookup\n", ENTRIES, (double)find / (2 * ENTRIES));
+
+    free(source);
+    pddlp_free_cache(cache);
+    return 0;
+}
@@ -0,0 +1,89 @@
+// SPDX-FileCopyrightText: 2024 Guilherme Puida Moreira <guilherme@puida.xyz>
+// SPDX-License-Identifier: BSD-3-Clause
+
+// compares checking a problem against its domain with a pass that only
+// tokenizes it, and with parsing it. takes a problem of the generated
+// logistics domain, or generates one with 1.6 million :init atoms.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "pddlp.h"
+
+#include "bench.h"
+
+// what pddlp-count-tokens does.
+static uint64_t
+tokenize(const char *source)
+{
+    struct pddlp_tokenizer tokenizer;
+    pddlp_init_tokenizer(&tokenizer, source);
+
+    uint64_t count = 0;
+    while (pddlp_scan_token(&tokenizer).token_type != PDDLP_TOKEN_EOF)
+        count++;
+
+    return count;
+}
+
+static bool
+print_error(void *context, const struct pddlp_error *error)
+{
+    (void)context;
+    fprintf(stderr, "%s at %" PRIu64 ":%" PRIu64 "\n", error->message, error->line, error->column);
+    return false;
+}
+
+static void
+report(const char *name, uint64_t best, uint64_t baseline, size_t length)
+{
+    printf("%s: %.2f ms, %.1f MB/s, %.2fx tokenize\n", name, best / 1e6, length / (best / 1e9) / 1e6,
+        (double)best / baseline);
+}
+
+int
+main(int argc, char **argv)
+{
+    struct pddlp_error error;
+    struct pddlp_domain *domain = pddlp_parse_domain(BENCH_DOMAIN, &error);
+    bool valid;
+    struct pddlp_checker *checker = pddlp_new_checker(BENCH_DOMAIN, print_error, NULL, &valid);
+    if (domain == NULL || checker == NULL || !valid)
+        return -1;
+
+    size_t length;
+    char *source = bench_load_input(argc, argv, &length);
+    if (source == NULL)
+        return -1;
+
+    uint64_t best[3] = { UINT64_MAX, UINT64_MAX, UINT64_MAX };
+    uint64_t token_count = 0;
+
+    for (int run = 0; run < BENCH_RUNS; ++run) {
+        uint64_t start = bench_now();
+        token_count = tokenize(source);
+        uint64_t tokenized = bench_now();
+        valid = pddlp_check_problem(checker, source, print_error, NULL);
+        uint64_t checked = bench_now();
+        struct pddlp_problem *problem = pddlp_parse_problem(domain, source, &error);
+        uint64_t parsed = bench_now();
+
+        if (!valid || problem == NULL)
+            return -1;
+        pddlp_free_problem(problem);
+
+        uint64_t elapsed[3] = { tokenized - start, checked - tokenized, parsed - checked };
+        for (int i = 0; i < 3; ++i)
+            if (elapsed[i] < best[i])
+                best[i] = elapsed[i];
+    }
+
+    printf("%" PRIu64 " tokens\n", token_count);
+    report("tokenize", best[0], best[0], length);
+    report("check", best[1], best[0], length);
+    report("parse", best[2], best[0], length);
+
+    pddlp_free_checker(checker);
+    pddlp_release_domain(domain);
+    free(source);
+    return 0;
+}
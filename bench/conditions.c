@@ -0,0 +1,270 @@
+// SPDX-FileCopyrightText: 2024 Guilherme Puida Moreira <guilherme@puida.xyz>
+// SPDX-License-Identifier: BSD-3-Clause
+
+// compares evaluating adl preconditions from the parsed formulas, expanding
+// the quantifiers every time, with compiling them once into normal form and
+// evaluating that. takes a domain and a problem, or generates an elevator
+// problem whose actions quantify over every passenger. the lift is on every
+// floor at once, and every vip has boarded, so most of the quantifiers have
+// to go through all of them.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "pddlp.h"
+
+#include "bench.h"
+
+#define FLOORS 40
+#define PASSENGERS 400
+#define ROUNDS 20
+
+static const char *elevator_domain =
+    "(define (domain elevator)\n"
+    "  (:requirements :adl :typing)\n"
+    "  (:types passenger floor)\n"
+    "  (:predicates (origin ?p - passenger ?f - floor) (destin ?p - passenger ?f - floor)\n"
+    "               (above ?f1 ?f2 - floor) (boarded ?p - passenger) (served ?p - passenger)\n"
+    "               (vip ?p - passenger) (lift-at ?f - floor))\n"
+    "  (:action stop\n"
+    "    :parameters (?f - floor)\n"
+    "    :precondition (and (lift-at ?f)\n"
+    "      (imply (exists (?p - passenger) (and (vip ?p) (not (served ?p))))\n"
+    "             (forall (?p - passenger) (imply (and (vip ?p) (not (served ?p)))\n"
+    "                                             (or (origin ?p ?f) (destin ?p ?f) (boarded ?p)))))\n"
+    "      (not (exists (?p - passenger) (and (boarded ?p) (served ?p)))))\n"
+    "    :effect (forall (?p - passenger) (when (and (boarded ?p) (destin ?p ?f))\n"
+    "                                           (and (not (boarded ?p)) (served ?p)))))\n"
+    "  (:action up\n"
+    "    :parameters (?f1 ?f2 - floor)\n"
+    "    :precondition (and (lift-at ?f1) (above ?f1 ?f2)\n"
+    "      (not (exists (?p - passenger) (and (origin ?p ?f1) (not (boarded ?p)) (not (served ?p))))))\n"
+    "    :effect (and (lift-at ?f2) (not (lift-at ?f1)))))\n";
+
+static char *
+generate_problem(void)
+{
+    char *source = malloc((size_t)FLOORS * FLOORS * 40 + PASSENGERS * 160 + 4096);
+    if (source == NULL)
+        return NULL;
+
+    size_t n = sprintf(source, "(define (problem elevator-bench) (:domain elevator)\n  (:objects\n   ");
+    for (int f = 0; f < FLOORS; ++f)
+        n += sprintf(source + n, " f%d", f);
+    n += sprintf(source + n, " - floor\n   ");
+    for (int p = 0; p < PASSENGERS; ++p)
+        n += sprintf(source + n, " p%d", p);
+    n += sprintf(source + n, " - passenger)\n  (:init\n");
+
+    for (int f = 0; f < FLOORS; ++f) {
+        n += sprintf(source + n, "    (lift-at f%d)\n", f);
+        for (int g = f + 1; g < FLOORS; ++g)
+            n += sprintf(source + n, "    (above f%d f%d)\n", f, g);
+    }
+
+    for (int p = 0; p < PASSENGERS; ++p) {
+        n += sprintf(source + n, "    (origin p%d f%d) (destin p%d f%d)", p, p * 7 % FLOORS, p, p * 13 % FLOORS);
+        if (p % 10 == 0)
+            n += sprintf(source + n, " (vip p%d)", p);
+        if (p % 10 == 0 || p % 3 == 0)
+            n += sprintf(source + n, " (boarded p%d)", p);
+        n += sprintf(source + n, "\n");
+    }
+
+    n += sprintf(source + n, "  )\n  (:goal (forall (?p - passenger) (served ?p))))\n");
+    return source;
+}
+
+// what a consumer of the parsed formulas does: walks the tree, and expands
+// quantifiers as it gets to them. `binding` holds the object of each
+// variable of the action.
+struct tree {
+    const struct pddlp_problem *problem;
+    const struct pddlp_formulas *formulas;
+    const struct pddlp_typed_name *variables;
+    const uint32_t *type_refs;
+    uint32_t *binding;
+};
+
+// `variable` is the first variable of the quantifier at `node` that is
+// still to be bound.
+static bool
+tree_holds(struct tree *t, uint32_t node, uint32_t variable)
+{
+    const struct pddlp_formulas *f = t->formulas;
+    const struct pddlp_problem *pr = t->problem;
+    const struct pddlp_node *n = &f->nodes[node];
+    uint32_t args[16];
+
+    if (n->node_type == PDDLP_NODE_ATOM || (n->node_type == PDDLP_NODE_COMPOUND && n->op == PDDLP_TOKEN_EQ)) {
+        for (uint32_t i = 0; i < n->count && i < 16; ++i) {
+            const struct pddlp_node *term = &f->nodes[f->children[n->first + i]];
+            args[i] = term->node_type == PDDLP_NODE_OBJECT ? term->value : t->binding[term->value];
+        }
+
+        if (n->node_type == PDDLP_NODE_ATOM)
+            return pddlp_find_fact(t->problem, n->value, args) != PDDLP_NONE;
+        return args[0] == args[1];
+    }
+
+    switch (n->op) {
+    case PDDLP_TOKEN_AND:
+        for (uint32_t i = 0; i < n->count; ++i)
+            if (!tree_holds(t, f->children[n->first + i], 0))
+                return false;
+        return true;
+    case PDDLP_TOKEN_OR:
+        for (uint32_t i = 0; i < n->count; ++i)
+            if (tree_holds(t, f->children[n->first + i], 0))
+                return true;
+        return false;
+    case PDDLP_TOKEN_NOT:
+        return !tree_holds(t, f->children[n->first], 0);
+    case PDDLP_TOKEN_IMPLY:
+        return !tree_holds(t, f->children[n->first], 0) || tree_holds(t, f->children[n->first + 1], 0);
+    case PDDLP_TOKEN_FORALL:
+    case PDDLP_TOKEN_EXISTS: {
+        if (variable == n->count - 1)
+            return tree_holds(t, f->children[n->first + variable], 0);
+
+        uint32_t v = f->nodes[f->children[n->first + variable]].value;
+        const struct pddlp_typed_name *name = &t->variables[v];
+        uint32_t type = name->type_count ? t->type_refs[name->type_first] : 0;
+        bool all = n->op == PDDLP_TOKEN_FORALL;
+
+        for (uint32_t i = pr->type_objects_first[type]; i < pr->type_objects_first[type + 1]; ++i) {
+            t->binding[v] = pr->type_objects[i];
+            if (tree_holds(t, node, variable + 1) != all)
+                return !all;
+        }
+
+        return all;
+    }
+    default:
+        return false;
+    }
+}
+
+static uint32_t
+param_type(const struct pddlp_domain *domain, const struct pddlp_action *action, uint32_t param)
+{
+    const struct pddlp_typed_name *name = &domain->variables[action->variable_first + param];
+    return name->type_count ? domain->type_refs[name->type_first] : 0;
+}
+
+static bool
+init_holds(void *context, uint32_t predicate, const uint32_t *args)
+{
+    return pddlp_find_fact(context, predicate, args) != PDDLP_NONE;
+}
+
+// evaluates each precondition ROUNDS times with the first parameter of the
+// action going through the objects of its type, and the others bound to the
+// first object of theirs. walks the tree when `conditions` is NULL. returns
+// how many held.
+static uint64_t
+evaluate(struct tree *tree, const struct pddlp_conditions *conditions, uint32_t *params, uint32_t *scratch,
+    uint64_t *evaluations)
+{
+    const struct pddlp_problem *problem = tree->problem;
+    const struct pddlp_domain *domain = problem->domain;
+    uint64_t held = 0;
+
+    for (int round = 0; round < ROUNDS; ++round) {
+        for (uint32_t a = 0; a < domain->action_count; ++a) {
+            const struct pddlp_action *action = &domain->actions[a];
+            if (action->param_count == 0)
+                continue;
+
+            for (uint32_t i = 0; i < action->param_count; ++i) {
+                params[i] = problem->type_objects[problem->type_objects_first[param_type(domain, action, i)]];
+                tree->binding[action->variable_first + i] = params[i];
+            }
+
+            uint32_t type = param_type(domain, action, 0);
+            for (uint32_t o = problem->type_objects_first[type]; o < problem->type_objects_first[type + 1]; ++o) {
+                params[0] = problem->type_objects[o];
+                tree->binding[action->variable_first] = params[0];
+
+                if (conditions)
+                    held += pddlp_condition_holds(conditions, &conditions->preconditions[a], params, init_holds,
+                        (void *)problem, scratch);
+                else
+                    held += action->precondition == PDDLP_NONE || tree_holds(tree, action->precondition, 0);
+                (*evaluations)++;
+            }
+        }
+    }
+
+    return held;
+}
+
+int
+main(int argc, char **argv)
+{
+    char *domain_source = argc > 2 ? bench_read_file(argv[1]) : strdup(elevator_domain);
+    char *problem_source = argc > 2 ? bench_read_file(argv[2]) : generate_problem();
+    if (domain_source == NULL || problem_source == NULL)
+        return -1;
+
+    struct pddlp_error error;
+    struct pddlp_domain *domain = pddlp_parse_domain(domain_source, &error);
+    struct pddlp_problem *problem = domain ? pddlp_parse_problem(domain, problem_source, &error) : NULL;
+    if (problem == NULL) {
+        fprintf(stderr, "%s at %" PRIu64 ":%" PRIu64 "\n", error.message, error.line, error.column);
+        return -1;
+    }
+
+    struct pddlp_conditions *conditions = NULL;
+    uint64_t compile_time = UINT64_MAX;
+    for (int run = 0; run < BENCH_RUNS; ++run) {
+        pddlp_free_conditions(conditions);
+
+        uint64_t start = bench_now();
+        conditions = pddlp_compile_conditions(problem, &error);
+        uint64_t elapsed = bench_now() - start;
+
+        if (conditions == NULL) {
+            fprintf(stderr, "%s\n", error.message);
+            return -1;
+        }
+
+        if (elapsed < compile_time)
+            compile_time = elapsed;
+    }
+
+    uint32_t *params = calloc(domain->variable_count + 1, sizeof(*params));
+    uint32_t *binding = calloc(domain->variable_count + 1, sizeof(*binding));
+    uint32_t *scratch = calloc(conditions->scratch_count, sizeof(*scratch));
+    if (params == NULL || binding == NULL || scratch == NULL)
+        return -1;
+
+    struct tree tree = {problem, &domain->formulas, domain->variables, domain->type_refs, binding};
+    uint64_t evaluations = 0;
+
+    uint64_t start = bench_now();
+    uint64_t tree_held = evaluate(&tree, NULL, params, scratch, &evaluations);
+    uint64_t tree_time = bench_now() - start;
+
+    start = bench_now();
+    uint64_t compiled_held = evaluate(&tree, conditions, params, scratch, &evaluations);
+    uint64_t compiled_time = bench_now() - start;
+    evaluations /= 2;
+
+    printf("compile: %.2f ms, %" PRIu32 " nodes, %" PRIu32 " steps, %zu bytes\n", compile_time / 1e6,
+        conditions->node_count, conditions->step_count, conditions->memory);
+    printf("tree: %.0f evaluations/s\n", evaluations / (tree_time / 1e9));
+    printf("compiled: %.0f evaluations/s, %.2fx\n", evaluations / (compiled_time / 1e9),
+        (double)tree_time / compiled_time);
+    if (tree_held != compiled_held)
+        printf("mismatch: %" PRIu64 " preconditions hold, %" PRIu64 " expected\n", compiled_held, tree_held);
+
+    free(params);
+    free(binding);
+    free(scratch);
+    pddlp_free_conditions(conditions);
+    pddlp_free_problem(problem);
+    pddlp_release_domain(domain);
+    free(domain_source);
+    free(problem_source);
+    return tree_held == compiled_held ? 0 : -1;
+}
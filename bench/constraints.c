@@ -0,0 +1,195 @@
+// SPDX-FileCopyrightText: 2024 Guilherme Puida Moreira <guilherme@puida.xyz>
+// SPDX-License-Identifier: BSD-3-Clause
+
+// measures how much sharing repeated subformulas saves on problems with
+// large goals and constraints. takes a domain and a problem, or generates a
+// pddl3 delivery problem with a constraint and a preference per package and
+// location, all of them over the same few atoms. reports the parse time, and
+// the nodes and bytes of the formulas against those of the tree they stand
+// for.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "pddlp.h"
+
+#include "bench.h"
+
+#define PACKAGES 300
+#define LOCATIONS 20
+
+static const char *delivery_domain =
+    "(define (domain delivery)\n"
+    "  (:requirements :typing :constraints :preferences)\n"
+    "  (:types package truck location)\n"
+    "  (:predicates (at ?p - package ?l - location) (in ?p - package ?t - truck)\n"
+    "               (truck-at ?t - truck ?l - location))\n"
+    "  (:action load\n"
+    "    :parameters (?p - package ?t - truck ?l - location)\n"
+    "    :precondition (and (at ?p ?l) (truck-at ?t ?l))\n"
+    "    :effect (and (not (at ?p ?l)) (in ?p ?t)))\n"
+    "  (:action unload\n"
+    "    :parameters (?p - package ?t - truck ?l - location)\n"
+    "    :precondition (and (in ?p ?t) (truck-at ?t ?l))\n"
+    "    :effect (and (not (in ?p ?t)) (at ?p ?l)))\n"
+    "  (:action drive\n"
+    "    :parameters (?t - truck ?from ?to - location)\n"
+    "    :precondition (truck-at ?t ?from)\n"
+    "    :effect (and (not (truck-at ?t ?from)) (truck-at ?t ?to))))\n";
+
+static char *
+generate_problem(size_t *length)
+{
+    char *source = malloc((size_t)PACKAGES * LOCATIONS * 320 + PACKAGES * 128 + 4096);
+    if (source == NULL)
+        return NULL;
+
+    size_t n = sprintf(source, "(define (problem delivery-bench) (:domain delivery)\n  (:objects t0 - truck\n   ");
+    for (int l = 0; l < LOCATIONS; ++l)
+        n += sprintf(source + n, " l%d", l);
+    n += sprintf(source + n, " - location\n   ");
+    for (int p = 0; p < PACKAGES; ++p)
+        n += sprintf(source + n, " p%d", p);
+    n += sprintf(source + n, " - package)\n  (:init (truck-at t0 l0)");
+    for (int p = 0; p < PACKAGES; ++p)
+        n += sprintf(source + n, " (at p%d l%d)", p, p % LOCATIONS);
+
+    n += sprintf(source + n, ")\n  (:goal (and");
+    for (int p = 0; p < PACKAGES; ++p)
+        n += sprintf(source + n, "\n    (preference delivered (at p%d l%d))"
+                                 " (preference direct (sometime-before (at p%d l%d) (in p%d t0)))",
+            p, (p + 1) % LOCATIONS, p, (p + 1) % LOCATIONS, p);
+
+    n += sprintf(source + n, "))\n  (:constraints (and");
+    for (int p = 0; p < PACKAGES; ++p) {
+        for (int l = 0; l < LOCATIONS; ++l) {
+            n += sprintf(source + n,
+                "\n    (always (imply (and (at p%d l%d) (not (in p%d t0))) (or (truck-at t0 l%d) (at p%d l%d))))"
+                " (preference visit (sometime (and (truck-at t0 l%d) (in p%d t0))))",
+                p, l, p, l, p, l, l, p);
+        }
+    }
+
+    n += sprintf(source + n, ")))\n");
+    *length = n;
+    return source;
+}
+
+static char *
+read_file(const char *file_name, size_t *length)
+{
+    FILE *file = fopen(file_name, "r");
+    if (file == NULL) {
+        fprintf(stderr, "couldn't open %s\n", file_name);
+        return NULL;
+    }
+
+    fseek(file, 0, SEEK_END);
+    long file_size = ftell(file);
+    rewind(file);
+
+    char *source = file_size >= 0 ? malloc(file_size + 1) : NULL;
+    if (source != NULL) {
+        *length = fread(source, 1, file_size, file);
+        source[*length] = 0;
+    }
+
+    fclose(file);
+    return source;
+}
+
+// what the formulas would take as a tree: every use of a node is a copy of
+// it, children and numbers included. `sizes` and `numbers` memoize the
+// nodes and number leaves of each subtree, and are 0 until visited. nodes
+// come after their children, so one pass in order fills them.
+static void
+tree_size(const struct pddlp_formulas *f, uint64_t *sizes, uint64_t *numbers)
+{
+    for (uint32_t node = 0; node < f->node_count; ++node) {
+        const struct pddlp_node *n = &f->nodes[node];
+        sizes[node] = 1;
+        numbers[node] = n->node_type == PDDLP_NODE_NUMBER;
+
+        for (uint32_t i = 0; i < n->count; ++i) {
+            sizes[node] += sizes[f->children[n->first + i]];
+            numbers[node] += numbers[f->children[n->first + i]];
+        }
+    }
+}
+
+int
+main(int argc, char **argv)
+{
+    size_t length = 0;
+    char *domain_source = argc > 2 ? read_file(argv[1], &length) : strdup(delivery_domain);
+    char *problem_source = argc > 2 ? read_file(argv[2], &length) : generate_problem(&length);
+    if (domain_source == NULL || problem_source == NULL)
+        return -1;
+
+    struct pddlp_error error;
+    struct pddlp_domain *domain = pddlp_parse_domain(domain_source, &error);
+    if (domain == NULL) {
+        fprintf(stderr, "%s at %" PRIu64 ":%" PRIu64 "\n", error.message, error.line, error.column);
+        return -1;
+    }
+
+    struct pddlp_problem *problem = NULL;
+    uint64_t best = UINT64_MAX;
+    for (int run = 0; run < BENCH_RUNS; ++run) {
+        pddlp_free_problem(problem);
+
+        uint64_t start = bench_now();
+        problem = pddlp_parse_problem(domain, problem_source, &error);
+        uint64_t elapsed = bench_now() - start;
+
+        if (problem == NULL) {
+            fprintf(stderr, "%s at %" PRIu64 ":%" PRIu64 "\n", error.message, error.line, error.column);
+            return -1;
+        }
+
+        if (elapsed < best)
+            best = elapsed;
+    }
+
+    const struct pddlp_formulas *f = &problem->formulas;
+    uint64_t *sizes = calloc(f->node_count + 1, sizeof(*sizes));
+    uint64_t *numbers = calloc(f->node_count + 1, sizeof(*numbers));
+    if (sizes == NULL || numbers == NULL)
+        return -1;
+
+    tree_size(f, sizes, numbers);
+
+    uint32_t roots[3] = {problem->goal, problem->constraints, problem->metric};
+    uint64_t tree_nodes = 0, tree_numbers = 0, root_count = 0;
+    for (int i = 0; i < 3; ++i) {
+        if (roots[i] != PDDLP_NONE) {
+            tree_nodes += sizes[roots[i]];
+            tree_numbers += numbers[roots[i]];
+            root_count++;
+        }
+    }
+    for (uint32_t i = 0; i < problem->timed_literal_count; ++i) {
+        tree_nodes += sizes[problem->timed_literals[i]];
+        tree_numbers += numbers[problem->timed_literals[i]];
+        root_count++;
+    }
+
+    // every tree node but the roots is the child of another.
+    uint64_t tree_bytes = tree_nodes * sizeof(struct pddlp_node) + (tree_nodes - root_count) * sizeof(uint32_t)
+        + tree_numbers * sizeof(double);
+    uint64_t shared_bytes = (uint64_t)f->node_count * sizeof(struct pddlp_node)
+        + (uint64_t)f->child_count * sizeof(uint32_t) + (uint64_t)f->number_count * sizeof(double);
+
+    printf("parse: %.2f ms, %.1f MB/s, %.0f nodes/s\n", best / 1e6, length / (best / 1e9) / 1e6,
+        tree_nodes / (best / 1e9));
+    printf("tree: %" PRIu64 " nodes, %" PRIu64 " bytes\n", tree_nodes, tree_bytes);
+    printf("shared: %" PRIu32 " nodes, %" PRIu64 " bytes, %.1f%% smaller\n", f->node_count, shared_bytes,
+        100.0 * (tree_bytes - shared_bytes) / (tree_bytes ? tree_bytes : 1));
+
+    free(sizes);
+    free(numbers);
+    pddlp_free_problem(problem);
+    pddlp_release_domain(domain);
+    free(domain_source);
+    free(problem_source);
+    return 0;
+}
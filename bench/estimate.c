@@ -0,0 +1,107 @@
+// SPDX-FileCopyrightText: 2024 Guilherme Puida Moreira <guilherme@puida.xyz>
+// SPDX-License-Identifier: BSD-3-Clause
+
+// measures pddlp_estimate_tokens against counting with pddlp_scan_token,
+// and how far the estimate is from the real count. then stores every token
+// in an array, grown by doubling or allocated once from the estimate.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "pddlp.h"
+
+#include "bench.h"
+
+static uint64_t
+scan_all(const char *source)
+{
+    struct pddlp_tokenizer tokenizer;
+    pddlp_init_tokenizer(&tokenizer, source);
+
+    uint64_t token_count = 0;
+    while (pddlp_scan_token(&tokenizer).token_type != PDDLP_TOKEN_EOF)
+        token_count++;
+
+    return token_count;
+}
+
+static struct pddlp_token *
+store_all(const char *source, size_t length, bool presize)
+{
+    struct pddlp_tokenizer tokenizer;
+    pddlp_init_tokenizer(&tokenizer, source);
+
+    size_t capacity = presize ? pddlp_estimate_tokens(source, length) + 1 : 16;
+    size_t count = 0;
+    struct pddlp_token *tokens = malloc(sizeof(*tokens) * capacity);
+
+    for (;;) {
+        if (count == capacity) {
+            capacity *= 2;
+            struct pddlp_token *grown = realloc(tokens, sizeof(*tokens) * capacity);
+            if (grown == NULL)
+                break;
+            tokens = grown;
+        }
+
+        tokens[count] = pddlp_scan_token(&tokenizer);
+        if (tokens[count++].token_type == PDDLP_TOKEN_EOF)
+            break;
+    }
+
+    return tokens;
+}
+
+int
+main(int argc, char **argv)
+{
+    size_t length;
+    char *source = bench_load_input(argc, argv, &length);
+    if (source == NULL)
+        return -1;
+
+    uint64_t token_count = 0;
+    uint64_t estimate = 0;
+    uint64_t scan_best = UINT64_MAX;
+    uint64_t estimate_best = UINT64_MAX;
+
+    for (int run = 0; run < BENCH_RUNS; ++run) {
+        uint64_t start = bench_now();
+        token_count = scan_all(source);
+        uint64_t elapsed = bench_now() - start;
+        if (elapsed < scan_best)
+            scan_best = elapsed;
+
+        start = bench_now();
+        estimate = pddlp_estimate_tokens(source, length);
+        elapsed = bench_now() - start;
+        if (elapsed < estimate_best)
+            estimate_best = elapsed;
+    }
+
+    printf("scan: %" PRIu64 " tokens, %.2f ms, %.2f GB/s\n",
+        token_count, scan_best / 1e6, length / (double)scan_best);
+    printf("estimate: %" PRIu64 " tokens, %.2f ms, %.2f GB/s, %.2fx\n",
+        estimate, estimate_best / 1e6, length / (double)estimate_best, (double)scan_best / estimate_best);
+    printf("difference: %" PRId64 " tokens (%.4f%%)\n",
+        (int64_t)(estimate - token_count), 100.0 * (double)(int64_t)(estimate - token_count) / token_count);
+
+    uint64_t grown_best = UINT64_MAX;
+    uint64_t presized_best = UINT64_MAX;
+
+    for (int run = 0; run < 2 * BENCH_RUNS; ++run) {
+        bool presize = run % 2;
+        uint64_t start = bench_now();
+        free(store_all(source, length, presize));
+        uint64_t elapsed = bench_now() - start;
+
+        uint64_t *best = presize ? &presized_best : &grown_best;
+        if (elapsed < *best)
+            *best = elapsed;
+    }
+
+    printf("store, grown: %.2f ms\n", grown_best / 1e6);
+    printf("store, presized: %.2f ms, %.2fx\n", presized_best / 1e6, (double)grown_best / presized_best);
+
+    free(source);
+    return 0;
+}
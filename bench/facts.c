@@ -0,0 +1,101 @@
+// SPDX-FileCopyrightText: 2024 Guilherme Puida Moreira <guilherme@puida.xyz>
+// SPDX-License-Identifier: BSD-3-Clause
+
+// measures the :init fact store: parsing with deduplication, membership
+// queries, and pattern queries, the first of which pays for building the
+// position index. the generated problem has about ten million facts.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "pddlp.h"
+
+#include "bench.h"
+
+#define QUERIES 1000000
+
+static uint64_t
+bench_random(uint64_t *state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+int
+main(int argc, char **argv)
+{
+    struct pddlp_error error;
+    struct pddlp_domain *domain = pddlp_parse_domain(BENCH_DOMAIN, &error);
+    if (domain == NULL)
+        return -1;
+
+    size_t length;
+    char *source = argc < 2 ? bench_generate_problem(1250000, &length) : bench_load_input(argc, argv, &length);
+    if (source == NULL)
+        return -1;
+
+    uint64_t start = bench_now();
+    struct pddlp_problem *problem = pddlp_parse_problem(domain, source, &error);
+    uint64_t elapsed = bench_now() - start;
+    free(source);
+
+    if (problem == NULL) {
+        fprintf(stderr, "%s at %" PRIu64 ":%" PRIu64 "\n", error.message, error.line, error.column);
+        return -1;
+    }
+
+    printf("parse: %" PRIu32 " facts, %.2f ms\n", problem->fact_count, elapsed / 1e6);
+
+    uint32_t connected = pddlp_find_predicate(domain, "connected", 9);
+    uint32_t object_count = problem->object_count;
+    uint64_t state = 88172645463325252u;
+
+    // half of the queries are facts of the problem, the other half random
+    // pairs, which are almost never there.
+    uint32_t found = 0;
+    start = bench_now();
+    for (uint32_t i = 0; i < QUERIES; ++i) {
+        uint32_t args[2];
+        if (i & 1) {
+            uint32_t fact = bench_random(&state) % problem->fact_count;
+            memcpy(args, problem->fact_args + problem->fact_args_first[fact], sizeof(args));
+            if (problem->fact_predicates[fact] != connected)
+                args[1] = args[0];
+        } else {
+            args[0] = bench_random(&state) % object_count;
+            args[1] = bench_random(&state) % object_count;
+        }
+
+        found += pddlp_find_fact(problem, connected, args) != PDDLP_NONE;
+    }
+    elapsed = bench_now() - start;
+
+    printf("find: %d queries, %" PRIu32 " found, %.1f ns/query\n", QUERIES, found, (double)elapsed / QUERIES);
+
+    uint32_t matches[64];
+    for (uint32_t position = 0; position < 2; ++position) {
+        uint32_t pattern[2] = { PDDLP_NONE, PDDLP_NONE };
+
+        start = bench_now();
+        pattern[position] = 0;
+        if (pddlp_match_facts(problem, connected, pattern, matches, 64) == PDDLP_NONE)
+            return -1;
+        uint64_t first = bench_now() - start;
+
+        uint64_t total = 0;
+        start = bench_now();
+        for (uint32_t i = 0; i < QUERIES; ++i) {
+            pattern[position] = bench_random(&state) % object_count;
+            total += pddlp_match_facts(problem, connected, pattern, matches, 64);
+        }
+        elapsed = bench_now() - start;
+
+        printf("match position %" PRIu32 ": first %.2f ms, then %d queries, %" PRIu64 " matches, %.1f ns/query\n",
+            position, first / 1e6, QUERIES, total, (double)elapsed / QUERIES);
+    }
+
+    pddlp_free_problem(problem);
+    pddlp_release_domain(domain);
+    return 0;
+}
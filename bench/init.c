@@ -0,0 +1,65 @@
+// SPDX-FileCopyrightText: 2024 Guilherme Puida Moreira <guilherme@puida.xyz>
+// SPDX-License-Identifier: BSD-3-Clause
+
+// measures how :init parsing scales with threads. parses one large problem
+// with pddlp_parse_problem_parallel on 1, 2, 4... threads up to twice the
+// CPUs, and reports :init atoms per second against one thread.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "pddlp.h"
+
+#include "bench.h"
+
+#include <unistd.h>
+
+int
+main(int argc, char **argv)
+{
+    struct pddlp_error error;
+    struct pddlp_domain *domain = pddlp_parse_domain(BENCH_DOMAIN, &error);
+    if (domain == NULL)
+        return -1;
+
+    size_t length;
+    char *source = bench_load_input(argc, argv, &length);
+    if (source == NULL)
+        return -1;
+
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    unsigned max_threads = cpus > 1 ? (unsigned)cpus * 2 : 2;
+    uint64_t sequential = 0;
+
+    for (unsigned threads = 1; threads <= max_threads; threads *= 2) {
+        uint64_t best = UINT64_MAX;
+        uint32_t atom_count = 0;
+
+        for (int run = 0; run < BENCH_RUNS; ++run) {
+            uint64_t start = bench_now();
+            struct pddlp_problem *problem = pddlp_parse_problem_parallel(domain, source, threads, &error);
+            uint64_t elapsed = bench_now() - start;
+
+            if (problem == NULL) {
+                fprintf(stderr, "%s at %" PRIu64 ":%" PRIu64 "\n", error.message, error.line, error.column);
+                return -1;
+            }
+
+            atom_count = problem->fact_count + problem->fluent_count;
+            pddlp_free_problem(problem);
+            if (elapsed < best)
+                best = elapsed;
+        }
+
+        if (threads == 1)
+            sequential = best;
+
+        printf("%u threads: %.2f ms, %.1f MB/s, %.2f M atoms/s, %.2fx\n", threads, best / 1e6,
+            length / (best / 1e9) / 1e6, atom_count / (best / 1e9) / 1e6, (double)sequential / best);
+    }
+
+    printf("%ld CPUs\n", cpus);
+
+    free(source);
+    pddlp_release_domain(domain);
+    return 0;
+}
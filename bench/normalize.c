@@ -0,0 +1,54 @@
+// SPDX-FileCopyrightText: 2024 Guilherme Puida Moreira <guilherme@puida.xyz>
+// SPDX-License-Identifier: BSD-3-Clause
+
+// measures pddlp_normalize next to a bare tokenizer loop over the same
+// input, with the output only hashed.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "pddlp.h"
+
+#include "bench.h"
+
+int
+main(int argc, char **argv)
+{
+    size_t length;
+    char *source = bench_load_input(argc, argv, &length);
+    if (source == NULL)
+        return -1;
+
+    uint64_t scan_best = UINT64_MAX;
+    uint64_t normalize_best = UINT64_MAX;
+    struct pddlp_hash128 hash;
+
+    for (int run = 0; run < BENCH_RUNS; ++run) {
+        struct pddlp_tokenizer tokenizer;
+        uint64_t start = bench_now();
+        pddlp_init_tokenizer(&tokenizer, source);
+        while (pddlp_scan_token(&tokenizer).token_type != PDDLP_TOKEN_EOF)
+            ;
+        uint64_t elapsed = bench_now() - start;
+
+        if (elapsed < scan_best)
+            scan_best = elapsed;
+
+        struct pddlp_error error;
+        start = bench_now();
+        if (!pddlp_normalize(source, NULL, NULL, &hash, &error)) {
+            fprintf(stderr, "%s at %" PRIu64 ":%" PRIu64 "\n", error.message, error.line, error.column);
+            return -1;
+        }
+        elapsed = bench_now() - start;
+
+        if (elapsed < normalize_best)
+            normalize_best = elapsed;
+    }
+
+    printf("scan: %.2f ms, %.1f MB/s\n", scan_best / 1e6, length / (scan_best / 1e9) / 1e6);
+    printf("normalize: %.2f ms, %.1f MB/s, hash %016" PRIx64 "%016" PRIx64 "\n",
+        normalize_best / 1e6, length / (normalize_best / 1e9) / 1e6, hash.high, hash.low);
+
+    free(source);
+    return 0;
+}
@@ -0,0 +1,358 @@
+// SPDX-FileCopyrightText: 2024 Guilherme Puida Moreira <guilherme@puida.xyz>
+// SPDX-License-Identifier: BSD-3-Clause
+
+// compares three ways of evaluating the numeric comparisons and effects of
+// every grounded operator over many states: walking the parsed expressions
+// and looking each fluent up by its function and arguments, running the
+// compiled programs on one state at a time, and running each program over a
+// batch of states. generates a problem with trucks that burn fuel as they
+// drive along roads, depending on what they carry.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "pddlp.h"
+
+#include "bench.h"
+
+#include <math.h>
+
+#define TRUCKS 20
+#define PLACES 200
+#define ROADS 5
+#define STATES 256
+
+static const char *fuel_domain =
+    "(define (domain fuel)\n"
+    "  (:requirements :typing :numeric-fluents)\n"
+    "  (:types truck place)\n"
+    "  (:predicates (at ?t - truck ?p - place) (road ?a ?b - place))\n"
+    "  (:functions (fuel ?t - truck) (load ?t - truck) (rate ?t - truck) (distance ?a ?b - place)\n"
+    "              (total-cost))\n"
+    "  (:action drive\n"
+    "    :parameters (?t - truck ?from ?to - place)\n"
+    "    :precondition (and (at ?t ?from) (road ?from ?to)\n"
+    "      (>= (fuel ?t) (* (distance ?from ?to) (+ (rate ?t) (/ (load ?t) 10)))))\n"
+    "    :effect (and (not (at ?t ?from)) (at ?t ?to)\n"
+    "      (decrease (fuel ?t) (* (distance ?from ?to) (+ (rate ?t) (/ (load ?t) 10))))\n"
+    "      (increase (total-cost) (+ (* 2 (distance ?from ?to)) (* 0.5 (+ 1 1))))))\n"
+    "  (:action refuel\n"
+    "    :parameters (?t - truck ?p - place)\n"
+    "    :precondition (and (at ?t ?p) (< (fuel ?t) (- 100 (* 5 2))))\n"
+    "    :effect (and (assign (fuel ?t) 100) (increase (total-cost) (+ 10 (load ?t))))))\n";
+
+static char *
+generate_problem(void)
+{
+    char *source = malloc((size_t)PLACES * ROADS * 80 + TRUCKS * 160 + PLACES * 16 + 4096);
+    if (source == NULL)
+        return NULL;
+
+    size_t n = sprintf(source, "(define (problem fuel-bench) (:domain fuel)\n  (:objects\n   ");
+    for (int t = 0; t < TRUCKS; ++t)
+        n += sprintf(source + n, " t%d", t);
+    n += sprintf(source + n, " - truck\n   ");
+    for (int p = 0; p < PLACES; ++p)
+        n += sprintf(source + n, " p%d", p);
+    n += sprintf(source + n, " - place)\n  (:init (= (total-cost) 0)\n");
+
+    for (int t = 0; t < TRUCKS; ++t)
+        n += sprintf(source + n, "    (at t%d p%d) (= (fuel t%d) %d) (= (load t%d) %d) (= (rate t%d) 1.%d)\n", t,
+            t * 7 % PLACES, t, 50 + t, t, t * 3 % 20, t, t % 10);
+
+    for (int p = 0; p < PLACES; ++p)
+        for (int r = 1; r <= ROADS; ++r)
+            n += sprintf(source + n, "    (road p%d p%d) (= (distance p%d p%d) %d)\n", p, (p + r * 37) % PLACES, p,
+                (p + r * 37) % PLACES, 1 + (p * r) % 9);
+
+    n += sprintf(source + n, "  )\n  (:goal (at t0 p1))\n  (:metric minimize (total-cost)))\n");
+    return source;
+}
+
+// fluents by function and arguments, for walking the parsed expressions.
+struct fluent_table {
+    const struct pddlp_numeric *numeric;
+    const struct pddlp_domain *domain;
+    uint32_t *slots;
+    uint32_t mask;
+};
+
+static uint32_t
+fluent_hash(uint32_t function, const uint32_t *args, uint32_t arity)
+{
+    uint32_t h = function * 2654435761u;
+    for (uint32_t i = 0; i < arity; ++i)
+        h = (h ^ args[i]) * 2654435761u;
+    return h ^ (h >> 16);
+}
+
+static uint32_t
+fluent_find(const struct fluent_table *table, uint32_t function, const uint32_t *args)
+{
+    const struct pddlp_numeric *n = table->numeric;
+    uint32_t arity = table->domain->functions[function].param_count;
+
+    for (uint32_t i = fluent_hash(function, args, arity) & table->mask;; i = (i + 1) & table->mask) {
+        uint32_t fluent = table->slots[i];
+        if (fluent == PDDLP_NONE)
+            return PDDLP_NONE;
+        if (n->fluent_functions[fluent] == function &&
+            memcmp(n->fluent_args + n->fluent_args_first[fluent], args, sizeof(*args) * arity) == 0)
+            return fluent;
+    }
+}
+
+// evaluates an expression or comparison of the domain with the parameters
+// of an action bound to `params`.
+static double
+walk(const struct fluent_table *table, const struct pddlp_action *action, const uint32_t *params, uint32_t node,
+    const double *values)
+{
+    const struct pddlp_formulas *f = &table->domain->formulas;
+    const struct pddlp_node *n = &f->nodes[node];
+
+    if (n->node_type == PDDLP_NODE_NUMBER)
+        return f->numbers[n->value];
+
+    if (n->node_type == PDDLP_NODE_FUNCTION) {
+        uint32_t args[8];
+        for (uint32_t i = 0; i < n->count; ++i) {
+            const struct pddlp_node *term = &f->nodes[f->children[n->first + i]];
+            args[i] = term->node_type == PDDLP_NODE_OBJECT ? term->value : params[term->value - action->variable_first];
+        }
+
+        uint32_t fluent = fluent_find(table, n->value, args);
+        return fluent == PDDLP_NONE ? NAN : values[fluent];
+    }
+
+    double result = walk(table, action, params, f->children[n->first], values);
+    if (n->op == PDDLP_TOKEN_MINUS && n->count == 1)
+        return -result;
+
+    for (uint32_t i = 1; i < n->count; ++i) {
+        double b = walk(table, action, params, f->children[n->first + i], values);
+        switch (n->op) {
+        case PDDLP_TOKEN_PLUS:
+            result += b;
+            break;
+        case PDDLP_TOKEN_MINUS:
+            result -= b;
+            break;
+        case PDDLP_TOKEN_STAR:
+            result *= b;
+            break;
+        case PDDLP_TOKEN_SLASH:
+            result /= b;
+            break;
+        case PDDLP_TOKEN_LT:
+            result = result < b;
+            break;
+        case PDDLP_TOKEN_LTE:
+            result = result <= b;
+            break;
+        case PDDLP_TOKEN_GT:
+            result = result > b;
+            break;
+        case PDDLP_TOKEN_GTE:
+            result = result >= b;
+            break;
+        default:
+            result = result == b;
+            break;
+        }
+    }
+
+    return result;
+}
+
+// what the walk evaluates for each operator: its comparisons, and the
+// expressions of its numeric effects.
+struct walk_item {
+    uint32_t op;
+    uint32_t node;
+};
+
+static void
+collect(const struct pddlp_formulas *f, uint32_t op, uint32_t node, bool effect, struct walk_item *items,
+    uint32_t *count)
+{
+    if (node == PDDLP_NONE)
+        return;
+
+    const struct pddlp_node *n = &f->nodes[node];
+    if (n->node_type != PDDLP_NODE_COMPOUND)
+        return;
+
+    switch (n->op) {
+    case PDDLP_TOKEN_AND:
+        for (uint32_t i = 0; i < n->count; ++i)
+            collect(f, op, f->children[n->first + i], effect, items, count);
+        break;
+    case PDDLP_TOKEN_LT:
+    case PDDLP_TOKEN_LTE:
+    case PDDLP_TOKEN_GT:
+    case PDDLP_TOKEN_GTE:
+        items[(*count)++] = (struct walk_item) { op, node };
+        break;
+    case PDDLP_TOKEN_ASSIGN:
+    case PDDLP_TOKEN_INCREASE:
+    case PDDLP_TOKEN_DECREASE:
+        if (effect)
+            items[(*count)++] = (struct walk_item) { op, f->children[n->first + 1] };
+        break;
+    default:
+        break;
+    }
+}
+
+int
+main(int argc, char **argv)
+{
+    (void)argv;
+    if (argc > 1) {
+        fprintf(stderr, "bench-numeric generates its own problem\n");
+        return -1;
+    }
+
+    struct pddlp_error error;
+    struct pddlp_domain *domain = pddlp_parse_domain(fuel_domain, &error);
+    char *source = generate_problem();
+    if (domain == NULL || source == NULL)
+        return -1;
+
+    struct pddlp_problem *problem = pddlp_parse_problem(domain, source, &error);
+    struct pddlp_strips *strips = problem ? pddlp_ground(problem, 1, &error) : NULL;
+    if (strips == NULL) {
+        fprintf(stderr, "%s\n", error.message);
+        return -1;
+    }
+
+    uint64_t start = bench_now();
+    struct pddlp_numeric *numeric = pddlp_compile_numeric(strips, &error);
+    uint64_t elapsed = bench_now() - start;
+    if (numeric == NULL) {
+        fprintf(stderr, "%s\n", error.message);
+        return -1;
+    }
+
+    // the programs to run, in the same order as the walk.
+    uint32_t program_count = numeric->condition_first[strips->operator_count] +
+        numeric->effect_first[strips->operator_count];
+    uint32_t *programs = malloc(sizeof(*programs) * program_count);
+    struct walk_item *items = malloc(sizeof(*items) * program_count);
+    if (programs == NULL || items == NULL)
+        return -1;
+
+    uint32_t n = 0;
+    uint32_t item_count = 0;
+    for (uint32_t o = 0; o < strips->operator_count; ++o) {
+        for (uint32_t i = numeric->condition_first[o]; i < numeric->condition_first[o + 1]; ++i)
+            programs[n++] = numeric->conditions[i];
+        for (uint32_t i = numeric->effect_first[o]; i < numeric->effect_first[o + 1]; ++i)
+            programs[n++] = numeric->effects[i].program;
+
+        const struct pddlp_action *action = &domain->actions[strips->operators[o].action];
+        collect(&domain->formulas, o, action->precondition, false, items, &item_count);
+        collect(&domain->formulas, o, action->effect, true, items, &item_count);
+    }
+
+    if (item_count != program_count) {
+        fprintf(stderr, "the walk has %" PRIu32 " expressions, the programs %" PRIu32 "\n", item_count,
+            program_count);
+        return -1;
+    }
+
+    printf("compile: %" PRIu32 " operators, %" PRIu32 " fluents, %" PRIu32 " programs, %" PRIu32 " ops, %.2f ms\n",
+        strips->operator_count, numeric->fluent_count, numeric->program_count, numeric->op_count, elapsed / 1e6);
+
+    // the states: every fluent of state s is its initial value plus s, in
+    // rows for the programs and the walk, and in columns for batches.
+    uint32_t fluent_count = numeric->fluent_count;
+    double *rows = malloc(sizeof(*rows) * fluent_count * STATES);
+    double *columns = malloc(sizeof(*columns) * fluent_count * STATES);
+    double *results = malloc(sizeof(*results) * STATES);
+    double *stack = malloc(sizeof(*stack) * numeric->depth * PDDLP_NUMERIC_LANES);
+    if (rows == NULL || columns == NULL || results == NULL || stack == NULL)
+        return -1;
+
+    for (uint32_t s = 0; s < STATES; ++s) {
+        for (uint32_t f = 0; f < fluent_count; ++f) {
+            rows[(size_t)s * fluent_count + f] = numeric->initial_values[f] + s;
+            columns[(size_t)f * STATES + s] = numeric->initial_values[f] + s;
+        }
+    }
+
+    struct fluent_table table = { numeric, domain, NULL, 0 };
+    uint32_t capacity = 64;
+    while (capacity < fluent_count * 2)
+        capacity *= 2;
+    table.slots = malloc(sizeof(*table.slots) * capacity);
+    table.mask = capacity - 1;
+    if (table.slots == NULL)
+        return -1;
+    memset(table.slots, 0xff, sizeof(*table.slots) * capacity);
+    for (uint32_t fluent = 0; fluent < fluent_count; ++fluent) {
+        uint32_t function = numeric->fluent_functions[fluent];
+        uint32_t i = fluent_hash(function, numeric->fluent_args + numeric->fluent_args_first[fluent],
+                         domain->functions[function].param_count) & table.mask;
+        while (table.slots[i] != PDDLP_NONE)
+            i = (i + 1) & table.mask;
+        table.slots[i] = fluent;
+    }
+
+    double evaluations = (double)program_count * STATES;
+    double walked = 0, single = 0, batched = 0;
+
+    start = bench_now();
+    for (uint32_t s = 0; s < STATES; ++s) {
+        const double *values = rows + (size_t)s * fluent_count;
+        for (uint32_t i = 0; i < item_count; ++i) {
+            const struct pddlp_operator *op = &strips->operators[items[i].op];
+            walked += walk(&table, &domain->actions[op->action], strips->operator_args + op->args, items[i].node,
+                values);
+        }
+    }
+    uint64_t walk_time = bench_now() - start;
+
+    start = bench_now();
+    for (uint32_t s = 0; s < STATES; ++s) {
+        const double *values = rows + (size_t)s * fluent_count;
+        for (uint32_t i = 0; i < program_count; ++i)
+            single += pddlp_evaluate(numeric, programs[i], values, stack);
+    }
+    uint64_t single_time = bench_now() - start;
+
+    start = bench_now();
+    for (uint32_t i = 0; i < program_count; ++i) {
+        pddlp_evaluate_batch(numeric, programs[i], columns, STATES, STATES, results, stack);
+        for (uint32_t s = 0; s < STATES; ++s)
+            batched += results[s];
+    }
+    uint64_t batch_time = bench_now() - start;
+
+    // the batches add the results up in another order.
+    if (single != walked || fabs(batched - walked) > 1e-9 * fabs(walked)) {
+        fprintf(stderr, "the sums differ: %g walked, %g single, %g batched\n", walked, single, batched);
+        return -1;
+    }
+
+    printf("walk: %.0f evaluations, %.2f ms, %.1f M/s\n", evaluations, walk_time / 1e6,
+        evaluations / (walk_time / 1e3));
+    printf("single: %.2f ms, %.1f M/s, %.1fx the walk\n", single_time / 1e6, evaluations / (single_time / 1e3),
+        (double)walk_time / single_time);
+    printf("batch: %.2f ms, %.1f M/s, %.1fx the walk, %.1fx single\n", batch_time / 1e6,
+        evaluations / (batch_time / 1e3), (double)walk_time / batch_time, (double)single_time / batch_time);
+
+    free(table.slots);
+    free(stack);
+    free(results);
+    free(columns);
+    free(rows);
+    free(items);
+    free(programs);
+    pddlp_free_numeric(numeric);
+    pddlp_free_strips(strips);
+    pddlp_free_problem(problem);
+    free(source);
+    pddlp_release_domain(domain);
+    return 0;
+}
@@ -0,0 +1,102 @@
+// SPDX-FileCopyrightText: 2024 Guilherme Puida Moreira <guilherme@puida.xyz>
+// SPDX-License-Identifier: BSD-3-Clause
+
+// measures problem parsing. the first number is the throughput on one large
+// problem, the other two compare parsing many small problems with the domain
+// parsed each time against loading it once through the domain cache.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "pddlp.h"
+
+#include "bench.h"
+
+#define SMALL_PROBLEMS 2000
+
+static int
+parse_small(const char *problem, bool cached)
+{
+    struct pddlp_error error;
+
+    for (int i = 0; i < SMALL_PROBLEMS; ++i) {
+        struct pddlp_domain *domain = cached
+            ? pddlp_load_domain(BENCH_DOMAIN, &error)
+            : pddlp_parse_domain(BENCH_DOMAIN, &error);
+        struct pddlp_problem *parsed = domain ? pddlp_parse_problem(domain, problem, &error) : NULL;
+
+        if (parsed == NULL) {
+            fprintf(stderr, "%s at %" PRIu64 ":%" PRIu64 "\n", error.message, error.line, error.column);
+            return -1;
+        }
+
+        pddlp_free_problem(parsed);
+        pddlp_release_domain(domain);
+    }
+
+    return 0;
+}
+
+int
+main(int argc, char **argv)
+{
+    struct pddlp_error error;
+    struct pddlp_domain *domain = pddlp_parse_domain(BENCH_DOMAIN, &error);
+    if (domain == NULL)
+        return -1;
+
+    size_t length;
+    char *source = bench_load_input(argc, argv, &length);
+    if (source == NULL)
+        return -1;
+
+    uint32_t fact_count = 0;
+    uint64_t best = UINT64_MAX;
+
+    for (int run = 0; run < BENCH_RUNS; ++run) {
+        uint64_t start = bench_now();
+        struct pddlp_problem *problem = pddlp_parse_problem(domain, source, &error);
+        uint64_t elapsed = bench_now() - start;
+
+        if (problem == NULL) {
+            fprintf(stderr, "%s at %" PRIu64 ":%" PRIu64 "\n", error.message, error.line, error.column);
+            return -1;
+        }
+
+        fact_count = problem->fact_count;
+        pddlp_free_problem(problem);
+
+        if (elapsed < best)
+            best = elapsed;
+    }
+
+    printf("large: %" PRIu32 " facts, %.2f ms, %.1f MB/s\n",
+        fact_count, best / 1e6, length / (best / 1e9) / 1e6);
+
+    size_t small_length;
+    char *small = bench_generate_problem(20, &small_length);
+    if (small == NULL)
+        return -1;
+
+    for (int cached = 0; cached <= 1; ++cached) {
+        best = UINT64_MAX;
+
+        for (int run = 0; run < BENCH_RUNS; ++run) {
+            uint64_t start = bench_now();
+            if (parse_small(small, cached) != 0)
+                return -1;
+            uint64_t elapsed = bench_now() - start;
+
+            if (elapsed < best)
+                best = elapsed;
+        }
+
+        printf("%s: %d problems, %.2f us/problem\n",
+            cached ? "cached domain" : "parsed domain", SMALL_PROBLEMS, best / 1e3 / SMALL_PROBLEMS);
+    }
+
+    pddlp_clear_domain_cache();
+    pddlp_release_domain(domain);
+    free(small);
+    free(source);
+    return 0;
+}
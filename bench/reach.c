@@ -0,0 +1,82 @@
+// SPDX-FileCopyrightText: 2024 Guilherme Puida Moreira <guilherme@puida.xyz>
+// SPDX-License-Identifier: BSD-3-Clause
+
+// compares grounding every operator whose static preconditions hold with
+// grounding only the reachable ones. takes a domain and a problem, or
+// generates an ipc-style logistics problem, where trucks never leave their
+// city and most of the loads and drives are unreachable.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "pddlp.h"
+
+#include "bench.h"
+
+#define PACKAGES 120
+
+// the best of BENCH_RUNS runs, keeping the last result.
+static struct pddlp_strips *
+time_grounding(const struct pddlp_problem *problem, bool reachable, uint64_t *best)
+{
+    struct pddlp_error error;
+    struct pddlp_strips *strips = NULL;
+    *best = UINT64_MAX;
+
+    for (int run = 0; run < BENCH_RUNS; ++run) {
+        pddlp_free_strips(strips);
+
+        uint64_t start = bench_now();
+        strips = reachable ? pddlp_ground_reachable(problem, &error) : pddlp_ground(problem, 1, &error);
+        uint64_t elapsed = bench_now() - start;
+
+        if (strips == NULL) {
+            fprintf(stderr, "%s\n", error.message);
+            return NULL;
+        }
+
+        if (elapsed < *best)
+            *best = elapsed;
+    }
+
+    return strips;
+}
+
+int
+main(int argc, char **argv)
+{
+    char *domain_source = argc > 2 ? bench_read_file(argv[1]) : strdup(BENCH_LOGISTICS_DOMAIN);
+    char *problem_source = argc > 2 ? bench_read_file(argv[2]) : bench_generate_logistics(PACKAGES);
+    if (domain_source == NULL || problem_source == NULL)
+        return -1;
+
+    struct pddlp_error error;
+    struct pddlp_domain *domain = pddlp_parse_domain(domain_source, &error);
+    struct pddlp_problem *problem = domain ? pddlp_parse_problem(domain, problem_source, &error) : NULL;
+    if (problem == NULL) {
+        fprintf(stderr, "%s at %" PRIu64 ":%" PRIu64 "\n", error.message, error.line, error.column);
+        return -1;
+    }
+
+    uint64_t all_time, reachable_time;
+    struct pddlp_strips *all = time_grounding(problem, false, &all_time);
+    struct pddlp_strips *reachable = time_grounding(problem, true, &reachable_time);
+    if (all == NULL || reachable == NULL)
+        return -1;
+
+    printf("all: %" PRIu32 " operators, %" PRIu32 " facts, %.2f ms\n",
+        all->operator_count, all->fact_count, all_time / 1e6);
+    printf("reachable: %" PRIu32 " operators, %" PRIu32 " facts, %.2f ms\n",
+        reachable->operator_count, reachable->fact_count, reachable_time / 1e6);
+    printf("pruned: %.1f%% of operators, %.1f%% of facts, %.2fx time\n",
+        100.0 * (all->operator_count - reachable->operator_count) / (all->operator_count ? all->operator_count : 1),
+        100.0 * (all->fact_count - reachable->fact_count) / (all->fact_count ? all->fact_count : 1),
+        (double)all_time / reachable_time);
+
+    pddlp_free_strips(all);
+    pddlp_free_strips(reachable);
+    pddlp_free_problem(problem);
+    pddlp_release_domain(domain);
+    free(domain_source);
+    free(problem_source);
+    return 0;
+}
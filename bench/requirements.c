@@ -0,0 +1,138 @@
+// SPDX-FileCopyrightText: 2024 Guilherme Puida Moreira <guilherme@puida.xyz>
+// SPDX-License-Identifier: BSD-3-Clause
+
+// compares the strips-specialized parser that pddlp_parse_domain_strict
+// picks for a :strips/:typing domain with negative preconditions and
+// equality with the general one. times a large
+// generated domain, and a problem against each of the two domains.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "pddlp.h"
+
+#include "bench.h"
+
+#define ACTIONS 20000
+
+// a domain with many actions, each with a few preconditions and effects.
+static char *
+generate_domain(void)
+{
+    char *source = malloc((size_t)ACTIONS * 512 + 1024);
+    if (source == NULL)
+        return NULL;
+
+    size_t n = 0;
+    n += sprintf(source + n,
+        "(define (domain logistics)\n"
+        "  (:requirements :strips :typing :negative-preconditions :equality)\n"
+        "  (:types truck location)\n"
+        "  (:predicates (at ?t - truck ?l - location) (connected ?a ?b - location)\n"
+        "               (visited ?l - location) (ready ?t - truck))\n");
+
+    for (int i = 0; i < ACTIONS; ++i)
+        n += sprintf(source + n,
+            "  (:action drive%d\n"
+            "    :parameters (?t - truck ?from ?to - location)\n"
+            "    :precondition (and (at ?t ?from) (connected ?from ?to) (ready ?t)\n"
+            "                       (not (visited ?to)) (not (= ?from ?to)))\n"
+            "    :effect (and (not (at ?t ?from)) (at ?t ?to) (visited ?to)))\n", i);
+
+    n += sprintf(source + n, ")\n");
+    return source;
+}
+
+// the runs of the two parsers alternate, so neither gets a warmer heap.
+static bool
+time_domains(const char *source, uint64_t *general, uint64_t *strict)
+{
+    struct pddlp_error error;
+    *general = *strict = UINT64_MAX;
+
+    for (int run = 0; run < 2 * BENCH_RUNS; ++run) {
+        bool is_strict = run % 2;
+        uint64_t start = bench_now();
+        struct pddlp_domain *domain = is_strict
+            ? pddlp_parse_domain_strict(source, &error)
+            : pddlp_parse_domain(source, &error);
+        uint64_t elapsed = bench_now() - start;
+
+        if (domain == NULL) {
+            fprintf(stderr, "%s at %" PRIu64 ":%" PRIu64 "\n", error.message, error.line, error.column);
+            return false;
+        }
+
+        pddlp_release_domain(domain);
+        uint64_t *best = is_strict ? strict : general;
+        if (elapsed < *best)
+            *best = elapsed;
+    }
+
+    return true;
+}
+
+static bool
+time_problems(const char *source, uint64_t *general, uint64_t *strict)
+{
+    struct pddlp_error error;
+    struct pddlp_domain *domains[2] = {
+        pddlp_parse_domain(BENCH_DOMAIN, &error),
+        pddlp_parse_domain_strict(BENCH_DOMAIN, &error),
+    };
+
+    if (domains[0] == NULL || domains[1] == NULL)
+        return false;
+
+    *general = *strict = UINT64_MAX;
+
+    for (int run = 0; run < 2 * BENCH_RUNS; ++run) {
+        bool is_strict = run % 2;
+        uint64_t start = bench_now();
+        struct pddlp_problem *problem = pddlp_parse_problem(domains[is_strict], source, &error);
+        uint64_t elapsed = bench_now() - start;
+
+        if (problem == NULL) {
+            fprintf(stderr, "%s at %" PRIu64 ":%" PRIu64 "\n", error.message, error.line, error.column);
+            return false;
+        }
+
+        pddlp_free_problem(problem);
+        uint64_t *best = is_strict ? strict : general;
+        if (elapsed < *best)
+            *best = elapsed;
+    }
+
+    pddlp_release_domain(domains[0]);
+    pddlp_release_domain(domains[1]);
+    return true;
+}
+
+int
+main(int argc, char **argv)
+{
+    char *domain = generate_domain();
+    size_t length;
+    char *problem = bench_load_input(argc, argv, &length);
+    if (domain == NULL || problem == NULL)
+        return -1;
+
+    size_t domain_length = strlen(domain);
+    uint64_t general, strict;
+    if (!time_domains(domain, &general, &strict))
+        return -1;
+
+    printf("domain, general: %.2f ms, %.1f MB/s\n", general / 1e6, domain_length / (general / 1e9) / 1e6);
+    printf("domain, strips: %.2f ms, %.1f MB/s, %.2fx\n",
+        strict / 1e6, domain_length / (strict / 1e9) / 1e6, (double)general / strict);
+
+    if (!time_problems(problem, &general, &strict))
+        return -1;
+
+    printf("problem, general: %.2f ms, %.1f MB/s\n", general / 1e6, length / (general / 1e9) / 1e6);
+    printf("problem, strips: %.2f ms, %.1f MB/s, %.2fx\n",
+        strict / 1e6, length / (strict / 1e9) / 1e6, (double)general / strict);
+
+    free(domain);
+    free(problem);
+    return 0;
+}
@@ -0,0 +1,64 @@
+// SPDX-FileCopyrightText: 2024 Guilherme Puida Moreira <guilherme@puida.xyz>
+// SPDX-License-Identifier: BSD-3-Clause
+
+// measures the raw pddlp_scan_token loop. built twice: once against the
+// shared library and once with BENCH_INLINE, which compiles the tokenizer
+// into this file through the single-header build.
+
+#define _POSIX_C_SOURCE 200809L
+
+#ifdef BENCH_INLINE
+#define PDDLP_IMPLEMENTATION
+#include "pddlp_impl.h"
+#else
+#include "pddlp.h"
+#endif
+
+#include "bench.h"
+
+static uint64_t
+scan_all(const char *source)
+{
+    struct pddlp_tokenizer tokenizer;
+    pddlp_init_tokenizer(&tokenizer, source);
+
+    uint64_t token_count = 0;
+    while (pddlp_scan_token(&tokenizer).token_type != PDDLP_TOKEN_EOF)
+        token_count++;
+
+    return token_count;
+}
+
+int
+main(int argc, char **argv)
+{
+    size_t length;
+    char *source = bench_load_input(argc, argv, &length);
+    if (source == NULL)
+        return -1;
+
+    uint64_t token_count = 0;
+    uint64_t best = UINT64_MAX;
+
+    for (int run = 0; run < BENCH_RUNS; ++run) {
+        uint64_t start = bench_now();
+        token_count = scan_all(source);
+        uint64_t elapsed = bench_now() - start;
+
+        if (elapsed < best)
+            best = elapsed;
+    }
+
+#ifdef BENCH_INLINE
+    const char *mode = "inline";
+#else
+    const char *mode = "shared";
+#endif
+
+    printf("%s: %" PRIu64 " tokens, %.2f ms, %.2f ns/token, %.1f MB/s\n",
+        mode, token_count, best / 1e6, (double)best / token_count,
+        length / (best / 1e9) / 1e6);
+
+    free(source);
+    return 0;
+}
@@ -0,0 +1,268 @@
+// SPDX-FileCopyrightText: 2024 Guilherme Puida Moreira <guilherme@puida.xyz>
+// SPDX-License-Identifier: BSD-3-Clause
+
+// a load generator for pddlp-serve. starts the daemon given as the first
+// argument on a temporary socket, or connects to the socket given instead,
+// and sends a mix of validate, hash, count and tokenize requests against
+// one domain from a few connections, each with its own problem.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "bench.h"
+
+#include "../bin/serve.h"
+
+#include <pthread.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+
+#define CONNECTIONS 4
+#define REQUESTS 5000
+#define LOCATIONS 200
+#define STEPS 50
+
+struct request {
+    char *frame;
+    size_t length;
+};
+
+struct client {
+    pthread_t thread;
+    const char *path;
+    bool failed;
+
+    struct request requests[SERVE_KIND_COUNT];
+    struct serve_latency latency[SERVE_KIND_COUNT];
+};
+
+// the order requests are sent in.
+static const enum serve_kind mix[] = {
+    SERVE_VALIDATE, SERVE_HASH, SERVE_VALIDATE, SERVE_COUNT, SERVE_VALIDATE, SERVE_TOKENIZE,
+};
+
+static struct request
+build_request(enum serve_kind kind, const char **fields, int field_count)
+{
+    size_t length = 4 + 1;
+    for (int i = 0; i < field_count; ++i)
+        length += 4 + strlen(fields[i]);
+
+    struct request request = {malloc(length), length};
+    if (request.frame == NULL)
+        return request;
+
+    serve_put_u32(request.frame, (uint32_t)(length - 4));
+    request.frame[4] = (char)kind;
+
+    char *current = request.frame + 5;
+    for (int i = 0; i < field_count; ++i) {
+        size_t field_length = strlen(fields[i]);
+        serve_put_u32(current, (uint32_t)field_length);
+        memcpy(current + 4, fields[i], field_length);
+        current += 4 + field_length;
+    }
+
+    return request;
+}
+
+static int
+connect_socket(const char *path)
+{
+    struct sockaddr_un address = {.sun_family = AF_UNIX};
+    strncpy(address.sun_path, path, sizeof(address.sun_path) - 1);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd >= 0 && connect(fd, (struct sockaddr *)&address, sizeof(address)) < 0) {
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+// sends a request and reads its response into `*buffer`.
+static bool
+send_request(int fd, const struct request *request, char **buffer, size_t *capacity, uint32_t *length)
+{
+    struct iovec part = {request->frame, request->length};
+    return serve_write_full(fd, &part, 1) && serve_read_frame(fd, buffer, capacity, length) && *length > 0;
+}
+
+static void *
+run_client(void *context)
+{
+    struct client *client = context;
+    int fd = connect_socket(client->path);
+    if (fd < 0) {
+        client->failed = true;
+        return NULL;
+    }
+
+    char *response = NULL;
+    size_t capacity = 0;
+    uint32_t length;
+
+    for (int i = 0; i < REQUESTS; ++i) {
+        enum serve_kind kind = mix[i % (sizeof(mix) / sizeof(*mix))];
+
+        uint64_t start = bench_now();
+        if (!send_request(fd, &client->requests[kind], &response, &capacity, &length) || response[0] != SERVE_OK) {
+            client->failed = true;
+            break;
+        }
+        serve_latency_add(&client->latency[kind], bench_now() - start);
+    }
+
+    free(response);
+    close(fd);
+    return NULL;
+}
+
+static pid_t
+start_server(const char *server, const char *path)
+{
+    pid_t pid = fork();
+    if (pid == 0) {
+        execl(server, server, path, (char *)NULL);
+        _exit(127);
+    }
+
+    // waits up to five seconds for the socket.
+    for (int i = 0; pid > 0 && i < 500; ++i) {
+        int fd = connect_socket(path);
+        if (fd >= 0) {
+            close(fd);
+            return pid;
+        }
+
+        struct timespec delay = {0, 10000000};
+        nanosleep(&delay, NULL);
+    }
+
+    fprintf(stderr, "couldn't start %s\n", server);
+    if (pid > 0)
+        kill(pid, SIGTERM);
+    return -1;
+}
+
+int
+main(int argc, char **argv)
+{
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <pddlp-serve | socket>\n", argv[0]);
+        return -1;
+    }
+
+    char path[64];
+    pid_t server = 0;
+    struct stat info;
+
+    if (stat(argv[1], &info) == 0 && S_ISSOCK(info.st_mode)) {
+        snprintf(path, sizeof(path), "%s", argv[1]);
+    } else {
+        snprintf(path, sizeof(path), "/tmp/pddlp-serve-bench.%ld", (long)getpid());
+        if ((server = start_server(argv[1], path)) < 0)
+            return -1;
+    }
+
+    // a random walk of truck0 along the connected locations, as in
+    // bench/validate.c.
+    char plan[STEPS * 48];
+    size_t n = 0;
+    size_t location = 0;
+    uint64_t seed = 88172645463325252u;
+    for (int i = 0; i < STEPS; ++i) {
+        seed ^= seed << 13;
+        seed ^= seed >> 7;
+        seed ^= seed << 17;
+
+        size_t next = (location + (seed % 7 + 1) * 7919) % LOCATIONS;
+        n += sprintf(plan + n, "(drive truck0 loc%zu loc%zu)\n", location, next);
+        location = next;
+    }
+
+    static struct client clients[CONNECTIONS];
+    char *problems[CONNECTIONS];
+
+    for (int i = 0; i < CONNECTIONS; ++i) {
+        size_t length;
+        problems[i] = bench_generate_problem(LOCATIONS, &length);
+        if (problems[i] == NULL)
+            return -1;
+
+        // a comment tells the problems apart without changing them.
+        sprintf(strstr(problems[i], "(:goal"), "(:goal (and (at truck0 loc%zu)))) ; client %d\n", location, i);
+
+        const char *validate[] = {BENCH_DOMAIN, problems[i], plan};
+        const char *source[] = {problems[i]};
+        const char *domain[] = {BENCH_DOMAIN};
+
+        clients[i].path = path;
+        clients[i].requests[SERVE_VALIDATE] = build_request(SERVE_VALIDATE, validate, 3);
+        clients[i].requests[SERVE_HASH] = build_request(SERVE_HASH, source, 1);
+        clients[i].requests[SERVE_COUNT] = build_request(SERVE_COUNT, source, 1);
+        clients[i].requests[SERVE_TOKENIZE] = build_request(SERVE_TOKENIZE, domain, 1);
+    }
+
+    uint64_t start = bench_now();
+    for (int i = 0; i < CONNECTIONS; ++i)
+        pthread_create(&clients[i].thread, NULL, run_client, &clients[i]);
+    for (int i = 0; i < CONNECTIONS; ++i)
+        pthread_join(clients[i].thread, NULL);
+    uint64_t elapsed = bench_now() - start;
+
+    static struct serve_latency totals[SERVE_KIND_COUNT];
+    int status = 0;
+
+    for (int i = 0; i < CONNECTIONS; ++i) {
+        if (clients[i].failed)
+            status = -1;
+        for (int kind = 1; kind < SERVE_KIND_COUNT; ++kind)
+            serve_latency_merge(&totals[kind], &clients[i].latency[kind]);
+    }
+
+    if (status != 0)
+        fprintf(stderr, "some requests failed\n");
+
+    for (int kind = 1; kind < SERVE_KIND_COUNT; ++kind) {
+        if (totals[kind].count == 0)
+            continue;
+
+        printf("%s: %" PRIu64 " requests, p50 %.1f us, p99 %.1f us\n", serve_kind_names[kind], totals[kind].count,
+            serve_latency_percentile(&totals[kind], 50) / 1e3, serve_latency_percentile(&totals[kind], 99) / 1e3);
+    }
+
+    printf("%d connections, %d requests, %.2f ms, %.0f requests/s\n", CONNECTIONS, CONNECTIONS * REQUESTS,
+        elapsed / 1e6, CONNECTIONS * REQUESTS / (elapsed / 1e9));
+
+    // what the server measured.
+    int fd = connect_socket(path);
+    struct request stats = build_request(SERVE_STATS, NULL, 0);
+    char *response = NULL;
+    size_t capacity = 0;
+    uint32_t length;
+
+    if (fd >= 0 && stats.frame && send_request(fd, &stats, &response, &capacity, &length))
+        printf("server:\n%.*s", (int)length - 1, response + 1);
+
+    if (fd >= 0)
+        close(fd);
+    free(response);
+    free(stats.frame);
+
+    if (server > 0) {
+        kill(server, SIGTERM);
+        waitpid(server, NULL, 0);
+    }
+
+    for (int i = 0; i < CONNECTIONS; ++i) {
+        for (int kind = 1; kind < SERVE_KIND_COUNT; ++kind)
+            free(clients[i].requests[kind].frame);
+        free(problems[i]);
+    }
+
+    return status;
+}
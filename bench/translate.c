@@ -0,0 +1,94 @@
+// SPDX-FileCopyrightText: 2024 Guilherme Puida Moreira <guilherme@puida.xyz>
+// SPDX-License-Identifier: BSD-3-Clause
+
+// times each stage of translating a problem into a finite-domain task:
+// grounding the reachable operators, finding the invariants and variables,
+// and writing the task out, here into a sink that only counts the bytes.
+// takes a domain and a problem, or generates an ipc-style logistics problem.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "pddlp.h"
+
+#include "bench.h"
+
+#define PACKAGES 400
+
+static bool
+count_bytes(void *context, const char *data, size_t length)
+{
+    (void)data;
+    *(size_t *)context += length;
+    return true;
+}
+
+int
+main(int argc, char **argv)
+{
+    char *domain_source = argc > 2 ? bench_read_file(argv[1]) : strdup(BENCH_LOGISTICS_DOMAIN);
+    char *problem_source = argc > 2 ? bench_read_file(argv[2]) : bench_generate_logistics(PACKAGES);
+    if (domain_source == NULL || problem_source == NULL)
+        return -1;
+
+    struct pddlp_error error;
+    struct pddlp_domain *domain = pddlp_parse_domain(domain_source, &error);
+    struct pddlp_problem *problem = domain ? pddlp_parse_problem(domain, problem_source, &error) : NULL;
+    if (problem == NULL) {
+        fprintf(stderr, "%s at %" PRIu64 ":%" PRIu64 "\n", error.message, error.line, error.column);
+        return -1;
+    }
+
+    uint64_t start = bench_now();
+    struct pddlp_strips *strips = pddlp_ground_reachable(problem, &error);
+    uint64_t ground_time = bench_now() - start;
+    if (strips == NULL) {
+        fprintf(stderr, "%s\n", error.message);
+        return -1;
+    }
+
+    struct pddlp_sas *sas = NULL;
+    uint64_t translate_time = UINT64_MAX, write_time = UINT64_MAX;
+    size_t bytes = 0;
+
+    for (int run = 0; run < BENCH_RUNS; ++run) {
+        pddlp_free_sas(sas);
+
+        start = bench_now();
+        sas = pddlp_translate(strips, &error);
+        uint64_t elapsed = bench_now() - start;
+        if (sas == NULL) {
+            fprintf(stderr, "%s\n", error.message);
+            return -1;
+        }
+
+        if (elapsed < translate_time)
+            translate_time = elapsed;
+
+        bytes = 0;
+        start = bench_now();
+        if (!pddlp_write_sas(sas, count_bytes, &bytes, &error))
+            return -1;
+        elapsed = bench_now() - start;
+
+        if (elapsed < write_time)
+            write_time = elapsed;
+    }
+
+    uint32_t multi_valued = 0;
+    for (uint32_t v = 0; v < sas->variable_count; ++v)
+        multi_valued += sas->variable_first[v + 1] - sas->variable_first[v] > 1;
+
+    printf("ground: %" PRIu32 " operators, %" PRIu32 " facts, %.2f ms\n", strips->operator_count,
+        strips->fact_count, ground_time / 1e6);
+    printf("translate: %" PRIu32 " variables (%" PRIu32 " multi-valued), %" PRIu32 " invariants, %.2f ms\n",
+        sas->variable_count, multi_valued, sas->invariant_count, translate_time / 1e6);
+    printf("write: %zu bytes, %.2f ms, %.1f MB/s\n", bytes, write_time / 1e6, bytes / (write_time / 1e9) / 1e6);
+
+    pddlp_free_sas(sas);
+    pddlp_free_strips(strips);
+    pddlp_free_problem(problem);
+    pddlp_release_domain(domain);
+    free(domain_source);
+    free(problem_source);
+    return 0;
+}
@@ -0,0 +1,140 @@
+// SPDX-FileCopyrightText: 2024 Guilherme Puida Moreira <guilherme@puida.xyz>
+// SPDX-License-Identifier: BSD-3-Clause
+
+// measures updates to a parsed problem, the way a replanning loop makes
+// them: each round moves some trucks and changes a road, with the posting
+// lists built beforehand so they have to follow. the time of a round is set
+// against parsing the problem again, and writing the updated problem out is
+// timed too.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "pddlp.h"
+
+#include "bench.h"
+
+#define ROUNDS 1000
+#define MOVES 16
+
+static uint64_t
+bench_random(uint64_t *state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+static bool
+count_output(void *context, const char *data, size_t length)
+{
+    (void)data;
+    *(size_t *)context += length;
+    return true;
+}
+
+int
+main(int argc, char **argv)
+{
+    struct pddlp_error error;
+    struct pddlp_domain *domain = pddlp_parse_domain(BENCH_DOMAIN, &error);
+    if (domain == NULL)
+        return -1;
+
+    size_t length;
+    char *source = bench_load_input(argc, argv, &length);
+    if (source == NULL)
+        return -1;
+
+    uint64_t start = bench_now();
+    struct pddlp_problem *problem = pddlp_parse_problem(domain, source, &error);
+    uint64_t parse = bench_now() - start;
+
+    if (problem == NULL) {
+        fprintf(stderr, "%s at %" PRIu64 ":%" PRIu64 "\n", error.message, error.line, error.column);
+        return -1;
+    }
+
+    printf("parse: %" PRIu32 " facts, %.2f ms\n", problem->fact_count, parse / 1e6);
+
+    uint32_t at = pddlp_find_predicate(domain, "at", 2);
+    uint32_t connected = pddlp_find_predicate(domain, "connected", 9);
+    uint32_t truck = pddlp_find_type(domain, "truck", 5);
+    uint32_t location = pddlp_find_type(domain, "location", 8);
+    const uint32_t *trucks = problem->type_objects + problem->type_objects_first[truck];
+    uint32_t truck_count = problem->type_objects_first[truck + 1] - problem->type_objects_first[truck];
+    const uint32_t *locations = problem->type_objects + problem->type_objects_first[location];
+    uint32_t location_count = problem->type_objects_first[location + 1] - problem->type_objects_first[location];
+
+    // builds the lists of every position.
+    uint32_t matches[64];
+    uint32_t first[2] = { locations[0], PDDLP_NONE };
+    uint32_t second[2] = { PDDLP_NONE, locations[0] };
+    if (pddlp_match_facts(problem, at, first, matches, 64) == PDDLP_NONE ||
+        pddlp_match_facts(problem, at, second, matches, 64) == PDDLP_NONE ||
+        pddlp_match_facts(problem, connected, first, matches, 64) == PDDLP_NONE ||
+        pddlp_match_facts(problem, connected, second, matches, 64) == PDDLP_NONE)
+        return -1;
+
+    // a truck is moved by removing where it is and adding where it goes.
+    uint64_t state = 88172645463325252u;
+    uint32_t args[2 * MOVES + 2][2];
+    struct pddlp_change changes[2 * MOVES + 2];
+    uint64_t elapsed = 0;
+
+    for (uint32_t round = 0; round < ROUNDS; ++round) {
+        uint32_t n = 0;
+        for (uint32_t i = 0; i < MOVES; ++i) {
+            uint32_t t = trucks[bench_random(&state) % truck_count];
+            uint32_t here[2] = { t, PDDLP_NONE };
+            if (pddlp_match_facts(problem, at, here, matches, 1) > 0) {
+                memcpy(args[n], problem->fact_args + problem->fact_args_first[matches[0]], sizeof(args[n]));
+                changes[n] = (struct pddlp_change) { PDDLP_CHANGE_REMOVE, at, args[n], 0 };
+                n++;
+            }
+
+            args[n][0] = t;
+            args[n][1] = locations[bench_random(&state) % location_count];
+            changes[n] = (struct pddlp_change) { PDDLP_CHANGE_ADD, at, args[n], 0 };
+            n++;
+        }
+
+        // a road closes and another one opens.
+        uint32_t fact = bench_random(&state) % problem->fact_count;
+        if (problem->fact_predicates[fact] == connected) {
+            memcpy(args[n], problem->fact_args + problem->fact_args_first[fact], sizeof(args[n]));
+            changes[n] = (struct pddlp_change) { PDDLP_CHANGE_REMOVE, connected, args[n], 0 };
+            n++;
+        }
+
+        args[n][0] = locations[bench_random(&state) % location_count];
+        args[n][1] = locations[bench_random(&state) % location_count];
+        changes[n] = (struct pddlp_change) { PDDLP_CHANGE_ADD, connected, args[n], 0 };
+        n++;
+
+        start = bench_now();
+        if (!pddlp_apply_changes(problem, changes, n, &error)) {
+            fprintf(stderr, "%s\n", error.message);
+            return -1;
+        }
+        elapsed += bench_now() - start;
+    }
+
+    printf("update: %d rounds, %" PRIu32 " facts, %.2f us/round, %.0fx faster than parsing again\n", ROUNDS,
+        problem->fact_count, elapsed / 1e3 / ROUNDS, (double)parse * ROUNDS / elapsed);
+
+    size_t written = 0;
+    start = bench_now();
+    if (!pddlp_write_problem(problem, source, count_output, &written, &error)) {
+        fprintf(stderr, "%s\n", error.message);
+        return -1;
+    }
+    elapsed = bench_now() - start;
+
+    printf("write: %zu bytes, %.2f ms, %.0f MB/s\n", written, elapsed / 1e6, written / (elapsed / 1e3));
+
+    free(source);
+    pddlp_free_problem(problem);
+    pddlp_release_domain(domain);
+    return 0;
+}
@@ -0,0 +1,86 @@
+// SPDX-FileCopyrightText: 2024 Guilherme Puida Moreira <guilherme@puida.xyz>
+// SPDX-License-Identifier: BSD-3-Clause
+
+// measures plan validation. grounds a generated problem, writes a long
+// random walk of truck0 along the connected locations, and validates it.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "pddlp.h"
+
+#include "bench.h"
+
+#define LOCATIONS 2000
+#define STEPS 1000000
+
+int
+main(void)
+{
+    struct pddlp_error error;
+    struct pddlp_domain *domain = pddlp_parse_domain(BENCH_DOMAIN, &error);
+    if (domain == NULL)
+        return -1;
+
+    // truck0 starts at loc0, and each location is connected to the next
+    // ones at multiples of 7919.
+    char *plan = malloc((size_t)STEPS * 48);
+    if (plan == NULL)
+        return -1;
+
+    size_t n = 0;
+    size_t location = 0;
+    uint64_t seed = 88172645463325252u;
+    for (int i = 0; i < STEPS; ++i) {
+        seed ^= seed << 13;
+        seed ^= seed >> 7;
+        seed ^= seed << 17;
+
+        size_t next = (location + (seed % 7 + 1) * 7919) % LOCATIONS;
+        n += sprintf(plan + n, "(drive truck0 loc%zu loc%zu)\n", location, next);
+        location = next;
+    }
+
+    // the goal is moved to where the walk ends.
+    size_t length;
+    char *source = bench_generate_problem(LOCATIONS, &length);
+    if (source == NULL)
+        return -1;
+
+    sprintf(strstr(source, "(:goal"), "(:goal (and (at truck0 loc%zu))))\n", location);
+
+    struct pddlp_problem *problem = pddlp_parse_problem(domain, source, &error);
+    struct pddlp_strips *strips = problem ? pddlp_ground(problem, 0, &error) : NULL;
+    struct pddlp_validator *validator = strips ? pddlp_new_validator(strips, &error) : NULL;
+    if (validator == NULL) {
+        fprintf(stderr, "%s\n", error.message);
+        return -1;
+    }
+
+    struct pddlp_plan_result result;
+    uint64_t best = UINT64_MAX;
+
+    for (int run = 0; run < BENCH_RUNS; ++run) {
+        uint64_t start = bench_now();
+        bool valid = pddlp_validate_plan(validator, plan, &result);
+        uint64_t elapsed = bench_now() - start;
+
+        if (!valid) {
+            fprintf(stderr, "step %" PRIu32 ": %s\n", result.step, result.message);
+            return -1;
+        }
+
+        if (elapsed < best)
+            best = elapsed;
+    }
+
+    printf("%" PRIu32 " operators, %d steps, %.2f ms, %.1f ns/step, %.2fM steps/s\n",
+        strips->operator_count, STEPS, best / 1e6, (double)best / STEPS, STEPS / (best / 1e9) / 1e6);
+
+    pddlp_free_validator(validator);
+    pddlp_free_strips(strips);
+    pddlp_free_problem(problem);
+    pddlp_release_domain(domain);
+    free(plan);
+    free(source);
+    return 0;
+}
@@ -0,0 +1,243 @@
+// SPDX-FileCopyrightText: 2024 Guilherme Puida Moreira <guilherme@puida.xyz>
+// SPDX-License-Identifier: BSD-3-Clause
+
+// needed for fseeko/ftello and clock_gettime.
+#define _POSIX_C_SOURCE 200809L
+#define _FILE_OFFSET_BITS 64
+
+#include "pddlp.h"
+#include "tool.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// the mistakes of one file, up to `limit` when it isn't 0. with a cache they
+// are also recorded, as whether the file is valid and then the line, column,
+// length and text of each message.
+struct report {
+    const char *file_name;
+    uint64_t count;
+    uint64_t limit;
+
+    bool recording;
+    bool failed;
+    unsigned char *record;
+    size_t record_size;
+    size_t record_capacity;
+};
+
+static void
+record(struct report *report, const void *data, size_t size)
+{
+    if (report->record_size + size > report->record_capacity) {
+        size_t capacity = report->record_capacity ? report->record_capacity * 2 : 256;
+        while (capacity < report->record_size + size)
+            capacity *= 2;
+
+        unsigned char *grown = realloc(report->record, capacity);
+        if (grown == NULL) {
+            report->failed = true;
+            return;
+        }
+
+        report->record = grown;
+        report->record_capacity = capacity;
+    }
+
+    memcpy(report->record + report->record_size, data, size);
+    report->record_size += size;
+}
+
+static void
+report_error(struct report *report, uint64_t line, uint64_t column, const char *message, uint32_t length)
+{
+    fprintf(stderr, "%s:%" PRIu64 ":%" PRIu64 ": %.*s\n", report->file_name, line, column, (int)length, message);
+    report->count++;
+
+    if (report->recording) {
+        record(report, &line, sizeof(line));
+        record(report, &column, sizeof(column));
+        record(report, &length, sizeof(length));
+        record(report, message, length);
+    }
+}
+
+static bool
+print_error(void *context, const struct pddlp_error *error)
+{
+    struct report *report = context;
+    report_error(report, error->line, error->column, error->message, strlen(error->message));
+    return report->limit == 0 || report->count < report->limit;
+}
+
+// starts a report, recording it when there is a cache.
+static void
+begin_report(struct report *report, const char *file_name, uint64_t limit, const struct pddlp_cache *cache)
+{
+    report->file_name = file_name;
+    report->count = 0;
+    report->limit = limit;
+    report->recording = cache != NULL;
+    report->failed = false;
+    report->record_size = 0;
+
+    bool valid = true;
+    if (report->recording)
+        record(report, &valid, sizeof(valid));
+}
+
+// stores the report of a file that was checked.
+static bool
+store_report(struct report *report, struct pddlp_cache *cache, uint64_t hash, bool valid)
+{
+    if (cache == NULL)
+        return true;
+
+    memcpy(report->record, &valid, sizeof(valid));
+    return !report->failed && report->record_size <= UINT32_MAX &&
+        pddlp_cache_store(cache, hash, PDDLP_CACHE_CHECK, report->record, report->record_size);
+}
+
+// prints the errors the cache has for a file again, and whether it was
+// valid. returns false when the cache has nothing for it.
+static bool
+replay_report(struct report *report, const struct pddlp_cache *cache, uint64_t hash, bool *valid)
+{
+    uint32_t size;
+    const unsigned char *data = cache ? pddlp_cache_find(cache, hash, PDDLP_CACHE_CHECK, &size) : NULL;
+    if (data == NULL || size < sizeof(*valid))
+        return false;
+
+    const unsigned char *end = data + size;
+    memcpy(valid, data, sizeof(*valid));
+    data += sizeof(*valid);
+    report->recording = false;
+
+    while (end - data >= 20) {
+        uint64_t line, column;
+        uint32_t length;
+        memcpy(&line, data, sizeof(line));
+        memcpy(&column, data + 8, sizeof(column));
+        memcpy(&length, data + 16, sizeof(length));
+        data += 20;
+
+        if ((size_t)(end - data) < length)
+            break;
+
+        report_error(report, line, column, (const char *)data, length);
+        data += length;
+    }
+
+    return true;
+}
+
+int
+main(int argc, char **argv)
+{
+    uint64_t limit = 0;
+    const char *cache_path = NULL;
+
+    while (argc > 2 && argv[1][0] == '-') {
+        if (strcmp(argv[1], "-n") == 0)
+            limit = strtoull(argv[2], NULL, 10);
+        else if (strcmp(argv[1], "-c") == 0)
+            cache_path = argv[2];
+        else
+            break;
+        argc -= 2;
+        argv += 2;
+    }
+
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s [-n errors] [-c cache] <domain> <problem>...\n", argv[0]);
+        return -1;
+    }
+
+    struct pddlp_error error;
+    struct pddlp_cache *cache = NULL;
+    if (cache_path != NULL && (cache = pddlp_open_cache(cache_path, &error)) == NULL) {
+        fprintf(stderr, "%s: %s\n", cache_path, error.message);
+        return -1;
+    }
+
+    // what is reported depends on the limit, and for problems on the domain
+    // too, so both go into the hashes.
+    uint64_t domain_hash;
+    char *domain_source = tool_read_file(argv[1], limit, &domain_hash);
+    if (domain_source == NULL) {
+        pddlp_free_cache(cache);
+        return -1;
+    }
+
+    double start = tool_now_ms();
+    struct report report = { 0 };
+    struct pddlp_checker *checker = NULL;
+    bool valid;
+    int status = 0;
+
+    begin_report(&report, argv[1], limit, cache);
+    if (!replay_report(&report, cache, domain_hash, &valid)) {
+        checker = pddlp_new_checker(domain_source, print_error, &report, &valid);
+        if (checker == NULL || !store_report(&report, cache, domain_hash, valid))
+            status = -1;
+    }
+
+    status = status < 0 || valid ? status : 1;
+    uint64_t error_count = report.count;
+    int hits = 0;
+
+    // each problem is read and checked in turn, so only one is in memory.
+    // the domain is only checked when some problem isn't in the cache.
+    for (int i = 2; i < argc; ++i) {
+        uint64_t hash;
+        char *problem_source = tool_read_file(argv[i], domain_hash, &hash);
+        if (problem_source == NULL) {
+            status = -1;
+            continue;
+        }
+
+        begin_report(&report, argv[i], limit, cache);
+        if (replay_report(&report, cache, hash, &valid)) {
+            hits++;
+        } else {
+            // the domain's own mistakes were already replayed.
+            bool domain_valid;
+            if (checker == NULL)
+                checker = pddlp_new_checker(domain_source, NULL, NULL, &domain_valid);
+
+            if (checker == NULL) {
+                status = -1;
+            } else {
+                valid = pddlp_check_problem(checker, problem_source, print_error, &report);
+                if (!store_report(&report, cache, hash, valid))
+                    status = -1;
+            }
+        }
+
+        if (!valid)
+            status = status < 0 ? status : 1;
+
+        error_count += report.count;
+        free(problem_source);
+    }
+
+    if (cache != NULL && !pddlp_save_cache(cache, &error)) {
+        fprintf(stderr, "%s: %s\n", cache_path, error.message);
+        status = -1;
+    }
+
+    double elapsed = tool_now_ms() - start;
+    if (cache != NULL)
+        printf("checked %d problems, %d from the cache, %" PRIu64 " errors, %.2f ms\n", argc - 2, hits,
+            error_count, elapsed);
+    else
+        printf("checked %d problems, %" PRIu64 " errors, %.2f ms\n", argc - 2, error_count, elapsed);
+
+    free(report.record);
+    free(domain_source);
+    pddlp_free_checker(checker);
+    pddlp_free_cache(cache);
+    return status;
+}
@@ -1,22 +1,38 @@
 // SPDX-FileCopyrightText: 2023 Guilherme Puida Moreira <guilherme@puida.xyz>
 // SPDX-License-Identifier: BSD-3-Clause
 
+// needed for fseeko/ftello, which work with files larger than 2GB, and
+// clock_gettime.
+#define _POSIX_C_SOURCE 200809L
+#define _FILE_OFFSET_BITS 64
+
 #include "pddlp.h"
+#include "tool.h"
 
+#include <inttypes.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 struct count_tokens_result {
-    int token_count;
-    int error_count;
+    uint64_t token_count;
+    uint64_t error_count;
 };
 
 static struct count_tokens_result
-count_tokens(const char *source)
+count_tokens(const char *source, struct pddlp_stats *stats)
 {
 struct pddlp_tokenizer tokenizer;
     pddlp_init_tokenizer(&tokenizer, source);
 
+#ifdef PDDLP_STATS
+    if (stats)
+        pddlp_attach_stats(&tokenizer, stats);
+#else
+    (void)stats;
+#endif
+
     struct count_tokens_result result = {
         .token_count = 0,
         .error_count = 0,
@@ -38,33 +54,156 @@ struct pddlp_tokenizer tokenizer;
     return result;
 }
 
+static void
+print_counts(const char *key, const uint64_t *counts, const char **names, int count)
+{
+    printf("  \"%s\": {", key);
+
+    bool first = true;
+    for (int i = 0; i < count; ++i) {
+        if (!counts[i])
+            continue;
+
+        printf("%s\n    \"%s\": %" PRIu64, first ? "" : ",", names[i], counts[i]);
+        first = false;
+    }
+
+    printf("%s},\n", first ? "" : "\n  ");
+}
+
+static void
+print_stats_json(struct count_tokens_result result, const struct pddlp_stats *stats)
+{
+    printf("{\n");
+    printf("  \"tokens\": %" PRIu64 ",\n", result.token_count);
+    printf("  \"errors\": %" PRIu64 ",\n", result.error_count);
+
+    print_counts("token_counts", stats->token_counts,
+        pddlp_token_type_names, PDDLP_TOKEN_TYPE_COUNT);
+    print_counts("error_counts", stats->error_counts,
+        pddlp_token_error_messages, PDDLP_TOKEN_ERROR_COUNT);
+    print_counts("section_nanoseconds", stats->section_nanoseconds,
+        pddlp_token_type_names, PDDLP_TOKEN_TYPE_COUNT);
+
+    printf("  \"bytes\": {\n");
+    printf("    \"tokens\": %" PRIu64 ",\n", stats->token_bytes);
+    printf("    \"whitespace\": %" PRIu64 ",\n", stats->whitespace_bytes);
+    printf("    \"comments\": %" PRIu64 "\n", stats->comment_bytes);
+    printf("  },\n");
+
+    printf("  \"keywords\": {\n");
+    printf("    \"hits\": %" PRIu64 ",\n", stats->keyword_hits);
+    printf("    \"misses\": %" PRIu64 "\n", stats->keyword_misses);
+    printf("  },\n");
+
+    printf("  \"name_lengths\": [");
+    for (int i = 0; i < PDDLP_STATS_NAME_LENGTHS; ++i)
+        printf("%s%" PRIu64, i ? ", " : "", stats->name_lengths[i]);
+    printf("]\n");
+
+    printf("}\n");
+}
+
+// what the cache keeps for a file. the stats are only there for
+// PDDLP_CACHE_STATS.
+struct cached_count {
+    struct count_tokens_result result;
+    struct pddlp_stats stats;
+};
+
 int
 main(int argc, char **argv)
 {
+    bool want_stats = false;
+    const char *cache_path = NULL;
+
+    for (;;) {
+        if (argc > 1 && strcmp(argv[1], "--stats") == 0) {
+            want_stats = true;
+            argc--;
+            argv++;
+        } else if (argc > 2 && strcmp(argv[1], "--cache") == 0) {
+            cache_path = argv[2];
+            argc -= 2;
+            argv += 2;
+        } else {
+            break;
+        }
+    }
+
     if (argc < 2) {
-        fprintf(stderr, "usage: %s <file>\n", argv[0]);
+        fprintf(stderr, "usage: %s [--stats] [--cache <cache>] <file>...\n", argv[0]);
         return -1;
     }
 
-    char *file_name = argv[1];
+#ifndef PDDLP_STATS
+    if (want_stats) {
+        fprintf(stderr, "--stats requires pddlp to be built with -Dwith_stats=true\n");
+        return -1;
+    }
+#endif
 
-    FILE *file = fopen(file_name, "r");
-    if (file == NULL) {
-        fprintf(stderr, "couldn't open %s\n", file_name);
+    struct pddlp_error error;
+    struct pddlp_cache *cache = NULL;
+    if (cache_path != NULL && (cache = pddlp_open_cache(cache_path, &error)) == NULL) {
+        fprintf(stderr, "%s: %s\n", cache_path, error.message);
         return -1;
     }
 
-    fseek(file, 0, SEEK_END);
-    long file_size = ftell(file);
-    rewind(file);
+    enum pddlp_cache_kind kind = want_stats ? PDDLP_CACHE_STATS : PDDLP_CACHE_TOKENS;
+    uint32_t cached_size = want_stats ? sizeof(struct cached_count) : sizeof(struct count_tokens_result);
+    double start = tool_now_ms();
+    int status = 0;
+    int hits = 0;
+
+    for (int i = 1; i < argc; ++i) {
+        const char *file_name = argv[i];
+
+        uint64_t hash;
+        char *source = tool_read_file(file_name, 0, &hash);
+        if (source == NULL) {
+            status = -1;
+            continue;
+        }
+
+        struct cached_count counted;
+        pddlp_init_stats(&counted.stats);
+
+        uint32_t size;
+        const void *cached = cache ? pddlp_cache_find(cache, hash, kind, &size) : NULL;
+        if (cached != NULL && size == cached_size) {
+            memcpy(&counted, cached, size);
+            hits++;
+        } else {
+            counted.result = count_tokens(source, want_stats ? &counted.stats : NULL);
+            if (cache != NULL && !pddlp_cache_store(cache, hash, kind, &counted, cached_size)) {
+                fprintf(stderr, "%s: out of memory\n", cache_path);
+                status = -1;
+            }
+        }
+
+        free(source);
+
+        if (want_stats)
+            print_stats_json(counted.result, &counted.stats);
+        else if (argc == 2)
+            printf("tokens: %" PRIu64 "\nerrors: %" PRIu64 "\n",
+                counted.result.token_count, counted.result.error_count);
+        else
+            printf("%s: %" PRIu64 " tokens, %" PRIu64 " errors\n",
+                file_name, counted.result.token_count, counted.result.error_count);
+    }
+
+    if (cache != NULL && !pddlp_save_cache(cache, &error)) {
+        fprintf(stderr, "%s: %s\n", cache_path, error.message);
+        status = -1;
+    }
 
-    char *source = malloc(sizeof(*source) * file_size + 1);
-    long read_amount = fread(source, 1, file_size, file);
-    source[read_amount] = 0;
-    fclose(file);
+    if (!want_stats && cache != NULL)
+        printf("counted %d files, %d from the cache, %.2f ms\n", argc - 1, hits, tool_now_ms() - start);
+    else if (!want_stats && argc > 2)
+        printf("counted %d files, %.2f ms\n", argc - 1, tool_now_ms() - start);
 
-    struct count_tokens_result result = count_tokens(source);
-    printf("tokens: %d\nerrors: %d\n", result.token_count, result.error_count);
-    free(source);
-    return 0;
+    pddlp_free_cache(cache);
+    return status;
 }
@@ -0,0 +1,115 @@
+// SPDX-FileCopyrightText: 2024 Guilherme Puida Moreira <guilherme@puida.xyz>
+// SPDX-License-Identifier: BSD-3-Clause
+
+// needed for fseeko/ftello and clock_gettime.
+#define _POSIX_C_SOURCE 200809L
+#define _FILE_OFFSET_BITS 64
+
+#include "pddlp.h"
+#include "tool.h"
+
+#include <inttypes.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+int
+main(int argc, char **argv)
+{
+    unsigned threads = 0;
+    size_t budget = 0;
+    bool reachable = false;
+    bool valid = true;
+
+    while (argc > 2 && argv[1][0] == '-') {
+        if (strcmp(argv[1], "-r") == 0) {
+            reachable = true;
+            argc -= 1;
+            argv += 1;
+            continue;
+        }
+
+        uint64_t number = 0;
+        if (strcmp(argv[1], "-j") == 0) {
+            valid = tool_parse_number(argv[2], UINT_MAX, &number);
+            threads = (unsigned)number;
+        } else if (strcmp(argv[1], "-m") == 0) {
+            valid = tool_parse_number(argv[2], SIZE_MAX >> 20, &number);
+            budget = (size_t)number << 20;
+        } else {
+            break;
+        }
+
+        if (!valid)
+            break;
+        argc -= 2;
+        argv += 2;
+    }
+
+    if (!valid || argc < 3) {
+        fprintf(stderr, "usage: %s [-r] [-j threads] [-m megabytes] <domain> <problem>\n", argv[0]);
+        return -1;
+    }
+
+    // counts what the library allocates, up to the budget when there is one.
+    struct pddlp_accounting *accounting = pddlp_new_accounting(NULL, budget);
+    if (accounting == NULL)
+        return -1;
+
+    struct pddlp_allocator allocator = pddlp_accounting_allocator(accounting);
+    pddlp_set_allocator(&allocator);
+
+    char *domain_source = tool_read_file(argv[1], 0, NULL);
+    char *problem_source = tool_read_file(argv[2], 0, NULL);
+    if (domain_source == NULL || problem_source == NULL)
+        return -1;
+
+    int status = -1;
+    struct pddlp_error error;
+    struct pddlp_problem *problem = NULL;
+    struct pddlp_strips *strips = NULL;
+
+    double start = tool_now_ms();
+
+    struct pddlp_domain *domain = pddlp_parse_domain(domain_source, &error);
+    if (domain == NULL) {
+        tool_print_error(argv[1], &error);
+        goto done;
+    }
+
+    problem = pddlp_parse_problem(domain, problem_source, &error);
+    if (problem == NULL) {
+        tool_print_error(argv[2], &error);
+        goto done;
+    }
+
+    double parsed = tool_now_ms();
+
+    strips = reachable ? pddlp_ground_reachable(problem, &error) : pddlp_ground(problem, threads, &error);
+    if (strips == NULL) {
+        fprintf(stderr, "%s\n", error.message);
+        goto done;
+    }
+
+    double grounded = tool_now_ms();
+
+    printf("facts: %" PRIu32 "\n", strips->fact_count);
+    printf("operators: %" PRIu32 "\n", strips->operator_count);
+    printf("parse: %.2f ms\n", parsed - start);
+    printf("ground: %.2f ms\n", grounded - parsed);
+    printf("memory: %zu bytes\n", strips->memory);
+    status = 0;
+
+done:
+    pddlp_free_strips(strips);
+    pddlp_free_problem(problem);
+    pddlp_release_domain(domain);
+    free(domain_source);
+    free(problem_source);
+
+    tool_print_memory(accounting);
+    pddlp_set_allocator(NULL);
+    pddlp_free_accounting(accounting);
+    return status;
+}
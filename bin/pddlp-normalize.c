@@ -0,0 +1,62 @@
+// SPDX-FileCopyrightText: 2024 Guilherme Puida Moreira <guilherme@puida.xyz>
+// SPDX-License-Identifier: BSD-3-Clause
+
+// needed for fseeko/ftello.
+#define _POSIX_C_SOURCE 200809L
+#define _FILE_OFFSET_BITS 64
+
+#include "pddlp.h"
+#include "tool.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static bool
+write_stdout(void *context, const char *data, size_t length)
+{
+    (void)context;
+    return fwrite(data, 1, length, stdout) == length;
+}
+
+int
+main(int argc, char **argv)
+{
+    bool hash_only = argc > 1 && strcmp(argv[1], "--hash") == 0;
+    if (hash_only) {
+        argc--;
+        argv++;
+    }
+
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s [--hash] <file>...\n", argv[0]);
+        return -1;
+    }
+
+    int status = 0;
+
+    for (int i = 1; i < argc; ++i) {
+        char *source = tool_read_file(argv[i], 0, NULL);
+        if (source == NULL) {
+            status = -1;
+            continue;
+        }
+
+        struct pddlp_error error;
+        struct pddlp_hash128 hash;
+
+        if (!pddlp_normalize(source, hash_only ? NULL : write_stdout, NULL, &hash, &error)) {
+            fprintf(stderr, "%s:%" PRIu64 ":%" PRIu64 ": %s\n", argv[i], error.line, error.column, error.message);
+            status = -1;
+        } else if (hash_only) {
+            printf("%016" PRIx64 "%016" PRIx64 "  %s\n", hash.high, hash.low, argv[i]);
+        } else {
+            putchar('\n');
+        }
+
+        free(source);
+    }
+
+    return status;
+}
@@ -0,0 +1,1202 @@
+// SPDX-FileCopyrightText: 2024 Guilherme Puida Moreira <guilherme@puida.xyz>
+// SPDX-License-Identifier: BSD-3-Clause
+
+// a daemon that tokenizes, hashes and validates over a unix socket, see
+// serve.h for the protocol. parsed domains and grounded problems stay in
+// lru caches keyed by a hash of their text, so requests against the same
+// few domains don't parse them again.
+//
+// the main thread polls the idle connections and reads their requests as
+// the bytes come in, without blocking. only whole requests are handed to a
+// pool of workers, so any number of connections share the workers, and a
+// client that stops halfway through a request holds nothing but its own
+// buffer.
+
+// needed for sigaction, sigwait and clock_gettime.
+#define _POSIX_C_SOURCE 200809L
+
+#include "pddlp.h"
+#include "serve.h"
+#include "tool.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MAX_FIELDS 1024
+
+// a parsed domain, or a problem grounded against one with its validator.
+// problems hold a reference to their domain, so evicting the domain doesn't
+// free it. entries still in use are freed when the last user releases them.
+struct cache_entry {
+    struct cache_entry *previous;
+    struct cache_entry *next;
+
+    uint64_t hash;
+    char *source;
+    size_t length;
+    unsigned references;
+    bool evicted;
+
+    struct pddlp_domain *domain;
+    struct pddlp_problem *problem;
+    struct pddlp_strips *strips;
+    struct pddlp_validator *validator;
+};
+
+struct cache {
+    pthread_mutex_t lock;
+
+    // entries and their copies of the source are allocated through it.
+    const struct pddlp_allocator *allocator;
+
+    // most recently used first.
+    struct cache_entry *first;
+    struct cache_entry *last;
+    unsigned count;
+    unsigned capacity;
+
+    uint64_t hits;
+    uint64_t misses;
+};
+
+// a response. the buffer is allocated through `allocator`, or realloc when
+// it is NULL, and a buffer that can't grow sets `failed`.
+struct output {
+    const struct pddlp_allocator *allocator;
+    char *data;
+    size_t length;
+    size_t capacity;
+    bool failed;
+};
+
+struct field {
+    char *data;
+    uint32_t length;
+};
+
+// a client, with the frame it is sending. `received` counts the bytes of
+// the frame read so far, the 4 of the header included, and `length` is set
+// once those are in. the frame is allocated through the library's
+// allocator, so it counts against the budget.
+struct connection {
+    int fd;
+
+    unsigned char header[4];
+    uint32_t length;
+    size_t received;
+
+    char *frame;
+    size_t capacity;
+};
+
+// frames and responses larger than this aren't kept around between requests.
+#define KEPT_FRAME (64u << 10)
+
+struct server;
+
+struct worker {
+    struct server *server;
+    pthread_t thread;
+
+    // the connection being served, or NULL. guarded by the server lock.
+    struct connection *connection;
+
+    struct output output;
+    struct field fields[MAX_FIELDS];
+
+    pthread_mutex_t latency_lock;
+    struct serve_latency latency[SERVE_KIND_COUNT];
+};
+
+struct connection_list {
+    struct connection **connections;
+    unsigned count;
+    unsigned capacity;
+};
+
+struct server {
+    pthread_mutex_t lock;
+    pthread_cond_t ready_changed;
+    bool stopping;
+
+    // connections with a whole request, from ready_first on, and the ones
+    // workers are done with, which go back to the main thread's poll.
+    struct connection_list ready;
+    unsigned ready_first;
+    struct connection_list returned;
+
+    // written to wake the main thread up.
+    int wake[2];
+
+    struct cache domains;
+    struct cache images;
+
+    // counts what the library allocates. each request may allocate up to
+    // request_budget bytes, when there is one, on the thread serving it, so
+    // one that goes past it fails on its own. frames are allocated through
+    // it too, and are at most max_frame bytes.
+    struct pddlp_accounting *accounting;
+    struct pddlp_allocator allocator;
+    size_t request_budget;
+    uint32_t max_frame;
+
+    struct worker *workers;
+    unsigned worker_count;
+
+    sigset_t signals;
+};
+
+static uint64_t
+now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void
+output_reserve(struct output *output, size_t extra)
+{
+    if (output->length + extra <= output->capacity)
+        return;
+
+    size_t capacity = output->capacity ? output->capacity : 4096;
+    while (capacity < output->length + extra)
+        capacity *= 2;
+
+    const struct pddlp_allocator *allocator = output->allocator;
+    char *data = allocator
+        ? allocator->realloc(allocator->context, output->data, capacity)
+        : realloc(output->data, capacity);
+    if (data == NULL) {
+        output->failed = true;
+        return;
+    }
+
+    output->data = data;
+    output->capacity = capacity;
+}
+
+static void
+output_free(struct output *output)
+{
+    if (output->allocator)
+        output->allocator->free(output->allocator->context, output->data);
+    else
+        free(output->data);
+
+    output->data = NULL;
+    output->length = 0;
+    output->capacity = 0;
+}
+
+static void
+output_printf(struct output *output, const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    va_list retry;
+    va_copy(retry, args);
+
+    size_t available = output->capacity - output->length;
+    int n = vsnprintf(output->data ? output->data + output->length : NULL, available, format, args);
+
+    if (n >= 0 && (size_t)n >= available) {
+        output_reserve(output, (size_t)n + 1);
+        if (!output->failed)
+            vsnprintf(output->data + output->length, (size_t)n + 1, format, retry);
+    }
+
+    if (n >= 0 && !output->failed)
+        output->length += n;
+
+    va_end(retry);
+    va_end(args);
+}
+
+// the keys only pick a candidate, which is then compared byte by byte.
+static uint64_t
+cache_hash(const char *data, size_t length, uint64_t seed)
+{
+    uint64_t hash = seed ^ (length * 0x9e3779b97f4a7c15u);
+    size_t i = 0;
+
+    for (; i + 8 <= length; i += 8) {
+        uint64_t word;
+        memcpy(&word, data + i, sizeof(word));
+        hash = (hash ^ word) * 0xff51afd7ed558ccdu;
+        hash ^= hash >> 32;
+    }
+
+    uint64_t tail = 0;
+    memcpy(&tail, data + i, length - i);
+    hash = (hash ^ tail) * 0xc4ceb9fe1a85ec53u;
+    return hash ^ hash >> 29;
+}
+
+static void
+cache_init(struct cache *cache, unsigned capacity, const struct pddlp_allocator *allocator)
+{
+    memset(cache, 0, sizeof(*cache));
+    pthread_mutex_init(&cache->lock, NULL);
+    cache->capacity = capacity;
+    cache->allocator = allocator;
+}
+
+static void
+cache_free_entry(struct cache *cache, struct cache_entry *entry)
+{
+    const struct pddlp_allocator *allocator = cache->allocator;
+
+    pddlp_free_validator(entry->validator);
+    pddlp_free_strips(entry->strips);
+    pddlp_free_problem(entry->problem);
+    if (entry->domain)
+        pddlp_release_domain(entry->domain);
+    allocator->free(allocator->context, entry->source);
+    allocator->free(allocator->context, entry);
+}
+
+static void
+cache_unlink(struct cache *cache, struct cache_entry *entry)
+{
+    if (entry->previous)
+        entry->previous->next = entry->next;
+    else
+        cache->first = entry->next;
+
+    if (entry->next)
+        entry->next->previous = entry->previous;
+    else
+        cache->last = entry->previous;
+
+    entry->previous = entry->next = NULL;
+}
+
+static void
+cache_push(struct cache *cache, struct cache_entry *entry)
+{
+    entry->previous = NULL;
+    entry->next = cache->first;
+    if (cache->first)
+        cache->first->previous = entry;
+    else
+        cache->last = entry;
+    cache->first = entry;
+}
+
+// caller holds the lock. `domain` is NULL for domain entries.
+static struct cache_entry *
+cache_lookup(struct cache *cache, uint64_t hash, const struct pddlp_domain *domain, const char *source,
+    size_t length)
+{
+    for (struct cache_entry *entry = cache->first; entry; entry = entry->next) {
+        if (entry->hash != hash || entry->length != length || (domain && entry->domain != domain))
+            continue;
+        if (memcmp(entry->source, source, length) != 0)
+            continue;
+
+        cache_unlink(cache, entry);
+        cache_push(cache, entry);
+        entry->references++;
+        return entry;
+    }
+
+    return NULL;
+}
+
+static struct cache_entry *
+cache_find(struct cache *cache, uint64_t hash, const struct pddlp_domain *domain, const char *source,
+    size_t length)
+{
+    pthread_mutex_lock(&cache->lock);
+    struct cache_entry *entry = cache_lookup(cache, hash, domain, source, length);
+    if (entry)
+        cache->hits++;
+    else
+        cache->misses++;
+    pthread_mutex_unlock(&cache->lock);
+    return entry;
+}
+
+// adds a new entry, or returns the one another worker added for the same
+// source in the meantime. either way the caller holds a reference.
+static struct cache_entry *
+cache_insert(struct cache *cache, struct cache_entry *entry)
+{
+    struct cache_entry *evicted = NULL;
+
+    pthread_mutex_lock(&cache->lock);
+
+    struct cache_entry *existing = cache_lookup(cache, entry->hash,
+        entry->problem ? entry->domain : NULL, entry->source, entry->length);
+
+    if (existing == NULL) {
+        entry->references = 1;
+        cache_push(cache, entry);
+        cache->count++;
+
+        while (cache->count > cache->capacity) {
+            struct cache_entry *victim = cache->last;
+            cache_unlink(cache, victim);
+            cache->count--;
+            victim->evicted = true;
+
+            if (victim->references == 0) {
+                victim->next = evicted;
+                evicted = victim;
+            }
+        }
+    }
+
+    pthread_mutex_unlock(&cache->lock);
+
+    while (evicted) {
+        struct cache_entry *next = evicted->next;
+        cache_free_entry(cache, evicted);
+        evicted = next;
+    }
+
+    if (existing) {
+        cache_free_entry(cache, entry);
+        return existing;
+    }
+
+    return entry;
+}
+
+static void
+cache_release(struct cache *cache, struct cache_entry *entry)
+{
+    pthread_mutex_lock(&cache->lock);
+    bool unused = --entry->references == 0 && entry->evicted;
+    pthread_mutex_unlock(&cache->lock);
+
+    if (unused)
+        cache_free_entry(cache, entry);
+}
+
+static void
+cache_destroy(struct cache *cache)
+{
+    struct cache_entry *entry = cache->first;
+    while (entry) {
+        struct cache_entry *next = entry->next;
+        cache_free_entry(cache, entry);
+        entry = next;
+    }
+
+    pthread_mutex_destroy(&cache->lock);
+}
+
+static struct cache_entry *
+new_entry(struct cache *cache, uint64_t hash, const struct field *field)
+{
+    const struct pddlp_allocator *allocator = cache->allocator;
+    struct cache_entry *entry = allocator->alloc(allocator->context, sizeof(*entry));
+    if (entry == NULL)
+        return NULL;
+
+    memset(entry, 0, sizeof(*entry));
+    entry->hash = hash;
+    entry->length = field->length;
+    entry->source = allocator->alloc(allocator->context, field->length + 1);
+    if (entry->source == NULL) {
+        allocator->free(allocator->context, entry);
+        return NULL;
+    }
+
+    memcpy(entry->source, field->data, field->length + 1);
+    return entry;
+}
+
+static struct cache_entry *
+load_domain(struct worker *worker, const struct field *field)
+{
+    struct cache *cache = &worker->server->domains;
+    uint64_t hash = cache_hash(field->data, field->length, 0);
+
+    struct cache_entry *entry = cache_find(cache, hash, NULL, field->data, field->length);
+    if (entry)
+        return entry;
+
+    entry = new_entry(cache, hash, field);
+    if (entry == NULL) {
+        output_printf(&worker->output, "out of memory\n");
+        return NULL;
+    }
+
+    struct pddlp_error error;
+    entry->domain = pddlp_parse_domain(entry->source, &error);
+    if (entry->domain == NULL) {
+        output_printf(&worker->output, "domain:%" PRIu64 ":%" PRIu64 ": %s\n",
+            error.line, error.column, error.message);
+        cache_free_entry(cache, entry);
+        return NULL;
+    }
+
+    return cache_insert(cache, entry);
+}
+
+// the problem is grounded with one thread, since the workers already keep
+// the cores busy.
+static struct cache_entry *
+load_image(struct worker *worker, struct pddlp_domain *domain, uint64_t domain_hash, const struct field *field)
+{
+    struct cache *cache = &worker->server->images;
+    uint64_t hash = cache_hash(field->data, field->length, domain_hash);
+
+    struct cache_entry *entry = cache_find(cache, hash, domain, field->data, field->length);
+    if (entry)
+        return entry;
+
+    entry = new_entry(cache, hash, field);
+    if (entry == NULL) {
+        output_printf(&worker->output, "out of memory\n");
+        return NULL;
+    }
+
+    pddlp_retain_domain(domain);
+    entry->domain = domain;
+
+    struct pddlp_error error;
+    entry->problem = pddlp_parse_problem(domain, entry->source, &error);
+    if (entry->problem == NULL) {
+        output_printf(&worker->output, "problem:%" PRIu64 ":%" PRIu64 ": %s\n",
+            error.line, error.column, error.message);
+        cache_free_entry(cache, entry);
+        return NULL;
+    }
+
+    entry->strips = pddlp_ground(entry->problem, 1, &error);
+    entry->validator = entry->strips ? pddlp_new_validator(entry->strips, &error) : NULL;
+    if (entry->validator == NULL) {
+        output_printf(&worker->output, "problem: %s\n", error.message);
+        cache_free_entry(cache, entry);
+        return NULL;
+    }
+
+    return cache_insert(cache, entry);
+}
+
+static void
+print_fact(struct output *output, const struct pddlp_strips *strips, uint32_t fact)
+{
+    const struct pddlp_problem *problem = strips->problem;
+    const uint32_t *args = strips->fact_args + strips->fact_args_first[fact];
+    const struct pddlp_predicate *predicate = &problem->domain->predicates[strips->fact_predicates[fact]];
+
+    output_printf(output, " (%s", predicate->name);
+    for (uint32_t i = 0; i < predicate->param_count; ++i)
+        output_printf(output, " %s", problem->objects[args[i]].name);
+    output_printf(output, ")");
+}
+
+static bool
+handle_tokenize(struct worker *worker, const struct field *fields, unsigned field_count)
+{
+    if (field_count != 1) {
+        output_printf(&worker->output, "wrong number of fields\n");
+        return false;
+    }
+
+    struct pddlp_tokenizer tokenizer;
+    pddlp_init_tokenizer(&tokenizer, fields[0].data);
+
+    // stops early once the response can't grow.
+    while (!worker->output.failed) {
+        struct pddlp_token token = pddlp_scan_token(&tokenizer);
+        if (token.token_type == PDDLP_TOKEN_EOF)
+            break;
+
+        output_printf(&worker->output, "%" PRIu64 ":%" PRIu64 " %s %.*s\n", token.line, token.column,
+            pddlp_token_type_names[token.token_type], (int)token.length, token.start);
+    }
+
+    return true;
+}
+
+static bool
+handle_count(struct worker *worker, const struct field *fields, unsigned field_count)
+{
+    if (field_count != 1) {
+        output_printf(&worker->output, "wrong number of fields\n");
+        return false;
+    }
+
+    struct pddlp_tokenizer tokenizer;
+    pddlp_init_tokenizer(&tokenizer, fields[0].data);
+
+    uint64_t token_count = 0;
+    uint64_t error_count = 0;
+
+    for (;;) {
+        enum pddlp_token_type token_type = pddlp_scan_token(&tokenizer).token_type;
+        if (token_type == PDDLP_TOKEN_EOF)
+            break;
+        if (token_type == PDDLP_TOKEN_ERROR)
+            error_count++;
+        token_count++;
+    }
+
+    output_printf(&worker->output, "%" PRIu64 " %" PRIu64 "\n", token_count, error_count);
+    return true;
+}
+
+static bool
+handle_hash(struct worker *worker, const struct field *fields, unsigned field_count)
+{
+    if (field_count != 1) {
+        output_printf(&worker->output, "wrong number of fields\n");
+        return false;
+    }
+
+    struct pddlp_hash128 hash;
+    struct pddlp_error error;
+    if (!pddlp_normalize(fields[0].data, NULL, NULL, &hash, &error)) {
+        output_printf(&worker->output, "%" PRIu64 ":%" PRIu64 ": %s\n", error.line, error.column, error.message);
+        return false;
+    }
+
+    output_printf(&worker->output, "%016" PRIx64 "%016" PRIx64 "\n", hash.high, hash.low);
+    return true;
+}
+
+static bool
+handle_validate(struct worker *worker, const struct field *fields, unsigned field_count)
+{
+    if (field_count < 2) {
+        output_printf(&worker->output, "wrong number of fields\n");
+        return false;
+    }
+
+    struct cache_entry *domain = load_domain(worker, &fields[0]);
+    if (domain == NULL)
+        return false;
+
+    struct cache_entry *image = load_image(worker, domain->domain, domain->hash, &fields[1]);
+    cache_release(&worker->server->domains, domain);
+    if (image == NULL)
+        return false;
+
+    for (unsigned i = 2; i < field_count; ++i) {
+        struct pddlp_plan_result result;
+        if (pddlp_validate_plan(image->validator, fields[i].data, &result)) {
+            output_printf(&worker->output, "valid %" PRIu32 "\n", result.step_count);
+            continue;
+        }
+
+        output_printf(&worker->output, "invalid %" PRIu64 ":%" PRIu64 ": step %" PRIu32 ": %s",
+            result.line, result.column, result.step, result.message);
+        if (result.fact != PDDLP_NONE)
+            print_fact(&worker->output, image->strips, result.fact);
+        output_printf(&worker->output, "\n");
+    }
+
+    cache_release(&worker->server->images, image);
+    return true;
+}
+
+static void
+print_cache(struct output *output, const char *name, struct cache *cache)
+{
+    pthread_mutex_lock(&cache->lock);
+    output_printf(output, "%s: %u cached, %" PRIu64 " hits, %" PRIu64 " misses\n",
+        name, cache->count, cache->hits, cache->misses);
+    pthread_mutex_unlock(&cache->lock);
+}
+
+static void
+print_memory(struct output *output, struct server *server)
+{
+    struct pddlp_memory usage;
+    pddlp_memory_usage(server->accounting, &usage);
+
+    output_printf(output, "memory: %zu bytes, peak %zu", usage.current, usage.peak);
+    for (int i = 0; i < PDDLP_SUBSYSTEM_COUNT; ++i)
+        if (usage.subsystem_peak[i])
+            output_printf(output, ", %s %zu", pddlp_subsystem_names[i], usage.subsystem_peak[i]);
+
+    if (server->request_budget)
+        output_printf(output, ", budget %zu per request, %" PRIu64 " refused", server->request_budget,
+            usage.refused);
+    output_printf(output, "\n");
+}
+
+// the latencies are measured from a request being read to its response
+// being written.
+static void
+print_report(struct output *output, struct server *server)
+{
+    struct serve_latency *totals = calloc(SERVE_KIND_COUNT, sizeof(*totals));
+    if (totals == NULL) {
+        output->failed = true;
+        return;
+    }
+
+    for (unsigned i = 0; i < server->worker_count; ++i) {
+        struct worker *worker = &server->workers[i];
+        pthread_mutex_lock(&worker->latency_lock);
+        for (int kind = 1; kind < SERVE_KIND_COUNT; ++kind)
+            serve_latency_merge(&totals[kind], &worker->latency[kind]);
+        pthread_mutex_unlock(&worker->latency_lock);
+    }
+
+    for (int kind = 1; kind < SERVE_KIND_COUNT; ++kind) {
+        if (totals[kind].count == 0)
+            continue;
+
+        output_printf(output, "%s: %" PRIu64 " requests, p50 %.1f us, p99 %.1f us\n",
+            serve_kind_names[kind], totals[kind].count,
+            serve_latency_percentile(&totals[kind], 50) / 1e3, serve_latency_percentile(&totals[kind], 99) / 1e3);
+    }
+
+    free(totals);
+
+    print_cache(output, "domains", &server->domains);
+    print_cache(output, "images", &server->images);
+    print_memory(output, server);
+}
+
+// fields are terminated in place: the byte after each one is the first
+// byte of the next length, which has already been read, or the spare byte
+// read_connection leaves at the end.
+static bool
+handle_request(struct worker *worker, char *request, uint32_t length)
+{
+    worker->output.length = 0;
+    worker->output.failed = false;
+    output_reserve(&worker->output, 1);
+    if (worker->output.failed || length == 0)
+        return false;
+
+    unsigned kind = (unsigned char)request[0];
+    unsigned field_count = 0;
+    uint32_t position = 1;
+
+    while (position < length) {
+        if (length - position < 4 || field_count == MAX_FIELDS)
+            return false;
+
+        uint32_t field_length = serve_get_u32(request + position);
+        position += 4;
+        if (field_length > length - position)
+            return false;
+
+        worker->fields[field_count++] = (struct field){request + position, field_length};
+        position += field_length;
+    }
+
+    for (unsigned i = 0; i < field_count; ++i)
+        worker->fields[i].data[worker->fields[i].length] = 0;
+
+    worker->output.length = 1;
+
+    bool ok;
+    switch (kind) {
+    case SERVE_TOKENIZE:
+        ok = handle_tokenize(worker, worker->fields, field_count);
+        break;
+    case SERVE_COUNT:
+        ok = handle_count(worker, worker->fields, field_count);
+        break;
+    case SERVE_HASH:
+        ok = handle_hash(worker, worker->fields, field_count);
+        break;
+    case SERVE_VALIDATE:
+        ok = handle_validate(worker, worker->fields, field_count);
+        break;
+    case SERVE_STATS:
+        print_report(&worker->output, worker->server);
+        ok = true;
+        break;
+    default:
+        output_printf(&worker->output, "unknown request\n");
+        ok = false;
+        break;
+    }
+
+    // a response that outgrew the budget is dropped, and the request fails
+    // like any other that runs out of memory. the buffer holds at least the
+    // capacity output_reserve starts from, so the message fits.
+    if (worker->output.failed) {
+        worker->output.length = 1;
+        worker->output.failed = false;
+        output_printf(&worker->output, "out of memory\n");
+        ok = false;
+    }
+
+    worker->output.data[0] = ok ? SERVE_OK : SERVE_FAILED;
+    return true;
+}
+
+// serves the request a connection has sent. returns false when the
+// connection should be closed.
+static bool
+serve_request(struct worker *worker, struct connection *connection)
+{
+    uint64_t start = now_ns();
+    pddlp_set_thread_budget(worker->server->request_budget);
+    bool handled = handle_request(worker, connection->frame, connection->length);
+    pddlp_set_thread_budget(0);
+    if (!handled)
+        return false;
+
+    unsigned char header[4];
+    serve_put_u32(header, (uint32_t)worker->output.length);
+    struct iovec parts[2] = {
+        {header, sizeof(header)},
+        {worker->output.data, worker->output.length},
+    };
+
+    bool written = serve_write_full(connection->fd, parts, 2);
+    if (worker->output.capacity > KEPT_FRAME)
+        output_free(&worker->output);
+    if (!written)
+        return false;
+
+    unsigned kind = (unsigned char)connection->frame[0];
+    if (kind > 0 && kind < SERVE_KIND_COUNT) {
+        pthread_mutex_lock(&worker->latency_lock);
+        serve_latency_add(&worker->latency[kind], now_ns() - start);
+        pthread_mutex_unlock(&worker->latency_lock);
+    }
+
+    return true;
+}
+
+static struct connection *
+new_connection(int fd)
+{
+    struct connection *connection = calloc(1, sizeof(*connection));
+    if (connection == NULL)
+        return NULL;
+
+    connection->fd = fd;
+    return connection;
+}
+
+static void
+close_connection(struct server *server, struct connection *connection)
+{
+    close(connection->fd);
+    if (connection->frame)
+        server->allocator.free(server->allocator.context, connection->frame);
+    free(connection);
+}
+
+enum read_result {
+    READ_PARTIAL,
+    READ_FRAME,
+    READ_CLOSED,
+};
+
+// reads what the connection has sent without blocking, up to the end of
+// its frame. the frame grows with the bytes that come in rather than with
+// the length in its header, and keeps a spare byte at the end.
+static enum read_result
+read_connection(struct server *server, struct connection *c)
+{
+    for (;;) {
+        char *into;
+        size_t wanted;
+
+        if (c->received < sizeof(c->header)) {
+            into = (char *)c->header + c->received;
+            wanted = sizeof(c->header) - c->received;
+        } else {
+            size_t have = c->received - sizeof(c->header);
+            if (have == c->length)
+                return READ_FRAME;
+
+            if (have + 1 == c->capacity || c->capacity == 0) {
+                size_t capacity = c->capacity ? c->capacity * 2 : 4096;
+                if (capacity > (size_t)c->length + 1)
+                    capacity = (size_t)c->length + 1;
+
+                char *frame = server->allocator.realloc(server->allocator.context, c->frame, capacity);
+                if (frame == NULL)
+                    return READ_CLOSED;
+                c->frame = frame;
+                c->capacity = capacity;
+            }
+
+            into = c->frame + have;
+            wanted = c->length - have < c->capacity - 1 - have ? c->length - have : c->capacity - 1 - have;
+        }
+
+        ssize_t n = read(c->fd, into, wanted);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            return READ_PARTIAL;
+        if (n <= 0)
+            return READ_CLOSED;
+
+        c->received += n;
+        if (c->received == sizeof(c->header)) {
+            c->length = serve_get_u32(c->header);
+            if (c->length > server->max_frame)
+                return READ_CLOSED;
+        }
+    }
+}
+
+// gets a connection ready for its next frame once a worker is done with it.
+static void
+reset_connection(struct server *server, struct connection *connection)
+{
+    connection->received = 0;
+    connection->length = 0;
+
+    if (connection->capacity > KEPT_FRAME) {
+        server->allocator.free(server->allocator.context, connection->frame);
+        connection->frame = NULL;
+        connection->capacity = 0;
+    }
+}
+
+static bool
+push_connection(struct connection_list *list, struct connection *connection)
+{
+    if (list->count == list->capacity) {
+        unsigned capacity = list->capacity ? list->capacity * 2 : 64;
+        struct connection **connections = realloc(list->connections, sizeof(*connections) * capacity);
+        if (connections == NULL)
+            return false;
+        list->connections = connections;
+        list->capacity = capacity;
+    }
+
+    list->connections[list->count++] = connection;
+    return true;
+}
+
+static void
+close_connections(struct server *server, struct connection_list *list)
+{
+    for (unsigned i = 0; i < list->count; ++i)
+        close_connection(server, list->connections[i]);
+    free(list->connections);
+    memset(list, 0, sizeof(*list));
+}
+
+static void
+wake_main(struct server *server)
+{
+    char byte = 0;
+    while (write(server->wake[1], &byte, 1) < 0 && errno == EINTR)
+        ;
+}
+
+static void *
+run_worker(void *context)
+{
+    struct worker *worker = context;
+    struct server *server = worker->server;
+
+    for (;;) {
+        pthread_mutex_lock(&server->lock);
+        while (!server->stopping && server->ready_first == server->ready.count)
+            pthread_cond_wait(&server->ready_changed, &server->lock);
+
+        if (server->stopping) {
+            pthread_mutex_unlock(&server->lock);
+            return NULL;
+        }
+
+        struct connection *connection = server->ready.connections[server->ready_first++];
+        worker->connection = connection;
+        pthread_mutex_unlock(&server->lock);
+
+        bool open = serve_request(worker, connection);
+        reset_connection(server, connection);
+
+        pthread_mutex_lock(&server->lock);
+        worker->connection = NULL;
+        if (open)
+            open = push_connection(&server->returned, connection);
+        pthread_mutex_unlock(&server->lock);
+
+        if (open)
+            wake_main(server);
+        else
+            close_connection(server, connection);
+    }
+}
+
+// SIGINT and SIGTERM are blocked everywhere and taken here.
+static void *
+wait_signals(void *context)
+{
+    struct server *server = context;
+    int signal_number;
+    sigwait(&server->signals, &signal_number);
+
+    pthread_mutex_lock(&server->lock);
+    server->stopping = true;
+    pthread_mutex_unlock(&server->lock);
+
+    wake_main(server);
+    return NULL;
+}
+
+static int
+open_socket(const char *path)
+{
+    struct sockaddr_un address = {.sun_family = AF_UNIX};
+    if (strlen(path) >= sizeof(address.sun_path)) {
+        fprintf(stderr, "socket path too long: %s\n", path);
+        return -1;
+    }
+    strcpy(address.sun_path, path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        perror("socket");
+        return -1;
+    }
+
+    unlink(path);
+    if (bind(fd, (struct sockaddr *)&address, sizeof(address)) < 0 || listen(fd, 128) < 0) {
+        perror(path);
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+// waits for the idle connections, reads what they send, and hands the ones
+// with a whole request to the workers. returns when the server is stopping.
+static void
+dispatch(struct server *server, int listen_fd)
+{
+    struct connection_list idle = {0};
+    struct pollfd *polls = NULL;
+    unsigned poll_capacity = 0;
+
+    for (;;) {
+        // connections come back from the workers after each request.
+        pthread_mutex_lock(&server->lock);
+        bool stopping = server->stopping;
+        for (unsigned i = 0; i < server->returned.count; ++i)
+            if (!push_connection(&idle, server->returned.connections[i]))
+                close_connection(server, server->returned.connections[i]);
+        server->returned.count = 0;
+        pthread_mutex_unlock(&server->lock);
+
+        if (stopping)
+            break;
+
+        if (idle.count + 2 > poll_capacity) {
+            unsigned capacity = idle.capacity + 2;
+            struct pollfd *grown = realloc(polls, sizeof(*polls) * capacity);
+            if (grown == NULL)
+                break;
+            polls = grown;
+            poll_capacity = capacity;
+        }
+
+        polls[0] = (struct pollfd){.fd = server->wake[0], .events = POLLIN};
+        polls[1] = (struct pollfd){.fd = listen_fd, .events = POLLIN};
+        for (unsigned i = 0; i < idle.count; ++i)
+            polls[i + 2] = (struct pollfd){.fd = idle.connections[i]->fd, .events = POLLIN};
+
+        if (poll(polls, idle.count + 2, -1) < 0) {
+            if (errno == EINTR)
+                continue;
+            perror("poll");
+            break;
+        }
+
+        if (polls[0].revents) {
+            char bytes[256];
+            while (read(server->wake[0], bytes, sizeof(bytes)) == sizeof(bytes))
+                ;
+        }
+
+        pthread_mutex_lock(&server->lock);
+
+        if (server->ready_first > 0) {
+            server->ready.count -= server->ready_first;
+            memmove(server->ready.connections, server->ready.connections + server->ready_first,
+                sizeof(*server->ready.connections) * server->ready.count);
+            server->ready_first = 0;
+        }
+
+        unsigned kept = 0;
+        for (unsigned i = 0; i < idle.count; ++i) {
+            struct connection *connection = idle.connections[i];
+            enum read_result result = polls[i + 2].revents ? read_connection(server, connection) : READ_PARTIAL;
+
+            if (result == READ_FRAME && push_connection(&server->ready, connection))
+                pthread_cond_signal(&server->ready_changed);
+            else if (result == READ_PARTIAL)
+                idle.connections[kept++] = connection;
+            else
+                close_connection(server, connection);
+        }
+        idle.count = kept;
+
+        pthread_mutex_unlock(&server->lock);
+
+        if (polls[1].revents) {
+            int fd = accept(listen_fd, NULL, NULL);
+            struct connection *connection = NULL;
+            if (fd >= 0 && fcntl(fd, F_SETFL, O_NONBLOCK) == 0)
+                connection = new_connection(fd);
+
+            if (connection == NULL || !push_connection(&idle, connection)) {
+                free(connection);
+                if (fd >= 0)
+                    close(fd);
+            }
+        }
+    }
+
+    free(polls);
+    close_connections(server, &idle);
+}
+
+int
+main(int argc, char **argv)
+{
+    long online = sysconf(_SC_NPROCESSORS_ONLN);
+    unsigned worker_count = online > 0 ? (unsigned)online : 1;
+    unsigned cache_capacity = 64;
+    size_t budget = 0;
+    bool valid = true;
+
+    while (argc > 2 && argv[1][0] == '-') {
+        uint64_t number = 0;
+        if (strcmp(argv[1], "-j") == 0) {
+            valid = tool_parse_number(argv[2], UINT_MAX, &number);
+            worker_count = (unsigned)number;
+        } else if (strcmp(argv[1], "-c") == 0) {
+            valid = tool_parse_number(argv[2], UINT_MAX, &number);
+            cache_capacity = (unsigned)number;
+        } else if (strcmp(argv[1], "-m") == 0) {
+            valid = tool_parse_number(argv[2], SIZE_MAX >> 20, &number);
+            budget = (size_t)number << 20;
+        } else {
+            break;
+        }
+
+        if (!valid)
+            break;
+        argc -= 2;
+        argv += 2;
+    }
+
+    if (!valid || argc != 2 || worker_count == 0 || cache_capacity == 0) {
+        fprintf(stderr, "usage: %s [-j workers] [-c cache entries] [-m megabytes per request] <socket>\n", argv[0]);
+        return -1;
+    }
+
+    static struct server server;
+    server.worker_count = worker_count;
+    server.workers = calloc(worker_count, sizeof(*server.workers));
+    server.request_budget = budget;
+    server.accounting = pddlp_new_accounting(NULL, 0);
+    if (server.workers == NULL || server.accounting == NULL)
+        return -1;
+
+    server.allocator = pddlp_accounting_allocator(server.accounting);
+    pddlp_set_allocator(&server.allocator);
+    server.max_frame = budget && budget < SERVE_MAX_FRAME ? (uint32_t)budget : SERVE_MAX_FRAME;
+
+    int listen_fd = open_socket(argv[1]);
+    if (listen_fd < 0)
+        return -1;
+
+    if (pipe(server.wake) < 0 || fcntl(server.wake[0], F_SETFL, O_NONBLOCK) < 0) {
+        perror("pipe");
+        return -1;
+    }
+
+    pthread_mutex_init(&server.lock, NULL);
+    pthread_cond_init(&server.ready_changed, NULL);
+    cache_init(&server.domains, cache_capacity, &server.allocator);
+    cache_init(&server.images, cache_capacity, &server.allocator);
+
+    // a client going away shows up as a failed write instead.
+    struct sigaction ignore = {.sa_handler = SIG_IGN};
+    sigaction(SIGPIPE, &ignore, NULL);
+
+    sigemptyset(&server.signals);
+    sigaddset(&server.signals, SIGINT);
+    sigaddset(&server.signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &server.signals, NULL);
+
+    for (unsigned i = 0; i < worker_count; ++i) {
+        struct worker *worker = &server.workers[i];
+        worker->server = &server;
+        worker->output.allocator = &server.allocator;
+        pthread_mutex_init(&worker->latency_lock, NULL);
+        pthread_create(&worker->thread, NULL, run_worker, worker);
+    }
+
+    pthread_t signal_thread;
+    pthread_create(&signal_thread, NULL, wait_signals, &server);
+
+    fprintf(stderr, "serving on %s with %u workers\n", argv[1], worker_count);
+    dispatch(&server, listen_fd);
+
+    // wakes the workers, and the ones waiting to write a response.
+    pthread_mutex_lock(&server.lock);
+    if (!server.stopping)
+        pthread_kill(signal_thread, SIGTERM);
+    server.stopping = true;
+    pthread_cond_broadcast(&server.ready_changed);
+    for (unsigned i = 0; i < worker_count; ++i)
+        if (server.workers[i].connection)
+            shutdown(server.workers[i].connection->fd, SHUT_RDWR);
+    pthread_mutex_unlock(&server.lock);
+
+    pthread_join(signal_thread, NULL);
+    for (unsigned i = 0; i < worker_count; ++i)
+        pthread_join(server.workers[i].thread, NULL);
+
+    struct output report = {0};
+    print_report(&report, &server);
+    if (report.data)
+        fwrite(report.data, 1, report.length, stderr);
+
+    for (unsigned i = 0; i < worker_count; ++i) {
+        output_free(&server.workers[i].output);
+        pthread_mutex_destroy(&server.workers[i].latency_lock);
+    }
+
+    // the ones before ready_first were handed out, and are closed or in
+    // returned by now.
+    for (unsigned i = server.ready_first; i < server.ready.count; ++i)
+        close_connection(&server, server.ready.connections[i]);
+    free(server.ready.connections);
+    close_connections(&server, &server.returned);
+
+    output_free(&report);
+    free(server.workers);
+    cache_destroy(&server.images);
+    cache_destroy(&server.domains);
+    pddlp_set_allocator(NULL);
+    pddlp_free_accounting(server.accounting);
+    close(server.wake[0]);
+    close(server.wake[1]);
+    close(listen_fd);
+    unlink(argv[1]);
+    return 0;
+}
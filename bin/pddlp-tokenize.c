@@ -1,18 +1,23 @@
 // SPDX-FileCopyrightText: 2023 Guilherme Puida Moreira <guilherme@puida.xyz>
 // SPDX-License-Identifier: BSD-3-Clause
 
+// needed for fseeko/ftello, which work with files larger than 2GB.
+#define _POSIX_C_SOURCE 200809L
+#define _FILE_OFFSET_BITS 64
+
 #include "pddlp.h"
 
+#include <inttypes.h>
 #include <stdio.h>
 #include <stdlib.h>
 
-static int
+static uint64_t
 print_all_tokens(const char *source)
 {
     struct pddlp_tokenizer tokenizer;
     pddlp_init_tokenizer(&tokenizer, source);
 
-    int error_count = 0;
+    uint64_t error_count = 0;
 
     for (;;) {
         struct pddlp_token token = pddlp_scan_token(&tokenizer);
@@ -26,10 +31,11 @@ print_all_tokens(const char *source)
         if (token_type == PDDLP_TOKEN_ERROR)
             error_count++;
 
-        printf("[%02d:%02d] %s %.*s\n",
+        printf("[%02" PRIu64 ":%02" PRIu64 "] %s ",
             token.line, token.column,
-            pddlp_token_type_names[token_type],
-            token.length, token.start);
+            pddlp_token_type_names[token_type]);
+        fwrite(token.start, 1, token.length, stdout);
+        putchar('\n');
     }
 
     return error_count;
@@ -51,18 +57,30 @@ main(int argc, char **argv)
         return -1;
     }
 
-    fseek(file, 0, SEEK_END);
-    long file_size = ftell(file);
+    fseeko(file, 0, SEEK_END);
+    off_t file_size = ftello(file);
     rewind(file);
 
+    if (file_size < 0 || (uintmax_t)file_size >= SIZE_MAX) {
+        fprintf(stderr, "couldn't read %s\n", file_name);
+        fclose(file);
+        return -1;
+    }
+
     char *source = malloc(sizeof(*source) * file_size + 1);
-    long read_amount = fread(source, 1, file_size, file);
+    if (source == NULL) {
+        fprintf(stderr, "not enough memory to read %s\n", file_name);
+        fclose(file);
+        return -1;
+    }
+
+    size_t read_amount = fread(source, 1, file_size, file);
     source[read_amount] = 0;
     fclose(file);
 
-    int error_count = print_all_tokens(source);
+    uint64_t error_count = print_all_tokens(source);
     if (error_count)
-        printf("error count: %d\n", error_count);
+        printf("error count: %" PRIu64 "\n", error_count);
 
     free(source);
     return 0;
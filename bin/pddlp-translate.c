@@ -0,0 +1,132 @@
+// SPDX-FileCopyrightText: 2024 Guilherme Puida Moreira <guilherme@puida.xyz>
+// SPDX-License-Identifier: BSD-3-Clause
+
+// needed for fseeko/ftello and clock_gettime.
+#define _POSIX_C_SOURCE 200809L
+#define _FILE_OFFSET_BITS 64
+
+#include "pddlp.h"
+#include "tool.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static bool
+write_file(void *context, const char *data, size_t length)
+{
+    return fwrite(data, 1, length, context) == length;
+}
+
+int
+main(int argc, char **argv)
+{
+    const char *output_name = "output.sas";
+    bool all = false;
+
+    while (argc > 2 && argv[1][0] == '-') {
+        if (strcmp(argv[1], "-a") == 0) {
+            all = true;
+            argc -= 1;
+            argv += 1;
+            continue;
+        }
+
+        if (strcmp(argv[1], "-o") == 0)
+            output_name = argv[2];
+        else
+            break;
+        argc -= 2;
+        argv += 2;
+    }
+
+    if (argc < 3) {
+        fprintf(stderr, "usage: %s [-a] [-o output] <domain> <problem>\n", argv[0]);
+        return -1;
+    }
+
+    char *domain_source = tool_read_file(argv[1], 0, NULL);
+    char *problem_source = tool_read_file(argv[2], 0, NULL);
+    if (domain_source == NULL || problem_source == NULL)
+        return -1;
+
+    int status = -1;
+    struct pddlp_error error;
+    struct pddlp_problem *problem = NULL;
+    struct pddlp_strips *strips = NULL;
+    struct pddlp_sas *sas = NULL;
+    FILE *output = NULL;
+
+    double start = tool_now_ms();
+
+    struct pddlp_domain *domain = pddlp_parse_domain(domain_source, &error);
+    if (domain == NULL) {
+        tool_print_error(argv[1], &error);
+        goto done;
+    }
+
+    problem = pddlp_parse_problem(domain, problem_source, &error);
+    if (problem == NULL) {
+        tool_print_error(argv[2], &error);
+        goto done;
+    }
+
+    double parsed = tool_now_ms();
+
+    // like other translators, only what is reachable ignoring deletes,
+    // unless asked for everything.
+    strips = all ? pddlp_ground(problem, 0, &error) : pddlp_ground_reachable(problem, &error);
+    if (strips == NULL) {
+        fprintf(stderr, "%s\n", error.message);
+        goto done;
+    }
+
+    double grounded = tool_now_ms();
+
+    sas = pddlp_translate(strips, &error);
+    if (sas == NULL) {
+        fprintf(stderr, "%s\n", error.message);
+        goto done;
+    }
+
+    double translated = tool_now_ms();
+
+    output = strcmp(output_name, "-") == 0 ? stdout : fopen(output_name, "w");
+    if (output == NULL) {
+        fprintf(stderr, "couldn't open %s\n", output_name);
+        goto done;
+    }
+
+    if (!pddlp_write_sas(sas, write_file, output, &error) || fflush(output) != 0) {
+        fprintf(stderr, "couldn't write %s\n", output_name);
+        goto done;
+    }
+
+    double written = tool_now_ms();
+
+    // the task may be going to stdout.
+    uint32_t multi_valued = 0;
+    for (uint32_t v = 0; v < sas->variable_count; ++v)
+        multi_valued += sas->variable_first[v + 1] - sas->variable_first[v] > 1;
+
+    fprintf(stderr, "variables: %" PRIu32 " (%" PRIu32 " multi-valued)\n", sas->variable_count, multi_valued);
+    fprintf(stderr, "invariants: %" PRIu32 ", mutex groups: %" PRIu32 "\n", sas->invariant_count, sas->group_count);
+    fprintf(stderr, "operators: %" PRIu32 "\n", sas->operator_count);
+    fprintf(stderr, "parse: %.2f ms\n", parsed - start);
+    fprintf(stderr, "ground: %.2f ms\n", grounded - parsed);
+    fprintf(stderr, "translate: %.2f ms\n", translated - grounded);
+    fprintf(stderr, "write: %.2f ms\n", written - translated);
+    status = 0;
+
+done:
+    if (output != NULL && output != stdout)
+        fclose(output);
+    pddlp_free_sas(sas);
+    pddlp_free_strips(strips);
+    pddlp_free_problem(problem);
+    pddlp_release_domain(domain);
+    free(domain_source);
+    free(problem_source);
+    return status;
+}
@@ -0,0 +1,153 @@
+// SPDX-FileCopyrightText: 2024 Guilherme Puida Moreira <guilherme@puida.xyz>
+// SPDX-License-Identifier: BSD-3-Clause
+
+// needed for fseeko/ftello and clock_gettime.
+#define _POSIX_C_SOURCE 200809L
+#define _FILE_OFFSET_BITS 64
+
+#include "pddlp.h"
+#include "tool.h"
+
+#include <inttypes.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void
+print_fact(const struct pddlp_strips *strips, uint32_t fact)
+{
+    const struct pddlp_problem *problem = strips->problem;
+    const uint32_t *args = strips->fact_args + strips->fact_args_first[fact];
+    const struct pddlp_predicate *predicate = &problem->domain->predicates[strips->fact_predicates[fact]];
+
+    fprintf(stderr, "  (%s", predicate->name);
+    for (uint32_t i = 0; i < predicate->param_count; ++i)
+        fprintf(stderr, " %s", problem->objects[args[i]].name);
+    fprintf(stderr, ")\n");
+}
+
+int
+main(int argc, char **argv)
+{
+    unsigned threads = 0;
+    size_t budget = 0;
+    bool valid = true;
+
+    while (argc > 2 && argv[1][0] == '-') {
+        uint64_t number = 0;
+        if (strcmp(argv[1], "-j") == 0) {
+            valid = tool_parse_number(argv[2], UINT_MAX, &number);
+            threads = (unsigned)number;
+        } else if (strcmp(argv[1], "-m") == 0) {
+            valid = tool_parse_number(argv[2], SIZE_MAX >> 20, &number);
+            budget = (size_t)number << 20;
+        } else {
+            break;
+        }
+
+        if (!valid)
+            break;
+        argc -= 2;
+        argv += 2;
+    }
+
+    if (!valid || argc < 4) {
+        fprintf(stderr, "usage: %s [-j threads] [-m megabytes] <domain> <problem> <plan>...\n", argv[0]);
+        return -1;
+    }
+
+    // counts what the library allocates, up to the budget when there is one.
+    struct pddlp_accounting *accounting = pddlp_new_accounting(NULL, budget);
+    if (accounting == NULL)
+        return -1;
+
+    struct pddlp_allocator allocator = pddlp_accounting_allocator(accounting);
+    pddlp_set_allocator(&allocator);
+
+    char *domain_source = tool_read_file(argv[1], 0, NULL);
+    char *problem_source = tool_read_file(argv[2], 0, NULL);
+    if (domain_source == NULL || problem_source == NULL)
+        return -1;
+
+    int status = -1;
+    struct pddlp_error error;
+    struct pddlp_problem *problem = NULL;
+    struct pddlp_strips *strips = NULL;
+    struct pddlp_validator *validator = NULL;
+
+    struct pddlp_domain *domain = pddlp_parse_domain(domain_source, &error);
+    if (domain == NULL) {
+        tool_print_error(argv[1], &error);
+        goto done;
+    }
+
+    problem = pddlp_parse_problem(domain, problem_source, &error);
+    if (problem == NULL) {
+        tool_print_error(argv[2], &error);
+        goto done;
+    }
+
+    strips = pddlp_ground(problem, threads, &error);
+    if (strips == NULL) {
+        fprintf(stderr, "%s\n", error.message);
+        goto done;
+    }
+
+    validator = pddlp_new_validator(strips, &error);
+    if (validator == NULL) {
+        fprintf(stderr, "%s\n", error.message);
+        goto done;
+    }
+
+    // the plans are read up front so only validation is timed.
+    int plan_count = argc - 3;
+    char **plans = calloc(plan_count, sizeof(*plans));
+    if (plans == NULL)
+        goto done;
+
+    for (int i = 0; i < plan_count; ++i)
+        if ((plans[i] = tool_read_file(argv[i + 3], 0, NULL)) == NULL)
+            goto free_plans;
+
+    status = 0;
+    uint64_t step_count = 0;
+    double start = tool_now_ms();
+
+    for (int i = 0; i < plan_count; ++i) {
+        struct pddlp_plan_result result;
+        if (pddlp_validate_plan(validator, plans[i], &result)) {
+            printf("%s: valid, %" PRIu32 " steps\n", argv[i + 3], result.step_count);
+        } else {
+            fprintf(stderr, "%s:%" PRIu64 ":%" PRIu64 ": step %" PRIu32 ": %s\n",
+                argv[i + 3], result.line, result.column, result.step, result.message);
+            if (result.fact != PDDLP_NONE)
+                print_fact(strips, result.fact);
+            status = 1;
+        }
+
+        step_count += result.step_count;
+    }
+
+    double elapsed = tool_now_ms() - start;
+    printf("validated %d plans, %" PRIu64 " steps, %.2f ms, %.0f steps/s\n",
+        plan_count, step_count, elapsed, elapsed > 0 ? step_count / (elapsed / 1e3) : 0);
+
+free_plans:
+    for (int i = 0; i < plan_count; ++i)
+        free(plans[i]);
+    free(plans);
+
+done:
+    pddlp_free_validator(validator);
+    pddlp_free_strips(strips);
+    pddlp_free_problem(problem);
+    pddlp_release_domain(domain);
+    free(domain_source);
+    free(problem_source);
+
+    tool_print_memory(accounting);
+    pddlp_set_allocator(NULL);
+    pddlp_free_accounting(accounting);
+    return status;
+}
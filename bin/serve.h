@@ -0,0 +1,209 @@
+// SPDX-FileCopyrightText: 2024 Guilherme Puida Moreira <guilherme@puida.xyz>
+// SPDX-License-Identifier: BSD-3-Clause
+
+// the protocol of pddlp-serve, shared with its load generator in
+// bench/serve.c.
+//
+// every message is a frame: a 32-bit little-endian length, then that many
+// bytes. a request is a byte with its kind followed by its fields, each of
+// them a 32-bit little-endian length and that many bytes. a response is a
+// status byte, SERVE_OK or SERVE_FAILED, followed by text.
+//
+//   SERVE_TOKENIZE  source                  a "line:column type text" line per token
+//   SERVE_COUNT     source                  "tokens errors"
+//   SERVE_HASH      source                  the pddlp_normalize hash, in hex
+//   SERVE_VALIDATE  domain problem plan...  a line per plan
+//   SERVE_STATS                             latencies and cache counters
+
+#ifndef SERVE_H_
+#define SERVE_H_
+
+#include <errno.h>
+#include <poll.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+enum serve_kind {
+    SERVE_TOKENIZE = 1,
+    SERVE_COUNT,
+    SERVE_HASH,
+    SERVE_VALIDATE,
+    SERVE_STATS,
+    SERVE_KIND_COUNT,
+};
+
+static const char *const serve_kind_names[SERVE_KIND_COUNT] = {
+    [SERVE_TOKENIZE] = "tokenize",
+    [SERVE_COUNT] = "count",
+    [SERVE_HASH] = "hash",
+    [SERVE_VALIDATE] = "validate",
+    [SERVE_STATS] = "stats",
+};
+
+#define SERVE_OK 0
+#define SERVE_FAILED 1
+
+// larger frames close the connection. the daemon lowers this to its memory
+// budget when it has one.
+#define SERVE_MAX_FRAME (1u << 30)
+
+// how long a write to a non-blocking socket waits for the peer to make room,
+// in milliseconds, before the connection is dropped.
+#define SERVE_WRITE_TIMEOUT 5000
+
+static inline uint32_t
+serve_get_u32(const void *data)
+{
+    const unsigned char *bytes = data;
+    return (uint32_t)bytes[0] | (uint32_t)bytes[1] << 8 | (uint32_t)bytes[2] << 16 | (uint32_t)bytes[3] << 24;
+}
+
+static inline void
+serve_put_u32(void *data, uint32_t value)
+{
+    unsigned char *bytes = data;
+    bytes[0] = value & 0xff;
+    bytes[1] = value >> 8 & 0xff;
+    bytes[2] = value >> 16 & 0xff;
+    bytes[3] = value >> 24 & 0xff;
+}
+
+static inline bool
+serve_read_full(int fd, void *data, size_t length)
+{
+    char *current = data;
+    while (length > 0) {
+        ssize_t n = read(fd, current, length);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        current += n;
+        length -= n;
+    }
+
+    return true;
+}
+
+static inline bool
+serve_write_full(int fd, struct iovec *parts, int part_count)
+{
+    while (part_count > 0) {
+        ssize_t n = writev(fd, parts, part_count);
+        if (n < 0 && errno == EINTR)
+            continue;
+
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            struct pollfd writable = {.fd = fd, .events = POLLOUT};
+            if (poll(&writable, 1, SERVE_WRITE_TIMEOUT) > 0)
+                continue;
+            return false;
+        }
+
+        if (n < 0)
+            return false;
+
+        while (part_count > 0 && (size_t)n >= parts->iov_len) {
+            n -= parts->iov_len;
+            parts++;
+            part_count--;
+        }
+
+        if (part_count > 0) {
+            parts->iov_base = (char *)parts->iov_base + n;
+            parts->iov_len -= n;
+        }
+    }
+
+    return true;
+}
+
+// reads a frame into `*buffer`, growing it as needed. one byte past the
+// frame is left for a terminator.
+static inline bool
+serve_read_frame(int fd, char **buffer, size_t *capacity, uint32_t *length)
+{
+    unsigned char header[4];
+    if (!serve_read_full(fd, header, sizeof(header)))
+        return false;
+
+    *length = serve_get_u32(header);
+    if (*length > SERVE_MAX_FRAME)
+        return false;
+
+    if (*length + 1 > *capacity) {
+        char *grown = realloc(*buffer, *length + 1);
+        if (grown == NULL)
+            return false;
+        *buffer = grown;
+        *capacity = *length + 1;
+    }
+
+    return serve_read_full(fd, *buffer, *length);
+}
+
+// latencies are kept in a log-linear histogram, with 16 buckets per power of
+// two, so percentiles are within about 6% of the real value.
+#define SERVE_LATENCY_BUCKETS 1024
+
+struct serve_latency {
+    uint64_t count;
+    uint64_t buckets[SERVE_LATENCY_BUCKETS];
+};
+
+// the index of the highest set bit of `value`, which isn't 0.
+static inline unsigned
+serve_highest_bit(uint64_t value)
+{
+#ifdef __GNUC__
+    return 63 - __builtin_clzll(value);
+#else
+    unsigned bit = 0;
+    while (value >>= 1)
+        bit++;
+    return bit;
+#endif
+}
+
+static inline void
+serve_latency_add(struct serve_latency *latency, uint64_t ns)
+{
+    unsigned bucket = (unsigned)ns;
+    if (ns >= 32) {
+        unsigned shift = serve_highest_bit(ns) - 4;
+        bucket = shift * 16 + (unsigned)(ns >> shift);
+    }
+
+    latency->buckets[bucket]++;
+    latency->count++;
+}
+
+static inline void
+serve_latency_merge(struct serve_latency *into, const struct serve_latency *latency)
+{
+    into->count += latency->count;
+    for (unsigned i = 0; i < SERVE_LATENCY_BUCKETS; ++i)
+        into->buckets[i] += latency->buckets[i];
+}
+
+// the lower bound of the bucket holding the `percentile`th latency.
+static inline uint64_t
+serve_latency_percentile(const struct serve_latency *latency, double percentile)
+{
+    uint64_t rank = (uint64_t)(latency->count * percentile / 100);
+    uint64_t seen = 0;
+
+    for (unsigned bucket = 0; bucket < SERVE_LATENCY_BUCKETS; ++bucket) {
+        seen += latency->buckets[bucket];
+        if (seen > rank || seen == latency->count)
+            return bucket < 32 ? bucket : (uint64_t)(bucket % 16 + 16) << (bucket / 16 - 1);
+    }
+
+    return 0;
+}
+
+#endif // SERVE_H_
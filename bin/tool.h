@@ -0,0 +1,121 @@
+// SPDX-FileCopyrightText: 2024 Guilherme Puida Moreira <guilherme@puida.xyz>
+// SPDX-License-Identifier: BSD-3-Clause
+
+// helpers shared by the command-line tools. they need fseeko/ftello and
+// clock_gettime, so the tools define _POSIX_C_SOURCE, and _FILE_OFFSET_BITS
+// for large files, before including this.
+
+#ifndef TOOL_H_
+#define TOOL_H_
+
+#include "pddlp.h"
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/types.h>
+#include <time.h>
+
+// reads the whole file. when `hash` isn't NULL, it is hashed with `seed` as
+// it comes in, so a cached result can be looked up without another pass
+// over it.
+static inline char *
+tool_read_file(const char *file_name, uint64_t seed, uint64_t *hash)
+{
+    FILE *file = fopen(file_name, "r");
+    if (file == NULL) {
+        fprintf(stderr, "couldn't open %s\n", file_name);
+        return NULL;
+    }
+
+    fseeko(file, 0, SEEK_END);
+    off_t file_size = ftello(file);
+    rewind(file);
+
+    if (file_size < 0 || (uintmax_t)file_size >= SIZE_MAX) {
+        fprintf(stderr, "couldn't read %s\n", file_name);
+        fclose(file);
+        return NULL;
+    }
+
+    char *source = malloc(sizeof(*source) * file_size + 1);
+    if (source == NULL) {
+        fprintf(stderr, "not enough memory to read %s\n", file_name);
+        fclose(file);
+        return NULL;
+    }
+
+    struct pddlp_hasher hasher;
+    pddlp_hasher_init(&hasher, seed);
+
+    size_t read_amount = 0;
+    while (read_amount < (size_t)file_size) {
+        size_t chunk = (size_t)file_size - read_amount < (1 << 20) ? (size_t)file_size - read_amount : (1 << 20);
+        size_t amount = fread(source + read_amount, 1, chunk, file);
+        if (amount == 0)
+            break;
+
+        if (hash)
+            pddlp_hasher_update(&hasher, source + read_amount, amount);
+        read_amount += amount;
+    }
+
+    source[read_amount] = 0;
+    fclose(file);
+
+    if (hash)
+        *hash = pddlp_hasher_digest(&hasher);
+    return source;
+}
+
+static inline double
+tool_now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+static inline void
+tool_print_error(const char *file_name, const struct pddlp_error *error)
+{
+    fprintf(stderr, "%s:%" PRIu64 ":%" PRIu64 ": %s\n",
+        file_name, error->line, error->column, error->message);
+}
+
+// the peak of the library's memory, by subsystem, or why it ran out.
+static inline void
+tool_print_memory(struct pddlp_accounting *accounting)
+{
+    struct pddlp_memory usage;
+    pddlp_memory_usage(accounting, &usage);
+
+    if (usage.refused)
+        fprintf(stderr, "memory budget of %zu bytes exceeded\n", usage.budget);
+
+    printf("peak memory: %zu bytes", usage.peak);
+    for (int i = 0; i < PDDLP_SUBSYSTEM_COUNT; ++i)
+        if (usage.subsystem_peak[i])
+            printf(", %s %zu", pddlp_subsystem_names[i], usage.subsystem_peak[i]);
+    printf("\n");
+}
+
+// reads the number an option takes. anything but digits, or a number above
+// `max`, is refused.
+static inline bool
+tool_parse_number(const char *text, uint64_t max, uint64_t *number)
+{
+    char *end;
+    errno = 0;
+    unsigned long long parsed = strtoull(text, &end, 10);
+    if (text[0] < '0' || text[0] > '9' || *end != 0 || errno == ERANGE || parsed > max)
+        return false;
+
+    *number = parsed;
+    return true;
+}
+
+#endif // TOOL_H_
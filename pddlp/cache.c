@@ -0,0 +1,390 @@
+// SPDX-FileCopyrightText: 2024 Guilherme Puida Moreira <guilherme@puida.xyz>
+// SPDX-License-Identifier: BSD-3-Clause
+
+// results of tools kept across runs, keyed by the hash of the file they are
+// for.
+//
+// the file is a header, the magic and the version of the library padded to
+// 16 bytes, then the number of entries and the entries: the hash, the kind
+// and the size of the result, and the result, padded to 8 bytes. it is read
+// whole when opened, and the results stay in that buffer, with an open
+// addressing table over them.
+
+#include "internal.h"
+
+#include <stdio.h>
+
+#define CACHE_MAGIC "pddlpc1\n"
+#define CACHE_VERSION_SIZE 16
+#define CACHE_HEADER_SIZE (8 + CACHE_VERSION_SIZE + 8)
+#define CACHE_ENTRY_SIZE 16
+
+struct cache_entry {
+    uint64_t hash;
+    uint32_t kind;
+    uint32_t size;
+    size_t offset;
+};
+
+struct pddlp_cache {
+    char *path;
+
+    unsigned char *data;
+    size_t data_size;
+    size_t data_capacity;
+
+    struct cache_entry *entries;
+    uint32_t entry_count;
+
+    // entry + 1, or 0 when empty. kept at most half full.
+    uint32_t *slots;
+    uint32_t capacity;
+
+    bool changed;
+};
+
+static uint32_t
+cache_slot(uint64_t hash, uint32_t kind)
+{
+    return (uint32_t)(hash ^ hash >> 32) ^ kind * 0x9e3779b9u;
+}
+
+static uint32_t
+cache_find_entry(const struct pddlp_cache *cache, uint64_t hash, uint32_t kind)
+{
+    if (cache->capacity == 0)
+        return PDDLP_NONE;
+
+    uint32_t mask = cache->capacity - 1;
+    for (uint32_t i = cache_slot(hash, kind) & mask;; i = (i + 1) & mask) {
+        uint32_t slot = cache->slots[i];
+        if (slot == 0)
+            return PDDLP_NONE;
+
+        const struct cache_entry *entry = &cache->entries[slot - 1];
+        if (entry->hash == hash && entry->kind == kind)
+            return slot - 1;
+    }
+}
+
+static bool
+cache_grow(struct pddlp_cache *cache)
+{
+    uint64_t capacity = cache->capacity ? (uint64_t)cache->capacity * 2 : 64;
+    if (capacity > UINT32_MAX)
+        return false;
+
+    uint32_t *slots = mem_alloc(sizeof(*slots) * capacity);
+    if (slots == NULL)
+        return false;
+
+    memset(slots, 0, sizeof(*slots) * capacity);
+
+    uint32_t mask = capacity - 1;
+    for (uint32_t e = 0; e < cache->entry_count; ++e) {
+        uint32_t i = cache_slot(cache->entries[e].hash, cache->entries[e].kind) & mask;
+        while (slots[i])
+            i = (i + 1) & mask;
+        slots[i] = e + 1;
+    }
+
+    mem_free(cache->slots);
+    cache->slots = slots;
+    cache->capacity = capacity;
+    return true;
+}
+
+// room for `size` more bytes of results.
+static bool
+cache_reserve_data(struct pddlp_cache *cache, size_t size)
+{
+    if (cache->data_size + size <= cache->data_capacity)
+        return true;
+
+    size_t capacity = cache->data_capacity ? cache->data_capacity : 4096;
+    while (capacity < cache->data_size + size)
+        capacity *= 2;
+
+    unsigned char *data = mem_realloc(cache->data, capacity);
+    if (data == NULL)
+        return false;
+
+    cache->data = data;
+    cache->data_capacity = capacity;
+    return true;
+}
+
+static bool
+cache_add_entry(struct pddlp_cache *cache, uint64_t hash, uint32_t kind, uint32_t size, size_t offset)
+{
+    if ((uint64_t)(cache->entry_count + 1) * 2 > cache->capacity && !cache_grow(cache))
+        return false;
+
+    struct cache_entry *entries = array_reserve(cache->entries, cache->entry_count + 1, sizeof(*entries));
+    if (entries == NULL)
+        return false;
+    cache->entries = entries;
+
+    uint32_t e = cache->entry_count++;
+    entries[e] = (struct cache_entry) { hash, kind, size, offset };
+
+    uint32_t mask = cache->capacity - 1;
+    uint32_t i = cache_slot(hash, kind) & mask;
+    while (cache->slots[i])
+        i = (i + 1) & mask;
+    cache->slots[i] = e + 1;
+    return true;
+}
+
+static size_t
+cache_padded(size_t size)
+{
+    return (size + 7) & ~(size_t)7;
+}
+
+// reads the whole file into `data`. a file that is missing, can't be read
+// or doesn't look like a cache of this version leaves the cache empty.
+static bool
+cache_load(struct pddlp_cache *cache)
+{
+    FILE *file = fopen(cache->path, "rb");
+    if (file == NULL)
+        return true;
+
+    unsigned char header[CACHE_HEADER_SIZE];
+    char version[CACHE_VERSION_SIZE] = PDDLP_VERSION;
+    uint64_t entry_count;
+
+    if (fread(header, 1, sizeof(header), file) != sizeof(header) || memcmp(header, CACHE_MAGIC, 8) != 0 ||
+        memcmp(header + 8, version, sizeof(version)) != 0) {
+        fclose(file);
+        return true;
+    }
+
+    memcpy(&entry_count, header + 8 + CACHE_VERSION_SIZE, sizeof(entry_count));
+
+    // the rest of the file is read in blocks until it ends, so its size
+    // doesn't have to be known.
+    for (;;) {
+        if (!cache_reserve_data(cache, 1 << 16)) {
+            fclose(file);
+            return false;
+        }
+
+        size_t amount = fread(cache->data + cache->data_size, 1, cache->data_capacity - cache->data_size, file);
+        cache->data_size += amount;
+        if (amount == 0)
+            break;
+    }
+
+    bool failed = ferror(file);
+    fclose(file);
+
+    size_t offset = 0;
+    for (uint64_t e = 0; e < entry_count && !failed; ++e) {
+        if (cache->data_size - offset < CACHE_ENTRY_SIZE) {
+            failed = true;
+            break;
+        }
+
+        uint64_t hash;
+        uint32_t kind;
+        uint32_t size;
+        memcpy(&hash, cache->data + offset, sizeof(hash));
+        memcpy(&kind, cache->data + offset + 8, sizeof(kind));
+        memcpy(&size, cache->data + offset + 12, sizeof(size));
+        offset += CACHE_ENTRY_SIZE;
+
+        if (cache->data_size - offset < cache_padded(size)) {
+            failed = true;
+            break;
+        }
+
+        if (!cache_add_entry(cache, hash, kind, size, offset))
+            return false;
+        offset += cache_padded(size);
+    }
+
+    // a damaged file is dropped whole, rather than trusting part of it.
+    if (failed || offset != cache->data_size) {
+        cache->data_size = 0;
+        cache->entry_count = 0;
+        memset(cache->slots, 0, sizeof(*cache->slots) * cache->capacity);
+    }
+
+    return true;
+}
+
+struct pddlp_cache *
+pddlp_open_cache(const char *path, struct pddlp_error *error)
+{
+    enum pddlp_subsystem previous = mem_enter(PDDLP_SUBSYSTEM_CACHE);
+    size_t length = strlen(path);
+    struct pddlp_cache *cache = mem_alloc(sizeof(*cache));
+    bool loaded = false;
+
+    if (cache != NULL) {
+        memset(cache, 0, sizeof(*cache));
+        cache->path = mem_alloc(length + 1);
+        if (cache->path != NULL) {
+            memcpy(cache->path, path, length + 1);
+            loaded = cache_load(cache);
+        }
+    }
+
+    mem_leave(previous);
+    if (!loaded) {
+        pddlp_free_cache(cache);
+        error->message = "out of memory";
+        error->line = 0;
+        error->column = 0;
+        return NULL;
+    }
+
+    return cache;
+}
+
+static bool
+cache_write(const struct pddlp_cache *cache, FILE *file)
+{
+    unsigned char header[CACHE_HEADER_SIZE] = CACHE_MAGIC;
+    char version[CACHE_VERSION_SIZE] = PDDLP_VERSION;
+    uint64_t entry_count = cache->entry_count;
+    memcpy(header + 8, version, sizeof(version));
+    memcpy(header + 8 + CACHE_VERSION_SIZE, &entry_count, sizeof(entry_count));
+
+    if (fwrite(header, 1, sizeof(header), file) != sizeof(header))
+        return false;
+
+    static const unsigned char padding[8];
+    for (uint32_t e = 0; e < cache->entry_count; ++e) {
+        const struct cache_entry *entry = &cache->entries[e];
+        unsigned char head[CACHE_ENTRY_SIZE];
+        memcpy(head, &entry->hash, sizeof(entry->hash));
+        memcpy(head + 8, &entry->kind, sizeof(entry->kind));
+        memcpy(head + 12, &entry->size, sizeof(entry->size));
+
+        size_t pad = cache_padded(entry->size) - entry->size;
+        if (fwrite(head, 1, sizeof(head), file) != sizeof(head) ||
+            fwrite(cache->data + entry->offset, 1, entry->size, file) != entry->size ||
+            fwrite(padding, 1, pad, file) != pad)
+            return false;
+    }
+
+    return true;
+}
+
+bool
+pddlp_save_cache(struct pddlp_cache *cache, struct pddlp_error *error)
+{
+    if (!cache->changed)
+        return true;
+
+    error->message = "out of memory";
+    error->line = 0;
+    error->column = 0;
+
+    enum pddlp_subsystem previous = mem_enter(PDDLP_SUBSYSTEM_CACHE);
+    size_t length = strlen(cache->path);
+    char *temporary = mem_alloc(length + 5);
+    mem_leave(previous);
+    if (temporary == NULL)
+        return false;
+
+    memcpy(temporary, cache->path, length);
+    memcpy(temporary + length, ".tmp", 5);
+
+    FILE *file = fopen(temporary, "wb");
+    bool written = file != NULL && cache_write(cache, file);
+    if (file != NULL && fclose(file) != 0)
+        written = false;
+
+    if (written && rename(temporary, cache->path) == 0) {
+        mem_free(temporary);
+        cache->changed = false;
+        return true;
+    }
+
+    if (file != NULL)
+        remove(temporary);
+    mem_free(temporary);
+    error->message = "couldn't write the cache";
+    return false;
+}
+
+void
+pddlp_free_cache(struct pddlp_cache *cache)
+{
+    if (cache == NULL)
+        return;
+
+    mem_free(cache->path);
+    mem_free(cache->data);
+    array_free(cache->entries);
+    mem_free(cache->slots);
+    mem_free(cache);
+}
+
+const void *
+pddlp_cache_find(const struct pddlp_cache *cache, uint64_t hash, uint32_t kind, uint32_t *size)
+{
+    uint32_t e = cache_find_entry(cache, hash, kind);
+    if (e == PDDLP_NONE)
+        return NULL;
+
+    *size = cache->entries[e].size;
+    return cache->data + cache->entries[e].offset;
+}
+
+bool
+pddlp_cache_store(struct pddlp_cache *cache, uint64_t hash, uint32_t kind, const void *data, uint32_t size)
+{
+    uint32_t e = cache_find_entry(cache, hash, kind);
+
+    // a result of the same size is replaced in place. otherwise the new one
+    // goes at the end, and the old one is left out of the next save.
+    if (e != PDDLP_NONE && cache->entries[e].size == size) {
+        if (size > 0)
+            memcpy(cache->data + cache->entries[e].offset, data, size);
+        cache->changed = true;
+        return true;
+    }
+
+    enum pddlp_subsystem previous = mem_enter(PDDLP_SUBSYSTEM_CACHE);
+    bool stored = cache_reserve_data(cache, cache_padded(size)) &&
+        (e != PDDLP_NONE || cache_add_entry(cache, hash, kind, size, cache->data_size));
+    mem_leave(previous);
+    if (!stored)
+        return false;
+
+    if (e != PDDLP_NONE) {
+        cache->entries[e].size = size;
+        cache->entries[e].offset = cache->data_size;
+    }
+
+    if (size > 0)
+        memcpy(cache->data + cache->data_size, data, size);
+    cache->data_size += cache_padded(size);
+    cache->changed = true;
+    return true;
+}
+
+// hashing
+
+void
+pddlp_hasher_init(struct pddlp_hasher *hasher, uint64_t seed)
+{
+    hash_stream_init(hasher, seed);
+}
+
+void
+pddlp_hasher_update(struct pddlp_hasher *hasher, const void *data, size_t length)
+{
+    hash_stream_update(hasher, data, length);
+}
+
+uint64_t
+pddlp_hasher_digest(const struct pddlp_hasher *hasher)
+{
+    return hash_stream_digest(hasher);
+}
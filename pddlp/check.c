@@ -0,0 +1,1059 @@
+// SPDX-FileCopyrightText: 2024 Guilherme Puida Moreira <guilherme@puida.xyz>
+// SPDX-License-Identifier: BSD-3-Clause
+
+// consistency checks over the tokens of a domain and its problems. nothing
+// is parsed into arrays: a single pass keeps tables of the names declared so
+// far, checks every name, arity and object type it comes across against
+// them, and reports each mistake as it goes on.
+
+#include "internal.h"
+
+#include <setjmp.h>
+
+// the type of a name whose type isn't checked: an `either`, an undeclared
+// type, or an undeclared name.
+#define CHECK_ANY PDDLP_NONE
+
+struct check_skeleton {
+    uint32_t param_first;       // into `param_types`.
+    uint32_t arity;
+};
+
+// the symbol tables map names to indexes into the arrays after them. the
+// names are copied into `arena`.
+struct pddlp_checker {
+    struct arena arena;
+    const char *domain_name;
+
+    // the parent of each type, PDDLP_NONE for object.
+    struct symbols type_symbols;
+    uint32_t *type_parents;
+    uint32_t type_count;
+
+    struct symbols constant_symbols;
+    uint32_t *constant_types;
+    uint32_t constant_count;
+
+    struct symbols predicate_symbols;
+    struct check_skeleton *predicates;
+    uint32_t predicate_count;
+
+    struct symbols function_symbols;
+    struct check_skeleton *functions;
+    uint32_t function_count;
+
+    struct symbols action_symbols;
+    uint32_t action_count;
+
+    uint32_t *param_types;
+    uint32_t param_count;
+};
+
+struct check_object {
+    const char *name;
+    uint32_t length;
+    uint32_t type;
+};
+
+struct check_variable {
+    const char *name;
+    uint32_t length;
+    uint32_t type;
+};
+
+// what a typed list declares.
+enum check_list {
+    CHECK_TYPES,
+    CHECK_CONSTANTS,
+    CHECK_OBJECTS,
+    CHECK_VARIABLES,
+    CHECK_PARAMS,
+};
+
+// one pass over a domain, which fills `checker`, or over a problem, which
+// only reads it.
+struct check {
+    struct pddlp_checker *checker;
+    struct pddlp_tokenizer tokenizer;
+    struct pddlp_token ahead;
+    bool peeked;
+    pddlp_report_fn report;
+    void *context;
+    jmp_buf stop;
+    bool problem;
+    bool valid;
+    bool out_of_memory;
+
+    // the objects of the problem, which point into its source. large
+    // problems look them up millions of times, so the table only keeps the
+    // hash of each name in the high half of a slot, and the object + 1 in
+    // the low half, or 0 when empty.
+    struct check_object *objects;
+    uint32_t object_count;
+    uint64_t *object_slots;
+    uint32_t object_capacity;
+
+    // variables visible from the formula being checked.
+    struct check_variable *scope;
+    uint32_t scope_count;
+
+    // entries of a typed list still waiting for their type.
+    struct pddlp_token *pending;
+    uint32_t pending_count;
+};
+
+static void
+check_report(struct check *ck, struct pddlp_token token, const char *message)
+{
+    // whatever was expected, running out of input is the actual problem.
+    if (token.token_type == PDDLP_TOKEN_EOF)
+        message = "unexpected end of input";
+
+    struct pddlp_error error = { message, token.line, token.column };
+    ck->valid = false;
+
+    if (ck->report && !ck->report(ck->context, &error))
+        longjmp(ck->stop, 1);
+}
+
+// for mistakes the pass can't carry on after.
+static void
+check_fail(struct check *ck, struct pddlp_token token, const char *message)
+{
+    check_report(ck, token, message);
+    longjmp(ck->stop, 1);
+}
+
+static void
+check_fail_memory(struct check *ck)
+{
+    struct pddlp_token token = {
+        .token_type = PDDLP_TOKEN_ERROR,
+        .line = ck->tokenizer.line,
+        .column = ck->tokenizer.column,
+    };
+
+    ck->out_of_memory = true;
+    check_fail(ck, token, "out of memory");
+}
+
+static void *
+check_reserve(struct check *ck, void *items, uint32_t needed, size_t item_size)
+{
+    void *result = array_reserve(items, needed, item_size);
+    if (result == NULL)
+        check_fail_memory(ck);
+
+    return result;
+}
+
+#define CHECK_PUSH(ck, items, count) \
+    ((items) = check_reserve((ck), (items), (count) + 1, sizeof(*(items))), &(items)[(count)++])
+
+static void
+check_insert(struct check *ck, struct symbols *symbols, const char *name, size_t length, uint32_t value)
+{
+    if (!symbols_insert(symbols, name, length, value))
+        check_fail_memory(ck);
+}
+
+static const char *
+check_intern(struct check *ck, struct pddlp_token token)
+{
+    const char *result = arena_strndup(&ck->checker->arena, token.start, token.length);
+    if (result == NULL)
+        check_fail_memory(ck);
+
+    return result;
+}
+
+// tokens the tokenizer couldn't make sense of are reported and skipped.
+// they carry their message instead of their text. the pass only ever looks
+// one token ahead, so it keeps that token itself and scans without the
+// tokenizer's lookahead ring.
+static struct pddlp_token
+check_scan(struct check *ck)
+{
+    struct pddlp_token token = pddlp_scan_token(&ck->tokenizer);
+    while (token.token_type == PDDLP_TOKEN_ERROR) {
+        check_report(ck, token, token.start);
+        token = pddlp_scan_token(&ck->tokenizer);
+    }
+
+    return token;
+}
+
+static struct pddlp_token
+check_next(struct check *ck)
+{
+    if (ck->peeked) {
+        ck->peeked = false;
+        return ck->ahead;
+    }
+
+    return check_scan(ck);
+}
+
+static enum pddlp_token_type
+check_peek(struct check *ck)
+{
+    if (!ck->peeked) {
+        ck->ahead = check_scan(ck);
+        ck->peeked = true;
+    }
+
+    return ck->ahead.token_type;
+}
+
+static struct pddlp_token
+check_expect(struct check *ck, enum pddlp_token_type token_type, const char *message)
+{
+    struct pddlp_token token = check_next(ck);
+    if (token.token_type != token_type)
+        check_fail(ck, token, message);
+
+    return token;
+}
+
+// keywords that can also be names, like the parser takes them.
+static bool
+check_is_name(enum pddlp_token_type token_type)
+{
+    return token_type == PDDLP_TOKEN_NAME ||
+        (token_type >= PDDLP_TOKEN_ALL && token_type <= PDDLP_TOKEN_WITHIN);
+}
+
+static struct pddlp_token
+check_expect_name(struct check *ck)
+{
+    struct pddlp_token token = check_next(ck);
+    if (!check_is_name(token.token_type))
+        check_fail(ck, token, "expected a name");
+
+    return token;
+}
+
+// consumes the ')' that ends a list, and fails at the end of the input.
+static bool
+check_at_end(struct check *ck)
+{
+    enum pddlp_token_type token_type = check_peek(ck);
+    if (token_type == PDDLP_TOKEN_EOF)
+        check_fail(ck, check_next(ck), "expected ')'");
+
+    if (token_type != PDDLP_TOKEN_RPAREN)
+        return false;
+
+    check_next(ck);
+    return true;
+}
+
+// skips to the ')' that closes the list the pass is in, and consumes it.
+static void
+check_skip_list(struct check *ck)
+{
+    uint64_t depth = 1;
+
+    while (depth > 0) {
+        struct pddlp_token token = check_next(ck);
+
+        if (token.token_type == PDDLP_TOKEN_LPAREN)
+            depth++;
+        else if (token.token_type == PDDLP_TOKEN_RPAREN)
+            depth--;
+        else if (token.token_type == PDDLP_TOKEN_EOF)
+            check_fail(ck, token, "expected ')'");
+    }
+}
+
+// problem objects
+
+static uint32_t
+check_find_object_hashed(const struct check *ck, const char *name, uint32_t length, uint32_t hash)
+{
+    if (ck->object_count == 0)
+        return PDDLP_NONE;
+
+    uint32_t mask = ck->object_capacity - 1;
+    for (uint32_t i = hash & mask;; i = (i + 1) & mask) {
+        uint64_t slot = ck->object_slots[i];
+        if (slot == 0)
+            return PDDLP_NONE;
+
+        const struct check_object *object = &ck->objects[(uint32_t)slot - 1];
+        if ((uint32_t)(slot >> 32) == hash && object->length == length && memcmp(object->name, name, length) == 0)
+            return (uint32_t)slot - 1;
+    }
+}
+
+static void
+check_prefetch_object(const struct check *ck, uint32_t hash)
+{
+#ifdef __GNUC__
+    if (ck->object_count)
+        __builtin_prefetch(&ck->object_slots[hash & (ck->object_capacity - 1)]);
+#else
+    (void)ck;
+    (void)hash;
+#endif
+}
+
+static void
+check_insert_object(struct check *ck, struct pddlp_token token, uint32_t type)
+{
+    if ((uint64_t)(ck->object_count + 1) * 2 > ck->object_capacity) {
+        uint64_t capacity = ck->object_capacity ? (uint64_t)ck->object_capacity * 2 : 64;
+        uint64_t *slots = capacity <= UINT32_MAX ? mem_alloc(sizeof(*slots) * capacity) : NULL;
+        if (slots == NULL)
+            check_fail_memory(ck);
+
+        memset(slots, 0, sizeof(*slots) * capacity);
+
+        for (uint32_t i = 0; i < ck->object_capacity; ++i) {
+            uint64_t slot = ck->object_slots[i];
+            if (slot == 0)
+                continue;
+
+            uint32_t j = (uint32_t)(slot >> 32) & (capacity - 1);
+            while (slots[j])
+                j = (j + 1) & (capacity - 1);
+            slots[j] = slot;
+        }
+
+        mem_free(ck->object_slots);
+        ck->object_slots = slots;
+        ck->object_capacity = capacity;
+    }
+
+    uint32_t hash = hash_name(token.start, token.length);
+    uint32_t mask = ck->object_capacity - 1;
+    uint32_t i = hash & mask;
+    while (ck->object_slots[i])
+        i = (i + 1) & mask;
+
+    ck->object_slots[i] = (uint64_t)hash << 32 | (ck->object_count + 1);
+
+    struct check_object *object = CHECK_PUSH(ck, ck->objects, ck->object_count);
+    object->name = token.start;
+    object->length = token.length;
+    object->type = type;
+}
+
+// types
+
+static bool
+check_is_subtype(const struct pddlp_checker *c, uint32_t type, uint32_t parent)
+{
+    // the bound keeps a cycle in :types from hanging the pass.
+    for (uint32_t depth = 0; type != PDDLP_NONE && depth <= c->type_count; ++depth) {
+        if (type == parent)
+            return true;
+        type = c->type_parents[type];
+    }
+
+    return false;
+}
+
+// whether a name of type `type` can be where one of type `expected` goes.
+// objects and constants have to be of that type. variables only have to
+// share some object with it, since a subtype may be what is meant.
+static bool
+check_compatible(const struct pddlp_checker *c, uint32_t type, uint32_t expected, bool variable)
+{
+    if (type == CHECK_ANY || expected == CHECK_ANY || expected == 0)
+        return true;
+
+    if (check_is_subtype(c, type, expected))
+        return true;
+
+    return variable && check_is_subtype(c, expected, type);
+}
+
+static uint32_t
+check_declare_type(struct check *ck, struct pddlp_token token)
+{
+    struct pddlp_checker *c = ck->checker;
+    uint32_t type = symbols_find(&c->type_symbols, token.start, token.length);
+    if (type != PDDLP_NONE)
+        return type;
+
+    type = c->type_count;
+    *CHECK_PUSH(ck, c->type_parents, c->type_count) = 0;
+    check_insert(ck, &c->type_symbols, check_intern(ck, token), token.length, type);
+    return type;
+}
+
+static uint32_t
+check_find_type(struct check *ck, struct pddlp_token token, bool declare)
+{
+    if (declare)
+        return check_declare_type(ck, token);
+
+    uint32_t type = symbols_find(&ck->checker->type_symbols, token.start, token.length);
+    if (type == PDDLP_NONE)
+        check_report(ck, token, "undeclared type");
+
+    return type;
+}
+
+// what follows a '-' in a typed list. `(either ...)` isn't checked.
+static uint32_t
+check_type(struct check *ck, bool declare)
+{
+    struct pddlp_token token = check_next(ck);
+
+    if (check_is_name(token.token_type))
+        return check_find_type(ck, token, declare);
+
+    if (token.token_type != PDDLP_TOKEN_LPAREN)
+        check_fail(ck, token, "expected a type");
+
+    check_expect(ck, PDDLP_TOKEN_EITHER, "expected either");
+    while (!check_at_end(ck))
+        check_find_type(ck, check_expect_name(ck), declare);
+
+    return CHECK_ANY;
+}
+
+// typed lists
+
+static void
+check_add_entry(struct check *ck, enum check_list list, struct pddlp_token token, uint32_t type)
+{
+    struct pddlp_checker *c = ck->checker;
+
+    switch (list) {
+    case CHECK_TYPES: {
+        uint32_t entry = check_declare_type(ck, token);
+        if (type == CHECK_ANY)
+            type = 0;
+
+        // the first parent given is kept, and object has none.
+        if (entry != 0 && entry != type && c->type_parents[entry] == 0)
+            c->type_parents[entry] = type;
+        break;
+    }
+    case CHECK_CONSTANTS:
+        if (symbols_find(&c->constant_symbols, token.start, token.length) != PDDLP_NONE) {
+            check_report(ck, token, "duplicate constant");
+            break;
+        }
+
+        check_insert(ck, &c->constant_symbols, check_intern(ck, token), token.length, c->constant_count);
+        *CHECK_PUSH(ck, c->constant_types, c->constant_count) = type;
+        break;
+    case CHECK_OBJECTS:
+        if (check_find_object_hashed(ck, token.start, token.length, hash_name(token.start, token.length)) !=
+            PDDLP_NONE) {
+            check_report(ck, token, "duplicate object");
+            break;
+        }
+
+        check_insert_object(ck, token, type);
+        break;
+    case CHECK_VARIABLES: {
+        struct check_variable *variable = CHECK_PUSH(ck, ck->scope, ck->scope_count);
+        variable->name = token.start;
+        variable->length = token.length;
+        variable->type = type;
+        break;
+    }
+    case CHECK_PARAMS:
+        *CHECK_PUSH(ck, c->param_types, c->param_count) = type;
+        break;
+    }
+}
+
+// checks `a b - t c - (either t u) d)`, consuming the closing paren, and
+// declares its entries in order. entries without a type are objects.
+static void
+check_typed_list(struct check *ck, enum check_list list)
+{
+    bool variables = list == CHECK_VARIABLES || list == CHECK_PARAMS;
+    ck->pending_count = 0;
+
+    for (;;) {
+        struct pddlp_token token = check_next(ck);
+
+        if (token.token_type == PDDLP_TOKEN_RPAREN)
+            break;
+
+        if (token.token_type == PDDLP_TOKEN_MINUS) {
+            if (ck->pending_count == 0)
+                check_report(ck, token, "expected a name before '-'");
+
+            uint32_t type = check_type(ck, list == CHECK_TYPES);
+            for (uint32_t i = 0; i < ck->pending_count; ++i)
+                check_add_entry(ck, list, ck->pending[i], type);
+
+            ck->pending_count = 0;
+            continue;
+        }
+
+        if (token.token_type == PDDLP_TOKEN_EOF || token.token_type == PDDLP_TOKEN_LPAREN)
+            check_fail(ck, token, "expected ')'");
+
+        if (variables ? token.token_type != PDDLP_TOKEN_VARIABLE : !check_is_name(token.token_type)) {
+            check_report(ck, token, variables ? "expected a variable" : "expected a name");
+            continue;
+        }
+
+        *CHECK_PUSH(ck, ck->pending, ck->pending_count) = token;
+    }
+
+    for (uint32_t i = 0; i < ck->pending_count; ++i)
+        check_add_entry(ck, list, ck->pending[i], 0);
+}
+
+// `(name params...)` declarations of predicates or functions, up to the
+// closing paren of the section. functions may be followed by `- type`.
+static void
+check_skeletons(struct check *ck, struct symbols *symbols, struct check_skeleton **skeletons, uint32_t *count,
+    bool functions)
+{
+    struct pddlp_checker *c = ck->checker;
+
+    while (!check_at_end(ck)) {
+        check_expect(ck, PDDLP_TOKEN_LPAREN, "expected '('");
+        struct pddlp_token name = check_expect_name(ck);
+
+        uint32_t param_first = c->param_count;
+        check_typed_list(ck, CHECK_PARAMS);
+
+        if (symbols_find(symbols, name.start, name.length) != PDDLP_NONE) {
+            check_report(ck, name, functions ? "duplicate function" : "duplicate predicate");
+        } else {
+            check_insert(ck, symbols, check_intern(ck, name), name.length, *count);
+            struct check_skeleton *skeleton = CHECK_PUSH(ck, *skeletons, *count);
+            skeleton->param_first = param_first;
+            skeleton->arity = c->param_count - param_first;
+        }
+
+        if (functions && check_peek(ck) == PDDLP_TOKEN_MINUS) {
+            check_next(ck);
+            check_expect_name(ck);
+        }
+    }
+}
+
+// formulas
+
+static uint32_t
+check_find_variable(struct check *ck, struct pddlp_token token)
+{
+    // the innermost variable of the name wins.
+    for (uint32_t i = ck->scope_count; i-- > 0;) {
+        const struct check_variable *variable = &ck->scope[i];
+        if (variable->length == token.length && memcmp(variable->name, token.start, token.length) == 0)
+            return variable->type;
+    }
+
+    check_report(ck, token, "undeclared variable");
+    return CHECK_ANY;
+}
+
+// checks an object or constant where one of type `expected` goes.
+static void
+check_object(struct check *ck, struct pddlp_token token, uint32_t hash, uint32_t expected)
+{
+    const struct pddlp_checker *c = ck->checker;
+    uint32_t type = CHECK_ANY;
+    uint32_t object = PDDLP_NONE;
+
+    if (ck->problem)
+        object = check_find_object_hashed(ck, token.start, token.length, hash);
+
+    if (object != PDDLP_NONE) {
+        type = ck->objects[object].type;
+    } else {
+        uint32_t constant = symbols_find_hashed(&c->constant_symbols, token.start, token.length, hash);
+        if (constant != PDDLP_NONE)
+            type = c->constant_types[constant];
+        else
+            check_report(ck, token, ck->problem ? "undeclared object" : "undeclared constant");
+    }
+
+    if (!check_compatible(c, type, expected, false))
+        check_report(ck, token, "argument of the wrong type");
+}
+
+// checks one formula, effect, term or numeric expression. `expected` is the
+// type a term has to have there, or CHECK_ANY.
+static void
+check_expression(struct check *ck, uint32_t expected)
+{
+    const struct pddlp_checker *c = ck->checker;
+    struct pddlp_token token = check_next(ck);
+
+    switch (token.token_type) {
+    case PDDLP_TOKEN_NUMBER:
+        return;
+    case PDDLP_TOKEN_VARIABLE:
+        if (!check_compatible(c, check_find_variable(ck, token), expected, true))
+            check_report(ck, token, "argument of the wrong type");
+        return;
+    case PDDLP_TOKEN_LPAREN:
+        break;
+    case PDDLP_TOKEN_EOF:
+    case PDDLP_TOKEN_RPAREN:
+        check_fail(ck, token, "expected an expression");
+        return;
+    default:
+        if (!check_is_name(token.token_type)) {
+            check_report(ck, token, "expected an expression");
+            return;
+        }
+
+        check_object(ck, token, hash_name(token.start, token.length), expected);
+        return;
+    }
+
+    struct pddlp_token head = check_next(ck);
+    bool call = false;
+
+    switch (head.token_type) {
+    case PDDLP_TOKEN_RPAREN:
+        return;
+
+    case PDDLP_TOKEN_FORALL:
+    case PDDLP_TOKEN_EXISTS: {
+        uint32_t scope_count = ck->scope_count;
+        check_expect(ck, PDDLP_TOKEN_LPAREN, "expected '('");
+        check_typed_list(ck, CHECK_VARIABLES);
+
+        while (!check_at_end(ck))
+            check_expression(ck, CHECK_ANY);
+
+        ck->scope_count = scope_count;
+        return;
+    }
+
+    case PDDLP_TOKEN_AT:
+        // `(at start ...)`, `(at 10 (p))` for a timed initial literal, or
+        // the at predicate.
+        if (check_peek(ck) == PDDLP_TOKEN_START || check_peek(ck) == PDDLP_TOKEN_END)
+            check_next(ck);
+        else if (check_peek(ck) != PDDLP_TOKEN_NUMBER)
+            call = true;
+        break;
+
+    case PDDLP_TOKEN_OVER:
+        check_expect(ck, PDDLP_TOKEN_ALL, "expected all");
+        break;
+
+    case PDDLP_TOKEN_PREFERENCE:
+        if (check_is_name(check_peek(ck)))
+            check_next(ck);
+        break;
+
+    case PDDLP_TOKEN_IS_VIOLATED:
+        check_expect_name(ck);
+        break;
+
+    case PDDLP_TOKEN_AND:
+    case PDDLP_TOKEN_OR:
+    case PDDLP_TOKEN_NOT:
+    case PDDLP_TOKEN_IMPLY:
+    case PDDLP_TOKEN_WHEN:
+    case PDDLP_TOKEN_EQ:
+    case PDDLP_TOKEN_LT:
+    case PDDLP_TOKEN_LTE:
+    case PDDLP_TOKEN_GT:
+    case PDDLP_TOKEN_GTE:
+    case PDDLP_TOKEN_PLUS:
+    case PDDLP_TOKEN_MINUS:
+    case PDDLP_TOKEN_STAR:
+    case PDDLP_TOKEN_SLASH:
+    case PDDLP_TOKEN_ASSIGN:
+    case PDDLP_TOKEN_INCREASE:
+    case PDDLP_TOKEN_DECREASE:
+    case PDDLP_TOKEN_SCALE_UP:
+    case PDDLP_TOKEN_SCALE_DOWN:
+    case PDDLP_TOKEN_TOTAL_TIME:
+    case PDDLP_TOKEN_ALWAYS:
+    case PDDLP_TOKEN_SOMETIME:
+    case PDDLP_TOKEN_WITHIN:
+    case PDDLP_TOKEN_AT_MOST_ONCE:
+    case PDDLP_TOKEN_SOMETIME_AFTER:
+    case PDDLP_TOKEN_SOMETIME_BEFORE:
+    case PDDLP_TOKEN_ALWAYS_WITHIN:
+    case PDDLP_TOKEN_HOLD_DURING:
+    case PDDLP_TOKEN_HOLD_AFTER:
+        break;
+
+    default:
+        if (!check_is_name(head.token_type)) {
+            check_report(ck, head, "expected a formula");
+            check_skip_list(ck);
+            return;
+        }
+
+        call = true;
+    }
+
+    if (!call) {
+        while (!check_at_end(ck))
+            check_expression(ck, CHECK_ANY);
+        return;
+    }
+
+    // `(name terms...)` where name is a predicate or a function.
+    uint32_t hash = hash_name(head.start, head.length);
+    const struct check_skeleton *skeleton = NULL;
+
+    uint32_t predicate = symbols_find_hashed(&c->predicate_symbols, head.start, head.length, hash);
+    if (predicate != PDDLP_NONE) {
+        skeleton = &c->predicates[predicate];
+    } else {
+        uint32_t function = symbols_find_hashed(&c->function_symbols, head.start, head.length, hash);
+        if (function != PDDLP_NONE)
+            skeleton = &c->functions[function];
+        else
+            check_report(ck, head, c->function_count ? "undeclared predicate or function" : "undeclared predicate");
+    }
+
+    // arguments that are names, which is most of them in :init, are looked
+    // up one token late, with their slot prefetched, so a cache miss on a
+    // large table overlaps scanning the next token.
+    struct pddlp_token pending = { .start = NULL };
+    uint32_t pending_hash = 0;
+    uint32_t pending_type = CHECK_ANY;
+    uint32_t count = 0;
+
+    for (; !check_at_end(ck); ++count) {
+        bool typed = skeleton && count < skeleton->arity;
+        uint32_t expected = typed ? c->param_types[skeleton->param_first + count] : CHECK_ANY;
+        bool name = check_is_name(check_peek(ck));
+
+        if (pending.start) {
+            check_object(ck, pending, pending_hash, pending_type);
+            pending.start = NULL;
+        }
+
+        if (!name) {
+            check_expression(ck, expected);
+            continue;
+        }
+
+        pending = check_next(ck);
+        pending_hash = hash_name(pending.start, pending.length);
+        pending_type = expected;
+        check_prefetch_object(ck, pending_hash);
+    }
+
+    if (pending.start)
+        check_object(ck, pending, pending_hash, pending_type);
+
+    if (skeleton && count != skeleton->arity)
+        check_report(ck, head, "wrong number of arguments");
+}
+
+// skips what can't be checked, like the value of an unknown field.
+static void
+check_skip_expression(struct check *ck)
+{
+    if (check_next(ck).token_type == PDDLP_TOKEN_LPAREN)
+        check_skip_list(ck);
+}
+
+// domains
+
+static void
+check_action(struct check *ck, bool durative)
+{
+    struct pddlp_checker *c = ck->checker;
+    struct pddlp_token name = check_expect_name(ck);
+
+    if (symbols_find(&c->action_symbols, name.start, name.length) != PDDLP_NONE) {
+        check_report(ck, name, "duplicate action");
+    } else {
+        check_insert(ck, &c->action_symbols, check_intern(ck, name), name.length, c->action_count);
+        c->action_count++;
+    }
+
+    ck->scope_count = 0;
+
+    if (check_peek(ck) == PDDLP_TOKEN_SYM_PARAMETERS) {
+        check_next(ck);
+        check_expect(ck, PDDLP_TOKEN_LPAREN, "expected '('");
+        check_typed_list(ck, CHECK_VARIABLES);
+    }
+
+    if (durative) {
+        struct check_variable *duration = CHECK_PUSH(ck, ck->scope, ck->scope_count);
+        duration->name = "?duration";
+        duration->length = 9;
+        duration->type = CHECK_ANY;
+    }
+
+    while (!check_at_end(ck)) {
+        struct pddlp_token field = check_next(ck);
+
+        switch (field.token_type) {
+        case PDDLP_TOKEN_SYM_PRECONDITION:
+            if (durative)
+                check_report(ck, field, "durative actions use :condition");
+            check_expression(ck, CHECK_ANY);
+            break;
+        case PDDLP_TOKEN_SYM_CONDITION:
+            if (!durative)
+                check_report(ck, field, "actions use :precondition");
+            check_expression(ck, CHECK_ANY);
+            break;
+        case PDDLP_TOKEN_SYM_DURATION:
+            if (!durative)
+                check_report(ck, field, "only durative actions have a :duration");
+            check_expression(ck, CHECK_ANY);
+            break;
+        case PDDLP_TOKEN_SYM_EFFECT:
+            check_expression(ck, CHECK_ANY);
+            break;
+        default:
+            check_report(ck, field, "unexpected action field");
+            check_skip_expression(ck);
+        }
+    }
+}
+
+// `(:derived (name ?x - t...) formula)`, for a declared predicate.
+static void
+check_derived(struct check *ck)
+{
+    const struct pddlp_checker *c = ck->checker;
+
+    check_expect(ck, PDDLP_TOKEN_LPAREN, "expected '('");
+    struct pddlp_token name = check_expect_name(ck);
+
+    ck->scope_count = 0;
+    check_typed_list(ck, CHECK_VARIABLES);
+
+    uint32_t predicate = symbols_find(&c->predicate_symbols, name.start, name.length);
+    if (predicate == PDDLP_NONE)
+        check_report(ck, name, "undeclared predicate");
+    else if (c->predicates[predicate].arity != ck->scope_count)
+        check_report(ck, name, "wrong number of arguments");
+
+    check_expression(ck, CHECK_ANY);
+    check_expect(ck, PDDLP_TOKEN_RPAREN, "expected ')'");
+}
+
+static void
+check_domain(struct check *ck)
+{
+    struct pddlp_checker *c = ck->checker;
+
+    check_expect(ck, PDDLP_TOKEN_LPAREN, "expected '('");
+    check_expect(ck, PDDLP_TOKEN_DEFINE, "expected define");
+    check_expect(ck, PDDLP_TOKEN_LPAREN, "expected '('");
+    check_expect(ck, PDDLP_TOKEN_DOMAIN, "expected domain");
+    c->domain_name = check_intern(ck, check_expect_name(ck));
+    check_expect(ck, PDDLP_TOKEN_RPAREN, "expected ')'");
+
+    while (!check_at_end(ck)) {
+        check_expect(ck, PDDLP_TOKEN_LPAREN, "expected '('");
+        struct pddlp_token section = check_next(ck);
+
+        switch (section.token_type) {
+        case PDDLP_TOKEN_SYM_REQUIREMENTS:
+            check_skip_list(ck);
+            break;
+        case PDDLP_TOKEN_SYM_TYPES:
+            check_typed_list(ck, CHECK_TYPES);
+            break;
+        case PDDLP_TOKEN_SYM_CONSTANTS:
+            check_typed_list(ck, CHECK_CONSTANTS);
+            break;
+        case PDDLP_TOKEN_SYM_PREDICATES:
+            check_skeletons(ck, &c->predicate_symbols, &c->predicates, &c->predicate_count, false);
+            break;
+        case PDDLP_TOKEN_SYM_FUNCTIONS:
+            check_skeletons(ck, &c->function_symbols, &c->functions, &c->function_count, true);
+            break;
+        case PDDLP_TOKEN_SYM_CONSTRAINTS:
+            ck->scope_count = 0;
+            check_expression(ck, CHECK_ANY);
+            check_expect(ck, PDDLP_TOKEN_RPAREN, "expected ')'");
+            break;
+        case PDDLP_TOKEN_SYM_ACTION:
+            check_action(ck, false);
+            break;
+        case PDDLP_TOKEN_SYM_DURATIVE_ACTION:
+            check_action(ck, true);
+            break;
+        case PDDLP_TOKEN_SYM_DERIVED:
+            check_derived(ck);
+            break;
+        default:
+            check_report(ck, section, "unexpected domain section");
+            check_skip_list(ck);
+        }
+    }
+
+    check_expect(ck, PDDLP_TOKEN_EOF, "expected end of input");
+}
+
+// problems
+
+static void
+check_problem(struct check *ck)
+{
+    const struct pddlp_checker *c = ck->checker;
+
+    check_expect(ck, PDDLP_TOKEN_LPAREN, "expected '('");
+    check_expect(ck, PDDLP_TOKEN_DEFINE, "expected define");
+    check_expect(ck, PDDLP_TOKEN_LPAREN, "expected '('");
+    check_expect(ck, PDDLP_TOKEN_PROBLEM, "expected problem");
+    check_expect_name(ck);
+    check_expect(ck, PDDLP_TOKEN_RPAREN, "expected ')'");
+
+    while (!check_at_end(ck)) {
+        check_expect(ck, PDDLP_TOKEN_LPAREN, "expected '('");
+        struct pddlp_token section = check_next(ck);
+
+        switch (section.token_type) {
+        case PDDLP_TOKEN_SYM_DOMAIN: {
+            struct pddlp_token name = check_expect_name(ck);
+            if (c->domain_name &&
+                (strncmp(c->domain_name, name.start, name.length) != 0 || c->domain_name[name.length] != 0))
+                check_report(ck, name, "problem is for another domain");
+            check_expect(ck, PDDLP_TOKEN_RPAREN, "expected ')'");
+            break;
+        }
+        case PDDLP_TOKEN_SYM_REQUIREMENTS:
+        case PDDLP_TOKEN_SYM_LENGTH:
+            check_skip_list(ck);
+            break;
+        case PDDLP_TOKEN_SYM_OBJECTS:
+            check_typed_list(ck, CHECK_OBJECTS);
+            break;
+        case PDDLP_TOKEN_SYM_INIT:
+            // the entries are formulas over objects, so they go through the
+            // same checks as the goal.
+            while (!check_at_end(ck))
+                check_expression(ck, CHECK_ANY);
+            break;
+        case PDDLP_TOKEN_SYM_GOAL:
+        case PDDLP_TOKEN_SYM_CONSTRAINTS:
+            check_expression(ck, CHECK_ANY);
+            check_expect(ck, PDDLP_TOKEN_RPAREN, "expected ')'");
+            break;
+        case PDDLP_TOKEN_SYM_METRIC: {
+            struct pddlp_token direction = check_next(ck);
+            if (direction.token_type != PDDLP_TOKEN_MINIMIZE && direction.token_type != PDDLP_TOKEN_MAXIMIZE)
+                check_report(ck, direction, "expected minimize or maximize");
+            check_expression(ck, CHECK_ANY);
+            check_expect(ck, PDDLP_TOKEN_RPAREN, "expected ')'");
+            break;
+        }
+        default:
+            check_report(ck, section, "unexpected problem section");
+            check_skip_list(ck);
+        }
+    }
+
+    check_expect(ck, PDDLP_TOKEN_EOF, "expected end of input");
+}
+
+static void
+check_init(struct check *ck, struct pddlp_checker *checker, const char *source, pddlp_report_fn report,
+    void *context)
+{
+    memset(ck, 0, sizeof(*ck));
+    pddlp_init_tokenizer(&ck->tokenizer, source);
+    ck->checker = checker;
+    ck->report = report;
+    ck->context = context;
+    ck->valid = true;
+}
+
+static void
+check_free(struct check *ck)
+{
+    array_free(ck->objects);
+    mem_free(ck->object_slots);
+    array_free(ck->scope);
+    array_free(ck->pending);
+}
+
+void
+pddlp_free_checker(struct pddlp_checker *c)
+{
+    if (c == NULL)
+        return;
+
+    symbols_free(&c->type_symbols);
+    symbols_free(&c->constant_symbols);
+    symbols_free(&c->predicate_symbols);
+    symbols_free(&c->function_symbols);
+    symbols_free(&c->action_symbols);
+    array_free(c->type_parents);
+    array_free(c->constant_types);
+    array_free(c->predicates);
+    array_free(c->functions);
+    array_free(c->param_types);
+    arena_free(&c->arena);
+    mem_free(c);
+}
+
+struct pddlp_checker *
+pddlp_new_checker(const char *source, pddlp_report_fn report, void *context, bool *valid)
+{
+    enum pddlp_subsystem previous = mem_enter(PDDLP_SUBSYSTEM_CHECKER);
+    struct pddlp_checker *c = mem_alloc(sizeof(*c));
+
+    if (c == NULL) {
+        mem_leave(previous);
+
+        struct pddlp_error error = { "out of memory", 0, 0 };
+        if (report)
+            report(context, &error);
+
+        *valid = false;
+        return NULL;
+    }
+
+    memset(c, 0, sizeof(*c));
+
+    struct check check;
+    struct check *ck = &check;
+    check_init(ck, c, source, report, context);
+
+    if (setjmp(ck->stop) == 0) {
+        struct pddlp_token object = { .start = "object", .length = 6 };
+        check_declare_type(ck, object);
+        c->type_parents[0] = PDDLP_NONE;
+        check_domain(ck);
+    }
+
+    check_free(ck);
+    mem_leave(previous);
+
+    // tables left incomplete would report names that are declared.
+    if (ck->out_of_memory) {
+        pddlp_free_checker(c);
+        c = NULL;
+    }
+
+    *valid = ck->valid;
+    return c;
+}
+
+bool
+pddlp_check_problem(const struct pddlp_checker *c, const char *source, pddlp_report_fn report, void *context)
+{
+    enum pddlp_subsystem previous = mem_enter(PDDLP_SUBSYSTEM_CHECKER);
+
+    struct check check;
+    struct check *ck = &check;
+
+    // the checker is only read from here on.
+    check_init(ck, (struct pddlp_checker *)c, source, report, context);
+    ck->problem = true;
+
+    if (setjmp(ck->stop) == 0)
+        check_problem(ck);
+
+    check_free(ck);
+    mem_leave(previous);
+    return ck->valid;
+}
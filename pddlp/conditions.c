@@ -0,0 +1,615 @@
+// SPDX-FileCopyrightText: 2024 Guilherme Puida Moreira <guilherme@puida.xyz>
+// SPDX-License-Identifier: BSD-3-Clause
+
+// preconditions and goals in negation normal form, with quantifiers
+// expanded, hash-consed into one store of nodes.
+
+#include "internal.h"
+
+#include <setjmp.h>
+
+struct conditions_range {
+    uint32_t variable;
+    uint32_t first;
+    uint32_t end;
+    uint32_t cursor;
+};
+
+struct conditions_compiler {
+    const struct pddlp_problem *problem;
+    struct pddlp_error *error;
+    jmp_buf fail;
+
+    struct pddlp_conditions *conditions;
+
+    // nodes by content: the type, then the value, whether it is negated and
+    // the terms or operands.
+    struct atoms table;
+    uint32_t *key;
+
+    // what the condition being compiled is written in: the domain for
+    // preconditions, the problem for the goal.
+    const struct pddlp_formulas *formulas;
+    const struct pddlp_typed_name *variables;
+    const uint32_t *type_refs;
+
+    // the term each variable stands for, or PDDLP_NONE outside its scope.
+    uint32_t *binding;
+
+    // operands of the `and`s and `or`s being built, innermost last.
+    uint32_t *stack;
+    uint32_t stack_count;
+
+    // the objects each variable of the quantifiers being expanded ranges
+    // over, and where the expansion is at.
+    struct conditions_range *ranges;
+    uint32_t range_count;
+    uint32_t *objects;
+    uint32_t object_count;
+
+    uint32_t *args;
+
+    // how many steps each node takes, or PDDLP_NONE when not known yet.
+    uint32_t *sizes;
+};
+
+static void
+conditions_fail(struct conditions_compiler *c, const char *message)
+{
+    c->error->message = message;
+    c->error->line = 0;
+    c->error->column = 0;
+    longjmp(c->fail, 1);
+}
+
+static void *
+conditions_reserve(struct conditions_compiler *c, void *items, uint32_t needed, size_t item_size)
+{
+    void *result = array_reserve(items, needed, item_size);
+    if (result == NULL && needed > 0)
+        conditions_fail(c, "out of memory");
+
+    return result;
+}
+
+#define CONDITIONS_PUSH(c, items, count) \
+    ((items) = conditions_reserve((c), (items), (count) + 1, sizeof(*(items))), &(items)[(count)++])
+
+static int
+conditions_compare(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a;
+    uint32_t y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+// nodes
+
+// returns the node with this content, adding it when it is new. `items` are
+// its terms, or its operands for `and` and `or`.
+static uint32_t
+conditions_node(struct conditions_compiler *c, enum pddlp_condition_type type, bool negated, uint32_t value,
+    const uint32_t *items, uint32_t count)
+{
+    struct pddlp_conditions *cs = c->conditions;
+
+    c->key = conditions_reserve(c, c->key, count + 2, sizeof(*c->key));
+    c->key[0] = value;
+    c->key[1] = negated;
+    if (count > 0)
+        memcpy(c->key + 2, items, sizeof(*items) * count);
+
+    uint32_t id = atoms_intern(&c->table, type, c->key, count + 2);
+    if (id == PDDLP_NONE)
+        conditions_fail(c, "out of memory");
+
+    if (id < cs->node_count)
+        return id;
+
+    bool operands = type == PDDLP_CONDITION_AND || type == PDDLP_CONDITION_OR;
+    struct pddlp_condition_node *node = CONDITIONS_PUSH(c, cs->nodes, cs->node_count);
+    node->type = type;
+    node->negated = negated;
+    node->value = value;
+    node->first = operands ? cs->operand_count : cs->term_count;
+    node->count = count;
+
+    for (uint32_t i = 0; i < count; ++i) {
+        if (operands)
+            *CONDITIONS_PUSH(c, cs->operands, cs->operand_count) = items[i];
+        else
+            *CONDITIONS_PUSH(c, cs->terms, cs->term_count) = items[i];
+    }
+
+    return id;
+}
+
+static uint32_t
+conditions_constant(struct conditions_compiler *c, bool value)
+{
+    return conditions_node(c, value ? PDDLP_CONDITION_TRUE : PDDLP_CONDITION_FALSE, false, 0, NULL, 0);
+}
+
+// the `and` or `or` of the operands on the stack from `base` on, which are
+// popped. operands of the same kind are flattened into it, constants are
+// folded, and the rest are sorted so the order they were written in doesn't
+// matter.
+static uint32_t
+conditions_combine(struct conditions_compiler *c, enum pddlp_condition_type type, uint32_t base)
+{
+    struct pddlp_conditions *cs = c->conditions;
+    enum pddlp_condition_type identity = type == PDDLP_CONDITION_AND ? PDDLP_CONDITION_TRUE : PDDLP_CONDITION_FALSE;
+    enum pddlp_condition_type absorbing = type == PDDLP_CONDITION_AND ? PDDLP_CONDITION_FALSE : PDDLP_CONDITION_TRUE;
+
+    uint32_t end = c->stack_count;
+    for (uint32_t i = base; i < end; ++i) {
+        uint32_t operand = c->stack[i];
+        const struct pddlp_condition_node *node = &cs->nodes[operand];
+
+        if (node->type == absorbing) {
+            c->stack_count = base;
+            return operand;
+        }
+
+        if (node->type == identity)
+            continue;
+
+        if (node->type == type) {
+            uint32_t first = node->first, count = node->count;
+            for (uint32_t j = 0; j < count; ++j)
+                *CONDITIONS_PUSH(c, c->stack, c->stack_count) = cs->operands[first + j];
+            continue;
+        }
+
+        *CONDITIONS_PUSH(c, c->stack, c->stack_count) = operand;
+    }
+
+    uint32_t *operands = c->stack + end;
+    uint32_t count = c->stack_count - end;
+    qsort(operands, count, sizeof(*operands), conditions_compare);
+
+    uint32_t unique = 0;
+    for (uint32_t i = 0; i < count; ++i)
+        if (unique == 0 || operands[i] != operands[unique - 1])
+            operands[unique++] = operands[i];
+
+    uint32_t result;
+    if (unique == 0)
+        result = conditions_constant(c, type == PDDLP_CONDITION_AND);
+    else if (unique == 1)
+        result = operands[0];
+    else
+        result = conditions_node(c, type, false, 0, operands, unique);
+
+    c->stack_count = base;
+    return result;
+}
+
+// formulas
+
+static uint32_t
+conditions_term(struct conditions_compiler *c, uint32_t node)
+{
+    const struct pddlp_node *n = &c->formulas->nodes[node];
+
+    if (n->node_type == PDDLP_NODE_OBJECT)
+        return n->value;
+
+    if (n->node_type == PDDLP_NODE_VARIABLE && c->binding[n->value] != PDDLP_NONE)
+        return c->binding[n->value];
+
+    conditions_fail(c, "conditions support only objects and bound variables as terms");
+    return PDDLP_NONE;
+}
+
+static uint32_t
+conditions_atom(struct conditions_compiler *c, uint32_t node, bool negated)
+{
+    const struct pddlp_formulas *f = c->formulas;
+    const struct pddlp_node *n = &f->nodes[node];
+
+    for (uint32_t i = 0; i < n->count; ++i)
+        c->args[i] = conditions_term(c, f->children[n->first + i]);
+
+    return conditions_node(c, PDDLP_CONDITION_ATOM, negated, n->value, c->args, n->count);
+}
+
+// equalities between objects are decided right away, and so are the ones
+// between a parameter and itself.
+static uint32_t
+conditions_equal(struct conditions_compiler *c, uint32_t node, bool negated)
+{
+    const struct pddlp_formulas *f = c->formulas;
+    const struct pddlp_node *n = &f->nodes[node];
+
+    uint32_t terms[2];
+    terms[0] = conditions_term(c, f->children[n->first]);
+    terms[1] = conditions_term(c, f->children[n->first + 1]);
+
+    if (terms[0] == terms[1])
+        return conditions_constant(c, !negated);
+
+    if (!(terms[0] & PDDLP_CONDITION_PARAM) && !(terms[1] & PDDLP_CONDITION_PARAM))
+        return conditions_constant(c, negated);
+
+    if (terms[0] > terms[1]) {
+        uint32_t term = terms[0];
+        terms[0] = terms[1];
+        terms[1] = term;
+    }
+
+    return conditions_node(c, PDDLP_CONDITION_EQUAL, negated, 0, terms, 2);
+}
+
+// quantifiers
+
+// pushes a range for each variable of the quantifier `n`, and binds them to
+// the first objects. returns false when some variable has none to take.
+// untyped variables range over every object, and `either` over the objects
+// of each of its types, so an object of more than one is taken more than
+// once. conditions_combine merges what comes out of those.
+static bool
+conditions_ranges(struct conditions_compiler *c, const struct pddlp_node *n)
+{
+    const struct pddlp_formulas *f = c->formulas;
+    const struct pddlp_problem *pr = c->problem;
+    bool empty = false;
+
+    for (uint32_t k = 0; k + 1 < n->count; ++k) {
+        const struct pddlp_node *v = &f->nodes[f->children[n->first + k]];
+        if (v->node_type != PDDLP_NODE_VARIABLE)
+            conditions_fail(c, "malformed quantifier");
+
+        const struct pddlp_typed_name *name = &c->variables[v->value];
+        uint32_t type_count = name->type_count ? name->type_count : 1;
+
+        struct conditions_range *range = CONDITIONS_PUSH(c, c->ranges, c->range_count);
+        range->variable = v->value;
+        range->first = c->object_count;
+
+        for (uint32_t t = 0; t < type_count; ++t) {
+            uint32_t type = name->type_count ? c->type_refs[name->type_first + t] : 0;
+            for (uint32_t i = pr->type_objects_first[type]; i < pr->type_objects_first[type + 1]; ++i)
+                *CONDITIONS_PUSH(c, c->objects, c->object_count) = pr->type_objects[i];
+        }
+
+        range = &c->ranges[c->range_count - 1];
+        range->end = c->object_count;
+        range->cursor = range->first;
+        empty |= range->first == range->end;
+        if (!empty)
+            c->binding[range->variable] = c->objects[range->first];
+    }
+
+    return !empty;
+}
+
+// binds the variables of the ranges from `base` on to the next combination
+// of objects, the last variable changing fastest. returns false once they
+// have all been through.
+static bool
+conditions_advance(struct conditions_compiler *c, uint32_t base)
+{
+    for (uint32_t k = c->range_count; k > base; --k) {
+        struct conditions_range *range = &c->ranges[k - 1];
+
+        if (++range->cursor < range->end) {
+            c->binding[range->variable] = c->objects[range->cursor];
+            return true;
+        }
+
+        range->cursor = range->first;
+        c->binding[range->variable] = c->objects[range->first];
+    }
+
+    return false;
+}
+
+// compiles the formula at `node`, or its negation, pushing the `not`s down
+// to the atoms on the way.
+static uint32_t
+conditions_formula(struct conditions_compiler *c, uint32_t node, bool negated)
+{
+    const struct pddlp_formulas *f = c->formulas;
+    const struct pddlp_node *n = &f->nodes[node];
+
+    if (n->node_type == PDDLP_NODE_ATOM)
+        return conditions_atom(c, node, negated);
+
+    if (n->node_type != PDDLP_NODE_COMPOUND)
+        conditions_fail(c, "malformed condition");
+
+    uint32_t base = c->stack_count;
+    enum pddlp_condition_type all = negated ? PDDLP_CONDITION_OR : PDDLP_CONDITION_AND;
+    enum pddlp_condition_type any = negated ? PDDLP_CONDITION_AND : PDDLP_CONDITION_OR;
+
+    switch (n->op) {
+    case PDDLP_TOKEN_AND:
+    case PDDLP_TOKEN_OR:
+        for (uint32_t i = 0; i < n->count; ++i) {
+            uint32_t operand = conditions_formula(c, f->children[n->first + i], negated);
+            *CONDITIONS_PUSH(c, c->stack, c->stack_count) = operand;
+        }
+        return conditions_combine(c, n->op == PDDLP_TOKEN_AND ? all : any, base);
+    case PDDLP_TOKEN_NOT:
+        if (n->count != 1)
+            break;
+        return conditions_formula(c, f->children[n->first], !negated);
+    case PDDLP_TOKEN_IMPLY: {
+        if (n->count != 2)
+            break;
+        uint32_t premise = conditions_formula(c, f->children[n->first], !negated);
+        *CONDITIONS_PUSH(c, c->stack, c->stack_count) = premise;
+        uint32_t conclusion = conditions_formula(c, f->children[n->first + 1], negated);
+        *CONDITIONS_PUSH(c, c->stack, c->stack_count) = conclusion;
+        return conditions_combine(c, any, base);
+    }
+    case PDDLP_TOKEN_FORALL:
+    case PDDLP_TOKEN_EXISTS: {
+        if (n->count == 0)
+            break;
+
+        // a quantifier over a type without objects expands to nothing.
+        uint32_t ranges = c->range_count, objects = c->object_count;
+        for (bool more = conditions_ranges(c, n); more; more = conditions_advance(c, ranges)) {
+            uint32_t body = conditions_formula(c, f->children[n->first + n->count - 1], negated);
+            *CONDITIONS_PUSH(c, c->stack, c->stack_count) = body;
+        }
+
+        for (uint32_t k = ranges; k < c->range_count; ++k)
+            c->binding[c->ranges[k].variable] = PDDLP_NONE;
+        c->range_count = ranges;
+        c->object_count = objects;
+
+        return conditions_combine(c, n->op == PDDLP_TOKEN_FORALL ? all : any, base);
+    }
+    case PDDLP_TOKEN_EQ:
+        if (n->count != 2)
+            break;
+        return conditions_equal(c, node, negated);
+    default:
+        break;
+    }
+
+    conditions_fail(c, "conditions support only and, or, not, imply, forall, exists, atoms and equality");
+    return PDDLP_NONE;
+}
+
+// a condition whose root is `node` in `formulas`, or true when there is
+// none. the first `param_count` variables from `variable_first` are the
+// parameters.
+static uint32_t
+conditions_root(struct conditions_compiler *c, const struct pddlp_formulas *formulas,
+    const struct pddlp_typed_name *variables, const uint32_t *type_refs, uint32_t variable_first,
+    uint32_t param_count, uint32_t node)
+{
+    if (node == PDDLP_NONE)
+        return conditions_constant(c, true);
+
+    c->formulas = formulas;
+    c->variables = variables;
+    c->type_refs = type_refs;
+
+    for (uint32_t i = 0; i < param_count; ++i)
+        c->binding[variable_first + i] = PDDLP_CONDITION_PARAM | i;
+
+    uint32_t root = conditions_formula(c, node, false);
+
+    for (uint32_t i = 0; i < param_count; ++i)
+        c->binding[variable_first + i] = PDDLP_NONE;
+
+    return root;
+}
+
+// steps
+
+static uint32_t
+conditions_size(struct conditions_compiler *c, uint32_t node)
+{
+    const struct pddlp_conditions *cs = c->conditions;
+    const struct pddlp_condition_node *n = &cs->nodes[node];
+
+    if (c->sizes[node] != PDDLP_NONE)
+        return c->sizes[node];
+
+    uint64_t size = n->type == PDDLP_CONDITION_ATOM || n->type == PDDLP_CONDITION_EQUAL;
+    if (n->type == PDDLP_CONDITION_AND || n->type == PDDLP_CONDITION_OR)
+        for (uint32_t i = 0; i < n->count; ++i)
+            size += conditions_size(c, cs->operands[n->first + i]);
+
+    if (size >= PDDLP_CONDITION_HOLDS)
+        conditions_fail(c, "condition too large");
+
+    c->sizes[node] = size;
+    return size;
+}
+
+// writes the steps of `node` from `step` on. an operand of an `and` goes on
+// to the next one when it holds, and an operand of an `or` when it doesn't,
+// so a node takes a step for each atom under it. a node shared by several
+// others gets its own steps under each of them.
+static void
+conditions_emit(struct conditions_compiler *c, uint32_t node, uint32_t step, uint32_t on_true, uint32_t on_false)
+{
+    struct pddlp_conditions *cs = c->conditions;
+    const struct pddlp_condition_node *n = &cs->nodes[node];
+
+    if (n->type == PDDLP_CONDITION_ATOM || n->type == PDDLP_CONDITION_EQUAL) {
+        cs->steps[step].node = node;
+        cs->steps[step].on_true = on_true;
+        cs->steps[step].on_false = on_false;
+        return;
+    }
+
+    for (uint32_t i = 0; i < n->count; ++i) {
+        uint32_t operand = cs->operands[n->first + i];
+        uint32_t next = step + c->sizes[operand];
+        bool last = i + 1 == n->count;
+
+        if (n->type == PDDLP_CONDITION_AND)
+            conditions_emit(c, operand, step, last ? on_true : next, on_false);
+        else
+            conditions_emit(c, operand, step, on_true, last ? on_false : next);
+
+        step = next;
+    }
+}
+
+static void
+conditions_steps(struct conditions_compiler *c, struct pddlp_condition *condition)
+{
+    struct pddlp_conditions *cs = c->conditions;
+
+    uint64_t count = conditions_size(c, condition->root);
+    if (cs->step_count + count >= PDDLP_CONDITION_HOLDS)
+        conditions_fail(c, "conditions too large");
+
+    condition->first = cs->step_count;
+    condition->count = count;
+    cs->steps = conditions_reserve(c, cs->steps, cs->step_count + count, sizeof(*cs->steps));
+    cs->step_count += count;
+
+    if (count > 0)
+        conditions_emit(c, condition->root, condition->first, PDDLP_CONDITION_HOLDS, PDDLP_CONDITION_FAILS);
+}
+
+static size_t
+conditions_memory(const struct pddlp_conditions *cs)
+{
+    return sizeof(*cs) +
+        (size_t)array_capacity(cs->nodes) * sizeof(*cs->nodes) +
+        (size_t)array_capacity(cs->operands) * sizeof(*cs->operands) +
+        (size_t)array_capacity(cs->terms) * sizeof(*cs->terms) +
+        (size_t)array_capacity(cs->steps) * sizeof(*cs->steps) +
+        (size_t)array_capacity(cs->preconditions) * sizeof(*cs->preconditions);
+}
+
+static void
+conditions_compile(struct conditions_compiler *c)
+{
+    struct pddlp_conditions *cs = c->conditions;
+    const struct pddlp_problem *pr = c->problem;
+    const struct pddlp_domain *d = pr->domain;
+
+    uint32_t max_arity = 0;
+    for (uint32_t i = 0; i < d->predicate_count; ++i)
+        if (d->predicates[i].param_count > max_arity)
+            max_arity = d->predicates[i].param_count;
+
+    uint32_t variable_count = d->variable_count > pr->variable_count ? d->variable_count : pr->variable_count;
+    c->binding = conditions_reserve(c, NULL, variable_count, sizeof(*c->binding));
+    for (uint32_t i = 0; i < variable_count; ++i)
+        c->binding[i] = PDDLP_NONE;
+
+    c->args = conditions_reserve(c, NULL, max_arity, sizeof(*c->args));
+    cs->preconditions = conditions_reserve(c, NULL, d->action_count, sizeof(*cs->preconditions));
+
+    for (uint32_t a = 0; a < d->action_count; ++a) {
+        const struct pddlp_action *action = &d->actions[a];
+        if (action->durative)
+            conditions_fail(c, "conditions don't support durative actions");
+
+        cs->preconditions[a].root = conditions_root(c, &d->formulas, d->variables, d->type_refs,
+            action->variable_first, action->param_count, action->precondition);
+    }
+
+    cs->goal.root = conditions_root(c, &pr->formulas, pr->variables, pr->type_refs, 0, 0, pr->goal);
+
+    c->sizes = conditions_reserve(c, NULL, cs->node_count, sizeof(*c->sizes));
+    for (uint32_t i = 0; i < cs->node_count; ++i)
+        c->sizes[i] = PDDLP_NONE;
+
+    for (uint32_t a = 0; a < d->action_count; ++a)
+        conditions_steps(c, &cs->preconditions[a]);
+    conditions_steps(c, &cs->goal);
+
+    cs->scratch_count = max_arity > 2 ? max_arity : 2;
+    cs->memory = conditions_memory(cs);
+}
+
+static void
+conditions_free_compiler(struct conditions_compiler *c)
+{
+    atoms_free(&c->table);
+    array_free(c->key);
+    array_free(c->binding);
+    array_free(c->stack);
+    array_free(c->ranges);
+    array_free(c->objects);
+    array_free(c->args);
+    array_free(c->sizes);
+}
+
+struct pddlp_conditions *
+pddlp_compile_conditions(const struct pddlp_problem *problem, struct pddlp_error *error)
+{
+    struct conditions_compiler compiler;
+    struct conditions_compiler *c = &compiler;
+    memset(c, 0, sizeof(*c));
+    c->problem = problem;
+    c->error = error;
+
+    enum pddlp_subsystem previous = mem_enter(PDDLP_SUBSYSTEM_CONDITIONS);
+    c->conditions = mem_alloc(sizeof(*c->conditions));
+    if (c->conditions == NULL) {
+        mem_leave(previous);
+        error->message = "out of memory";
+        error->line = 0;
+        error->column = 0;
+        return NULL;
+    }
+
+    memset(c->conditions, 0, sizeof(*c->conditions));
+    c->conditions->problem = problem;
+
+    if (setjmp(c->fail)) {
+        pddlp_free_conditions(c->conditions);
+        conditions_free_compiler(c);
+        mem_leave(previous);
+        return NULL;
+    }
+
+    conditions_compile(c);
+    conditions_free_compiler(c);
+    mem_leave(previous);
+
+    return c->conditions;
+}
+
+void
+pddlp_free_conditions(struct pddlp_conditions *cs)
+{
+    if (cs == NULL)
+        return;
+
+    array_free(cs->nodes);
+    array_free(cs->operands);
+    array_free(cs->terms);
+    array_free(cs->steps);
+    array_free(cs->preconditions);
+    mem_free(cs);
+}
+
+bool
+pddlp_condition_holds(const struct pddlp_conditions *cs, const struct pddlp_condition *condition,
+    const uint32_t *params, pddlp_holds_fn holds, void *context, uint32_t *scratch)
+{
+    if (condition->count == 0)
+        return cs->nodes[condition->root].type == PDDLP_CONDITION_TRUE;
+
+    uint32_t step = condition->first;
+    while (step < PDDLP_CONDITION_HOLDS) {
+        const struct pddlp_condition_step *s = &cs->steps[step];
+        const struct pddlp_condition_node *n = &cs->nodes[s->node];
+
+        for (uint32_t i = 0; i < n->count; ++i) {
+            uint32_t term = cs->terms[n->first + i];
+            scratch[i] = (term & PDDLP_CONDITION_PARAM) ? params[term & ~PDDLP_CONDITION_PARAM] : term;
+        }
+
+        bool value = n->type == PDDLP_CONDITION_EQUAL ? scratch[0] == scratch[1] : holds(context, n->value, scratch);
+        step = value != n->negated ? s->on_true : s->on_false;
+    }
+
+    return step == PDDLP_CONDITION_HOLDS;
+}
@@ -0,0 +1,871 @@
+// SPDX-FileCopyrightText: 2024 Guilherme Puida Moreira <guilherme@puida.xyz>
+// SPDX-License-Identifier: BSD-3-Clause
+
+// the :init facts of a problem. once they are parsed, a hash set over their
+// contents drops the repeated ones and then answers membership queries. the
+// posting lists, by predicate and by object at each argument position, are
+// only built the first time they are asked for. updates change the set and
+// the lists in place.
+
+#include "internal.h"
+
+// a slot of the set is the hash of the fact in the high half and fact + 1 in
+// the low half, or 0 when empty. keeping the hash there means probing rarely
+// touches the facts.
+
+static uint32_t
+facts_hash(uint32_t predicate, const uint32_t *args, uint32_t arity)
+{
+    return (uint32_t)(hash64(args, sizeof(*args) * arity, predicate) >> 32);
+}
+
+static uint32_t
+facts_arity(const struct problem *pr, uint32_t predicate)
+{
+    return pr->base.domain->predicates[predicate].param_count;
+}
+
+static uint32_t
+facts_find(const struct problem *pr, uint32_t predicate, const uint32_t *args)
+{
+    if (pr->fact_capacity == 0)
+        return PDDLP_NONE;
+
+    const struct pddlp_problem *base = &pr->base;
+    uint32_t arity = facts_arity(pr, predicate);
+    uint32_t hash = facts_hash(predicate, args, arity);
+    uint32_t mask = pr->fact_capacity - 1;
+
+    for (uint32_t i = hash & mask;; i = (i + 1) & mask) {
+        uint64_t slot = pr->fact_slots[i];
+        if (slot == 0)
+            return PDDLP_NONE;
+
+        uint32_t fact = (uint32_t)slot - 1;
+        if ((uint32_t)(slot >> 32) == hash && base->fact_predicates[fact] == predicate &&
+            (arity == 0 || memcmp(base->fact_args + base->fact_args_first[fact], args, sizeof(*args) * arity) == 0))
+            return fact;
+    }
+}
+
+// how many facts ahead facts_index hashes, so the slot of each fact is
+// already being fetched by the time it is probed.
+#define FACTS_AHEAD 16
+
+#ifdef __GNUC__
+#define FACTS_PREFETCH(address) __builtin_prefetch((address), 1)
+#else
+#define FACTS_PREFETCH(address) ((void)(address))
+#endif
+
+PDDLP_INTERNAL bool
+facts_index(struct problem *pr)
+{
+    struct pddlp_problem *base = &pr->base;
+
+    // kept at most half full.
+    uint64_t capacity = 64;
+    while (capacity < (uint64_t)base->fact_count * 2)
+        capacity *= 2;
+
+    if (capacity > UINT32_MAX || capacity > SIZE_MAX / sizeof(uint64_t))
+        return false;
+
+    enum pddlp_subsystem previous = mem_enter(PDDLP_SUBSYSTEM_FACTS);
+    uint64_t *slots = mem_alloc(sizeof(*slots) * capacity);
+    mem_leave(previous);
+    if (slots == NULL)
+        return false;
+
+    memset(slots, 0, sizeof(*slots) * capacity);
+    pr->fact_slots = slots;
+    pr->fact_capacity = capacity;
+
+    // the facts that are kept are moved down over the dropped ones. they
+    // never move past the ones still to be read, so this works in place.
+    // the arguments of numeric fluents are mixed in with theirs, so with
+    // fluents around the arguments stay where they are.
+    bool move_args = base->fluent_count == 0;
+    uint32_t mask = capacity - 1;
+    uint32_t hashes[FACTS_AHEAD];
+    uint32_t count = 0;
+    uint32_t arg_count = 0;
+
+    for (uint32_t i = 0; i < base->fact_count + FACTS_AHEAD; ++i) {
+        if (i >= FACTS_AHEAD) {
+            uint32_t fact = i - FACTS_AHEAD;
+            uint32_t hash = hashes[fact % FACTS_AHEAD];
+            uint32_t predicate = base->fact_predicates[fact];
+            const uint32_t *args = base->fact_args + base->fact_args_first[fact];
+            uint32_t arity = facts_arity(pr, predicate);
+
+            uint32_t j = hash & mask;
+            bool repeated = false;
+            for (; slots[j] && !repeated; j = (j + 1) & mask) {
+                uint32_t other = (uint32_t)slots[j] - 1;
+                repeated = (uint32_t)(slots[j] >> 32) == hash && base->fact_predicates[other] == predicate &&
+                    (arity == 0 ||
+                        memcmp(base->fact_args + base->fact_args_first[other], args, sizeof(*args) * arity) == 0);
+            }
+
+            if (!repeated) {
+                slots[j] = (uint64_t)hash << 32 | (count + 1);
+
+                if (move_args && arity > 0)
+                    memmove(base->fact_args + arg_count, args, sizeof(*args) * arity);
+
+                base->fact_predicates[count] = predicate;
+                base->fact_args_first[count] = move_args ? arg_count : base->fact_args_first[fact];
+                arg_count += arity;
+                count++;
+            }
+        }
+
+        if (i < base->fact_count) {
+            uint32_t predicate = base->fact_predicates[i];
+            const uint32_t *args = base->fact_args + base->fact_args_first[i];
+            uint32_t hash = facts_hash(predicate, args, facts_arity(pr, predicate));
+
+            hashes[i % FACTS_AHEAD] = hash;
+            FACTS_PREFETCH(&slots[hash & mask]);
+        }
+    }
+
+    base->fact_count = count;
+    if (move_args)
+        base->fact_arg_count = arg_count;
+    return true;
+}
+
+PDDLP_INTERNAL void
+facts_free(struct problem *pr)
+{
+    uint32_t predicate_count = pr->base.domain->predicate_count;
+
+    mem_free(pr->fact_slots);
+    mem_free(pr->predicate_facts_first);
+    mem_free(pr->predicate_facts);
+
+    if (pr->postings_first) {
+        uint32_t posting_count = pr->postings_first[predicate_count];
+        for (uint32_t i = 0; i < posting_count; ++i) {
+            mem_free(pr->posting_offsets[i]);
+            mem_free(pr->posting_facts[i]);
+        }
+    }
+
+    mem_free(pr->postings_first);
+    mem_free(pr->posting_offsets);
+    mem_free(pr->posting_facts);
+    mem_free(pr->posting_objects);
+
+    if (pr->predicate_lists)
+        for (uint32_t p = 0; p < predicate_count; ++p)
+            array_free(pr->predicate_lists[p].facts);
+
+    for (uint32_t i = 0; i < pr->patch_count; ++i)
+        array_free(pr->patches[i].facts);
+
+    mem_free(pr->predicate_lists);
+    array_free(pr->fact_positions);
+    array_free(pr->patches);
+    mem_free(pr->patch_slots);
+}
+
+// posting lists. everything below runs with index_lock held.
+
+static void *
+facts_calloc(size_t count, size_t size)
+{
+    if (count == 0)
+        count = 1;
+
+    if (count > SIZE_MAX / size)
+        return NULL;
+
+    enum pddlp_subsystem previous = mem_enter(PDDLP_SUBSYSTEM_FACTS);
+    void *result = mem_alloc(count * size);
+    mem_leave(previous);
+    if (result)
+        memset(result, 0, count * size);
+
+    return result;
+}
+
+// groups the facts by predicate, and makes room for the posting lists of
+// every argument position.
+static bool
+facts_build_predicates(struct problem *pr)
+{
+    if (pr->predicate_facts_first)
+        return true;
+
+    const struct pddlp_problem *base = &pr->base;
+    const struct pddlp_domain *d = base->domain;
+
+    uint32_t *first = facts_calloc((size_t)d->predicate_count + 1, sizeof(*first));
+    uint32_t *facts = facts_calloc(base->fact_count, sizeof(*facts));
+    uint32_t *postings_first = facts_calloc((size_t)d->predicate_count + 1, sizeof(*postings_first));
+    if (first == NULL || facts == NULL || postings_first == NULL)
+        goto fail;
+
+    for (uint32_t i = 0; i < base->fact_count; ++i)
+        first[base->fact_predicates[i] + 1]++;
+
+    for (uint32_t p = 0; p < d->predicate_count; ++p) {
+        first[p + 1] += first[p];
+        postings_first[p + 1] = postings_first[p] + d->predicates[p].param_count;
+    }
+
+    // first[p] is the fill cursor of p, and ends up at the start of p + 1.
+    for (uint32_t i = 0; i < base->fact_count; ++i)
+        facts[first[base->fact_predicates[i]]++] = i;
+
+    for (uint32_t p = d->predicate_count; p > 0; --p)
+        first[p] = first[p - 1];
+    first[0] = 0;
+
+    uint32_t posting_count = postings_first[d->predicate_count];
+    pr->posting_offsets = facts_calloc(posting_count, sizeof(*pr->posting_offsets));
+    pr->posting_facts = facts_calloc(posting_count, sizeof(*pr->posting_facts));
+    pr->posting_objects = facts_calloc(posting_count, sizeof(*pr->posting_objects));
+    if (pr->posting_offsets == NULL || pr->posting_facts == NULL || pr->posting_objects == NULL)
+        goto fail;
+
+    pr->predicate_facts_first = first;
+    pr->predicate_facts = facts;
+    pr->postings_first = postings_first;
+    return true;
+
+fail:
+    mem_free(first);
+    mem_free(facts);
+    mem_free(postings_first);
+    mem_free(pr->posting_offsets);
+    mem_free(pr->posting_facts);
+    mem_free(pr->posting_objects);
+    pr->posting_offsets = NULL;
+    pr->posting_facts = NULL;
+    pr->posting_objects = NULL;
+    return false;
+}
+
+// the facts of `predicate`, once facts_build_predicates has run.
+static const uint32_t *
+facts_predicate_list(const struct problem *pr, uint32_t predicate, uint32_t *count)
+{
+    if (pr->predicate_lists && pr->predicate_lists[predicate].facts) {
+        *count = pr->predicate_lists[predicate].count;
+        return pr->predicate_lists[predicate].facts;
+    }
+
+    uint32_t first = pr->predicate_facts_first[predicate];
+    *count = pr->predicate_facts_first[predicate + 1] - first;
+    return pr->predicate_facts + first;
+}
+
+static uint32_t
+facts_patch_hash(uint32_t key, uint32_t object)
+{
+    uint32_t pair[2] = { key, object };
+    return (uint32_t)(hash64(pair, sizeof(pair), 0) >> 32);
+}
+
+// the copy of posting list `key` for `object`, or NULL when it hasn't
+// changed. slots are laid out like those of the set.
+static struct facts_list *
+facts_find_patch(const struct problem *pr, uint32_t key, uint32_t object)
+{
+    if (pr->patch_count == 0)
+        return NULL;
+
+    uint32_t hash = facts_patch_hash(key, object);
+    uint32_t mask = pr->patch_capacity - 1;
+
+    for (uint32_t i = hash & mask;; i = (i + 1) & mask) {
+        uint64_t slot = pr->patch_slots[i];
+        if (slot == 0)
+            return NULL;
+
+        struct facts_list *list = &pr->patches[(uint32_t)slot - 1];
+        if ((uint32_t)(slot >> 32) == hash && list->key == key && list->object == object)
+            return list;
+    }
+}
+
+// facts posting_facts[k][offsets[o] .. offsets[o + 1]) have object o at the
+// position, in increasing order, where offsets is posting_offsets[k].
+static bool
+facts_build_posting(struct problem *pr, uint32_t predicate, uint32_t position)
+{
+    uint32_t k = pr->postings_first[predicate] + position;
+    if (pr->posting_offsets[k])
+        return true;
+
+    const struct pddlp_problem *base = &pr->base;
+    uint32_t count;
+    const uint32_t *list = facts_predicate_list(pr, predicate, &count);
+
+    uint32_t *offsets = facts_calloc((size_t)base->object_count + 1, sizeof(*offsets));
+    uint32_t *facts = facts_calloc(count, sizeof(*facts));
+    if (offsets == NULL || facts == NULL) {
+        mem_free(offsets);
+        mem_free(facts);
+        return false;
+    }
+
+    for (uint32_t i = 0; i < count; ++i) {
+        uint32_t fact = list[i];
+        offsets[base->fact_args[base->fact_args_first[fact] + position] + 1]++;
+    }
+
+    for (uint32_t o = 0; o < base->object_count; ++o)
+        offsets[o + 1] += offsets[o];
+
+    for (uint32_t i = 0; i < count; ++i) {
+        uint32_t fact = list[i];
+        uint32_t object = base->fact_args[base->fact_args_first[fact] + position];
+        facts[offsets[object]++] = fact;
+    }
+
+    for (uint32_t o = base->object_count; o > 0; --o)
+        offsets[o] = offsets[o - 1];
+    offsets[0] = 0;
+
+    pr->posting_offsets[k] = offsets;
+    pr->posting_facts[k] = facts;
+    pr->posting_objects[k] = base->object_count;
+    return true;
+}
+
+// the unsynchronized part of pddlp_position_facts.
+static const uint32_t *
+facts_position(struct problem *pr, uint32_t predicate, uint32_t position, uint32_t object, uint32_t *count)
+{
+    if (!facts_build_predicates(pr) || !facts_build_posting(pr, predicate, position))
+        return NULL;
+
+    uint32_t k = pr->postings_first[predicate] + position;
+    const struct facts_list *patch = facts_find_patch(pr, k, object);
+    if (patch) {
+        *count = patch->count;
+        return patch->facts;
+    }
+
+    // objects added since the list was built have no facts in it.
+    if (object >= pr->posting_objects[k]) {
+        *count = 0;
+        return pr->posting_facts[k];
+    }
+
+    const uint32_t *offsets = pr->posting_offsets[k];
+    *count = offsets[object + 1] - offsets[object];
+    return pr->posting_facts[k] + offsets[object];
+}
+
+// updates. the set gets the same probing as above, with removals shifting
+// the slots after them back instead of leaving tombstones. a list built
+// before an update that changes it is copied out first, and the copy stands
+// in for it from then on, so an update costs the facts it touches plus, only
+// the first time, the lists it copies. lists lose their order on the way.
+
+static void
+facts_insert_slot(uint64_t *slots, uint32_t capacity, uint64_t slot)
+{
+    uint32_t mask = capacity - 1;
+    uint32_t i = (uint32_t)(slot >> 32) & mask;
+    while (slots[i])
+        i = (i + 1) & mask;
+
+    slots[i] = slot;
+}
+
+// keeps the set at most half full with `count` facts.
+static bool
+facts_grow(struct problem *pr, uint32_t count)
+{
+    if ((uint64_t)count * 2 <= pr->fact_capacity)
+        return true;
+
+    uint64_t capacity = pr->fact_capacity ? (uint64_t)pr->fact_capacity * 2 : 64;
+    while (capacity < (uint64_t)count * 2)
+        capacity *= 2;
+
+    if (capacity > UINT32_MAX || capacity > SIZE_MAX / sizeof(uint64_t))
+        return false;
+
+    uint64_t *slots = facts_calloc(capacity, sizeof(*slots));
+    if (slots == NULL)
+        return false;
+
+    for (uint32_t i = 0; i < pr->fact_capacity; ++i)
+        if (pr->fact_slots[i])
+            facts_insert_slot(slots, capacity, pr->fact_slots[i]);
+
+    mem_free(pr->fact_slots);
+    pr->fact_slots = slots;
+    pr->fact_capacity = capacity;
+    return true;
+}
+
+// the slot that holds `fact`.
+static uint32_t
+facts_slot(const struct problem *pr, uint32_t fact)
+{
+    const struct pddlp_problem *base = &pr->base;
+    uint32_t predicate = base->fact_predicates[fact];
+    uint32_t hash = facts_hash(predicate, base->fact_args + base->fact_args_first[fact], facts_arity(pr, predicate));
+    uint32_t mask = pr->fact_capacity - 1;
+
+    uint32_t i = hash & mask;
+    while ((uint32_t)pr->fact_slots[i] != fact + 1)
+        i = (i + 1) & mask;
+
+    return i;
+}
+
+static void
+facts_delete_slot(struct problem *pr, uint32_t i)
+{
+    uint64_t *slots = pr->fact_slots;
+    uint32_t mask = pr->fact_capacity - 1;
+
+    for (uint32_t j = (i + 1) & mask; slots[j]; j = (j + 1) & mask) {
+        // the fact in j can move back to i unless it hashes to (i, j].
+        uint32_t home = (uint32_t)(slots[j] >> 32) & mask;
+        if (((j - home) & mask) >= ((j - i) & mask)) {
+            slots[i] = slots[j];
+            i = j;
+        }
+    }
+
+    slots[i] = 0;
+}
+
+// makes room for `needed` facts in `list`.
+static bool
+facts_reserve_list(struct facts_list *list, uint32_t needed)
+{
+    uint32_t *facts = array_reserve(list->facts, needed, sizeof(*facts));
+    if (facts == NULL)
+        return false;
+
+    list->facts = facts;
+    return true;
+}
+
+// once the predicate lists are built, updates need the place of each fact
+// in them.
+static bool
+facts_track_positions(struct problem *pr)
+{
+    if (pr->predicate_facts_first == NULL || pr->predicate_lists)
+        return true;
+
+    const struct pddlp_problem *base = &pr->base;
+    struct facts_list *lists = facts_calloc(base->domain->predicate_count, sizeof(*lists));
+    uint32_t *positions = array_reserve(NULL, base->fact_count + 1, sizeof(*positions));
+    if (lists == NULL || positions == NULL) {
+        mem_free(lists);
+        array_free(positions);
+        return false;
+    }
+
+    for (uint32_t p = 0; p < base->domain->predicate_count; ++p) {
+        uint32_t first = pr->predicate_facts_first[p];
+        for (uint32_t i = first; i < pr->predicate_facts_first[p + 1]; ++i)
+            positions[pr->predicate_facts[i]] = i - first;
+    }
+
+    pr->predicate_lists = lists;
+    pr->fact_positions = positions;
+    return true;
+}
+
+// copies posting list `key` for `object` out, unless that was done already,
+// and makes room for `extra` more facts in it.
+static bool
+facts_patch(struct problem *pr, uint32_t key, uint32_t object, uint32_t extra)
+{
+    struct facts_list *list = facts_find_patch(pr, key, object);
+    if (list)
+        return facts_reserve_list(list, list->count + extra);
+
+    if ((uint64_t)(pr->patch_count + 1) * 2 > pr->patch_capacity) {
+        uint32_t capacity = pr->patch_capacity ? pr->patch_capacity * 2 : 64;
+        uint64_t *slots = facts_calloc(capacity, sizeof(*slots));
+        if (slots == NULL)
+            return false;
+
+        for (uint32_t i = 0; i < pr->patch_capacity; ++i)
+            if (pr->patch_slots[i])
+                facts_insert_slot(slots, capacity, pr->patch_slots[i]);
+
+        mem_free(pr->patch_slots);
+        pr->patch_slots = slots;
+        pr->patch_capacity = capacity;
+    }
+
+    struct facts_list *patches = array_reserve(pr->patches, pr->patch_count + 1, sizeof(*patches));
+    if (patches == NULL)
+        return false;
+    pr->patches = patches;
+
+    const uint32_t *facts = NULL;
+    uint32_t count = 0;
+    if (object < pr->posting_objects[key]) {
+        const uint32_t *offsets = pr->posting_offsets[key];
+        facts = pr->posting_facts[key] + offsets[object];
+        count = offsets[object + 1] - offsets[object];
+    }
+
+    struct facts_list patch = { key, object, NULL, count };
+    if (!facts_reserve_list(&patch, count + extra + 1))
+        return false;
+
+    if (count > 0)
+        memcpy(patch.facts, facts, sizeof(*facts) * count);
+
+    patches[pr->patch_count] = patch;
+    pr->patch_count++;
+    facts_insert_slot(pr->patch_slots, pr->patch_capacity,
+        (uint64_t)facts_patch_hash(key, object) << 32 | pr->patch_count);
+    return true;
+}
+
+// copies out every list built so far that has a fact of `predicate` with
+// `args`, making room for `extra` more facts in each.
+static bool
+facts_touch(struct problem *pr, uint32_t predicate, const uint32_t *args, uint32_t extra)
+{
+    if (pr->predicate_facts_first == NULL)
+        return true;
+
+    if (!facts_track_positions(pr))
+        return false;
+
+    struct facts_list *list = &pr->predicate_lists[predicate];
+    if (list->facts == NULL) {
+        uint32_t first = pr->predicate_facts_first[predicate];
+        uint32_t count = pr->predicate_facts_first[predicate + 1] - first;
+
+        if (!facts_reserve_list(list, count + extra + 1))
+            return false;
+
+        memcpy(list->facts, pr->predicate_facts + first, sizeof(*list->facts) * count);
+        list->count = count;
+    } else if (!facts_reserve_list(list, list->count + extra)) {
+        return false;
+    }
+
+    uint32_t k = pr->postings_first[predicate];
+    for (uint32_t i = 0; i < facts_arity(pr, predicate); ++i)
+        if (pr->posting_offsets[k + i] && !facts_patch(pr, k + i, args[i], extra))
+            return false;
+
+    return true;
+}
+
+// puts `fact` in its lists, which facts_touch made room in.
+static void
+facts_link(struct problem *pr, uint32_t fact)
+{
+    if (pr->predicate_lists == NULL)
+        return;
+
+    const struct pddlp_problem *base = &pr->base;
+    uint32_t predicate = base->fact_predicates[fact];
+    const uint32_t *args = base->fact_args + base->fact_args_first[fact];
+
+    struct facts_list *list = &pr->predicate_lists[predicate];
+    pr->fact_positions[fact] = list->count;
+    list->facts[list->count++] = fact;
+
+    uint32_t k = pr->postings_first[predicate];
+    for (uint32_t i = 0; i < facts_arity(pr, predicate); ++i) {
+        if (pr->posting_offsets[k + i]) {
+            struct facts_list *patch = facts_find_patch(pr, k + i, args[i]);
+            patch->facts[patch->count++] = fact;
+        }
+    }
+}
+
+// replaces `fact` in its lists with `other`, or takes it out of them when
+// `other` is PDDLP_NONE.
+static void
+facts_relink(struct problem *pr, uint32_t fact, uint32_t other)
+{
+    if (pr->predicate_lists == NULL)
+        return;
+
+    const struct pddlp_problem *base = &pr->base;
+    uint32_t predicate = base->fact_predicates[fact];
+    const uint32_t *args = base->fact_args + base->fact_args_first[fact];
+
+    struct facts_list *list = &pr->predicate_lists[predicate];
+    uint32_t position = pr->fact_positions[fact];
+    if (other == PDDLP_NONE) {
+        uint32_t moved = list->facts[--list->count];
+        list->facts[position] = moved;
+        pr->fact_positions[moved] = position;
+    } else {
+        list->facts[position] = other;
+        pr->fact_positions[other] = position;
+    }
+
+    uint32_t k = pr->postings_first[predicate];
+    for (uint32_t i = 0; i < facts_arity(pr, predicate); ++i) {
+        if (pr->posting_offsets[k + i] == NULL)
+            continue;
+
+        struct facts_list *patch = facts_find_patch(pr, k + i, args[i]);
+        uint32_t j = 0;
+        while (patch->facts[j] != fact)
+            j++;
+
+        patch->facts[j] = other == PDDLP_NONE ? patch->facts[--patch->count] : other;
+    }
+}
+
+// moves the arguments in use to the front of fact_args once most of it is
+// left over from removed facts, so that costs no more than the removals.
+static void
+facts_compact(struct problem *pr)
+{
+    struct pddlp_problem *base = &pr->base;
+    if (pr->dead_args < 4096 || pr->dead_args < base->fact_arg_count / 2)
+        return;
+
+    uint32_t *args = array_reserve(NULL, base->fact_arg_count - pr->dead_args + 1, sizeof(*args));
+    if (args == NULL)
+        return;
+
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < base->fact_count; ++i) {
+        uint32_t arity = facts_arity(pr, base->fact_predicates[i]);
+        memcpy(args + count, base->fact_args + base->fact_args_first[i], sizeof(*args) * arity);
+        base->fact_args_first[i] = count;
+        count += arity;
+    }
+
+    for (uint32_t i = 0; i < base->fluent_count; ++i) {
+        uint32_t arity = base->domain->functions[base->fluent_functions[i]].param_count;
+        memcpy(args + count, base->fact_args + base->fluent_args_first[i], sizeof(*args) * arity);
+        base->fluent_args_first[i] = count;
+        count += arity;
+    }
+
+    array_free(base->fact_args);
+    base->fact_args = args;
+    base->fact_arg_count = count;
+    pr->dead_args = 0;
+}
+
+PDDLP_INTERNAL uint32_t
+facts_add(struct problem *pr, uint32_t predicate, const uint32_t *args)
+{
+    uint32_t fact = facts_find(pr, predicate, args);
+    if (fact != PDDLP_NONE)
+        return fact;
+
+    struct pddlp_problem *base = &pr->base;
+    uint32_t arity = facts_arity(pr, predicate);
+    fact = base->fact_count;
+
+    if (fact == PDDLP_NONE - 1 || base->fact_arg_count > UINT32_MAX - arity)
+        return PDDLP_NONE;
+
+    // everything that can fail comes first.
+    uint32_t *predicates = array_reserve(base->fact_predicates, fact + 1, sizeof(*predicates));
+    if (predicates == NULL)
+        return PDDLP_NONE;
+    base->fact_predicates = predicates;
+
+    uint32_t *args_first = array_reserve(base->fact_args_first, fact + 1, sizeof(*args_first));
+    if (args_first == NULL)
+        return PDDLP_NONE;
+    base->fact_args_first = args_first;
+
+    if (arity > 0) {
+        uint32_t *fact_args = array_reserve(base->fact_args, base->fact_arg_count + arity, sizeof(*fact_args));
+        if (fact_args == NULL)
+            return PDDLP_NONE;
+        base->fact_args = fact_args;
+    }
+
+    if (!facts_grow(pr, fact + 1) || !facts_touch(pr, predicate, args, 1))
+        return PDDLP_NONE;
+
+    if (pr->fact_positions) {
+        uint32_t *positions = array_reserve(pr->fact_positions, fact + 1, sizeof(*positions));
+        if (positions == NULL)
+            return PDDLP_NONE;
+        pr->fact_positions = positions;
+    }
+
+    if (arity > 0)
+        memcpy(base->fact_args + base->fact_arg_count, args, sizeof(*args) * arity);
+
+    predicates[fact] = predicate;
+    args_first[fact] = base->fact_arg_count;
+    base->fact_arg_count += arity;
+    base->fact_count++;
+
+    uint32_t hash = facts_hash(predicate, args, arity);
+    facts_insert_slot(pr->fact_slots, pr->fact_capacity, (uint64_t)hash << 32 | (fact + 1));
+    facts_link(pr, fact);
+    return fact;
+}
+
+PDDLP_INTERNAL bool
+facts_remove(struct problem *pr, uint32_t fact)
+{
+    struct pddlp_problem *base = &pr->base;
+    uint32_t last = base->fact_count - 1;
+    uint32_t predicate = base->fact_predicates[fact];
+    uint32_t last_predicate = base->fact_predicates[last];
+
+    if (!facts_touch(pr, predicate, base->fact_args + base->fact_args_first[fact], 0) ||
+        !facts_touch(pr, last_predicate, base->fact_args + base->fact_args_first[last], 0))
+        return false;
+
+    facts_delete_slot(pr, facts_slot(pr, fact));
+    facts_relink(pr, fact, PDDLP_NONE);
+
+    if (last != fact) {
+        uint32_t slot = facts_slot(pr, last);
+        pr->fact_slots[slot] = (pr->fact_slots[slot] >> 32) << 32 | (fact + 1);
+        facts_relink(pr, last, fact);
+
+        base->fact_predicates[fact] = last_predicate;
+        base->fact_args_first[fact] = base->fact_args_first[last];
+    }
+
+    pr->dead_args += facts_arity(pr, predicate);
+    base->fact_count--;
+
+    facts_compact(pr);
+    return true;
+}
+
+// api
+
+uint32_t
+pddlp_find_fact(const struct pddlp_problem *problem, uint32_t predicate, const uint32_t *args)
+{
+    // only updates change the set, and they don't run alongside queries, so
+    // this needs no lock.
+    return facts_find((const struct problem *)problem, predicate, args);
+}
+
+const uint32_t *
+pddlp_predicate_facts(const struct pddlp_problem *problem, uint32_t predicate, uint32_t *count)
+{
+    struct problem *pr = (struct problem *)problem;
+    const uint32_t *result = NULL;
+    *count = 0;
+
+    pthread_mutex_lock(&pr->index_lock);
+
+    if (facts_build_predicates(pr))
+        result = facts_predicate_list(pr, predicate, count);
+
+    pthread_mutex_unlock(&pr->index_lock);
+    return result;
+}
+
+const uint32_t *
+pddlp_position_facts(const struct pddlp_problem *problem, uint32_t predicate, uint32_t position, uint32_t object,
+    uint32_t *count)
+{
+    struct problem *pr = (struct problem *)problem;
+    *count = 0;
+
+    pthread_mutex_lock(&pr->index_lock);
+    const uint32_t *result = facts_position(pr, predicate, position, object, count);
+    pthread_mutex_unlock(&pr->index_lock);
+
+    return result;
+}
+
+uint32_t
+pddlp_match_facts(const struct pddlp_problem *problem, uint32_t predicate, const uint32_t *pattern, uint32_t *facts,
+    uint32_t capacity)
+{
+    struct problem *pr = (struct problem *)problem;
+    uint32_t arity = facts_arity(pr, predicate);
+
+    uint32_t bound = 0;
+    for (uint32_t i = 0; i < arity; ++i)
+        if (pattern[i] != PDDLP_NONE)
+            bound++;
+
+    // a fully bound pattern is a membership query.
+    if (bound == arity) {
+        uint32_t fact = facts_find(pr, predicate, pattern);
+        if (fact == PDDLP_NONE)
+            return 0;
+
+        if (capacity > 0)
+            facts[0] = fact;
+
+        return 1;
+    }
+
+    pthread_mutex_lock(&pr->index_lock);
+
+    // scans the shortest list among the bound positions, so the cost is
+    // bounded by the size of that list rather than by the whole predicate.
+    const uint32_t *candidates = NULL;
+    uint32_t candidate_count = 0;
+    uint32_t scanned = PDDLP_NONE;
+
+    if (bound == 0) {
+        if (facts_build_predicates(pr))
+            candidates = facts_predicate_list(pr, predicate, &candidate_count);
+    } else {
+        for (uint32_t i = 0; i < arity; ++i) {
+            if (pattern[i] == PDDLP_NONE)
+                continue;
+
+            uint32_t count;
+            const uint32_t *list = facts_position(pr, predicate, i, pattern[i], &count);
+            if (list == NULL) {
+                candidates = NULL;
+                break;
+            }
+
+            if (candidates == NULL || count < candidate_count) {
+                candidates = list;
+                candidate_count = count;
+                scanned = i;
+            }
+        }
+    }
+
+    pthread_mutex_unlock(&pr->index_lock);
+
+    if (candidates == NULL)
+        return PDDLP_NONE;
+
+    const struct pddlp_problem *base = &pr->base;
+    uint32_t match_count = 0;
+
+    for (uint32_t i = 0; i < candidate_count; ++i) {
+        uint32_t fact = candidates[i];
+        const uint32_t *args = base->fact_args + base->fact_args_first[fact];
+
+        bool match = true;
+        for (uint32_t j = 0; j < arity && match; ++j)
+            match = j == scanned || pattern[j] == PDDLP_NONE || pattern[j] == args[j];
+
+        if (!match)
+            continue;
+
+        if (match_count < capacity)
+            facts[match_count] = fact;
+        match_count++;
+    }
+
+    return match_count;
+}
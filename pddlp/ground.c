@@ -0,0 +1,1599 @@
+// SPDX-FileCopyrightText: 2024 Guilherme Puida Moreira <guilherme@puida.xyz>
+// SPDX-License-Identifier: BSD-3-Clause
+
+// needed for sysconf.
+#define _POSIX_C_SOURCE 200809L
+
+#include "internal.h"
+
+#include <pthread.h>
+#include <setjmp.h>
+#include <unistd.h>
+
+// action schemas, compiled into the order parameters are bound in.
+
+// terms with this bit set are parameters, the others are objects.
+#define GROUND_PARAM 0x80000000u
+
+// equality is stored as an atom of this predicate.
+#define GROUND_EQUAL PDDLP_NONE
+
+struct ground_atom {
+    uint32_t predicate;
+    uint32_t first;             // into terms.
+    uint32_t count;
+};
+
+// a static atom or equality tested once `level` is bound. level 0 checks
+// run before anything is bound.
+struct ground_check {
+    uint32_t atom;
+    uint32_t level;
+    bool negated;
+};
+
+// a static atom that can enumerate the values of the parameter bound at
+// `level`, which appears at `position`. `key` is another position whose
+// value is known by then, or PDDLP_NONE to go through all the facts of the
+// predicate.
+struct ground_generator {
+    uint32_t atom;
+    uint32_t level;
+    uint32_t position;
+    uint32_t key;
+};
+
+struct ground_plan {
+    uint32_t action;
+    uint32_t param_count;
+    uint32_t variable_first;
+
+    struct ground_atom *atoms;
+    uint32_t atom_count;
+
+    uint32_t *terms;
+    uint32_t term_count;
+
+    struct ground_check *checks;
+    uint32_t check_count;
+
+    struct ground_generator *generators;
+    uint32_t generator_count;
+
+    // atoms of fluent predicates, and the level each one is interned at,
+    // which is as soon as its parameters are bound.
+    struct ground_check *interns;
+    uint32_t intern_count;
+    uint32_t *pre;
+    uint32_t pre_count;
+    uint32_t *add;
+    uint32_t add_count;
+    uint32_t *del;
+    uint32_t del_count;
+};
+
+// operators of one schema, with atoms numbered locally so workers never
+// share anything they write to.
+struct ground_output {
+    struct atoms atoms;
+
+    struct pddlp_operator *operators;
+    uint32_t operator_count;
+
+    uint32_t *args;
+    uint32_t arg_count;
+
+    uint32_t *facts;
+    uint32_t fact_count;
+};
+
+// relaxed reachability. facts are reached from :init by operators whose
+// delete effects are ignored, and each reached fact is joined once with the
+// facts reached before it, as each fluent precondition it matches. only the
+// bindings that come out of the joins are grounded.
+
+// the reached facts of a predicate, or of a predicate with `object` at
+// `position`, in the order they were reached. position PDDLP_NONE holds all
+// the facts of the predicate.
+struct reach_posting {
+    uint32_t predicate;
+    uint32_t position;
+    uint32_t object;
+
+    uint32_t *facts;
+    uint32_t count;
+};
+
+// a fluent precondition of an action, `pre` indexing the plan's pre list.
+struct reach_trigger {
+    uint32_t action;
+    uint32_t pre;
+};
+
+struct reach {
+    struct atoms atoms;
+
+    struct reach_posting *postings;
+    uint32_t posting_count;
+
+    // posting + 1, or 0 when empty.
+    uint32_t *slots;
+    uint32_t capacity;
+
+    // the triggers of predicate p are triggers[trigger_first[p] ..
+    // trigger_first[p + 1]).
+    uint32_t *trigger_first;
+    struct reach_trigger *triggers;
+    uint32_t trigger_count;
+
+    // add effects of the operators grounded while joining a fact, each as a
+    // predicate followed by its arguments. they are reached once the join is
+    // over, since the postings can't change under it.
+    uint32_t *pending;
+    uint32_t pending_count;
+};
+
+struct grounder {
+    const struct pddlp_problem *problem;
+    const struct pddlp_domain *domain;
+    struct pddlp_error *error;
+    jmp_buf fail;
+
+    // predicates that appear in some effect.
+    bool *fluent;
+
+    // the facts of the other predicates are looked up in the problem's
+    // :init store.
+
+    struct ground_plan *plans;
+    struct ground_output *outputs;
+    uint32_t max_arity;
+    uint32_t max_params;
+    uint32_t max_atoms;
+
+    pthread_mutex_t lock;
+    uint32_t next_plan;
+    bool failed;
+
+    struct pddlp_strips *strips;
+    struct atoms facts;
+
+    // only set when grounding the reachable operators.
+    struct reach *reach;
+};
+
+struct ground_worker {
+    struct grounder *g;
+    jmp_buf fail;
+
+    uint32_t *binding;
+
+    // the levels bound by a reachability join, which are not enumerated,
+    // and the order they were bound in.
+    bool *bound;
+    uint32_t *bound_levels;
+    uint32_t bound_count;
+
+    uint32_t **candidates;
+    uint32_t *candidate_counts;
+
+    // the static atom that generated the candidates of each level, when
+    // every candidate is known to satisfy it.
+    uint32_t *implied;
+
+    // local fact ids of the plan's fluent atoms under the current binding.
+    uint32_t *atom_ids;
+
+    uint32_t *seen;
+    uint32_t generation;
+
+    uint32_t *args;
+    uint32_t *facts;
+    uint32_t fact_count;
+
+    struct ground_output *output;
+};
+
+static void
+ground_fail(struct grounder *g, const char *message)
+{
+    g->error->message = message;
+    g->error->line = 0;
+    g->error->column = 0;
+    longjmp(g->fail, 1);
+}
+
+static void *
+ground_reserve(struct grounder *g, void *items, uint32_t needed, size_t item_size)
+{
+    void *result = array_reserve(items, needed, item_size);
+    if (result == NULL && needed > 0)
+        ground_fail(g, "out of memory");
+
+    return result;
+}
+
+#define GROUND_PUSH(g, items, count) \
+    ((items) = ground_reserve((g), (items), (count) + 1, sizeof(*(items))), &(items)[(count)++])
+
+static void *
+ground_calloc(struct grounder *g, size_t count, size_t size)
+{
+    if (count == 0)
+        count = 1;
+
+    if (count > SIZE_MAX / size)
+        ground_fail(g, "out of memory");
+
+    void *result = mem_alloc(count * size);
+    if (result == NULL)
+        ground_fail(g, "out of memory");
+
+    memset(result, 0, count * size);
+    return result;
+}
+
+// fluent predicates
+
+static void
+ground_collect_effects(struct grounder *g, uint32_t node)
+{
+    const struct pddlp_formulas *f = &g->domain->formulas;
+    if (node == PDDLP_NONE)
+        return;
+
+    const struct pddlp_node *n = &f->nodes[node];
+    if (n->node_type == PDDLP_NODE_ATOM) {
+        g->fluent[n->value] = true;
+        return;
+    }
+
+    if (n->node_type == PDDLP_NODE_COMPOUND)
+        for (uint32_t i = 0; i < n->count; ++i)
+            ground_collect_effects(g, f->children[n->first + i]);
+}
+
+static void
+ground_fluents(struct grounder *g)
+{
+    const struct pddlp_domain *d = g->domain;
+
+    g->fluent = ground_calloc(g, d->predicate_count, sizeof(*g->fluent));
+    for (uint32_t i = 0; i < d->action_count; ++i)
+        ground_collect_effects(g, d->actions[i].effect);
+}
+
+// plans
+
+static uint32_t
+ground_plan_term(struct grounder *g, struct ground_plan *plan, uint32_t node)
+{
+    const struct pddlp_node *n = &g->domain->formulas.nodes[node];
+
+    if (n->node_type == PDDLP_NODE_OBJECT)
+        return n->value;
+
+    if (n->node_type == PDDLP_NODE_VARIABLE && n->value - plan->variable_first < plan->param_count)
+        return GROUND_PARAM | (n->value - plan->variable_first);
+
+    ground_fail(g, "grounding supports only objects and parameters as terms");
+    return PDDLP_NONE;
+}
+
+static uint32_t
+ground_plan_atom(struct grounder *g, struct ground_plan *plan, uint32_t predicate, uint32_t node)
+{
+    const struct pddlp_formulas *f = &g->domain->formulas;
+    const struct pddlp_node *n = &f->nodes[node];
+
+    struct ground_atom *atom = GROUND_PUSH(g, plan->atoms, plan->atom_count);
+    atom->predicate = predicate;
+    atom->first = plan->term_count;
+    atom->count = n->count;
+
+    for (uint32_t i = 0; i < n->count; ++i) {
+        uint32_t term = ground_plan_term(g, plan, f->children[n->first + i]);
+        *GROUND_PUSH(g, plan->terms, plan->term_count) = term;
+    }
+
+    return plan->atom_count - 1;
+}
+
+// the level a check can run at: one past the last parameter it uses.
+static uint32_t
+ground_plan_level(const struct ground_plan *plan, uint32_t atom)
+{
+    const struct ground_atom *a = &plan->atoms[atom];
+    uint32_t level = 0;
+
+    for (uint32_t i = 0; i < a->count; ++i) {
+        uint32_t term = plan->terms[a->first + i];
+        if ((term & GROUND_PARAM) && (term & ~GROUND_PARAM) + 1 > level)
+            level = (term & ~GROUND_PARAM) + 1;
+    }
+
+    return level;
+}
+
+static void
+ground_plan_precondition(struct grounder *g, struct ground_plan *plan, uint32_t node, bool negated)
+{
+    const struct pddlp_formulas *f = &g->domain->formulas;
+    if (node == PDDLP_NONE)
+        return;
+
+    const struct pddlp_node *n = &f->nodes[node];
+
+    if (n->node_type == PDDLP_NODE_ATOM) {
+        uint32_t atom = ground_plan_atom(g, plan, n->value, node);
+
+        if (g->fluent[n->value]) {
+            if (negated)
+                ground_fail(g, "grounding doesn't support negative preconditions on fluents");
+            *GROUND_PUSH(g, plan->pre, plan->pre_count) = atom;
+            return;
+        }
+
+        struct ground_check *check = GROUND_PUSH(g, plan->checks, plan->check_count);
+        check->atom = atom;
+        check->level = ground_plan_level(plan, atom);
+        check->negated = negated;
+        return;
+    }
+
+    if (n->node_type != PDDLP_NODE_COMPOUND)
+        ground_fail(g, "grounding supports only strips preconditions");
+
+    if (n->op == PDDLP_TOKEN_AND && !negated) {
+        for (uint32_t i = 0; i < n->count; ++i)
+            ground_plan_precondition(g, plan, f->children[n->first + i], false);
+        return;
+    }
+
+    if (n->op == PDDLP_TOKEN_NOT && !negated && n->count == 1) {
+        ground_plan_precondition(g, plan, f->children[n->first], true);
+        return;
+    }
+
+    // numeric comparisons are left to pddlp_compile_numeric.
+    if (formula_numeric_comparison(f, n)) {
+        if (n->count != 2)
+            ground_fail(g, "numeric comparisons support only two operands");
+        return;
+    }
+
+    if (n->op == PDDLP_TOKEN_EQ && n->count == 2) {
+        uint32_t atom = ground_plan_atom(g, plan, GROUND_EQUAL, node);
+
+        struct ground_check *check = GROUND_PUSH(g, plan->checks, plan->check_count);
+        check->atom = atom;
+        check->level = ground_plan_level(plan, atom);
+        check->negated = negated;
+        return;
+    }
+
+    ground_fail(g, "grounding supports only strips preconditions");
+}
+
+// numeric effects are left to pddlp_compile_numeric.
+static void
+ground_plan_effect(struct grounder *g, struct ground_plan *plan, uint32_t node, bool negated)
+{
+    const struct pddlp_formulas *f = &g->domain->formulas;
+    if (node == PDDLP_NONE)
+        return;
+
+    const struct pddlp_node *n = &f->nodes[node];
+
+    if (n->node_type == PDDLP_NODE_ATOM) {
+        uint32_t atom = ground_plan_atom(g, plan, n->value, node);
+        if (negated)
+            *GROUND_PUSH(g, plan->del, plan->del_count) = atom;
+        else
+            *GROUND_PUSH(g, plan->add, plan->add_count) = atom;
+        return;
+    }
+
+    if (n->node_type != PDDLP_NODE_COMPOUND)
+        ground_fail(g, "grounding supports only strips effects");
+
+    switch (n->op) {
+    case PDDLP_TOKEN_AND:
+        if (negated)
+            break;
+        for (uint32_t i = 0; i < n->count; ++i)
+            ground_plan_effect(g, plan, f->children[n->first + i], false);
+        return;
+    case PDDLP_TOKEN_NOT:
+        if (negated || n->count != 1)
+            break;
+        ground_plan_effect(g, plan, f->children[n->first], true);
+        return;
+    case PDDLP_TOKEN_ASSIGN:
+    case PDDLP_TOKEN_INCREASE:
+    case PDDLP_TOKEN_DECREASE:
+    case PDDLP_TOKEN_SCALE_UP:
+    case PDDLP_TOKEN_SCALE_DOWN:
+        if (negated)
+            break;
+        return;
+    default:
+        break;
+    }
+
+    ground_fail(g, "grounding supports only strips effects");
+}
+
+static void
+ground_plan_generators(struct grounder *g, struct ground_plan *plan)
+{
+    for (uint32_t c = 0; c < plan->check_count; ++c) {
+        const struct ground_check *check = &plan->checks[c];
+        const struct ground_atom *atom = &plan->atoms[check->atom];
+
+        if (check->negated || atom->predicate == GROUND_EQUAL)
+            continue;
+
+        // the atom can generate the last parameter it uses. any other
+        // position is known by then and can be the key.
+        uint32_t level = check->level - 1;
+        uint32_t position = PDDLP_NONE;
+        uint32_t key = PDDLP_NONE;
+
+        for (uint32_t i = 0; i < atom->count; ++i) {
+            uint32_t term = plan->terms[atom->first + i];
+            if (term == (GROUND_PARAM | level))
+                position = i;
+            else if (key == PDDLP_NONE)
+                key = i;
+        }
+
+        if (position == PDDLP_NONE)
+            continue;
+
+        struct ground_generator *generator = GROUND_PUSH(g, plan->generators, plan->generator_count);
+        generator->atom = check->atom;
+        generator->level = level;
+        generator->position = position;
+        generator->key = key;
+    }
+}
+
+static void
+ground_plan_intern_list(struct grounder *g, struct ground_plan *plan, const uint32_t *atoms, uint32_t count)
+{
+    for (uint32_t i = 0; i < count; ++i) {
+        struct ground_check *intern = GROUND_PUSH(g, plan->interns, plan->intern_count);
+        intern->atom = atoms[i];
+        intern->level = ground_plan_level(plan, atoms[i]);
+        intern->negated = false;
+    }
+}
+
+static void
+ground_plan_interns(struct grounder *g, struct ground_plan *plan)
+{
+    ground_plan_intern_list(g, plan, plan->pre, plan->pre_count);
+    ground_plan_intern_list(g, plan, plan->add, plan->add_count);
+    ground_plan_intern_list(g, plan, plan->del, plan->del_count);
+}
+
+static void
+ground_plans(struct grounder *g)
+{
+    const struct pddlp_domain *d = g->domain;
+
+    if (d->derived_count > 0)
+        ground_fail(g, "grounding doesn't support derived predicates");
+
+    g->plans = ground_calloc(g, d->action_count, sizeof(*g->plans));
+    g->outputs = ground_calloc(g, d->action_count, sizeof(*g->outputs));
+
+    for (uint32_t i = 0; i < d->predicate_count; ++i)
+        if (d->predicates[i].param_count > g->max_arity)
+            g->max_arity = d->predicates[i].param_count;
+
+    for (uint32_t a = 0; a < d->action_count; ++a) {
+        const struct pddlp_action *action = &d->actions[a];
+        struct ground_plan *plan = &g->plans[a];
+
+        if (action->durative)
+            ground_fail(g, "grounding doesn't support durative actions");
+
+        plan->action = a;
+        plan->param_count = action->param_count;
+        plan->variable_first = action->variable_first;
+
+        if (plan->param_count > g->max_params)
+            g->max_params = plan->param_count;
+
+        ground_plan_precondition(g, plan, action->precondition, false);
+        ground_plan_effect(g, plan, action->effect, false);
+        ground_plan_generators(g, plan);
+        ground_plan_interns(g, plan);
+
+        if (plan->atom_count > g->max_atoms)
+            g->max_atoms = plan->atom_count;
+    }
+}
+
+static void
+ground_free_plan(struct ground_plan *plan)
+{
+    array_free(plan->atoms);
+    array_free(plan->terms);
+    array_free(plan->checks);
+    array_free(plan->generators);
+    array_free(plan->interns);
+    array_free(plan->pre);
+    array_free(plan->add);
+    array_free(plan->del);
+}
+
+// workers
+
+static void
+ground_worker_fail(struct ground_worker *w)
+{
+    longjmp(w->fail, 1);
+}
+
+static void *
+ground_worker_reserve(struct ground_worker *w, void *items, uint32_t needed, size_t item_size)
+{
+    void *result = array_reserve(items, needed, item_size);
+    if (result == NULL && needed > 0)
+        ground_worker_fail(w);
+
+    return result;
+}
+
+#define WORKER_PUSH(w, items, count) \
+    ((items) = ground_worker_reserve((w), (items), (count) + 1, sizeof(*(items))), &(items)[(count)++])
+
+static bool
+ground_worker_init(struct ground_worker *w, struct grounder *g)
+{
+    memset(w, 0, sizeof(*w));
+    w->g = g;
+
+    size_t levels = g->max_params + 1;
+    w->binding = mem_alloc(sizeof(*w->binding) * levels);
+    w->bound = mem_alloc(sizeof(*w->bound) * levels);
+    w->bound_levels = mem_alloc(sizeof(*w->bound_levels) * levels);
+    w->candidates = mem_alloc(sizeof(*w->candidates) * levels);
+    w->candidate_counts = mem_alloc(sizeof(*w->candidate_counts) * levels);
+    w->implied = mem_alloc(sizeof(*w->implied) * levels);
+    w->atom_ids = mem_alloc(sizeof(*w->atom_ids) * (g->max_atoms + 1));
+    w->seen = mem_alloc(sizeof(*w->seen) * (g->problem->object_count + 1));
+    w->args = mem_alloc(sizeof(*w->args) * (g->max_arity + 1));
+
+    if (!w->binding || !w->bound || !w->bound_levels || !w->candidates || !w->candidate_counts || !w->implied ||
+        !w->atom_ids || !w->seen || !w->args)
+        return false;
+
+    memset(w->bound, 0, sizeof(*w->bound) * levels);
+    memset(w->candidates, 0, sizeof(*w->candidates) * levels);
+    memset(w->seen, 0, sizeof(*w->seen) * (g->problem->object_count + 1));
+    return true;
+}
+
+static void
+ground_worker_free(struct ground_worker *w)
+{
+    if (w->candidates)
+        for (uint32_t i = 0; i <= w->g->max_params; ++i)
+            array_free(w->candidates[i]);
+
+    mem_free(w->binding);
+    mem_free(w->bound);
+    mem_free(w->bound_levels);
+    mem_free(w->candidates);
+    mem_free(w->candidate_counts);
+    mem_free(w->implied);
+    mem_free(w->atom_ids);
+    mem_free(w->seen);
+    mem_free(w->args);
+    array_free(w->facts);
+}
+
+// fills w->args with the arguments of an atom under the current binding.
+static const uint32_t *
+ground_bind_atom(struct ground_worker *w, const struct ground_plan *plan, const struct ground_atom *atom)
+{
+    for (uint32_t i = 0; i < atom->count; ++i) {
+        uint32_t term = plan->terms[atom->first + i];
+        w->args[i] = (term & GROUND_PARAM) ? w->binding[term & ~GROUND_PARAM] : term;
+    }
+
+    return w->args;
+}
+
+static bool
+ground_checks_pass(struct ground_worker *w, const struct ground_plan *plan, uint32_t level, uint32_t implied)
+{
+    for (uint32_t c = 0; c < plan->check_count; ++c) {
+        const struct ground_check *check = &plan->checks[c];
+        if (check->level != level || check->atom == implied)
+            continue;
+
+        const struct ground_atom *atom = &plan->atoms[check->atom];
+        const uint32_t *args = ground_bind_atom(w, plan, atom);
+
+        bool holds = atom->predicate == GROUND_EQUAL
+            ? args[0] == args[1]
+            : pddlp_find_fact(w->g->problem, atom->predicate, args) != PDDLP_NONE;
+
+        if (holds == check->negated)
+            return false;
+    }
+
+    return true;
+}
+
+static bool
+ground_allowed(const struct grounder *g, const struct ground_plan *plan, uint32_t level, uint32_t object)
+{
+    const struct pddlp_typed_name *param = &g->domain->variables[plan->variable_first + level];
+
+    for (uint32_t i = 0; i < param->type_count; ++i)
+        if (pddlp_has_type(g->problem, object, g->domain->type_refs[param->type_first + i]))
+            return true;
+
+    return false;
+}
+
+// collects the values the parameter at `level` can take, from the smallest
+// of the static facts that mention it, or from its types.
+static void
+ground_candidates(struct ground_worker *w, const struct ground_plan *plan, uint32_t level)
+{
+    const struct grounder *g = w->g;
+    const struct pddlp_problem *pr = g->problem;
+    const struct pddlp_typed_name *param = &g->domain->variables[plan->variable_first + level];
+
+    uint32_t type_size = 0;
+    for (uint32_t i = 0; i < param->type_count; ++i) {
+        uint32_t type = g->domain->type_refs[param->type_first + i];
+        type_size += pr->type_objects_first[type + 1] - pr->type_objects_first[type];
+    }
+
+    const uint32_t *best = NULL;
+    uint32_t best_size = type_size;
+    uint32_t best_position = 0;
+    uint32_t best_implied = PDDLP_NONE;
+
+    for (uint32_t i = 0; i < plan->generator_count; ++i) {
+        const struct ground_generator *generator = &plan->generators[i];
+        if (generator->level != level)
+            continue;
+
+        const struct ground_atom *atom = &plan->atoms[generator->atom];
+        const uint32_t *facts;
+        uint32_t fact_count;
+
+        if (generator->key != PDDLP_NONE) {
+            uint32_t term = plan->terms[atom->first + generator->key];
+            uint32_t object = (term & GROUND_PARAM) ? w->binding[term & ~GROUND_PARAM] : term;
+            facts = pddlp_position_facts(pr, atom->predicate, generator->key, object, &fact_count);
+        } else {
+            facts = pddlp_predicate_facts(pr, atom->predicate, &fact_count);
+        }
+
+        if (facts == NULL)
+            ground_worker_fail(w);
+
+        if (fact_count <= best_size) {
+            best = facts;
+            best_size = fact_count;
+            best_position = generator->position;
+
+            // the facts were picked by every position of the atom.
+            uint32_t used = generator->key != PDDLP_NONE ? 2 : 1;
+            best_implied = atom->count == used ? generator->atom : PDDLP_NONE;
+        }
+    }
+
+    uint32_t count = 0;
+    if (++w->generation == 0) {
+        memset(w->seen, 0, sizeof(*w->seen) * (pr->object_count + 1));
+        w->generation = 1;
+    }
+
+    if (best) {
+        for (uint32_t i = 0; i < best_size; ++i) {
+            uint32_t fact = best[i];
+            uint32_t object = pr->fact_args[pr->fact_args_first[fact] + best_position];
+
+            if (w->seen[object] == w->generation || !ground_allowed(g, plan, level, object))
+                continue;
+
+            w->seen[object] = w->generation;
+            *WORKER_PUSH(w, w->candidates[level], count) = object;
+        }
+    } else {
+        for (uint32_t i = 0; i < param->type_count; ++i) {
+            uint32_t type = g->domain->type_refs[param->type_first + i];
+
+            for (uint32_t j = pr->type_objects_first[type]; j < pr->type_objects_first[type + 1]; ++j) {
+                uint32_t object = pr->type_objects[j];
+                if (w->seen[object] == w->generation)
+                    continue;
+
+                w->seen[object] = w->generation;
+                *WORKER_PUSH(w, w->candidates[level], count) = object;
+            }
+        }
+    }
+
+    w->candidate_counts[level] = count;
+    w->implied[level] = best ? best_implied : PDDLP_NONE;
+}
+
+static uint32_t
+ground_unique(uint32_t *items, uint32_t count)
+{
+    for (uint32_t i = 1; i < count; ++i) {
+        uint32_t item = items[i];
+        uint32_t j = i;
+        for (; j > 0 && items[j - 1] > item; --j)
+            items[j] = items[j - 1];
+        items[j] = item;
+    }
+
+    uint32_t unique = 0;
+    for (uint32_t i = 0; i < count; ++i)
+        if (unique == 0 || items[unique - 1] != items[i])
+            items[unique++] = items[i];
+
+    return unique;
+}
+
+static void
+ground_intern_atoms(struct ground_worker *w, const struct ground_plan *plan, uint32_t level)
+{
+    struct ground_output *out = w->output;
+
+    for (uint32_t i = 0; i < plan->intern_count; ++i) {
+        const struct ground_check *intern = &plan->interns[i];
+        if (intern->level != level)
+            continue;
+
+        const struct ground_atom *atom = &plan->atoms[intern->atom];
+        uint32_t fact = atoms_intern(&out->atoms, atom->predicate, ground_bind_atom(w, plan, atom), atom->count);
+        if (fact == PDDLP_NONE)
+            ground_worker_fail(w);
+
+        w->atom_ids[intern->atom] = fact;
+    }
+}
+
+static uint32_t
+ground_push_atoms(struct ground_worker *w, const uint32_t *atoms, uint32_t count)
+{
+    uint32_t first = w->fact_count;
+
+    for (uint32_t i = 0; i < count; ++i)
+        *WORKER_PUSH(w, w->facts, w->fact_count) = w->atom_ids[atoms[i]];
+
+    return ground_unique(w->facts + first, count);
+}
+
+static void
+ground_emit(struct ground_worker *w, const struct ground_plan *plan)
+{
+    struct ground_output *out = w->output;
+
+    w->fact_count = 0;
+    uint32_t pre_count = ground_push_atoms(w, plan->pre, plan->pre_count);
+    w->fact_count = pre_count;
+    uint32_t add_count = ground_push_atoms(w, plan->add, plan->add_count);
+    w->fact_count = pre_count + add_count;
+    uint32_t del_count = ground_push_atoms(w, plan->del, plan->del_count);
+
+    // add effects win over delete effects of the same fact.
+    const uint32_t *add = w->facts + pre_count;
+    uint32_t *del = w->facts + pre_count + add_count;
+    uint32_t kept = 0;
+    for (uint32_t i = 0, j = 0; i < del_count; ++i) {
+        while (j < add_count && add[j] < del[i])
+            j++;
+        if (j == add_count || add[j] != del[i])
+            del[kept++] = del[i];
+    }
+
+    w->fact_count = pre_count + add_count + kept;
+
+    struct pddlp_operator *op = WORKER_PUSH(w, out->operators, out->operator_count);
+    op->action = plan->action;
+    op->args = out->arg_count;
+    op->pre = out->fact_count;
+    op->add = op->pre + pre_count;
+    op->del = op->add + add_count;
+    op->end = op->del + kept;
+
+    if (plan->param_count > 0) {
+        out->args = ground_worker_reserve(w, out->args, out->arg_count + plan->param_count, sizeof(*out->args));
+        memcpy(out->args + out->arg_count, w->binding, sizeof(*w->binding) * plan->param_count);
+        out->arg_count += plan->param_count;
+    }
+
+    if (w->fact_count > 0) {
+        out->facts = ground_worker_reserve(w, out->facts, out->fact_count + w->fact_count, sizeof(*out->facts));
+        memcpy(out->facts + out->fact_count, w->facts, sizeof(*w->facts) * w->fact_count);
+        out->fact_count += w->fact_count;
+    }
+
+    struct reach *r = w->g->reach;
+    for (uint32_t i = 0; r && i < plan->add_count; ++i) {
+        const struct ground_atom *atom = &plan->atoms[plan->add[i]];
+        const uint32_t *args = ground_bind_atom(w, plan, atom);
+
+        *WORKER_PUSH(w, r->pending, r->pending_count) = atom->predicate;
+        for (uint32_t j = 0; j < atom->count; ++j)
+            *WORKER_PUSH(w, r->pending, r->pending_count) = args[j];
+    }
+}
+
+static void
+ground_level(struct ground_worker *w, const struct ground_plan *plan, uint32_t level)
+{
+    if (level == plan->param_count) {
+        ground_emit(w, plan);
+        return;
+    }
+
+    if (w->bound[level]) {
+        if (ground_allowed(w->g, plan, level, w->binding[level]) &&
+            ground_checks_pass(w, plan, level + 1, PDDLP_NONE)) {
+            ground_intern_atoms(w, plan, level + 1);
+            ground_level(w, plan, level + 1);
+        }
+        return;
+    }
+
+    ground_candidates(w, plan, level);
+
+    for (uint32_t i = 0; i < w->candidate_counts[level]; ++i) {
+        w->binding[level] = w->candidates[level][i];
+        if (ground_checks_pass(w, plan, level + 1, w->implied[level])) {
+            ground_intern_atoms(w, plan, level + 1);
+            ground_level(w, plan, level + 1);
+        }
+    }
+}
+
+static void
+ground_work(struct ground_worker *w)
+{
+    struct grounder *g = w->g;
+
+    for (;;) {
+        pthread_mutex_lock(&g->lock);
+        uint32_t next = g->failed ? g->domain->action_count : g->next_plan++;
+        pthread_mutex_unlock(&g->lock);
+
+        if (next >= g->domain->action_count)
+            return;
+
+        const struct ground_plan *plan = &g->plans[next];
+        w->output = &g->outputs[next];
+
+        if (ground_checks_pass(w, plan, 0, PDDLP_NONE)) {
+            ground_intern_atoms(w, plan, 0);
+            ground_level(w, plan, 0);
+        }
+    }
+}
+
+static void *
+ground_thread(void *arg)
+{
+    struct ground_worker *w = arg;
+    mem_enter(PDDLP_SUBSYSTEM_GROUND);
+
+    if (setjmp(w->fail)) {
+        pthread_mutex_lock(&w->g->lock);
+        w->g->failed = true;
+        pthread_mutex_unlock(&w->g->lock);
+        return NULL;
+    }
+
+    ground_work(w);
+    return NULL;
+}
+
+static void
+ground_run(struct grounder *g, unsigned thread_count)
+{
+    if (thread_count == 0) {
+        long online = sysconf(_SC_NPROCESSORS_ONLN);
+        thread_count = online > 0 ? (unsigned)online : 1;
+    }
+
+    if (thread_count > g->domain->action_count)
+        thread_count = g->domain->action_count;
+
+    if (thread_count == 0)
+        return;
+
+    struct ground_worker *workers = ground_calloc(g, thread_count, sizeof(*workers));
+    pthread_t *threads = mem_alloc(sizeof(*threads) * thread_count);
+    unsigned started = 0;
+
+    if (threads) {
+        for (; started < thread_count; ++started) {
+            if (!ground_worker_init(&workers[started], g)) {
+                ground_worker_free(&workers[started]);
+                g->failed = true;
+                break;
+            }
+
+            // the calling thread takes the first worker.
+            if (started > 0 && pthread_create(&threads[started], NULL, ground_thread, &workers[started]) != 0) {
+                ground_worker_free(&workers[started]);
+                break;
+            }
+        }
+
+        if (started > 0)
+            ground_thread(&workers[0]);
+
+        for (unsigned i = 1; i < started; ++i)
+            pthread_join(threads[i], NULL);
+    }
+
+    bool failed = threads == NULL || started == 0 || g->failed;
+
+    for (unsigned i = 0; i < started; ++i)
+        ground_worker_free(&workers[i]);
+
+    mem_free(threads);
+    mem_free(workers);
+
+    if (failed)
+        ground_fail(g, "out of memory");
+}
+
+// reachability
+
+static struct reach_posting *
+reach_find(const struct reach *r, uint32_t predicate, uint32_t position, uint32_t object)
+{
+    if (r->posting_count == 0)
+        return NULL;
+
+    uint32_t key[3] = {predicate, position, object};
+    uint32_t mask = r->capacity - 1;
+
+    for (uint32_t i = (uint32_t)hash64(key, sizeof(key), 0) & mask;; i = (i + 1) & mask) {
+        uint32_t slot = r->slots[i];
+        if (slot == 0)
+            return NULL;
+
+        struct reach_posting *posting = &r->postings[slot - 1];
+        if (posting->predicate == predicate && posting->position == position && posting->object == object)
+            return posting;
+    }
+}
+
+static bool
+reach_grow(struct reach *r)
+{
+    uint64_t capacity = r->capacity ? (uint64_t)r->capacity * 2 : 64;
+    if (capacity > UINT32_MAX)
+        return false;
+
+    uint32_t *slots = mem_alloc(sizeof(*slots) * capacity);
+    if (slots == NULL)
+        return false;
+
+    memset(slots, 0, sizeof(*slots) * capacity);
+
+    uint32_t mask = capacity - 1;
+    for (uint32_t p = 0; p < r->posting_count; ++p) {
+        const struct reach_posting *posting = &r->postings[p];
+        uint32_t key[3] = {posting->predicate, posting->position, posting->object};
+        uint32_t i = (uint32_t)hash64(key, sizeof(key), 0) & mask;
+        while (slots[i])
+            i = (i + 1) & mask;
+        slots[i] = p + 1;
+    }
+
+    mem_free(r->slots);
+    r->slots = slots;
+    r->capacity = capacity;
+    return true;
+}
+
+static void
+reach_post(struct ground_worker *w, struct reach *r, uint32_t predicate, uint32_t position, uint32_t object,
+    uint32_t fact)
+{
+    struct reach_posting *posting = reach_find(r, predicate, position, object);
+
+    if (posting == NULL) {
+        if ((uint64_t)(r->posting_count + 1) * 2 > r->capacity && !reach_grow(r))
+            ground_worker_fail(w);
+
+        posting = WORKER_PUSH(w, r->postings, r->posting_count);
+        memset(posting, 0, sizeof(*posting));
+        posting->predicate = predicate;
+        posting->position = position;
+        posting->object = object;
+
+        uint32_t key[3] = {predicate, position, object};
+        uint32_t mask = r->capacity - 1;
+        uint32_t i = (uint32_t)hash64(key, sizeof(key), 0) & mask;
+        while (r->slots[i])
+            i = (i + 1) & mask;
+        r->slots[i] = r->posting_count;
+    }
+
+    *WORKER_PUSH(w, posting->facts, posting->count) = fact;
+}
+
+// adds a fact to the reached ones, unless it is there already.
+static void
+reach_add(struct ground_worker *w, struct reach *r, uint32_t predicate, const uint32_t *args, uint32_t arity)
+{
+    uint32_t count = r->atoms.count;
+    uint32_t fact = atoms_intern(&r->atoms, predicate, args, arity);
+    if (fact == PDDLP_NONE)
+        ground_worker_fail(w);
+
+    if (fact < count)
+        return;
+
+    reach_post(w, r, predicate, PDDLP_NONE, 0, fact);
+    for (uint32_t i = 0; i < arity; ++i)
+        reach_post(w, r, predicate, i, args[i], fact);
+}
+
+static void
+reach_flush(struct ground_worker *w, struct reach *r)
+{
+    const struct pddlp_domain *d = w->g->domain;
+
+    for (uint32_t i = 0; i < r->pending_count;) {
+        uint32_t predicate = r->pending[i];
+        uint32_t arity = d->predicates[predicate].param_count;
+        reach_add(w, r, predicate, r->pending + i + 1, arity);
+        i += arity + 1;
+    }
+
+    r->pending_count = 0;
+}
+
+// binds the parameters of `atom` to `args`, or returns false when the two
+// don't agree. the levels it binds stay bound, and are undone by
+// reach_unbind.
+static bool
+reach_bind(struct ground_worker *w, const struct ground_plan *plan, const struct ground_atom *atom,
+    const uint32_t *args)
+{
+    for (uint32_t i = 0; i < atom->count; ++i) {
+        uint32_t term = plan->terms[atom->first + i];
+
+        if (!(term & GROUND_PARAM)) {
+            if (term != args[i])
+                return false;
+            continue;
+        }
+
+        uint32_t level = term & ~GROUND_PARAM;
+        if (w->bound[level]) {
+            if (w->binding[level] != args[i])
+                return false;
+            continue;
+        }
+
+        w->binding[level] = args[i];
+        w->bound[level] = true;
+        w->bound_levels[w->bound_count++] = level;
+    }
+
+    return true;
+}
+
+static void
+reach_unbind(struct ground_worker *w, uint32_t bound_count)
+{
+    while (w->bound_count > bound_count)
+        w->bound[w->bound_levels[--w->bound_count]] = false;
+}
+
+// grounds the parameters the joins left unbound.
+static void
+reach_complete(struct ground_worker *w, const struct ground_plan *plan)
+{
+    if (ground_checks_pass(w, plan, 0, PDDLP_NONE)) {
+        ground_intern_atoms(w, plan, 0);
+        ground_level(w, plan, 0);
+    }
+}
+
+// matches the fluent preconditions from `pre` on with the reached facts,
+// `trigger` being the one already matched with `fact`. the ones before the
+// trigger only take facts reached before `fact`, so a binding that matches
+// it more than once is only found for the first.
+static void
+reach_join(struct ground_worker *w, const struct reach *r, const struct ground_plan *plan, uint32_t trigger,
+    uint32_t fact, uint32_t pre)
+{
+    if (pre == trigger)
+        pre++;
+
+    if (pre >= plan->pre_count) {
+        reach_complete(w, plan);
+        return;
+    }
+
+    // the facts with the first known argument of the atom, when there is
+    // one, otherwise all of its predicate.
+    const struct ground_atom *atom = &plan->atoms[plan->pre[pre]];
+    uint32_t position = PDDLP_NONE;
+    uint32_t object = 0;
+
+    for (uint32_t i = 0; i < atom->count && position == PDDLP_NONE; ++i) {
+        uint32_t term = plan->terms[atom->first + i];
+        if (!(term & GROUND_PARAM) || w->bound[term & ~GROUND_PARAM]) {
+            position = i;
+            object = (term & GROUND_PARAM) ? w->binding[term & ~GROUND_PARAM] : term;
+        }
+    }
+
+    const struct reach_posting *posting = reach_find(r, atom->predicate, position, object);
+    if (posting == NULL)
+        return;
+
+    uint32_t limit = pre < trigger ? fact : fact + 1;
+
+    for (uint32_t i = 0; i < posting->count && posting->facts[i] < limit; ++i) {
+        const uint32_t *key = r->atoms.keys + r->atoms.starts[posting->facts[i]];
+        uint32_t bound_count = w->bound_count;
+
+        if (reach_bind(w, plan, atom, key + 1))
+            reach_join(w, r, plan, trigger, fact, pre + 1);
+        reach_unbind(w, bound_count);
+    }
+}
+
+static void
+reach_triggers(struct ground_worker *w, struct reach *r)
+{
+    const struct grounder *g = w->g;
+    const struct pddlp_domain *d = g->domain;
+
+    r->trigger_first = ground_worker_reserve(w, NULL, d->predicate_count + 1, sizeof(*r->trigger_first));
+    memset(r->trigger_first, 0, sizeof(*r->trigger_first) * (d->predicate_count + 1));
+
+    for (uint32_t a = 0; a < d->action_count; ++a)
+        for (uint32_t i = 0; i < g->plans[a].pre_count; ++i)
+            r->trigger_first[g->plans[a].atoms[g->plans[a].pre[i]].predicate + 1]++;
+
+    for (uint32_t p = 0; p < d->predicate_count; ++p)
+        r->trigger_first[p + 1] += r->trigger_first[p];
+
+    r->trigger_count = r->trigger_first[d->predicate_count];
+    r->triggers = ground_worker_reserve(w, NULL, r->trigger_count, sizeof(*r->triggers));
+
+    // trigger_first[p] is the fill cursor of p, and ends up at the start of
+    // p + 1.
+    for (uint32_t a = 0; a < d->action_count; ++a) {
+        for (uint32_t i = 0; i < g->plans[a].pre_count; ++i) {
+            uint32_t predicate = g->plans[a].atoms[g->plans[a].pre[i]].predicate;
+            r->triggers[r->trigger_first[predicate]++] = (struct reach_trigger){a, i};
+        }
+    }
+
+    for (uint32_t p = d->predicate_count; p > 0; --p)
+        r->trigger_first[p] = r->trigger_first[p - 1];
+    r->trigger_first[0] = 0;
+}
+
+static void
+reach_run(struct ground_worker *w, struct reach *r)
+{
+    struct grounder *g = w->g;
+    const struct pddlp_problem *pr = g->problem;
+    const struct pddlp_domain *d = g->domain;
+
+    for (uint32_t i = 0; i < pr->fact_count; ++i) {
+        uint32_t predicate = pr->fact_predicates[i];
+        if (g->fluent[predicate])
+            reach_add(w, r, predicate, pr->fact_args + pr->fact_args_first[i], d->predicates[predicate].param_count);
+    }
+
+    // schemas without fluent preconditions are grounded once, up front.
+    for (uint32_t a = 0; a < d->action_count; ++a) {
+        if (g->plans[a].pre_count == 0) {
+            w->output = &g->outputs[a];
+            reach_complete(w, &g->plans[a]);
+        }
+    }
+
+    reach_flush(w, r);
+
+    for (uint32_t fact = 0; fact < r->atoms.count; ++fact) {
+        const uint32_t *key = r->atoms.keys + r->atoms.starts[fact];
+
+        for (uint32_t t = r->trigger_first[key[0]]; t < r->trigger_first[key[0] + 1]; ++t) {
+            const struct reach_trigger *trigger = &r->triggers[t];
+            const struct ground_plan *plan = &g->plans[trigger->action];
+            w->output = &g->outputs[trigger->action];
+
+            if (reach_bind(w, plan, &plan->atoms[plan->pre[trigger->pre]], key + 1))
+                reach_join(w, r, plan, trigger->pre, fact, 0);
+            reach_unbind(w, 0);
+        }
+
+        reach_flush(w, r);
+    }
+}
+
+static void
+reach_free(struct reach *r)
+{
+    for (uint32_t i = 0; i < r->posting_count; ++i)
+        array_free(r->postings[i].facts);
+
+    atoms_free(&r->atoms);
+    array_free(r->postings);
+    mem_free(r->slots);
+    array_free(r->trigger_first);
+    array_free(r->triggers);
+    array_free(r->pending);
+}
+
+// runs on the calling thread: each fact is joined with the ones reached
+// before it, so the order facts are reached in matters to the joins.
+static void
+ground_reach(struct grounder *g)
+{
+    struct reach reach;
+    struct reach *r = &reach;
+    memset(r, 0, sizeof(*r));
+
+    struct ground_worker worker;
+    struct ground_worker *w = &worker;
+    bool ready = ground_worker_init(w, g);
+
+    g->reach = r;
+    if (ready && setjmp(w->fail) == 0) {
+        reach_triggers(w, r);
+        reach_run(w, r);
+    } else {
+        g->failed = true;
+    }
+
+    g->reach = NULL;
+    ground_worker_free(w);
+    reach_free(r);
+
+    if (g->failed)
+        ground_fail(g, "out of memory");
+}
+
+// merging
+
+static uint32_t
+ground_intern(struct grounder *g, struct atoms *facts, uint32_t predicate, const uint32_t *args, uint32_t arity)
+{
+    uint32_t fact = atoms_intern(facts, predicate, args, arity);
+    if (fact == PDDLP_NONE)
+        ground_fail(g, "out of memory");
+
+    return fact;
+}
+
+static void
+ground_goal(struct grounder *g, struct atoms *facts, struct pddlp_strips *strips, uint32_t node)
+{
+    const struct pddlp_formulas *f = &g->problem->formulas;
+    if (node == PDDLP_NONE)
+        return;
+
+    const struct pddlp_node *n = &f->nodes[node];
+
+    if (n->node_type == PDDLP_NODE_COMPOUND && n->op == PDDLP_TOKEN_AND) {
+        for (uint32_t i = 0; i < n->count; ++i)
+            ground_goal(g, facts, strips, f->children[n->first + i]);
+        return;
+    }
+
+    if (n->node_type != PDDLP_NODE_ATOM)
+        ground_fail(g, "grounding supports only conjunctive goals");
+
+    uint32_t *args = ground_calloc(g, n->count, sizeof(*args));
+    for (uint32_t i = 0; i < n->count; ++i) {
+        const struct pddlp_node *term = &f->nodes[f->children[n->first + i]];
+        if (term->node_type != PDDLP_NODE_OBJECT) {
+            mem_free(args);
+            ground_fail(g, "grounding supports only conjunctive goals");
+        }
+        args[i] = term->value;
+    }
+
+    // static goals that hold are dropped. the others can never be reached,
+    // and keep a fact that nothing adds.
+    if (g->fluent[n->value] || pddlp_find_fact(g->problem, n->value, args) == PDDLP_NONE) {
+        uint32_t fact = atoms_intern(facts, n->value, args, n->count);
+        if (fact == PDDLP_NONE) {
+            mem_free(args);
+            ground_fail(g, "out of memory");
+        }
+
+        *GROUND_PUSH(g, strips->goal, strips->goal_count) = fact;
+    }
+
+    mem_free(args);
+}
+
+// numbers the facts of every schema in action order, so the result doesn't
+// depend on how the schemas were spread over threads. with `referenced`, the
+// facts no operator refers to are left out: the reachable operators intern
+// the atoms of bindings they go on to reject like the others do, and those
+// facts were never reached.
+static void
+ground_merge(struct grounder *g, struct pddlp_strips *strips, struct atoms *facts, bool referenced)
+{
+    const struct pddlp_problem *pr = g->problem;
+
+    for (uint32_t i = 0; i < pr->fact_count; ++i) {
+        uint32_t predicate = pr->fact_predicates[i];
+        if (!g->fluent[predicate])
+            continue;
+
+        uint32_t fact = ground_intern(g, facts, predicate, pr->fact_args + pr->fact_args_first[i],
+            g->domain->predicates[predicate].param_count);
+
+        // duplicates in :init get the id they already had.
+        if (fact == strips->init_count)
+            *GROUND_PUSH(g, strips->init, strips->init_count) = fact;
+    }
+
+    uint64_t operator_count = 0, arg_count = 0, fact_count = 0;
+    for (uint32_t a = 0; a < g->domain->action_count; ++a) {
+        operator_count += g->outputs[a].operator_count;
+        arg_count += g->outputs[a].arg_count;
+        fact_count += g->outputs[a].fact_count;
+    }
+
+    if (operator_count >= UINT32_MAX || arg_count >= UINT32_MAX || fact_count >= UINT32_MAX)
+        ground_fail(g, "too many operators");
+
+    strips->operators = ground_reserve(g, NULL, operator_count, sizeof(*strips->operators));
+    strips->operator_args = ground_reserve(g, NULL, arg_count, sizeof(*strips->operator_args));
+    strips->operator_facts = ground_reserve(g, NULL, fact_count, sizeof(*strips->operator_facts));
+
+    uint32_t *map = NULL;
+
+    for (uint32_t a = 0; a < g->domain->action_count; ++a) {
+        struct ground_output *out = &g->outputs[a];
+        const struct atoms *local = &out->atoms;
+
+        map = ground_reserve(g, map, local->count, sizeof(*map));
+        for (uint32_t i = 0; i < local->count; ++i)
+            map[i] = PDDLP_NONE;
+
+        for (uint32_t i = 0; i < (referenced ? out->fact_count : local->count); ++i) {
+            uint32_t atom = referenced ? out->facts[i] : i;
+            if (map[atom] != PDDLP_NONE)
+                continue;
+
+            const uint32_t *key = local->keys + local->starts[atom];
+            map[atom] = atoms_intern(facts, key[0], key + 1, atoms_arity(local, atom));
+            if (map[atom] == PDDLP_NONE) {
+                array_free(map);
+                ground_fail(g, "out of memory");
+            }
+        }
+
+        uint32_t arg_base = strips->operator_arg_count;
+        uint32_t fact_base = strips->operator_fact_count;
+
+        for (uint32_t i = 0; i < out->operator_count; ++i) {
+            struct pddlp_operator op = out->operators[i];
+            op.args += arg_base;
+            op.pre += fact_base;
+            op.add += fact_base;
+            op.del += fact_base;
+            op.end += fact_base;
+            strips->operators[strips->operator_count++] = op;
+        }
+
+        if (out->arg_count > 0)
+            memcpy(strips->operator_args + arg_base, out->args, sizeof(*out->args) * out->arg_count);
+        strips->operator_arg_count += out->arg_count;
+
+        for (uint32_t i = 0; i < out->fact_count; ++i)
+            strips->operator_facts[fact_base + i] = map[out->facts[i]];
+        strips->operator_fact_count += out->fact_count;
+
+        // the schema's output isn't needed anymore, so free it right away to
+        // keep the peak down.
+        atoms_free(&out->atoms);
+        array_free(out->operators);
+        array_free(out->args);
+        array_free(out->facts);
+        memset(out, 0, sizeof(*out));
+    }
+
+    array_free(map);
+
+    ground_goal(g, facts, strips, pr->goal);
+}
+
+static void
+ground_free(struct grounder *g)
+{
+    if (g->plans)
+        for (uint32_t a = 0; a < g->domain->action_count; ++a)
+            ground_free_plan(&g->plans[a]);
+
+    if (g->outputs) {
+        for (uint32_t a = 0; a < g->domain->action_count; ++a) {
+            atoms_free(&g->outputs[a].atoms);
+            array_free(g->outputs[a].operators);
+            array_free(g->outputs[a].args);
+            array_free(g->outputs[a].facts);
+        }
+    }
+
+    mem_free(g->plans);
+    mem_free(g->outputs);
+    atoms_free(&g->facts);
+    mem_free(g->fluent);
+
+    pthread_mutex_destroy(&g->lock);
+}
+
+static size_t
+strips_memory(const struct pddlp_strips *strips)
+{
+    return sizeof(*strips) +
+        (size_t)array_capacity(strips->fact_predicates) * sizeof(*strips->fact_predicates) +
+        (size_t)array_capacity(strips->fact_args_first) * sizeof(*strips->fact_args_first) +
+        (size_t)array_capacity(strips->fact_args) * sizeof(*strips->fact_args) +
+        (size_t)array_capacity(strips->operators) * sizeof(*strips->operators) +
+        (size_t)array_capacity(strips->operator_args) * sizeof(*strips->operator_args) +
+        (size_t)array_capacity(strips->operator_facts) * sizeof(*strips->operator_facts) +
+        (size_t)array_capacity(strips->init) * sizeof(*strips->init) +
+        (size_t)array_capacity(strips->goal) * sizeof(*strips->goal);
+}
+
+static void
+ground_build(struct grounder *g, unsigned threads, bool reachable)
+{
+    struct pddlp_strips *strips = g->strips;
+    struct atoms *facts = &g->facts;
+
+    ground_fluents(g);
+    ground_plans(g);
+    if (reachable)
+        ground_reach(g);
+    else
+        ground_run(g, threads);
+    ground_merge(g, strips, facts, reachable);
+
+    // facts take over the storage of the table: keys hold the predicate
+    // followed by the arguments, so the arguments start one past it.
+    strips->fact_count = facts->count;
+    strips->fact_args = facts->keys;
+    strips->fact_args_first = facts->starts;
+    facts->keys = NULL;
+    facts->starts = NULL;
+
+    strips->fact_predicates = ground_reserve(g, NULL, strips->fact_count, sizeof(*strips->fact_predicates));
+    for (uint32_t i = 0; i < strips->fact_count; ++i)
+        strips->fact_predicates[i] = strips->fact_args[strips->fact_args_first[i]++];
+
+    strips->memory = strips_memory(strips);
+}
+
+static struct pddlp_strips *
+ground(const struct pddlp_problem *problem, unsigned threads, bool reachable, struct pddlp_error *error)
+{
+    struct grounder grounder;
+    struct grounder *g = &grounder;
+    memset(g, 0, sizeof(*g));
+    g->problem = problem;
+    g->domain = problem->domain;
+    g->error = error;
+
+    enum pddlp_subsystem previous = mem_enter(PDDLP_SUBSYSTEM_GROUND);
+    g->strips = mem_alloc(sizeof(*g->strips));
+    if (g->strips == NULL) {
+        mem_leave(previous);
+        error->message = "out of memory";
+        error->line = 0;
+        error->column = 0;
+        return NULL;
+    }
+
+    memset(g->strips, 0, sizeof(*g->strips));
+    g->strips->problem = problem;
+    pthread_mutex_init(&g->lock, NULL);
+
+    if (setjmp(g->fail)) {
+        pddlp_free_strips(g->strips);
+        ground_free(g);
+        mem_leave(previous);
+        return NULL;
+    }
+
+    ground_build(g, threads, reachable);
+    ground_free(g);
+    mem_leave(previous);
+
+    return g->strips;
+}
+
+struct pddlp_strips *
+pddlp_ground(const struct pddlp_problem *problem, unsigned threads, struct pddlp_error *error)
+{
+    return ground(problem, threads, false, error);
+}
+
+struct pddlp_strips *
+pddlp_ground_reachable(const struct pddlp_problem *problem, struct pddlp_error *error)
+{
+    return ground(problem, 1, true, error);
+}
+
+void
+pddlp_free_strips(struct pddlp_strips *strips)
+{
+    if (strips == NULL)
+        return;
+
+    array_free(strips->fact_predicates);
+    array_free(strips->fact_args_first);
+    array_free(strips->fact_args);
+    array_free(strips->operators);
+    array_free(strips->operator_args);
+    array_free(strips->operator_facts);
+    array_free(strips->init);
+    array_free(strips->goal);
+    mem_free(strips);
+}
+
+void
+pddlp_strips_init_state(const struct pddlp_strips *strips, uint64_t *state)
+{
+    memset(state, 0, sizeof(*state) * PDDLP_STATE_WORDS(strips->fact_count));
+
+    for (uint32_t i = 0; i < strips->init_count; ++i)
+        state[strips->init[i] / 64] |= UINT64_C(1) << (strips->init[i] % 64);
+}
+
+bool
+pddlp_strips_applicable(const struct pddlp_strips *strips, uint32_t op, const uint64_t *state)
+{
+    const struct pddlp_operator *o = &strips->operators[op];
+
+    for (uint32_t i = o->pre; i < o->add; ++i) {
+        uint32_t fact = strips->operator_facts[i];
+        if (!(state[fact / 64] & (UINT64_C(1) << (fact % 64))))
+            return false;
+    }
+
+    return true;
+}
+
+void
+pddlp_strips_apply(const struct pddlp_strips *strips, uint32_t op, uint64_t *state)
+{
+    const struct pddlp_operator *o = &strips->operators[op];
+
+    for (uint32_t i = o->del; i < o->end; ++i) {
+        uint32_t fact = strips->operator_facts[i];
+        state[fact / 64] &= ~(UINT64_C(1) << (fact % 64));
+    }
+
+    for (uint32_t i = o->add; i < o->del; ++i) {
+        uint32_t fact = strips->operator_facts[i];
+        state[fact / 64] |= UINT64_C(1) << (fact % 64);
+    }
+}
@@ -0,0 +1,749 @@
+// SPDX-FileCopyrightText: 2024 Guilherme Puida Moreira <guilherme@puida.xyz>
+// SPDX-License-Identifier: BSD-3-Clause
+
+// helpers shared by the translation units of the library. nothing in here is
+// part of the public api.
+
+#ifndef PDDLP_INTERNAL_H_
+#define PDDLP_INTERNAL_H_
+
+#include "pddlp.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// functions shared between the translation units of the library. the
+// single-header build gives them internal linkage, like the public ones.
+#ifdef PDDLP_STATIC
+#define PDDLP_INTERNAL static
+#else
+#define PDDLP_INTERNAL
+#endif
+
+// every allocation of the library goes through these, see memory.c.
+
+PDDLP_INTERNAL void *
+mem_alloc(size_t size);
+
+PDDLP_INTERNAL void *
+mem_realloc(void *pointer, size_t size);
+
+PDDLP_INTERNAL void
+mem_free(void *pointer);
+
+// sets the subsystem the calling thread's allocations are counted against,
+// and returns the one to go back to with mem_leave.
+PDDLP_INTERNAL enum pddlp_subsystem
+mem_enter(enum pddlp_subsystem);
+
+PDDLP_INTERNAL void
+mem_leave(enum pddlp_subsystem previous);
+
+// growable arrays. the capacity is kept in a header right before the first
+// item, so an array is just a pointer plus a count stored by its owner. the
+// header is 16 bytes to keep any item type aligned.
+
+#define ARRAY_HEADER 16
+
+static inline uint32_t
+array_capacity(const void *items)
+{
+    return items ? *(const uint32_t *)((const char *)items - ARRAY_HEADER) : 0;
+}
+
+// makes room for at least `needed` items. returns the (possibly moved) array,
+// or NULL when out of memory, in which case `items` is left untouched.
+static inline void *
+array_reserve(void *items, uint32_t needed, size_t item_size)
+{
+    uint32_t capacity = array_capacity(items);
+    if (needed <= capacity)
+        return items;
+
+    uint64_t new_capacity = capacity ? (uint64_t)capacity * 2 : 8;
+    while (new_capacity < needed)
+        new_capacity *= 2;
+
+    if (new_capacity > UINT32_MAX)
+        new_capacity = UINT32_MAX;
+
+    if (new_capacity < needed || new_capacity * item_size > SIZE_MAX - ARRAY_HEADER)
+        return NULL;
+
+    char *header = items ? (char *)items - ARRAY_HEADER : NULL;
+    header = mem_realloc(header, ARRAY_HEADER + new_capacity * item_size);
+    if (header == NULL)
+        return NULL;
+
+    *(uint32_t *)header = new_capacity;
+    return header + ARRAY_HEADER;
+}
+
+static inline void
+array_free(void *items)
+{
+    if (items)
+        mem_free((char *)items - ARRAY_HEADER);
+}
+
+// arena for strings and other data that lives as long as its owner.
+
+struct arena_block {
+    struct arena_block *next;
+    size_t used;
+    size_t size;
+    // data follows, aligned like the header.
+};
+
+struct arena {
+    struct arena_block *blocks;
+};
+
+#define ARENA_BLOCK_SIZE (64 * 1024)
+
+static inline void *
+arena_alloc(struct arena *arena, size_t size)
+{
+    size = (size + 7) & ~(size_t)7;
+
+    struct arena_block *block = arena->blocks;
+    if (block == NULL || block->size - block->used < size) {
+        size_t block_size = size > ARENA_BLOCK_SIZE ? size : ARENA_BLOCK_SIZE;
+        block = mem_alloc(sizeof(*block) + block_size);
+        if (block == NULL)
+            return NULL;
+
+        block->used = 0;
+        block->size = block_size;
+        block->next = arena->blocks;
+        arena->blocks = block;
+    }
+
+    void *result = (char *)(block + 1) + block->used;
+    block->used += size;
+    return result;
+}
+
+static inline char *
+arena_strndup(struct arena *arena, const char *start, size_t length)
+{
+    char *result = arena_alloc(arena, length + 1);
+    if (result == NULL)
+        return NULL;
+
+    memcpy(result, start, length);
+    result[length] = 0;
+    return result;
+}
+
+static inline void
+arena_free(struct arena *arena)
+{
+    struct arena_block *block = arena->blocks;
+    while (block) {
+        struct arena_block *next = block->next;
+        mem_free(block);
+        block = next;
+    }
+
+    arena->blocks = NULL;
+}
+
+// index of the lowest set bit of a non-zero word.
+static inline uint32_t
+bit_lowest(uint64_t bits)
+{
+#ifdef __GNUC__
+    return __builtin_ctzll(bits);
+#else
+    uint32_t index = 0;
+    while (!(bits & 1)) {
+        bits >>= 1;
+        index++;
+    }
+    return index;
+#endif
+}
+
+// xxh64, used to key caches on file contents.
+
+#define XXH_PRIME64_1 UINT64_C(0x9E3779B185EBCA87)
+#define XXH_PRIME64_2 UINT64_C(0xC2B2AE3D27D4EB4F)
+#define XXH_PRIME64_3 UINT64_C(0x165667B19E3779F9)
+#define XXH_PRIME64_4 UINT64_C(0x85EBCA77C2B2AE63)
+#define XXH_PRIME64_5 UINT64_C(0x27D4EB2F165667C5)
+
+static inline uint64_t
+xxh_rotl(uint64_t x, int r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t
+xxh_read64(const unsigned char *p)
+{
+    uint64_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static inline uint32_t
+xxh_read32(const unsigned char *p)
+{
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static inline uint64_t
+xxh_round(uint64_t acc, uint64_t input)
+{
+    acc += input * XXH_PRIME64_2;
+    acc = xxh_rotl(acc, 31);
+    return acc * XXH_PRIME64_1;
+}
+
+static inline uint64_t
+xxh_merge_round(uint64_t acc, uint64_t value)
+{
+    acc ^= xxh_round(0, value);
+    return acc * XXH_PRIME64_1 + XXH_PRIME64_4;
+}
+
+// assumes a little-endian host, like everything else that reads this hash.
+static inline uint64_t
+hash64(const void *data, size_t length, uint64_t seed)
+{
+    const unsigned char *p = data;
+    const unsigned char *end = p + length;
+    uint64_t h;
+
+    if (length >= 32) {
+        uint64_t v1 = seed + XXH_PRIME64_1 + XXH_PRIME64_2;
+        uint64_t v2 = seed + XXH_PRIME64_2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - XXH_PRIME64_1;
+
+        do {
+            v1 = xxh_round(v1, xxh_read64(p));
+            v2 = xxh_round(v2, xxh_read64(p + 8));
+            v3 = xxh_round(v3, xxh_read64(p + 16));
+            v4 = xxh_round(v4, xxh_read64(p + 24));
+            p += 32;
+        } while (end - p >= 32);
+
+        h = xxh_rotl(v1, 1) + xxh_rotl(v2, 7) + xxh_rotl(v3, 12) + xxh_rotl(v4, 18);
+        h = xxh_merge_round(h, v1);
+        h = xxh_merge_round(h, v2);
+        h = xxh_merge_round(h, v3);
+        h = xxh_merge_round(h, v4);
+    } else {
+        h = seed + XXH_PRIME64_5;
+    }
+
+    h += length;
+
+    while (end - p >= 8) {
+        h ^= xxh_round(0, xxh_read64(p));
+        h = xxh_rotl(h, 27) * XXH_PRIME64_1 + XXH_PRIME64_4;
+        p += 8;
+    }
+
+    if (end - p >= 4) {
+        h ^= (uint64_t)xxh_read32(p) * XXH_PRIME64_1;
+        h = xxh_rotl(h, 23) * XXH_PRIME64_2 + XXH_PRIME64_3;
+        p += 4;
+    }
+
+    while (p < end) {
+        h ^= *p * XXH_PRIME64_5;
+        h = xxh_rotl(h, 11) * XXH_PRIME64_1;
+        p++;
+    }
+
+    h ^= h >> 33;
+    h *= XXH_PRIME64_2;
+    h ^= h >> 29;
+    h *= XXH_PRIME64_3;
+    h ^= h >> 32;
+
+    return h;
+}
+
+// hash64 over data that arrives in pieces. the digest is the same as
+// hash64 of all the pieces put together. the state is the public
+// pddlp_hasher, so callers of the library get the same hash.
+
+static inline void
+hash_stream_init(struct pddlp_hasher *s, uint64_t seed)
+{
+    s->seed = seed;
+    s->v1 = seed + XXH_PRIME64_1 + XXH_PRIME64_2;
+    s->v2 = seed + XXH_PRIME64_2;
+    s->v3 = seed;
+    s->v4 = seed - XXH_PRIME64_1;
+    s->length = 0;
+    s->buffered = 0;
+}
+
+static inline void
+hash_stream_stripe(struct pddlp_hasher *s, const unsigned char *p)
+{
+    s->v1 = xxh_round(s->v1, xxh_read64(p));
+    s->v2 = xxh_round(s->v2, xxh_read64(p + 8));
+    s->v3 = xxh_round(s->v3, xxh_read64(p + 16));
+    s->v4 = xxh_round(s->v4, xxh_read64(p + 24));
+}
+
+static inline void
+hash_stream_update(struct pddlp_hasher *s, const void *data, size_t length)
+{
+    const unsigned char *p = data;
+    const unsigned char *end = p + length;
+    s->length += length;
+
+    if (s->buffered > 0) {
+        size_t fill = 32 - s->buffered;
+        if (fill > length)
+            fill = length;
+
+        memcpy(s->buffer + s->buffered, p, fill);
+        s->buffered += fill;
+        p += fill;
+
+        if (s->buffered < 32)
+            return;
+
+        hash_stream_stripe(s, s->buffer);
+        s->buffered = 0;
+    }
+
+    for (; end - p >= 32; p += 32)
+        hash_stream_stripe(s, p);
+
+    if (p < end) {
+        memcpy(s->buffer, p, end - p);
+        s->buffered = end - p;
+    }
+}
+
+static inline uint64_t
+hash_stream_digest(const struct pddlp_hasher *s)
+{
+    const unsigned char *p = s->buffer;
+    const unsigned char *end = p + s->buffered;
+    uint64_t h;
+
+    if (s->length >= 32) {
+        h = xxh_rotl(s->v1, 1) + xxh_rotl(s->v2, 7) + xxh_rotl(s->v3, 12) + xxh_rotl(s->v4, 18);
+        h = xxh_merge_round(h, s->v1);
+        h = xxh_merge_round(h, s->v2);
+        h = xxh_merge_round(h, s->v3);
+        h = xxh_merge_round(h, s->v4);
+    } else {
+        h = s->seed + XXH_PRIME64_5;
+    }
+
+    h += s->length;
+
+    while (end - p >= 8) {
+        h ^= xxh_round(0, xxh_read64(p));
+        h = xxh_rotl(h, 27) * XXH_PRIME64_1 + XXH_PRIME64_4;
+        p += 8;
+    }
+
+    if (end - p >= 4) {
+        h ^= (uint64_t)xxh_read32(p) * XXH_PRIME64_1;
+        h = xxh_rotl(h, 23) * XXH_PRIME64_2 + XXH_PRIME64_3;
+        p += 4;
+    }
+
+    while (p < end) {
+        h ^= *p * XXH_PRIME64_5;
+        h = xxh_rotl(h, 11) * XXH_PRIME64_1;
+        p++;
+    }
+
+    h ^= h >> 33;
+    h *= XXH_PRIME64_2;
+    h ^= h >> 29;
+    h *= XXH_PRIME64_3;
+    h ^= h >> 32;
+
+    return h;
+}
+
+// fnv-1a, for the short names stored in symbol tables.
+static inline uint32_t
+hash_name(const char *start, size_t length)
+{
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < length; ++i) {
+        h ^= (unsigned char)start[i];
+        h *= 16777619u;
+    }
+
+    return h;
+}
+
+// open addressing table from names to ids. the names are owned by whoever
+// inserts them, and must stay alive as long as the table.
+
+struct symbol {
+    const char *name;
+    uint32_t length;
+    uint32_t hash;
+    uint32_t value;
+};
+
+struct symbols {
+    struct symbol *slots;
+    uint32_t capacity;
+    uint32_t count;
+};
+
+static inline uint32_t
+symbols_find_hashed(const struct symbols *symbols, const char *name, size_t length, uint32_t hash)
+{
+    if (symbols->count == 0)
+        return PDDLP_NONE;
+
+    uint32_t mask = symbols->capacity - 1;
+    for (uint32_t i = hash & mask;; i = (i + 1) & mask) {
+        const struct symbol *slot = &symbols->slots[i];
+        if (slot->name == NULL)
+            return PDDLP_NONE;
+
+        if (slot->hash == hash && slot->length == length && memcmp(slot->name, name, length) == 0)
+            return slot->value;
+    }
+}
+
+static inline uint32_t
+symbols_find(const struct symbols *symbols, const char *name, size_t length)
+{
+    return symbols_find_hashed(symbols, name, length, hash_name(name, length));
+}
+
+// inserts without checking for duplicates. returns false when out of memory.
+static inline bool
+symbols_insert(struct symbols *symbols, const char *name, size_t length, uint32_t value)
+{
+    if ((symbols->count + 1) * 2 > symbols->capacity) {
+        uint32_t capacity = symbols->capacity ? symbols->capacity * 2 : 16;
+        struct symbol *slots = mem_alloc(sizeof(*slots) * capacity);
+        if (slots == NULL)
+            return false;
+
+        memset(slots, 0, sizeof(*slots) * capacity);
+
+        for (uint32_t i = 0; i < symbols->capacity; ++i) {
+            struct symbol *slot = &symbols->slots[i];
+            if (slot->name == NULL)
+                continue;
+
+            uint32_t j = slot->hash & (capacity - 1);
+            while (slots[j].name)
+                j = (j + 1) & (capacity - 1);
+            slots[j] = *slot;
+        }
+
+        mem_free(symbols->slots);
+        symbols->slots = slots;
+        symbols->capacity = capacity;
+    }
+
+    uint32_t hash = hash_name(name, length);
+    uint32_t mask = symbols->capacity - 1;
+    uint32_t i = hash & mask;
+    while (symbols->slots[i].name)
+        i = (i + 1) & mask;
+
+    symbols->slots[i].name = name;
+    symbols->slots[i].length = length;
+    symbols->slots[i].hash = hash;
+    symbols->slots[i].value = value;
+    symbols->count++;
+
+    return true;
+}
+
+static inline void
+symbols_free(struct symbols *symbols)
+{
+    mem_free(symbols->slots);
+    symbols->slots = NULL;
+    symbols->capacity = 0;
+    symbols->count = 0;
+}
+
+// ground atoms, or any other tuple of ids, interned to dense ids in the order
+// they are first seen.
+
+struct atoms {
+    // the predicate and then the arguments of each atom.
+    uint32_t *keys;
+    uint32_t key_count;
+
+    uint32_t *starts;
+    uint32_t count;
+
+    // atom + 1, or 0 when empty.
+    uint32_t *slots;
+    uint32_t capacity;
+};
+
+static inline uint32_t
+atoms_hash(uint32_t predicate, const uint32_t *args, uint32_t arity)
+{
+    return (uint32_t)hash64(args, sizeof(*args) * arity, predicate);
+}
+
+static inline uint32_t
+atoms_arity(const struct atoms *atoms, uint32_t atom)
+{
+    uint32_t end = atom + 1 < atoms->count ? atoms->starts[atom + 1] : atoms->key_count;
+    return end - atoms->starts[atom] - 1;
+}
+
+static inline uint32_t
+atoms_find(const struct atoms *atoms, uint32_t predicate, const uint32_t *args, uint32_t arity)
+{
+    if (atoms->count == 0)
+        return PDDLP_NONE;
+
+    uint32_t mask = atoms->capacity - 1;
+    for (uint32_t i = atoms_hash(predicate, args, arity) & mask;; i = (i + 1) & mask) {
+        uint32_t slot = atoms->slots[i];
+        if (slot == 0)
+            return PDDLP_NONE;
+
+        const uint32_t *key = atoms->keys + atoms->starts[slot - 1];
+        if (key[0] == predicate && memcmp(key + 1, args, sizeof(*args) * arity) == 0)
+            return slot - 1;
+    }
+}
+
+static inline bool
+atoms_grow(struct atoms *atoms)
+{
+    uint64_t capacity = atoms->capacity ? (uint64_t)atoms->capacity * 2 : 64;
+    if (capacity > UINT32_MAX)
+        return false;
+
+    uint32_t *slots = mem_alloc(sizeof(*slots) * capacity);
+    if (slots == NULL)
+        return false;
+
+    memset(slots, 0, sizeof(*slots) * capacity);
+
+    uint32_t mask = capacity - 1;
+    for (uint32_t atom = 0; atom < atoms->count; ++atom) {
+        const uint32_t *key = atoms->keys + atoms->starts[atom];
+        uint32_t i = atoms_hash(key[0], key + 1, atoms_arity(atoms, atom)) & mask;
+        while (slots[i])
+            i = (i + 1) & mask;
+        slots[i] = atom + 1;
+    }
+
+    mem_free(atoms->slots);
+    atoms->slots = slots;
+    atoms->capacity = capacity;
+    return true;
+}
+
+// returns the id of the atom, adding it when missing, or PDDLP_NONE when out
+// of memory.
+static inline uint32_t
+atoms_intern(struct atoms *atoms, uint32_t predicate, const uint32_t *args, uint32_t arity)
+{
+    uint32_t atom = atoms_find(atoms, predicate, args, arity);
+    if (atom != PDDLP_NONE)
+        return atom;
+
+    if ((uint64_t)(atoms->count + 1) * 2 > atoms->capacity && !atoms_grow(atoms))
+        return PDDLP_NONE;
+
+    uint32_t *keys = array_reserve(atoms->keys, atoms->key_count + arity + 1, sizeof(*keys));
+    uint32_t *starts = array_reserve(atoms->starts, atoms->count + 1, sizeof(*starts));
+    if (keys)
+        atoms->keys = keys;
+    if (starts)
+        atoms->starts = starts;
+    if (keys == NULL || starts == NULL)
+        return PDDLP_NONE;
+
+    atom = atoms->count++;
+    atoms->starts[atom] = atoms->key_count;
+    atoms->keys[atoms->key_count++] = predicate;
+    memcpy(atoms->keys + atoms->key_count, args, sizeof(*args) * arity);
+    atoms->key_count += arity;
+
+    uint32_t mask = atoms->capacity - 1;
+    uint32_t i = atoms_hash(predicate, args, arity) & mask;
+    while (atoms->slots[i])
+        i = (i + 1) & mask;
+    atoms->slots[i] = atom + 1;
+
+    return atom;
+}
+
+static inline void
+atoms_free(struct atoms *atoms)
+{
+    array_free(atoms->keys);
+    array_free(atoms->starts);
+    mem_free(atoms->slots);
+    memset(atoms, 0, sizeof(*atoms));
+}
+
+// formulas.
+
+// whether `n` compares numbers rather than objects. the grounder and
+// pddlp_compile_numeric take these with two operands only, and reject the
+// others rather than skip them.
+static inline bool
+formula_numeric_comparison(const struct pddlp_formulas *f, const struct pddlp_node *n)
+{
+    switch (n->op) {
+    case PDDLP_TOKEN_LT:
+    case PDDLP_TOKEN_LTE:
+    case PDDLP_TOKEN_GT:
+    case PDDLP_TOKEN_GTE:
+        return true;
+    case PDDLP_TOKEN_EQ:
+        for (uint32_t i = 0; i < n->count; ++i) {
+            enum pddlp_node_type type = f->nodes[f->children[n->first + i]].node_type;
+            if (type != PDDLP_NODE_OBJECT && type != PDDLP_NODE_VARIABLE)
+                return true;
+        }
+        return false;
+    default:
+        return false;
+    }
+}
+
+// parsed domains and problems.
+
+// the public structs are the first member of these, so a pointer to one can
+// be cast to the other.
+
+struct domain {
+    struct pddlp_domain base;
+
+    struct symbols type_symbols;
+    struct symbols constant_symbols;
+    struct symbols predicate_symbols;
+    struct symbols function_symbols;
+    struct symbols action_symbols;
+
+    struct arena arena;
+
+    // the constructs :requirements enable, see parse_feature. everything
+    // unless parsed with pddlp_parse_domain_strict.
+    uint32_t features;
+
+    // protected by cache_lock. cached domains keep a copy of their source
+    // in the arena, to tell apart sources whose hashes collide.
+    int references;
+    uint64_t hash;
+    size_t length;
+    const char *source;
+};
+
+// a list of facts that can change. for posting lists, `key` is the posting
+// and `object` the argument.
+struct facts_list {
+    uint32_t key;
+    uint32_t object;
+    uint32_t *facts;
+    uint32_t count;
+};
+
+struct problem {
+    struct pddlp_problem base;
+
+    struct symbols object_symbols;
+
+    struct arena arena;
+
+    // :init facts by content. see facts.c.
+    uint64_t *fact_slots;
+    uint32_t fact_capacity;
+
+    // posting lists, built on first use. see facts.c.
+    pthread_mutex_t index_lock;
+    uint32_t *predicate_facts_first;
+    uint32_t *predicate_facts;
+    uint32_t *postings_first;
+    uint32_t **posting_offsets;
+    uint32_t **posting_facts;
+    uint32_t *posting_objects;
+
+    // the lists updates changed after they were built, which stand in for
+    // them from then on, and the place of each fact in its predicate list.
+    // see facts.c.
+    struct facts_list *predicate_lists;
+    uint32_t *fact_positions;
+    struct facts_list *patches;
+    uint32_t patch_count;
+    uint64_t *patch_slots;
+    uint32_t patch_capacity;
+
+    // arguments in fact_args that no fact uses since it was removed.
+    uint32_t dead_args;
+
+    // numeric :init entries by content, built by the first update that
+    // assigns one. see update.c.
+    uint64_t *fluent_slots;
+    uint32_t fluent_capacity;
+
+    // objects are added after the ones parsed, into rows and lists that have
+    // room for this many.
+    uint32_t parsed_object_count;
+    uint32_t object_capacity;
+    uint32_t type_object_capacity;
+
+    // where the sections pddlp_write_problem rewrites are in the source, as
+    // offsets. objects_list is right after `:objects` and objects_end right
+    // after its ')', and both are 0 when there is no such section. the same
+    // goes for init_start, at the '(' of :init, and init_end. body_end is at
+    // the ')' that closes the problem, and timed_spans has the start and end
+    // of each timed literal.
+    size_t source_length;
+    size_t objects_list;
+    size_t objects_end;
+    size_t init_start;
+    size_t init_end;
+    size_t body_end;
+    size_t *timed_spans;
+};
+
+// fills the :init set once the facts are parsed, dropping the repeated ones
+// so each fact keeps the id of its first occurrence. returns false when out
+// of memory.
+PDDLP_INTERNAL bool
+facts_index(struct problem *);
+
+// adds a fact to the set and to the lists built so far, and returns its id,
+// or the one it already had. returns PDDLP_NONE when out of memory, with the
+// facts as they were.
+PDDLP_INTERNAL uint32_t
+facts_add(struct problem *, uint32_t predicate, const uint32_t *args);
+
+// removes a fact, giving its id to the last one. returns false when out of
+// memory, with the facts as they were.
+PDDLP_INTERNAL bool
+facts_remove(struct problem *, uint32_t fact);
+
+PDDLP_INTERNAL void
+facts_free(struct problem *);
+
+PDDLP_INTERNAL void
+update_free(struct problem *);
+
+#endif // PDDLP_INTERNAL_H_
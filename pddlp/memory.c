@@ -0,0 +1,312 @@
+// SPDX-FileCopyrightText: 2024 Guilherme Puida Moreira <guilherme@puida.xyz>
+// SPDX-License-Identifier: BSD-3-Clause
+
+// the allocator every allocation of the library goes through, and the
+// accounting allocator.
+
+#include "internal.h"
+
+PDDLP_DATA const char *pddlp_subsystem_names[] = {
+    [PDDLP_SUBSYSTEM_OTHER] = "other",
+    [PDDLP_SUBSYSTEM_PARSER] = "parser",
+    [PDDLP_SUBSYSTEM_FACTS] = "facts",
+    [PDDLP_SUBSYSTEM_GROUND] = "ground",
+    [PDDLP_SUBSYSTEM_VALIDATOR] = "validator",
+    [PDDLP_SUBSYSTEM_NORMALIZE] = "normalize",
+    [PDDLP_SUBSYSTEM_CONDITIONS] = "conditions",
+    [PDDLP_SUBSYSTEM_CHECKER] = "checker",
+    [PDDLP_SUBSYSTEM_TRANSLATE] = "translate",
+    [PDDLP_SUBSYSTEM_NUMERIC] = "numeric",
+    [PDDLP_SUBSYSTEM_CACHE] = "cache",
+};
+
+static void *
+memory_default_alloc(void *context, size_t size)
+{
+    (void)context;
+    return malloc(size);
+}
+
+static void *
+memory_default_realloc(void *context, void *pointer, size_t size)
+{
+    (void)context;
+    return realloc(pointer, size);
+}
+
+static void
+memory_default_free(void *context, void *pointer)
+{
+    (void)context;
+    free(pointer);
+}
+
+static const struct pddlp_allocator memory_default = {
+    memory_default_alloc, memory_default_realloc, memory_default_free, NULL,
+};
+
+static struct pddlp_allocator memory_allocator = {
+    memory_default_alloc, memory_default_realloc, memory_default_free, NULL,
+};
+
+// without thread-local storage threads share these, so the split between
+// subsystems is only approximate when several of them allocate at once, and
+// thread budgets are one budget for the whole process.
+#if defined(__GNUC__)
+#define MEMORY_THREAD_LOCAL __thread
+#elif defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L
+#define MEMORY_THREAD_LOCAL _Thread_local
+#else
+#define MEMORY_THREAD_LOCAL
+#endif
+
+// the subsystem allocations of the calling thread are counted against.
+static MEMORY_THREAD_LOCAL enum pddlp_subsystem memory_subsystem;
+
+// the budget of the calling thread, see pddlp_set_thread_budget, and what it
+// has allocated through accounting allocators since, less what it freed.
+static MEMORY_THREAD_LOCAL size_t memory_thread_budget;
+static MEMORY_THREAD_LOCAL size_t memory_thread_current;
+
+PDDLP_INTERNAL void *
+mem_alloc(size_t size)
+{
+    return memory_allocator.alloc(memory_allocator.context, size);
+}
+
+PDDLP_INTERNAL void *
+mem_realloc(void *pointer, size_t size)
+{
+    return memory_allocator.realloc(memory_allocator.context, pointer, size);
+}
+
+PDDLP_INTERNAL void
+mem_free(void *pointer)
+{
+    if (pointer)
+        memory_allocator.free(memory_allocator.context, pointer);
+}
+
+PDDLP_INTERNAL enum pddlp_subsystem
+mem_enter(enum pddlp_subsystem subsystem)
+{
+    enum pddlp_subsystem previous = memory_subsystem;
+    memory_subsystem = subsystem;
+    return previous;
+}
+
+PDDLP_INTERNAL void
+mem_leave(enum pddlp_subsystem previous)
+{
+    memory_subsystem = previous;
+}
+
+void
+pddlp_set_allocator(const struct pddlp_allocator *allocator)
+{
+    memory_allocator = allocator ? *allocator : memory_default;
+}
+
+// accounting. each block starts with a header holding its size and
+// subsystem, 16 bytes so the data stays aligned like malloc's.
+
+struct pddlp_accounting {
+    struct pddlp_allocator base;
+    pthread_mutex_t lock;
+    struct pddlp_memory usage;
+};
+
+struct memory_header {
+    size_t size;
+    uint32_t subsystem;
+    uint32_t padding;
+};
+
+#define MEMORY_HEADER 16
+
+// whether growing by `size` bytes goes past `budget`, with `current` in use.
+static bool
+memory_over(size_t budget, size_t current, size_t size)
+{
+    return budget && (current > budget || size > budget - current);
+}
+
+// counts a block of `subsystem` going from `old_size` to `new_size` bytes,
+// for the accounting and the calling thread. refuses growth past either
+// budget. caller holds the lock.
+static bool
+memory_count(struct pddlp_memory *usage, uint32_t subsystem, size_t old_size, size_t new_size)
+{
+    if (new_size > old_size) {
+        size_t growth = new_size - old_size;
+        if (memory_over(usage->budget, usage->current, growth) ||
+            memory_over(memory_thread_budget, memory_thread_current, growth)) {
+            usage->refused++;
+            return false;
+        }
+
+        memory_thread_current += growth;
+    } else {
+        // memory freed by another thread than the one that allocated it is
+        // taken off the count of the one freeing it.
+        size_t shrink = old_size - new_size;
+        memory_thread_current = memory_thread_current > shrink ? memory_thread_current - shrink : 0;
+    }
+
+    usage->current = usage->current - old_size + new_size;
+    usage->subsystem_current[subsystem] = usage->subsystem_current[subsystem] - old_size + new_size;
+
+    if (usage->current > usage->peak)
+        usage->peak = usage->current;
+    if (usage->subsystem_current[subsystem] > usage->subsystem_peak[subsystem])
+        usage->subsystem_peak[subsystem] = usage->subsystem_current[subsystem];
+
+    return true;
+}
+
+static void *
+memory_accounting_alloc(void *context, size_t size)
+{
+    struct pddlp_accounting *a = context;
+    if (size > SIZE_MAX - MEMORY_HEADER)
+        return NULL;
+
+    uint32_t subsystem = memory_subsystem;
+
+    pthread_mutex_lock(&a->lock);
+    bool counted = memory_count(&a->usage, subsystem, 0, size);
+    pthread_mutex_unlock(&a->lock);
+    if (!counted)
+        return NULL;
+
+    struct memory_header *header = a->base.alloc(a->base.context, MEMORY_HEADER + size);
+    pthread_mutex_lock(&a->lock);
+    if (header == NULL)
+        memory_count(&a->usage, subsystem, size, 0);
+    else
+        a->usage.allocations++;
+    pthread_mutex_unlock(&a->lock);
+
+    if (header == NULL)
+        return NULL;
+
+    header->size = size;
+    header->subsystem = subsystem;
+    return (char *)header + MEMORY_HEADER;
+}
+
+static void
+memory_accounting_free(void *context, void *pointer)
+{
+    if (pointer == NULL)
+        return;
+
+    struct pddlp_accounting *a = context;
+    struct memory_header *header = (struct memory_header *)((char *)pointer - MEMORY_HEADER);
+
+    pthread_mutex_lock(&a->lock);
+    memory_count(&a->usage, header->subsystem, header->size, 0);
+    pthread_mutex_unlock(&a->lock);
+
+    a->base.free(a->base.context, header);
+}
+
+// the block keeps the subsystem it was first allocated for.
+static void *
+memory_accounting_realloc(void *context, void *pointer, size_t size)
+{
+    if (pointer == NULL)
+        return memory_accounting_alloc(context, size);
+
+    struct pddlp_accounting *a = context;
+    if (size > SIZE_MAX - MEMORY_HEADER)
+        return NULL;
+
+    struct memory_header *header = (struct memory_header *)((char *)pointer - MEMORY_HEADER);
+    size_t old_size = header->size;
+    uint32_t subsystem = header->subsystem;
+
+    pthread_mutex_lock(&a->lock);
+    bool counted = memory_count(&a->usage, subsystem, old_size, size);
+    pthread_mutex_unlock(&a->lock);
+    if (!counted)
+        return NULL;
+
+    struct memory_header *moved = a->base.realloc(a->base.context, header, MEMORY_HEADER + size);
+    pthread_mutex_lock(&a->lock);
+    if (moved == NULL)
+        memory_count(&a->usage, subsystem, size, old_size);
+    else
+        a->usage.allocations++;
+    pthread_mutex_unlock(&a->lock);
+
+    if (moved == NULL)
+        return NULL;
+
+    moved->size = size;
+    return (char *)moved + MEMORY_HEADER;
+}
+
+struct pddlp_accounting *
+pddlp_new_accounting(const struct pddlp_allocator *base, size_t budget)
+{
+    if (base == NULL)
+        base = &memory_default;
+
+    struct pddlp_accounting *a = base->alloc(base->context, sizeof(*a));
+    if (a == NULL)
+        return NULL;
+
+    memset(a, 0, sizeof(*a));
+    a->base = *base;
+    a->usage.budget = budget;
+
+    if (pthread_mutex_init(&a->lock, NULL) != 0) {
+        base->free(base->context, a);
+        return NULL;
+    }
+
+    return a;
+}
+
+struct pddlp_allocator
+pddlp_accounting_allocator(struct pddlp_accounting *a)
+{
+    struct pddlp_allocator allocator = {
+        memory_accounting_alloc, memory_accounting_realloc, memory_accounting_free, a,
+    };
+    return allocator;
+}
+
+void
+pddlp_free_accounting(struct pddlp_accounting *a)
+{
+    if (a == NULL)
+        return;
+
+    pthread_mutex_destroy(&a->lock);
+    a->base.free(a->base.context, a);
+}
+
+void
+pddlp_set_budget(struct pddlp_accounting *a, size_t budget)
+{
+    pthread_mutex_lock(&a->lock);
+    a->usage.budget = budget;
+    pthread_mutex_unlock(&a->lock);
+}
+
+void
+pddlp_set_thread_budget(size_t budget)
+{
+    memory_thread_budget = budget;
+    memory_thread_current = 0;
+}
+
+void
+pddlp_memory_usage(struct pddlp_accounting *a, struct pddlp_memory *usage)
+{
+    pthread_mutex_lock(&a->lock);
+    *usage = a->usage;
+    pthread_mutex_unlock(&a->lock);
+}
@@ -0,0 +1,511 @@
+// SPDX-FileCopyrightText: 2024 Guilherme Puida Moreira <guilherme@puida.xyz>
+// SPDX-License-Identifier: BSD-3-Clause
+
+// canonical minified form of a pddl file. tokens are copied to a buffered
+// writer as they are scanned, except for the entries of `:objects` and
+// `:init`, which are collected into a scratch buffer and sorted first. the
+// hash is taken over what the writer flushes, so it needs no second pass.
+
+#include "internal.h"
+
+#include <setjmp.h>
+
+#define NORMALIZE_BUFFER_SIZE (64 * 1024)
+
+// an entry of a sorted section. `text` is a name or a whole `(...)`
+// element, and `type` is the type of an object, when it has one.
+struct normalize_entry {
+    const char *text;
+    uint32_t text_first;
+    uint32_t length;
+
+    uint32_t type_first;
+    uint32_t type_length;
+    const char *type;
+};
+
+struct normalize_key {
+    uint64_t hash;
+    uint32_t entry;
+};
+
+struct normalizer {
+    struct pddlp_tokenizer tokenizer;
+    struct pddlp_error *error;
+    jmp_buf fail;
+
+    // the lowercased copy of the source the tokens point into.
+    char *source;
+
+    pddlp_write_fn write;
+    void *context;
+    char *buffer;
+    size_t buffered;
+    struct pddlp_hasher low;
+    struct pddlp_hasher high;
+
+    // whether the last byte written was '(', or nothing was written yet,
+    // which are the two cases where no space goes before the next token.
+    bool open;
+
+    char *scratch;
+    uint32_t scratch_length;
+    bool scratch_open;
+
+    struct normalize_entry *entries;
+    uint32_t entry_count;
+
+    // the order of the :init entries, see normalize_order.
+    struct normalize_key *keys;
+    struct normalize_key *sorted;
+    uint32_t *counts;
+};
+
+static void
+normalize_fail(struct normalizer *n, const char *message, uint64_t line, uint64_t column)
+{
+    n->error->message = message;
+    n->error->line = line;
+    n->error->column = column;
+    longjmp(n->fail, 1);
+}
+
+static void *
+normalize_reserve(struct normalizer *n, void *items, uint32_t needed, size_t item_size)
+{
+    void *result = array_reserve(items, needed, item_size);
+    if (result == NULL && needed > 0)
+        normalize_fail(n, "out of memory", 0, 0);
+
+    return result;
+}
+
+static struct pddlp_token
+normalize_next(struct normalizer *n)
+{
+    struct pddlp_token token = pddlp_scan_token(&n->tokenizer);
+    if (token.token_type == PDDLP_TOKEN_ERROR)
+        normalize_fail(n, token.start, token.line, token.column);
+
+    return token;
+}
+
+static struct pddlp_token
+normalize_next_in_list(struct normalizer *n)
+{
+    struct pddlp_token token = normalize_next(n);
+    if (token.token_type == PDDLP_TOKEN_EOF)
+        normalize_fail(n, "unexpected end of input", token.line, token.column);
+
+    return token;
+}
+
+// output
+
+static void
+normalize_flush(struct normalizer *n)
+{
+    hash_stream_update(&n->low, n->buffer, n->buffered);
+    hash_stream_update(&n->high, n->buffer, n->buffered);
+
+    if (n->write && n->buffered > 0 && !n->write(n->context, n->buffer, n->buffered))
+        normalize_fail(n, "couldn't write the output", 0, 0);
+
+    n->buffered = 0;
+}
+
+static void
+normalize_write_bytes(struct normalizer *n, const char *data, size_t length)
+{
+    while (length > 0) {
+        if (n->buffered == NORMALIZE_BUFFER_SIZE)
+            normalize_flush(n);
+
+        size_t chunk = NORMALIZE_BUFFER_SIZE - n->buffered;
+        if (chunk > length)
+            chunk = length;
+
+        memcpy(n->buffer + n->buffered, data, chunk);
+        n->buffered += chunk;
+        data += chunk;
+        length -= chunk;
+    }
+}
+
+// writes one token, or a run of tokens that is already minified.
+static void
+normalize_write(struct normalizer *n, const char *text, size_t length)
+{
+    if (!n->open && text[0] != ')')
+        normalize_write_bytes(n, " ", 1);
+
+    normalize_write_bytes(n, text, length);
+    n->open = length == 1 && text[0] == '(';
+}
+
+static void
+normalize_scratch(struct normalizer *n, const char *text, uint32_t length)
+{
+    bool space = !n->scratch_open && text[0] != ')';
+    uint32_t needed = n->scratch_length + space + length;
+    if (needed < length)
+        normalize_fail(n, "out of memory", 0, 0);
+
+    n->scratch = normalize_reserve(n, n->scratch, needed, 1);
+    if (space)
+        n->scratch[n->scratch_length++] = ' ';
+
+    memcpy(n->scratch + n->scratch_length, text, length);
+    n->scratch_length += length;
+    n->scratch_open = length == 1 && text[0] == '(';
+}
+
+// copies `first` to the scratch buffer, along with the rest of the list
+// when it opens one.
+static void
+normalize_scratch_item(struct normalizer *n, struct pddlp_token first)
+{
+    n->scratch_open = true;
+    normalize_scratch(n, first.start, first.length);
+
+    uint32_t depth = first.token_type == PDDLP_TOKEN_LPAREN;
+    while (depth > 0) {
+        struct pddlp_token token = normalize_next_in_list(n);
+        if (token.token_type == PDDLP_TOKEN_LPAREN)
+            depth++;
+        else if (token.token_type == PDDLP_TOKEN_RPAREN)
+            depth--;
+
+        normalize_scratch(n, token.start, token.length);
+    }
+}
+
+// sorted sections
+
+static int
+normalize_compare_text(const char *a, uint32_t a_length, const char *b, uint32_t b_length)
+{
+    uint32_t length = a_length < b_length ? a_length : b_length;
+    int result = length > 0 ? memcmp(a, b, length) : 0;
+    if (result != 0)
+        return result;
+
+    return (a_length > b_length) - (a_length < b_length);
+}
+
+static int
+normalize_compare_entries(const void *a, const void *b)
+{
+    const struct normalize_entry *x = a;
+    const struct normalize_entry *y = b;
+
+    // untyped objects go last, since a name that follows a typed group
+    // would otherwise take its type.
+    if ((x->type_length == 0) != (y->type_length == 0))
+        return x->type_length == 0 ? 1 : -1;
+
+    int result = normalize_compare_text(x->type, x->type_length, y->type, y->type_length);
+    if (result != 0)
+        return result;
+
+    return normalize_compare_text(x->text, x->length, y->text, y->length);
+}
+
+static bool
+normalize_same_entry(const struct normalize_entry *x, const struct normalize_entry *y)
+{
+    return normalize_compare_entries(x, y) == 0;
+}
+
+static struct normalize_entry *
+normalize_push_entry(struct normalizer *n)
+{
+    n->entries = normalize_reserve(n, n->entries, n->entry_count + 1, sizeof(*n->entries));
+
+    struct normalize_entry *entry = &n->entries[n->entry_count++];
+    memset(entry, 0, sizeof(*entry));
+    return entry;
+}
+
+// scratch offsets become pointers once nothing else is added to it.
+static void
+normalize_sort_entries(struct normalizer *n)
+{
+    for (uint32_t i = 0; i < n->entry_count; ++i) {
+        struct normalize_entry *entry = &n->entries[i];
+        entry->type = n->scratch ? n->scratch + entry->type_first : NULL;
+    }
+
+    if (n->entry_count > 1)
+        qsort(n->entries, n->entry_count, sizeof(*n->entries), normalize_compare_entries);
+}
+
+static int
+normalize_compare_keys(const void *a, const void *b, const struct normalize_entry *entries)
+{
+    const struct normalize_key *x = a;
+    const struct normalize_key *y = b;
+
+    if (x->hash != y->hash)
+        return x->hash < y->hash ? -1 : 1;
+
+    const struct normalize_entry *e = &entries[x->entry];
+    const struct normalize_entry *f = &entries[y->entry];
+    return normalize_compare_text(e->text, e->length, f->text, f->length);
+}
+
+// orders the :init entries by their hash, and by their text when the hashes
+// are equal. any fixed order makes equal sets come out the same, and this one
+// is a linear radix sort rather than a sort on strings, which would cost
+// more than tokenizing them.
+static void
+normalize_order(struct normalizer *n)
+{
+    uint32_t count = n->entry_count;
+    size_t size = sizeof(*n->keys) * ((size_t)count + 1);
+    n->keys = mem_alloc(size);
+    n->sorted = mem_alloc(size);
+    n->counts = mem_alloc(sizeof(*n->counts) * 65536);
+    if (n->keys == NULL || n->sorted == NULL || n->counts == NULL)
+        normalize_fail(n, "out of memory", 0, 0);
+
+    for (uint32_t i = 0; i < count; ++i) {
+        const struct normalize_entry *entry = &n->entries[i];
+        n->keys[i].hash = hash64(entry->text, entry->length, 0);
+        n->keys[i].entry = i;
+    }
+
+    // three passes over the high 48 bits. the rest only matters for the
+    // rare equal prefixes, which are fixed up below.
+    for (int shift = 16; shift < 64; shift += 16) {
+        memset(n->counts, 0, sizeof(*n->counts) * 65536);
+        for (uint32_t i = 0; i < count; ++i)
+            n->counts[(n->keys[i].hash >> shift) & 0xffff]++;
+
+        uint32_t total = 0;
+        for (uint32_t d = 0; d < 65536; ++d) {
+            uint32_t digit_count = n->counts[d];
+            n->counts[d] = total;
+            total += digit_count;
+        }
+
+        for (uint32_t i = 0; i < count; ++i)
+            n->sorted[n->counts[(n->keys[i].hash >> shift) & 0xffff]++] = n->keys[i];
+
+        struct normalize_key *swap = n->keys;
+        n->keys = n->sorted;
+        n->sorted = swap;
+    }
+
+    for (uint32_t i = 0; i + 1 < count;) {
+        uint32_t end = i + 1;
+        while (end < count && n->keys[end].hash >> 16 == n->keys[i].hash >> 16)
+            end++;
+
+        // insertion sort, since these runs are nearly always repeated
+        // entries.
+        for (uint32_t j = i + 1; j < end; ++j) {
+            struct normalize_key key = n->keys[j];
+            uint32_t k = j;
+            for (; k > i && normalize_compare_keys(&n->keys[k - 1], &key, n->entries) > 0; --k)
+                n->keys[k] = n->keys[k - 1];
+            n->keys[k] = key;
+        }
+
+        i = end;
+    }
+}
+
+// everything up to the ')' that closes `(:init`, as whole elements.
+static void
+normalize_init(struct normalizer *n)
+{
+    n->scratch_length = 0;
+    n->entry_count = 0;
+
+    for (;;) {
+        struct pddlp_token token = normalize_next_in_list(n);
+        if (token.token_type == PDDLP_TOKEN_RPAREN)
+            break;
+
+        uint32_t first = n->scratch_length;
+        normalize_scratch_item(n, token);
+
+        struct normalize_entry *entry = normalize_push_entry(n);
+        entry->text_first = first;
+        entry->length = n->scratch_length - first;
+    }
+
+    for (uint32_t i = 0; i < n->entry_count; ++i)
+        n->entries[i].text = n->scratch + n->entries[i].text_first;
+
+    normalize_order(n);
+
+    for (uint32_t i = 0; i < n->entry_count; ++i) {
+        const struct normalize_entry *entry = &n->entries[n->keys[i].entry];
+        if (i == 0 || normalize_compare_keys(&n->keys[i - 1], &n->keys[i], n->entries) != 0)
+            normalize_write(n, entry->text, entry->length);
+    }
+
+    normalize_write(n, ")", 1);
+}
+
+// everything up to the ')' that closes `(:objects`, regrouped by type.
+static void
+normalize_objects(struct normalizer *n)
+{
+    n->scratch_length = 0;
+    n->entry_count = 0;
+
+    uint32_t group_first = 0;
+
+    for (;;) {
+        struct pddlp_token token = normalize_next_in_list(n);
+        if (token.token_type == PDDLP_TOKEN_RPAREN)
+            break;
+
+        if (token.token_type == PDDLP_TOKEN_MINUS) {
+            uint32_t type_first = n->scratch_length;
+            normalize_scratch_item(n, normalize_next_in_list(n));
+
+            for (uint32_t i = group_first; i < n->entry_count; ++i) {
+                n->entries[i].type_first = type_first;
+                n->entries[i].type_length = n->scratch_length - type_first;
+            }
+
+            group_first = n->entry_count;
+            continue;
+        }
+
+        struct normalize_entry *entry = normalize_push_entry(n);
+        entry->text = token.start;
+        entry->length = token.length;
+    }
+
+    normalize_sort_entries(n);
+
+    for (uint32_t i = 0; i < n->entry_count; ++i) {
+        const struct normalize_entry *entry = &n->entries[i];
+        if (i > 0 && normalize_same_entry(&n->entries[i - 1], entry))
+            continue;
+
+        normalize_write(n, entry->text, entry->length);
+
+        const struct normalize_entry *next = i + 1 < n->entry_count ? &n->entries[i + 1] : NULL;
+        bool group_ends = next == NULL ||
+            normalize_compare_text(entry->type, entry->type_length, next->type, next->type_length) != 0;
+
+        if (group_ends && entry->type_length > 0) {
+            normalize_write(n, "-", 1);
+            normalize_write(n, entry->type, entry->type_length);
+        }
+    }
+
+    normalize_write(n, ")", 1);
+}
+
+// api
+
+static void
+normalize_run(struct normalizer *n)
+{
+    uint32_t depth = 0;
+    enum pddlp_token_type previous = PDDLP_TOKEN_EOF;
+
+    for (;;) {
+        struct pddlp_token token = normalize_next(n);
+        enum pddlp_token_type type = token.token_type;
+
+        if (type == PDDLP_TOKEN_EOF) {
+            if (depth > 0)
+                normalize_fail(n, "unexpected end of input", token.line, token.column);
+            break;
+        }
+
+        if (type == PDDLP_TOKEN_LPAREN) {
+            depth++;
+        } else if (type == PDDLP_TOKEN_RPAREN) {
+            if (depth == 0)
+                normalize_fail(n, "unbalanced ')'", token.line, token.column);
+            depth--;
+        }
+
+        normalize_write(n, token.start, token.length);
+
+        // sections are the lists right inside `(define`.
+        if (previous == PDDLP_TOKEN_LPAREN && depth == 2) {
+            if (type == PDDLP_TOKEN_SYM_INIT || type == PDDLP_TOKEN_SYM_OBJECTS) {
+                if (type == PDDLP_TOKEN_SYM_INIT)
+                    normalize_init(n);
+                else
+                    normalize_objects(n);
+
+                depth--;
+                type = PDDLP_TOKEN_RPAREN;
+            }
+        }
+
+        previous = type;
+    }
+
+    normalize_flush(n);
+}
+
+static void
+normalize_free(struct normalizer *n)
+{
+    mem_free(n->source);
+    mem_free(n->buffer);
+    array_free(n->scratch);
+    array_free(n->entries);
+    mem_free(n->keys);
+    mem_free(n->sorted);
+    mem_free(n->counts);
+}
+
+bool
+pddlp_normalize(const char *source, pddlp_write_fn write, void *context, struct pddlp_hash128 *hash,
+    struct pddlp_error *error)
+{
+    struct normalizer normalizer;
+    struct normalizer *n = &normalizer;
+    memset(n, 0, sizeof(*n));
+
+    n->error = error;
+    n->write = write;
+    n->context = context;
+    n->open = true;
+    hash_stream_init(&n->low, 0);
+    hash_stream_init(&n->high, XXH_PRIME64_1);
+
+    enum pddlp_subsystem previous = mem_enter(PDDLP_SUBSYSTEM_NORMALIZE);
+    size_t length = strlen(source);
+    n->source = mem_alloc(length + 1);
+    n->buffer = mem_alloc(NORMALIZE_BUFFER_SIZE);
+
+    if (setjmp(n->fail)) {
+        normalize_free(n);
+        mem_leave(previous);
+        return false;
+    }
+
+    if (n->source == NULL || n->buffer == NULL)
+        normalize_fail(n, "out of memory", 0, 0);
+
+    // names and keywords are matched case-insensitively by pddl, but the
+    // tokenizer only knows lowercase keywords.
+    for (size_t i = 0; i <= length; ++i) {
+        char c = source[i];
+        n->source[i] = c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : c;
+    }
+
+    pddlp_init_tokenizer(&n->tokenizer, n->source);
+    normalize_run(n);
+
+    hash->low = hash_stream_digest(&n->low);
+    hash->high = hash_stream_digest(&n->high);
+
+    normalize_free(n);
+    mem_leave(previous);
+    return true;
+}
@@ -0,0 +1,777 @@
+// SPDX-FileCopyrightText: 2024 Guilherme Puida Moreira <guilherme@puida.xyz>
+// SPDX-License-Identifier: BSD-3-Clause
+
+// numeric comparisons, effects and the metric of a grounded problem,
+// compiled into programs for a stack machine over ground fluents.
+
+#include "internal.h"
+
+#include <math.h>
+#include <setjmp.h>
+
+// what an expression compiled to: a constant, or the ops that push its value,
+// which are at the end of the program being built.
+struct numeric_value {
+    bool constant;
+    double value;
+};
+
+struct numeric_compiler {
+    const struct pddlp_strips *strips;
+    struct pddlp_error *error;
+    jmp_buf fail;
+
+    struct pddlp_numeric *numeric;
+
+    // fluents by function and arguments, constants by their bits, and
+    // programs by their ops, all in the order they were added.
+    struct atoms fluents;
+    struct atoms constants;
+    struct atoms programs;
+
+    // the program being built.
+    struct pddlp_numeric_op *code;
+    uint32_t code_count;
+
+    // what the expression being compiled is written in, and the objects its
+    // parameters stand for.
+    const struct pddlp_formulas *formulas;
+    uint32_t variable_first;
+    uint32_t param_count;
+    const uint32_t *params;
+
+    uint32_t *args;
+    uint32_t *key;
+};
+
+static void
+numeric_fail(struct numeric_compiler *c, const char *message)
+{
+    c->error->message = message;
+    c->error->line = 0;
+    c->error->column = 0;
+    longjmp(c->fail, 1);
+}
+
+static void *
+numeric_reserve(struct numeric_compiler *c, void *items, uint32_t needed, size_t item_size)
+{
+    void *result = array_reserve(items, needed, item_size);
+    if (result == NULL && needed > 0)
+        numeric_fail(c, "out of memory");
+
+    return result;
+}
+
+#define NUMERIC_PUSH(c, items, count) \
+    ((items) = numeric_reserve((c), (items), (count) + 1, sizeof(*(items))), &(items)[(count)++])
+
+// fluents and constants
+
+static uint32_t
+numeric_intern(struct numeric_compiler *c, struct atoms *table, uint32_t kind, const uint32_t *key, uint32_t count)
+{
+    uint32_t id = atoms_intern(table, kind, key, count);
+    if (id == PDDLP_NONE)
+        numeric_fail(c, "out of memory");
+
+    return id;
+}
+
+// the id of fluent `function` of `args`, with its initial value undefined
+// when it is new.
+static uint32_t
+numeric_fluent_id(struct numeric_compiler *c, uint32_t function, const uint32_t *args, uint32_t arity)
+{
+    struct pddlp_numeric *n = c->numeric;
+
+    uint32_t fluent = numeric_intern(c, &c->fluents, function, args, arity);
+    if (fluent == n->fluent_count)
+        *NUMERIC_PUSH(c, n->initial_values, n->fluent_count) = NAN;
+
+    return fluent;
+}
+
+static uint32_t
+numeric_constant(struct numeric_compiler *c, double value)
+{
+    struct pddlp_numeric *n = c->numeric;
+
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    uint32_t key[2] = { (uint32_t)bits, (uint32_t)(bits >> 32) };
+
+    uint32_t constant = numeric_intern(c, &c->constants, 0, key, 2);
+    if (constant == n->constant_count)
+        *NUMERIC_PUSH(c, n->constants, n->constant_count) = value;
+
+    return constant;
+}
+
+// the fluent a FUNCTION node stands for, with the parameters bound.
+static uint32_t
+numeric_fluent(struct numeric_compiler *c, uint32_t node)
+{
+    const struct pddlp_formulas *f = c->formulas;
+    const struct pddlp_node *n = &f->nodes[node];
+
+    if (n->node_type != PDDLP_NODE_FUNCTION)
+        numeric_fail(c, "numeric effects support only functions as targets");
+
+    for (uint32_t i = 0; i < n->count; ++i) {
+        const struct pddlp_node *term = &f->nodes[f->children[n->first + i]];
+
+        if (term->node_type == PDDLP_NODE_OBJECT)
+            c->args[i] = term->value;
+        else if (term->node_type == PDDLP_NODE_VARIABLE && term->value - c->variable_first < c->param_count)
+            c->args[i] = c->params[term->value - c->variable_first];
+        else
+            numeric_fail(c, "numeric expressions support only objects and parameters as terms");
+    }
+
+    return numeric_fluent_id(c, n->value, c->args, n->count);
+}
+
+// expressions
+
+static void
+numeric_emit(struct numeric_compiler *c, enum pddlp_numeric_code code, uint32_t operand)
+{
+    struct pddlp_numeric_op *op = NUMERIC_PUSH(c, c->code, c->code_count);
+    op->code = code;
+    op->operand = operand;
+}
+
+// pushes a constant that goes before the ops from `mark` on.
+static void
+numeric_emit_before(struct numeric_compiler *c, uint32_t mark, double value)
+{
+    numeric_emit(c, PDDLP_NUMERIC_CONSTANT, numeric_constant(c, value));
+
+    struct pddlp_numeric_op op = c->code[c->code_count - 1];
+    memmove(c->code + mark + 1, c->code + mark, sizeof(*c->code) * (c->code_count - 1 - mark));
+    c->code[mark] = op;
+}
+
+static double
+numeric_fold(enum pddlp_numeric_code code, double a, double b)
+{
+    switch (code) {
+    case PDDLP_NUMERIC_ADD:
+        return a + b;
+    case PDDLP_NUMERIC_SUBTRACT:
+        return a - b;
+    case PDDLP_NUMERIC_MULTIPLY:
+        return a * b;
+    case PDDLP_NUMERIC_DIVIDE:
+        return a / b;
+    case PDDLP_NUMERIC_LESS:
+        return a < b;
+    case PDDLP_NUMERIC_LESS_EQUAL:
+        return a <= b;
+    case PDDLP_NUMERIC_GREATER:
+        return a > b;
+    case PDDLP_NUMERIC_GREATER_EQUAL:
+        return a >= b;
+    case PDDLP_NUMERIC_EQUAL:
+        return a == b;
+    case PDDLP_NUMERIC_NOT_EQUAL:
+        return a != b;
+    default:
+        return NAN;
+    }
+}
+
+// combines `a`, whose ops start at `mark`, with `b`, whose ops follow them.
+static struct numeric_value
+numeric_binary(struct numeric_compiler *c, enum pddlp_numeric_code code, struct numeric_value a, uint32_t mark,
+    struct numeric_value b)
+{
+    if (a.constant && b.constant)
+        return (struct numeric_value) { true, numeric_fold(code, a.value, b.value) };
+
+    if (a.constant)
+        numeric_emit_before(c, mark, a.value);
+    if (b.constant)
+        numeric_emit(c, PDDLP_NUMERIC_CONSTANT, numeric_constant(c, b.value));
+
+    numeric_emit(c, code, 0);
+    return (struct numeric_value) { false, 0 };
+}
+
+// sums and products have their constants gathered into one that comes last,
+// and left out when it changes nothing. differences and quotients are
+// combined from left to right.
+static struct numeric_value
+numeric_expression(struct numeric_compiler *c, uint32_t node)
+{
+    const struct pddlp_formulas *f = c->formulas;
+    const struct pddlp_node *n = &f->nodes[node];
+
+    if (n->node_type == PDDLP_NODE_NUMBER)
+        return (struct numeric_value) { true, f->numbers[n->value] };
+
+    if (n->node_type == PDDLP_NODE_FUNCTION) {
+        numeric_emit(c, PDDLP_NUMERIC_FLUENT, numeric_fluent(c, node));
+        return (struct numeric_value) { false, 0 };
+    }
+
+    if (n->node_type != PDDLP_NODE_COMPOUND || n->count == 0)
+        numeric_fail(c, "numeric expressions support only numbers, functions and arithmetic");
+
+    enum pddlp_numeric_code code;
+    switch (n->op) {
+    case PDDLP_TOKEN_PLUS:
+        code = PDDLP_NUMERIC_ADD;
+        break;
+    case PDDLP_TOKEN_STAR:
+        code = PDDLP_NUMERIC_MULTIPLY;
+        break;
+    case PDDLP_TOKEN_MINUS:
+        code = PDDLP_NUMERIC_SUBTRACT;
+        break;
+    case PDDLP_TOKEN_SLASH:
+        code = PDDLP_NUMERIC_DIVIDE;
+        break;
+    default:
+        numeric_fail(c, "numeric expressions support only numbers, functions and arithmetic");
+        return (struct numeric_value) { true, 0 };
+    }
+
+    if (code == PDDLP_NUMERIC_ADD || code == PDDLP_NUMERIC_MULTIPLY) {
+        double identity = code == PDDLP_NUMERIC_ADD ? 0 : 1;
+        double constant = identity;
+        bool emitted = false;
+
+        for (uint32_t i = 0; i < n->count; ++i) {
+            struct numeric_value v = numeric_expression(c, f->children[n->first + i]);
+            if (v.constant)
+                constant = numeric_fold(code, constant, v.value);
+            else if (emitted)
+                numeric_emit(c, code, 0);
+            else
+                emitted = true;
+        }
+
+        if (!emitted)
+            return (struct numeric_value) { true, constant };
+
+        if (constant != identity || isnan(constant)) {
+            numeric_emit(c, PDDLP_NUMERIC_CONSTANT, numeric_constant(c, constant));
+            numeric_emit(c, code, 0);
+        }
+
+        return (struct numeric_value) { false, 0 };
+    }
+
+    uint32_t mark = c->code_count;
+    struct numeric_value a = numeric_expression(c, f->children[n->first]);
+
+    if (n->count == 1 && code == PDDLP_NUMERIC_SUBTRACT) {
+        if (a.constant)
+            return (struct numeric_value) { true, -a.value };
+
+        numeric_emit(c, PDDLP_NUMERIC_NEGATE, 0);
+        return a;
+    }
+
+    for (uint32_t i = 1; i < n->count; ++i) {
+        struct numeric_value b = numeric_expression(c, f->children[n->first + i]);
+        a = numeric_binary(c, code, a, mark, b);
+    }
+
+    return a;
+}
+
+// programs
+
+static uint32_t
+numeric_depth(const struct pddlp_numeric_op *code, uint32_t count)
+{
+    uint32_t depth = 0;
+    uint32_t max_depth = 0;
+
+    for (uint32_t i = 0; i < count; ++i) {
+        if (code[i].code == PDDLP_NUMERIC_CONSTANT || code[i].code == PDDLP_NUMERIC_FLUENT)
+            depth++;
+        else if (code[i].code != PDDLP_NUMERIC_NEGATE)
+            depth--;
+
+        if (depth > max_depth)
+            max_depth = depth;
+    }
+
+    return max_depth;
+}
+
+// turns the program being built, which leaves `value`, into a program,
+// sharing it with an identical one.
+static uint32_t
+numeric_program(struct numeric_compiler *c, struct numeric_value value)
+{
+    struct pddlp_numeric *n = c->numeric;
+
+    if (value.constant)
+        numeric_emit(c, PDDLP_NUMERIC_CONSTANT, numeric_constant(c, value.value));
+
+    c->key = numeric_reserve(c, c->key, c->code_count * 2, sizeof(*c->key));
+    for (uint32_t i = 0; i < c->code_count; ++i) {
+        c->key[2 * i] = c->code[i].code;
+        c->key[2 * i + 1] = c->code[i].operand;
+    }
+
+    uint32_t program = numeric_intern(c, &c->programs, 0, c->key, c->code_count * 2);
+    if (program == n->program_count) {
+        struct pddlp_numeric_program *p = NUMERIC_PUSH(c, n->programs, n->program_count);
+        p->first = n->op_count;
+        p->count = c->code_count;
+        p->depth = numeric_depth(c->code, c->code_count);
+
+        if (p->depth > n->depth)
+            n->depth = p->depth;
+
+        n->ops = numeric_reserve(c, n->ops, n->op_count + c->code_count, sizeof(*n->ops));
+        memcpy(n->ops + n->op_count, c->code, sizeof(*c->code) * c->code_count);
+        n->op_count += c->code_count;
+    }
+
+    c->code_count = 0;
+    return program;
+}
+
+static enum pddlp_numeric_code
+numeric_comparison(enum pddlp_token_type op, bool negated)
+{
+    switch (op) {
+    case PDDLP_TOKEN_LT:
+        return negated ? PDDLP_NUMERIC_GREATER_EQUAL : PDDLP_NUMERIC_LESS;
+    case PDDLP_TOKEN_LTE:
+        return negated ? PDDLP_NUMERIC_GREATER : PDDLP_NUMERIC_LESS_EQUAL;
+    case PDDLP_TOKEN_GT:
+        return negated ? PDDLP_NUMERIC_LESS_EQUAL : PDDLP_NUMERIC_GREATER;
+    case PDDLP_TOKEN_GTE:
+        return negated ? PDDLP_NUMERIC_LESS : PDDLP_NUMERIC_GREATER_EQUAL;
+    default:
+        return negated ? PDDLP_NUMERIC_NOT_EQUAL : PDDLP_NUMERIC_EQUAL;
+    }
+}
+
+// the comparisons of a precondition, which grounding accepted as a
+// conjunction of literals. comparisons that always hold are left out.
+static void
+numeric_conditions(struct numeric_compiler *c, uint32_t node, bool negated, uint32_t *condition_count)
+{
+    struct pddlp_numeric *nu = c->numeric;
+    const struct pddlp_formulas *f = c->formulas;
+    if (node == PDDLP_NONE)
+        return;
+
+    const struct pddlp_node *n = &f->nodes[node];
+    if (n->node_type != PDDLP_NODE_COMPOUND)
+        return;
+
+    if (n->op == PDDLP_TOKEN_AND || n->op == PDDLP_TOKEN_NOT) {
+        for (uint32_t i = 0; i < n->count; ++i)
+            numeric_conditions(c, f->children[n->first + i], negated != (n->op == PDDLP_TOKEN_NOT), condition_count);
+        return;
+    }
+
+    if (!formula_numeric_comparison(f, n))
+        return;
+
+    if (n->count != 2)
+        numeric_fail(c, "numeric comparisons support only two operands");
+
+    uint32_t mark = c->code_count;
+    struct numeric_value a = numeric_expression(c, f->children[n->first]);
+    struct numeric_value b = numeric_expression(c, f->children[n->first + 1]);
+    struct numeric_value v = numeric_binary(c, numeric_comparison(n->op, negated), a, mark, b);
+
+    if (v.constant && v.value != 0)
+        return;
+
+    *NUMERIC_PUSH(c, nu->conditions, *condition_count) = numeric_program(c, v);
+}
+
+static void
+numeric_effects(struct numeric_compiler *c, uint32_t node, uint32_t *effect_count)
+{
+    struct pddlp_numeric *nu = c->numeric;
+    const struct pddlp_formulas *f = c->formulas;
+    if (node == PDDLP_NONE)
+        return;
+
+    const struct pddlp_node *n = &f->nodes[node];
+    if (n->node_type != PDDLP_NODE_COMPOUND)
+        return;
+
+    switch (n->op) {
+    case PDDLP_TOKEN_AND:
+        for (uint32_t i = 0; i < n->count; ++i)
+            numeric_effects(c, f->children[n->first + i], effect_count);
+        return;
+    case PDDLP_TOKEN_ASSIGN:
+    case PDDLP_TOKEN_INCREASE:
+    case PDDLP_TOKEN_DECREASE:
+    case PDDLP_TOKEN_SCALE_UP:
+    case PDDLP_TOKEN_SCALE_DOWN: {
+        uint32_t fluent = numeric_fluent(c, f->children[n->first]);
+        uint32_t program = numeric_program(c, numeric_expression(c, f->children[n->first + 1]));
+
+        struct pddlp_numeric_effect *effect = NUMERIC_PUSH(c, nu->effects, *effect_count);
+        effect->op = n->op;
+        effect->fluent = fluent;
+        effect->program = program;
+        return;
+    }
+    case PDDLP_TOKEN_WHEN:
+    case PDDLP_TOKEN_FORALL:
+        numeric_fail(c, "numeric effects under when or forall are not supported");
+        return;
+    default:
+        return;
+    }
+}
+
+// whether the metric is only arithmetic over fluents, and not total-time or
+// preferences.
+static bool
+numeric_plain(const struct pddlp_formulas *f, uint32_t node)
+{
+    const struct pddlp_node *n = &f->nodes[node];
+    if (n->node_type != PDDLP_NODE_COMPOUND)
+        return true;
+
+    if (n->op != PDDLP_TOKEN_PLUS && n->op != PDDLP_TOKEN_MINUS && n->op != PDDLP_TOKEN_STAR &&
+        n->op != PDDLP_TOKEN_SLASH)
+        return false;
+
+    for (uint32_t i = 0; i < n->count; ++i)
+        if (!numeric_plain(f, f->children[n->first + i]))
+            return false;
+
+    return true;
+}
+
+static size_t
+numeric_memory(const struct pddlp_numeric *n)
+{
+    return sizeof(*n) +
+        (size_t)array_capacity(n->fluent_functions) * sizeof(*n->fluent_functions) +
+        (size_t)array_capacity(n->fluent_args_first) * sizeof(*n->fluent_args_first) +
+        (size_t)array_capacity(n->fluent_args) * sizeof(*n->fluent_args) +
+        (size_t)array_capacity(n->initial_values) * sizeof(*n->initial_values) +
+        (size_t)array_capacity(n->ops) * sizeof(*n->ops) +
+        (size_t)array_capacity(n->constants) * sizeof(*n->constants) +
+        (size_t)array_capacity(n->programs) * sizeof(*n->programs) +
+        (size_t)array_capacity(n->condition_first) * sizeof(*n->condition_first) +
+        (size_t)array_capacity(n->conditions) * sizeof(*n->conditions) +
+        (size_t)array_capacity(n->effect_first) * sizeof(*n->effect_first) +
+        (size_t)array_capacity(n->effects) * sizeof(*n->effects);
+}
+
+static void
+numeric_compile(struct numeric_compiler *c)
+{
+    struct pddlp_numeric *nu = c->numeric;
+    const struct pddlp_strips *strips = c->strips;
+    const struct pddlp_problem *pr = strips->problem;
+    const struct pddlp_domain *d = pr->domain;
+
+    uint32_t max_arity = 1;
+    for (uint32_t i = 0; i < d->function_count; ++i)
+        if (d->functions[i].param_count > max_arity)
+            max_arity = d->functions[i].param_count;
+    c->args = numeric_reserve(c, NULL, max_arity, sizeof(*c->args));
+
+    // the fluents of :init come first. a fluent given twice keeps the last
+    // value.
+    for (uint32_t i = 0; i < pr->fluent_count; ++i) {
+        uint32_t function = pr->fluent_functions[i];
+        uint32_t fluent = numeric_fluent_id(c, function, pr->fact_args + pr->fluent_args_first[i],
+            d->functions[function].param_count);
+        nu->initial_values[fluent] = pr->fluent_values[i];
+    }
+
+    nu->condition_first = numeric_reserve(c, NULL, strips->operator_count + 1, sizeof(*nu->condition_first));
+    nu->effect_first = numeric_reserve(c, NULL, strips->operator_count + 1, sizeof(*nu->effect_first));
+
+    uint32_t condition_count = 0;
+    uint32_t effect_count = 0;
+    c->formulas = &d->formulas;
+
+    for (uint32_t o = 0; o < strips->operator_count; ++o) {
+        const struct pddlp_operator *op = &strips->operators[o];
+        const struct pddlp_action *action = &d->actions[op->action];
+
+        c->variable_first = action->variable_first;
+        c->param_count = action->param_count;
+        c->params = strips->operator_args + op->args;
+
+        nu->condition_first[o] = condition_count;
+        numeric_conditions(c, action->precondition, false, &condition_count);
+        nu->effect_first[o] = effect_count;
+        numeric_effects(c, action->effect, &effect_count);
+    }
+
+    nu->condition_first[strips->operator_count] = condition_count;
+    nu->effect_first[strips->operator_count] = effect_count;
+
+    nu->metric = PDDLP_NONE;
+    if (pr->metric != PDDLP_NONE && numeric_plain(&pr->formulas, pr->metric)) {
+        c->formulas = &pr->formulas;
+        c->param_count = 0;
+        nu->metric = numeric_program(c, numeric_expression(c, pr->metric));
+    }
+
+    // the fluents, out of the table.
+    nu->fluent_functions = numeric_reserve(c, NULL, nu->fluent_count, sizeof(*nu->fluent_functions));
+    nu->fluent_args_first = numeric_reserve(c, NULL, nu->fluent_count, sizeof(*nu->fluent_args_first));
+    nu->fluent_args = numeric_reserve(c, NULL, c->fluents.key_count - nu->fluent_count, sizeof(*nu->fluent_args));
+
+    uint32_t arg_count = 0;
+    for (uint32_t i = 0; i < nu->fluent_count; ++i) {
+        const uint32_t *key = c->fluents.keys + c->fluents.starts[i];
+        uint32_t arity = atoms_arity(&c->fluents, i);
+
+        nu->fluent_functions[i] = key[0];
+        nu->fluent_args_first[i] = arg_count;
+        if (arity > 0)
+            memcpy(nu->fluent_args + arg_count, key + 1, sizeof(*key) * arity);
+        arg_count += arity;
+    }
+
+    nu->memory = numeric_memory(nu);
+}
+
+static void
+numeric_free_compiler(struct numeric_compiler *c)
+{
+    atoms_free(&c->fluents);
+    atoms_free(&c->constants);
+    atoms_free(&c->programs);
+    array_free(c->code);
+    array_free(c->args);
+    array_free(c->key);
+}
+
+struct pddlp_numeric *
+pddlp_compile_numeric(const struct pddlp_strips *strips, struct pddlp_error *error)
+{
+    struct numeric_compiler compiler;
+    struct numeric_compiler *c = &compiler;
+    memset(c, 0, sizeof(*c));
+    c->strips = strips;
+    c->error = error;
+
+    enum pddlp_subsystem previous = mem_enter(PDDLP_SUBSYSTEM_NUMERIC);
+    c->numeric = mem_alloc(sizeof(*c->numeric));
+    if (c->numeric == NULL) {
+        mem_leave(previous);
+        error->message = "out of memory";
+        error->line = 0;
+        error->column = 0;
+        return NULL;
+    }
+
+    memset(c->numeric, 0, sizeof(*c->numeric));
+    c->numeric->strips = strips;
+
+    if (setjmp(c->fail)) {
+        pddlp_free_numeric(c->numeric);
+        numeric_free_compiler(c);
+        mem_leave(previous);
+        return NULL;
+    }
+
+    numeric_compile(c);
+    numeric_free_compiler(c);
+    mem_leave(previous);
+
+    return c->numeric;
+}
+
+void
+pddlp_free_numeric(struct pddlp_numeric *n)
+{
+    if (n == NULL)
+        return;
+
+    array_free(n->fluent_functions);
+    array_free(n->fluent_args_first);
+    array_free(n->fluent_args);
+    array_free(n->initial_values);
+    array_free(n->ops);
+    array_free(n->constants);
+    array_free(n->programs);
+    array_free(n->condition_first);
+    array_free(n->conditions);
+    array_free(n->effect_first);
+    array_free(n->effects);
+    mem_free(n);
+}
+
+// evaluation
+
+double
+pddlp_evaluate(const struct pddlp_numeric *n, uint32_t program, const double *values, double *stack)
+{
+    const struct pddlp_numeric_program *p = &n->programs[program];
+    const struct pddlp_numeric_op *op = n->ops + p->first;
+    const struct pddlp_numeric_op *end = op + p->count;
+    double *top = stack;
+
+    // `top` is one past the top of the stack.
+    for (; op < end; ++op) {
+        switch (op->code) {
+        case PDDLP_NUMERIC_CONSTANT:
+            *top++ = n->constants[op->operand];
+            break;
+        case PDDLP_NUMERIC_FLUENT:
+            *top++ = values[op->operand];
+            break;
+        case PDDLP_NUMERIC_NEGATE:
+            top[-1] = -top[-1];
+            break;
+        default:
+            top--;
+            top[-1] = numeric_fold(op->code, top[-1], top[0]);
+            break;
+        }
+    }
+
+    return stack[0];
+}
+
+// a[j] = a[j] `code` b[j] for each of the `width` lanes. a loop for each
+// code, so each can be vectorized.
+static void
+numeric_lanes(enum pddlp_numeric_code code, double *restrict a, const double *restrict b, uint32_t width)
+{
+    switch (code) {
+    case PDDLP_NUMERIC_ADD:
+        for (uint32_t j = 0; j < width; ++j)
+            a[j] = a[j] + b[j];
+        break;
+    case PDDLP_NUMERIC_SUBTRACT:
+        for (uint32_t j = 0; j < width; ++j)
+            a[j] = a[j] - b[j];
+        break;
+    case PDDLP_NUMERIC_MULTIPLY:
+        for (uint32_t j = 0; j < width; ++j)
+            a[j] = a[j] * b[j];
+        break;
+    case PDDLP_NUMERIC_DIVIDE:
+        for (uint32_t j = 0; j < width; ++j)
+            a[j] = a[j] / b[j];
+        break;
+    case PDDLP_NUMERIC_LESS:
+        for (uint32_t j = 0; j < width; ++j)
+            a[j] = a[j] < b[j];
+        break;
+    case PDDLP_NUMERIC_LESS_EQUAL:
+        for (uint32_t j = 0; j < width; ++j)
+            a[j] = a[j] <= b[j];
+        break;
+    case PDDLP_NUMERIC_GREATER:
+        for (uint32_t j = 0; j < width; ++j)
+            a[j] = a[j] > b[j];
+        break;
+    case PDDLP_NUMERIC_GREATER_EQUAL:
+        for (uint32_t j = 0; j < width; ++j)
+            a[j] = a[j] >= b[j];
+        break;
+    case PDDLP_NUMERIC_EQUAL:
+        for (uint32_t j = 0; j < width; ++j)
+            a[j] = a[j] == b[j];
+        break;
+    case PDDLP_NUMERIC_NOT_EQUAL:
+        for (uint32_t j = 0; j < width; ++j)
+            a[j] = a[j] != b[j];
+        break;
+    default:
+        break;
+    }
+}
+
+void
+pddlp_evaluate_batch(const struct pddlp_numeric *n, uint32_t program, const double *values, size_t stride,
+    uint32_t count, double *results, double *stack)
+{
+    const struct pddlp_numeric_program *p = &n->programs[program];
+    const struct pddlp_numeric_op *ops = n->ops + p->first;
+
+    // each slot of the stack is a row of PDDLP_NUMERIC_LANES values, one for
+    // each state of the block.
+    for (uint32_t start = 0; start < count; start += PDDLP_NUMERIC_LANES) {
+        uint32_t width = count - start < PDDLP_NUMERIC_LANES ? count - start : PDDLP_NUMERIC_LANES;
+        double *top = stack;
+
+        for (uint32_t i = 0; i < p->count; ++i) {
+            const struct pddlp_numeric_op *op = &ops[i];
+
+            switch (op->code) {
+            case PDDLP_NUMERIC_CONSTANT:
+                for (uint32_t j = 0; j < width; ++j)
+                    top[j] = n->constants[op->operand];
+                top += PDDLP_NUMERIC_LANES;
+                break;
+            case PDDLP_NUMERIC_FLUENT:
+                memcpy(top, values + op->operand * stride + start, sizeof(*top) * width);
+                top += PDDLP_NUMERIC_LANES;
+                break;
+            case PDDLP_NUMERIC_NEGATE: {
+                double *a = top - PDDLP_NUMERIC_LANES;
+                for (uint32_t j = 0; j < width; ++j)
+                    a[j] = -a[j];
+                break;
+            }
+            default:
+                top -= PDDLP_NUMERIC_LANES;
+                numeric_lanes(op->code, top - PDDLP_NUMERIC_LANES, top, width);
+                break;
+            }
+        }
+
+        memcpy(results + start, stack, sizeof(*results) * width);
+    }
+}
+
+bool
+pddlp_numeric_applicable(const struct pddlp_numeric *n, uint32_t op, const double *values, double *stack)
+{
+    for (uint32_t i = n->condition_first[op]; i < n->condition_first[op + 1]; ++i)
+        if (pddlp_evaluate(n, n->conditions[i], values, stack) == 0)
+            return false;
+
+    return true;
+}
+
+void
+pddlp_numeric_apply(const struct pddlp_numeric *n, uint32_t op, const double *values, double *next, double *stack)
+{
+    for (uint32_t i = n->effect_first[op]; i < n->effect_first[op + 1]; ++i) {
+        const struct pddlp_numeric_effect *e = &n->effects[i];
+        double value = pddlp_evaluate(n, e->program, values, stack);
+        double current = values[e->fluent];
+
+        switch (e->op) {
+        case PDDLP_TOKEN_INCREASE:
+            value = current + value;
+            break;
+        case PDDLP_TOKEN_DECREASE:
+            value = current - value;
+            break;
+        case PDDLP_TOKEN_SCALE_UP:
+            value = current * value;
+            break;
+        case PDDLP_TOKEN_SCALE_DOWN:
+            value = current / value;
+            break;
+        default:
+            break;
+        }
+
+        next[e->fluent] = value;
+    }
+}
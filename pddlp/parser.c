@@ -0,0 +1,2295 @@
+// SPDX-FileCopyrightText: 2024 Guilherme Puida Moreira <guilherme@puida.xyz>
+// SPDX-License-Identifier: BSD-3-Clause
+
+// needed for sysconf.
+#define _POSIX_C_SOURCE 200809L
+
+#include "internal.h"
+
+#include <pthread.h>
+#include <setjmp.h>
+#include <unistd.h>
+
+struct parser {
+    struct pddlp_tokenizer tokenizer;
+    const char *source;
+    struct pddlp_error *error;
+    jmp_buf fail;
+
+    struct domain *domain;
+    struct problem *problem;    // NULL while parsing a domain.
+    struct arena *arena;
+
+    // storage of whatever is being parsed.
+    struct pddlp_formulas *formulas;
+    struct pddlp_typed_name **variables;
+    uint32_t *variable_count;
+    uint32_t **type_refs;
+    uint32_t *type_ref_count;
+
+    // variables visible from the formula being parsed.
+    uint32_t *scope;
+    uint32_t scope_count;
+
+    // children of the compound nodes being parsed.
+    uint32_t *stack;
+    uint32_t stack_count;
+
+    // the nodes of `formulas` by content, node + 1 or 0 when empty.
+    uint32_t *node_slots;
+    uint32_t node_capacity;
+
+    // the constructs accepted, a set of parse_feature, and the expression
+    // parser instantiated for them.
+    uint32_t features;
+    uint32_t (*expression)(struct parser *);
+
+    // set while parsing an effect, where `not` deletes rather than negates.
+    bool effect;
+
+    // threads for :init, where 0 is one per CPU. chunked is set on the
+    // parsers of its chunks.
+    unsigned threads;
+    bool chunked;
+
+    // entries of the last typed list.
+    struct pddlp_typed_name *typed;
+    struct pddlp_token *typed_tokens;
+    uint32_t typed_count;
+};
+
+// what a chunk of :init jumps to p->fail with when it has to be parsed
+// sequentially instead. errors jump with 1.
+#define PARSE_SEQUENTIAL 2
+
+static void
+parse_fail(struct parser *p, struct pddlp_token token, const char *message)
+{
+    // whatever was expected, running out of input is the actual problem.
+    if (token.token_type == PDDLP_TOKEN_EOF)
+        message = "unexpected end of input";
+
+    p->error->message = message;
+    p->error->line = token.line;
+    p->error->column = token.column;
+    longjmp(p->fail, 1);
+}
+
+static void
+parse_fail_memory(struct parser *p)
+{
+    p->error->message = "out of memory";
+    p->error->line = p->tokenizer.line;
+    p->error->column = p->tokenizer.column;
+    longjmp(p->fail, 1);
+}
+
+static void *
+parse_reserve(struct parser *p, void *items, uint32_t needed, size_t item_size)
+{
+    void *result = array_reserve(items, needed, item_size);
+    if (result == NULL && needed > 0)
+        parse_fail_memory(p);
+
+    return result;
+}
+
+// appends an item to a growable array, and evaluates to a pointer to it.
+#define PUSH(p, items, count) \
+    ((items) = parse_reserve((p), (items), (count) + 1, sizeof(*(items))), &(items)[(count)++])
+
+static struct pddlp_token
+parse_next(struct parser *p)
+{
+    struct pddlp_token token = pddlp_next_token(&p->tokenizer);
+    if (token.token_type == PDDLP_TOKEN_ERROR) {
+        // error tokens carry their message instead of their text.
+        p->error->message = token.start;
+        p->error->line = token.line;
+        p->error->column = token.column;
+        longjmp(p->fail, 1);
+    }
+
+    return token;
+}
+
+static enum pddlp_token_type
+parse_peek(struct parser *p, unsigned k)
+{
+    return pddlp_peek_token(&p->tokenizer, k).token_type;
+}
+
+static struct pddlp_token
+parse_expect(struct parser *p, enum pddlp_token_type token_type, const char *message)
+{
+    struct pddlp_token token = parse_next(p);
+    if (token.token_type != token_type)
+        parse_fail(p, token, message);
+
+    return token;
+}
+
+// keywords are valid names outside of the places where they have meaning,
+// like the `at` predicate of most logistics domains.
+static bool
+parse_is_name(enum pddlp_token_type token_type)
+{
+    return token_type == PDDLP_TOKEN_NAME ||
+        (token_type >= PDDLP_TOKEN_ALL && token_type <= PDDLP_TOKEN_WITHIN);
+}
+
+static struct pddlp_token
+parse_expect_name(struct parser *p)
+{
+    struct pddlp_token token = parse_next(p);
+    if (!parse_is_name(token.token_type))
+        parse_fail(p, token, "expected a name");
+
+    return token;
+}
+
+static const char *
+parse_intern(struct parser *p, struct pddlp_token token)
+{
+    const char *result = arena_strndup(p->arena, token.start, token.length);
+    if (result == NULL)
+        parse_fail_memory(p);
+
+    return result;
+}
+
+static void
+parse_insert(struct parser *p, struct symbols *symbols, const char *name, uint32_t value)
+{
+    if (!symbols_insert(symbols, name, strlen(name), value))
+        parse_fail_memory(p);
+}
+
+static void *
+parse_calloc(struct parser *p, size_t count, size_t size)
+{
+    if (count == 0)
+        count = 1;
+
+    if (count > SIZE_MAX / size)
+        parse_fail_memory(p);
+
+    void *result = mem_alloc(count * size);
+    if (result == NULL)
+        parse_fail_memory(p);
+
+    memset(result, 0, count * size);
+    return result;
+}
+
+// skips the rest of a list whose '(' was already consumed.
+static void
+parse_skip_list(struct parser *p)
+{
+    for (int depth = 1; depth > 0;) {
+        struct pddlp_token token = parse_next(p);
+        if (token.token_type == PDDLP_TOKEN_LPAREN)
+            depth++;
+        else if (token.token_type == PDDLP_TOKEN_RPAREN)
+            depth--;
+        else if (token.token_type == PDDLP_TOKEN_EOF)
+            parse_fail(p, token, NULL);
+    }
+}
+
+static double
+parse_number(struct pddlp_token token)
+{
+    double value = 0;
+    uint32_t i = 0;
+
+    for (; i < token.length && token.start[i] != '.'; ++i)
+        value = value * 10 + (token.start[i] - '0');
+
+    double scale = 0.1;
+    for (i++; i < token.length; ++i, scale /= 10)
+        value += (token.start[i] - '0') * scale;
+
+    return value;
+}
+
+// types
+
+static uint32_t
+parse_type(struct parser *p, struct pddlp_token token, bool declare)
+{
+    struct domain *d = p->domain;
+    uint32_t type = symbols_find(&d->type_symbols, token.start, token.length);
+
+    if (type != PDDLP_NONE)
+        return type;
+
+    if (!declare)
+        parse_fail(p, token, "undeclared type");
+
+    type = d->base.type_count;
+
+    struct pddlp_typed_name *entry = PUSH(p, d->base.types, d->base.type_count);
+    entry->name = parse_intern(p, token);
+    entry->type_first = 0;
+    entry->type_count = 0;
+
+    parse_insert(p, &d->type_symbols, entry->name, type);
+    return type;
+}
+
+// parses what follows a '-' in a typed list, either a type or
+// `(either type...)`, into the type_refs of the owner.
+static void
+parse_type_refs(struct parser *p, bool declare, uint32_t *first, uint32_t *count)
+{
+    struct pddlp_token token = parse_next(p);
+
+    *first = *p->type_ref_count;
+
+    if (token.token_type == PDDLP_TOKEN_LPAREN) {
+        parse_expect(p, PDDLP_TOKEN_EITHER, "expected either");
+
+        while (parse_peek(p, 0) != PDDLP_TOKEN_RPAREN)
+            *PUSH(p, *p->type_refs, *p->type_ref_count) = parse_type(p, parse_expect_name(p), declare);
+
+        parse_next(p);
+    } else if (parse_is_name(token.token_type)) {
+        *PUSH(p, *p->type_refs, *p->type_ref_count) = parse_type(p, token, declare);
+    } else {
+        parse_fail(p, token, "expected a type");
+    }
+
+    *count = *p->type_ref_count - *first;
+    if (*count == 0)
+        parse_fail(p, token, "expected a type");
+}
+
+// parses `a b - t c - (either t u) d)` into p->typed, consuming the closing
+// paren. entries without a type are objects.
+static void
+parse_typed_list(struct parser *p, bool variables, bool declare)
+{
+    uint32_t pending = 0;
+    p->typed_count = 0;
+
+    for (;;) {
+        struct pddlp_token token = parse_next(p);
+
+        if (token.token_type == PDDLP_TOKEN_RPAREN)
+            break;
+
+        if (token.token_type == PDDLP_TOKEN_MINUS) {
+            if (pending == p->typed_count)
+                parse_fail(p, token, "expected a name before '-'");
+
+            uint32_t first, count;
+            parse_type_refs(p, declare, &first, &count);
+
+            for (uint32_t i = pending; i < p->typed_count; ++i) {
+                p->typed[i].type_first = first;
+                p->typed[i].type_count = count;
+            }
+
+            pending = p->typed_count;
+            continue;
+        }
+
+        if (variables ? token.token_type != PDDLP_TOKEN_VARIABLE : !parse_is_name(token.token_type))
+            parse_fail(p, token, variables ? "expected a variable" : "expected a name");
+
+        struct pddlp_typed_name *entry = PUSH(p, p->typed, p->typed_count);
+        entry->name = parse_intern(p, token);
+        p->typed_tokens = parse_reserve(p, p->typed_tokens, p->typed_count, sizeof(*p->typed_tokens));
+        p->typed_tokens[p->typed_count - 1] = token;
+    }
+
+    if (pending < p->typed_count) {
+        uint32_t first = *p->type_ref_count;
+        *PUSH(p, *p->type_refs, *p->type_ref_count) = 0;
+
+        for (uint32_t i = pending; i < p->typed_count; ++i) {
+            p->typed[i].type_first = first;
+            p->typed[i].type_count = 1;
+        }
+    }
+}
+
+// pushes the entries of the last typed list as variables, and makes them
+// visible to the formulas parsed next.
+static uint32_t
+parse_push_variables(struct parser *p)
+{
+    uint32_t first = *p->variable_count;
+
+    for (uint32_t i = 0; i < p->typed_count; ++i) {
+        *PUSH(p, *p->variables, *p->variable_count) = p->typed[i];
+        *PUSH(p, p->scope, p->scope_count) = first + i;
+    }
+
+    return first;
+}
+
+static uint32_t
+parse_find_variable(struct parser *p, struct pddlp_token token)
+{
+    for (uint32_t i = p->scope_count; i-- > 0;) {
+        const char *name = (*p->variables)[p->scope[i]].name;
+        if (strncmp(name, token.start, token.length) == 0 && name[token.length] == 0)
+            return p->scope[i];
+    }
+
+    parse_fail(p, token, "undeclared variable");
+    return PDDLP_NONE;
+}
+
+static uint32_t
+parse_find_object(struct parser *p, struct pddlp_token token)
+{
+    uint32_t hash = hash_name(token.start, token.length);
+    uint32_t object = PDDLP_NONE;
+
+    if (p->problem)
+        object = symbols_find_hashed(&p->problem->object_symbols, token.start, token.length, hash);
+
+    if (object == PDDLP_NONE)
+        object = symbols_find_hashed(&p->domain->constant_symbols, token.start, token.length, hash);
+
+    if (object == PDDLP_NONE)
+        parse_fail(p, token, p->problem ? "undeclared object" : "undeclared constant");
+
+    return object;
+}
+
+// formulas
+
+// nodes are hash-consed: a node with the same type, operator, value and
+// children as one already built is that node, so repeated subformulas are
+// stored once and compare equal by id. numbers compare by value, and the
+// variables of each quantifier, and the names of preferences, are distinct
+// anyway.
+static uint32_t
+parse_node_hash(
+    const struct pddlp_formulas *f,
+    enum pddlp_node_type node_type,
+    enum pddlp_token_type op,
+    uint32_t value,
+    const uint32_t *children,
+    uint32_t count)
+{
+    uint64_t h = (uint64_t)node_type << 40 ^ (uint64_t)op << 32 ^ value;
+    if (node_type == PDDLP_NODE_NUMBER)
+        memcpy(&h, &f->numbers[value], sizeof(h));
+
+    // nodes have few children, so a multiply per child beats hash64.
+    h *= XXH_PRIME64_1;
+    for (uint32_t i = 0; i < count; ++i)
+        h = (h ^ children[i]) * XXH_PRIME64_1;
+
+    return (uint32_t)(h ^ h >> 29 ^ h >> 47);
+}
+
+static bool
+parse_node_equal(
+    const struct pddlp_formulas *f,
+    uint32_t node,
+    enum pddlp_node_type node_type,
+    enum pddlp_token_type op,
+    uint32_t value,
+    const uint32_t *children,
+    uint32_t count)
+{
+    const struct pddlp_node *n = &f->nodes[node];
+    if (n->node_type != node_type || n->op != op || n->count != count)
+        return false;
+
+    if (node_type == PDDLP_NODE_NUMBER) {
+        if (memcmp(&f->numbers[n->value], &f->numbers[value], sizeof(*f->numbers)) != 0)
+            return false;
+    } else if (n->value != value) {
+        return false;
+    }
+
+    return count == 0 || memcmp(f->children + n->first, children, sizeof(*children) * count) == 0;
+}
+
+static void
+parse_grow_nodes(struct parser *p)
+{
+    const struct pddlp_formulas *f = p->formulas;
+    uint64_t capacity = p->node_capacity ? (uint64_t)p->node_capacity * 2 : 64;
+    if (capacity > UINT32_MAX)
+        parse_fail_memory(p);
+
+    uint32_t *slots = mem_alloc(sizeof(*slots) * capacity);
+    if (slots == NULL)
+        parse_fail_memory(p);
+
+    memset(slots, 0, sizeof(*slots) * capacity);
+
+    uint32_t mask = capacity - 1;
+    for (uint32_t node = 0; node < f->node_count; ++node) {
+        const struct pddlp_node *n = &f->nodes[node];
+        uint32_t i = parse_node_hash(f, n->node_type, n->op, n->value, f->children + n->first, n->count) & mask;
+        while (slots[i])
+            i = (i + 1) & mask;
+        slots[i] = node + 1;
+    }
+
+    mem_free(p->node_slots);
+    p->node_slots = slots;
+    p->node_capacity = capacity;
+}
+
+static uint32_t
+parse_add_node(
+    struct parser *p,
+    enum pddlp_node_type node_type,
+    enum pddlp_token_type op,
+    uint32_t value,
+    uint32_t stack_base)
+{
+    struct pddlp_formulas *f = p->formulas;
+    const uint32_t *children = p->stack + stack_base;
+    uint32_t count = p->stack_count - stack_base;
+
+    if ((uint64_t)(f->node_count + 1) * 2 > p->node_capacity)
+        parse_grow_nodes(p);
+
+    uint32_t mask = p->node_capacity - 1;
+    uint32_t i = parse_node_hash(f, node_type, op, value, children, count) & mask;
+    for (; p->node_slots[i]; i = (i + 1) & mask) {
+        uint32_t node = p->node_slots[i] - 1;
+        if (parse_node_equal(f, node, node_type, op, value, children, count)) {
+            p->stack_count = stack_base;
+            return node;
+        }
+    }
+
+    uint32_t node = f->node_count;
+    p->node_slots[i] = node + 1;
+
+    struct pddlp_node *entry = PUSH(p, f->nodes, f->node_count);
+    entry->node_type = node_type;
+    entry->op = op;
+    entry->value = value;
+    entry->first = f->child_count;
+    entry->count = count;
+
+    if (count > 0) {
+        f->children = parse_reserve(p, f->children, f->child_count + count, sizeof(*f->children));
+        memcpy(f->children + f->child_count, p->stack + stack_base, sizeof(*p->stack) * count);
+        f->child_count += count;
+    }
+
+    p->stack_count = stack_base;
+    return node;
+}
+
+static uint32_t
+parse_add_number(struct parser *p, struct pddlp_token token)
+{
+    struct pddlp_formulas *f = p->formulas;
+    uint32_t index = f->number_count;
+
+    *PUSH(p, f->numbers, f->number_count) = parse_number(token);
+    uint32_t node = parse_add_node(p, PDDLP_NODE_NUMBER, PDDLP_TOKEN_NUMBER, index, p->stack_count);
+
+    // the same number again keeps the first copy.
+    if (f->nodes[node].value != index)
+        f->number_count = index;
+
+    return node;
+}
+
+static uint32_t
+parse_add_name(struct parser *p, struct pddlp_token token)
+{
+    struct pddlp_formulas *f = p->formulas;
+    uint32_t index = f->name_count;
+
+    *PUSH(p, f->names, f->name_count) = parse_intern(p, token);
+    return index;
+}
+
+// constructs beyond strips, by the requirements that allow them. a strict
+// parse only accepts the ones its :requirements enable, and the others
+// accept everything.
+enum parse_feature {
+    PARSE_ADL = 1 << 0,         // or, imply, when, forall, exists
+    PARSE_NUMERIC = 1 << 1,     // functions, numbers, comparisons, arithmetic, :metric
+    PARSE_TEMPORAL = 1 << 2,    // durative actions, at start/end, over all, timed literals
+    PARSE_PREFERENCES = 1 << 3,
+    PARSE_CONSTRAINTS = 1 << 4,
+    PARSE_DERIVED = 1 << 5,
+    PARSE_NEGATION = 1 << 6,    // not in conditions, since delete effects are strips
+    PARSE_EQUALITY = 1 << 7,    // = between objects
+    PARSE_LITERALS = PARSE_NEGATION | PARSE_EQUALITY,
+    PARSE_ALL = (1 << 8) - 1,
+};
+
+static uint32_t
+parse_features(uint64_t requirements)
+{
+    static const struct {
+        enum pddlp_token_type requirement;
+        uint32_t features;
+    } table[] = {
+        { PDDLP_TOKEN_SYM_ADL, PARSE_ADL | PARSE_LITERALS },
+        { PDDLP_TOKEN_SYM_NEGATIVE_PRECONDITIONS, PARSE_NEGATION },
+        { PDDLP_TOKEN_SYM_EQUALITY, PARSE_EQUALITY },
+        { PDDLP_TOKEN_SYM_CONDITIONAL_EFFECTS, PARSE_ADL },
+        { PDDLP_TOKEN_SYM_DISJUNCTIVE_PRECONDITIONS, PARSE_ADL },
+        { PDDLP_TOKEN_SYM_EXISTENTIAL_PRECONDITIONS, PARSE_ADL },
+        { PDDLP_TOKEN_SYM_UNIVERSAL_PRECONDITIONS, PARSE_ADL },
+        { PDDLP_TOKEN_SYM_QUANTIFIED_PRECONDITIONS, PARSE_ADL },
+        { PDDLP_TOKEN_SYM_NUMERIC_FLUENTS, PARSE_NUMERIC },
+        { PDDLP_TOKEN_SYM_FLUENTS, PARSE_NUMERIC },
+        { PDDLP_TOKEN_SYM_ACTION_COSTS, PARSE_NUMERIC },
+        { PDDLP_TOKEN_SYM_DURATIVE_ACTIONS, PARSE_TEMPORAL | PARSE_NUMERIC },
+        { PDDLP_TOKEN_SYM_DURATION_INEQUALITIES, PARSE_TEMPORAL | PARSE_NUMERIC },
+        { PDDLP_TOKEN_SYM_CONTINUOUS_EFFECTS, PARSE_TEMPORAL | PARSE_NUMERIC },
+        { PDDLP_TOKEN_SYM_TIMED_INITIAL_LITERALS, PARSE_TEMPORAL | PARSE_NUMERIC },
+        { PDDLP_TOKEN_SYM_PREFERENCES, PARSE_PREFERENCES | PARSE_NUMERIC },
+        { PDDLP_TOKEN_SYM_CONSTRAINTS, PARSE_CONSTRAINTS | PARSE_NUMERIC },
+        { PDDLP_TOKEN_SYM_DERIVED_PREDICATES, PARSE_DERIVED },
+        { PDDLP_TOKEN_SYM_DOMAIN_AXIOMS, PARSE_DERIVED },
+    };
+
+    uint32_t features = 0;
+    for (size_t i = 0; i < sizeof(table) / sizeof(*table); ++i)
+        if (requirements & PDDLP_REQUIREMENT(table[i].requirement))
+            features |= table[i].features;
+
+    return features;
+}
+
+static void
+parse_require(struct parser *p, uint32_t features, uint32_t feature, struct pddlp_token token)
+{
+    if ((features & feature) == 0)
+        parse_fail(p, token, "not enabled by the :requirements");
+}
+
+// the expression and :init parsers are written once over a set of
+// features, and instantiated for the common sets with the set known at
+// compile time, so what it leaves out drops out of the hot loop. the
+// instances recurse into themselves through `expression`.
+#ifdef __GNUC__
+#define PARSE_SPECIALIZED static inline __attribute__((always_inline))
+#else
+#define PARSE_SPECIALIZED static inline
+#endif
+
+typedef uint32_t (*parse_expression_fn)(struct parser *);
+
+// parses expressions up to the closing paren onto the stack.
+PARSE_SPECIALIZED void
+parse_operands(struct parser *p, parse_expression_fn expression)
+{
+    for (;;) {
+        if (parse_peek(p, 0) == PDDLP_TOKEN_RPAREN) {
+            parse_next(p);
+            return;
+        }
+
+        uint32_t child = expression(p);
+        if (child != PDDLP_NONE)
+            *PUSH(p, p->stack, p->stack_count) = child;
+    }
+}
+
+PARSE_SPECIALIZED uint32_t
+parse_operator(struct parser *p, enum pddlp_token_type op, uint32_t value, parse_expression_fn expression)
+{
+    uint32_t base = p->stack_count;
+    parse_operands(p, expression);
+    return parse_add_node(p, PDDLP_NODE_COMPOUND, op, value, base);
+}
+
+PARSE_SPECIALIZED uint32_t
+parse_quantifier(struct parser *p, enum pddlp_token_type op, parse_expression_fn expression)
+{
+    uint32_t base = p->stack_count;
+    uint32_t scope_count = p->scope_count;
+
+    parse_expect(p, PDDLP_TOKEN_LPAREN, "expected '('");
+    parse_typed_list(p, true, false);
+
+    uint32_t first = parse_push_variables(p);
+    uint32_t count = p->typed_count;
+
+    for (uint32_t i = 0; i < count; ++i) {
+        uint32_t variable = parse_add_node(p, PDDLP_NODE_VARIABLE, PDDLP_TOKEN_VARIABLE, first + i, p->stack_count);
+        *PUSH(p, p->stack, p->stack_count) = variable;
+    }
+
+    parse_operands(p, expression);
+    p->scope_count = scope_count;
+
+    return parse_add_node(p, PDDLP_NODE_COMPOUND, op, PDDLP_NONE, base);
+}
+
+// `(when condition effect)`, whose condition is not part of the effect.
+PARSE_SPECIALIZED uint32_t
+parse_when(struct parser *p, parse_expression_fn expression)
+{
+    uint32_t base = p->stack_count;
+    bool effect = p->effect;
+
+    if (parse_peek(p, 0) != PDDLP_TOKEN_RPAREN) {
+        p->effect = false;
+        uint32_t condition = expression(p);
+        if (condition != PDDLP_NONE)
+            *PUSH(p, p->stack, p->stack_count) = condition;
+        p->effect = effect;
+    }
+
+    parse_operands(p, expression);
+    return parse_add_node(p, PDDLP_NODE_COMPOUND, PDDLP_TOKEN_WHEN, PDDLP_NONE, base);
+}
+
+// `(name terms...)` where name is a predicate or a function.
+PARSE_SPECIALIZED uint32_t
+parse_call(struct parser *p, struct pddlp_token name, uint32_t features, parse_expression_fn expression)
+{
+    const struct pddlp_domain *d = &p->domain->base;
+    uint32_t base = p->stack_count;
+    enum pddlp_node_type node_type = PDDLP_NODE_ATOM;
+    uint32_t arity;
+
+    uint32_t value = symbols_find(&p->domain->predicate_symbols, name.start, name.length);
+    if (value != PDDLP_NONE) {
+        arity = d->predicates[value].param_count;
+    } else {
+        if ((features & PARSE_NUMERIC) == 0)
+            parse_fail(p, name, "undeclared predicate");
+
+        value = symbols_find(&p->domain->function_symbols, name.start, name.length);
+        if (value == PDDLP_NONE)
+            parse_fail(p, name, "undeclared predicate or function");
+
+        node_type = PDDLP_NODE_FUNCTION;
+        arity = d->functions[value].param_count;
+    }
+
+    parse_operands(p, expression);
+
+    if (p->stack_count - base != arity)
+        parse_fail(p, name, "wrong number of arguments");
+
+    return parse_add_node(p, node_type, PDDLP_TOKEN_NAME, value, base);
+}
+
+// parses one formula, effect, term or numeric expression. returns
+// PDDLP_NONE for `()`.
+PARSE_SPECIALIZED uint32_t
+parse_expression_with(struct parser *p, uint32_t features, parse_expression_fn expression)
+{
+    struct pddlp_token token = parse_next(p);
+
+    switch (token.token_type) {
+    case PDDLP_TOKEN_NUMBER:
+        parse_require(p, features, PARSE_NUMERIC, token);
+        return parse_add_number(p, token);
+    case PDDLP_TOKEN_VARIABLE:
+        return parse_add_node(p, PDDLP_NODE_VARIABLE, PDDLP_TOKEN_VARIABLE,
+            parse_find_variable(p, token), p->stack_count);
+    case PDDLP_TOKEN_TOTAL_TIME:
+        parse_require(p, features, PARSE_NUMERIC, token);
+        return parse_add_node(p, PDDLP_NODE_COMPOUND, PDDLP_TOKEN_TOTAL_TIME, PDDLP_NONE, p->stack_count);
+    case PDDLP_TOKEN_LPAREN:
+        break;
+    default:
+        if (!parse_is_name(token.token_type))
+            parse_fail(p, token, "expected an expression");
+
+        return parse_add_node(p, PDDLP_NODE_OBJECT, PDDLP_TOKEN_NAME,
+            parse_find_object(p, token), p->stack_count);
+    }
+
+    struct pddlp_token head = parse_next(p);
+    enum pddlp_token_type op = head.token_type;
+
+    switch (op) {
+    case PDDLP_TOKEN_RPAREN:
+        return PDDLP_NONE;
+
+    case PDDLP_TOKEN_AND:
+        return parse_operator(p, op, PDDLP_NONE, expression);
+
+    case PDDLP_TOKEN_NOT:
+        if (!p->effect)
+            parse_require(p, features, PARSE_NEGATION, head);
+        return parse_operator(p, op, PDDLP_NONE, expression);
+
+    case PDDLP_TOKEN_EQ: {
+        // `=` between numeric expressions is a comparison, whose operands
+        // already need :numeric-fluents.
+        uint32_t node = parse_operator(p, op, PDDLP_NONE, expression);
+        const struct pddlp_formulas *f = p->formulas;
+        if (!formula_numeric_comparison(f, &f->nodes[node]))
+            parse_require(p, features, PARSE_EQUALITY, head);
+        return node;
+    }
+
+    case PDDLP_TOKEN_OR:
+    case PDDLP_TOKEN_IMPLY:
+        parse_require(p, features, PARSE_ADL, head);
+        return parse_operator(p, op, PDDLP_NONE, expression);
+
+    case PDDLP_TOKEN_WHEN:
+        parse_require(p, features, PARSE_ADL, head);
+        return parse_when(p, expression);
+
+    case PDDLP_TOKEN_LT:
+    case PDDLP_TOKEN_LTE:
+    case PDDLP_TOKEN_GT:
+    case PDDLP_TOKEN_GTE:
+    case PDDLP_TOKEN_PLUS:
+    case PDDLP_TOKEN_MINUS:
+    case PDDLP_TOKEN_STAR:
+    case PDDLP_TOKEN_SLASH:
+    case PDDLP_TOKEN_ASSIGN:
+    case PDDLP_TOKEN_INCREASE:
+    case PDDLP_TOKEN_DECREASE:
+    case PDDLP_TOKEN_SCALE_UP:
+    case PDDLP_TOKEN_SCALE_DOWN:
+        parse_require(p, features, PARSE_NUMERIC, head);
+        return parse_operator(p, op, PDDLP_NONE, expression);
+
+    case PDDLP_TOKEN_ALWAYS:
+    case PDDLP_TOKEN_SOMETIME:
+    case PDDLP_TOKEN_WITHIN:
+    case PDDLP_TOKEN_AT_MOST_ONCE:
+    case PDDLP_TOKEN_SOMETIME_AFTER:
+    case PDDLP_TOKEN_SOMETIME_BEFORE:
+    case PDDLP_TOKEN_ALWAYS_WITHIN:
+    case PDDLP_TOKEN_HOLD_DURING:
+    case PDDLP_TOKEN_HOLD_AFTER:
+        parse_require(p, features, PARSE_CONSTRAINTS, head);
+        return parse_operator(p, op, PDDLP_NONE, expression);
+
+    case PDDLP_TOKEN_FORALL:
+    case PDDLP_TOKEN_EXISTS:
+        parse_require(p, features, PARSE_ADL, head);
+        return parse_quantifier(p, op, expression);
+
+    case PDDLP_TOKEN_AT:
+        if (parse_peek(p, 0) == PDDLP_TOKEN_START || parse_peek(p, 0) == PDDLP_TOKEN_END) {
+            parse_require(p, features, PARSE_TEMPORAL, head);
+            return parse_operator(p, op, parse_next(p).token_type, expression);
+        }
+
+        // `(at 10 (p))`, a timed initial literal.
+        if (parse_peek(p, 0) == PDDLP_TOKEN_NUMBER) {
+            parse_require(p, features, PARSE_TEMPORAL, head);
+            return parse_operator(p, op, PDDLP_NONE, expression);
+        }
+
+        return parse_call(p, head, features, expression);
+
+    case PDDLP_TOKEN_OVER:
+        parse_require(p, features, PARSE_TEMPORAL, head);
+        parse_expect(p, PDDLP_TOKEN_ALL, "expected all");
+        return parse_operator(p, op, PDDLP_TOKEN_ALL, expression);
+
+    case PDDLP_TOKEN_PREFERENCE: {
+        parse_require(p, features, PARSE_PREFERENCES, head);
+        uint32_t name = PDDLP_NONE;
+        if (parse_is_name(parse_peek(p, 0)))
+            name = parse_add_name(p, parse_next(p));
+
+        return parse_operator(p, op, name, expression);
+    }
+
+    case PDDLP_TOKEN_TOTAL_TIME:
+        parse_require(p, features, PARSE_NUMERIC, head);
+        parse_expect(p, PDDLP_TOKEN_RPAREN, "expected ')'");
+        return parse_add_node(p, PDDLP_NODE_COMPOUND, op, PDDLP_NONE, p->stack_count);
+
+    case PDDLP_TOKEN_IS_VIOLATED: {
+        parse_require(p, features, PARSE_PREFERENCES, head);
+        uint32_t name = parse_add_name(p, parse_expect_name(p));
+        parse_expect(p, PDDLP_TOKEN_RPAREN, "expected ')'");
+        return parse_add_node(p, PDDLP_NODE_COMPOUND, op, name, p->stack_count);
+    }
+
+    default:
+        if (!parse_is_name(op))
+            parse_fail(p, head, "expected a formula");
+
+        return parse_call(p, head, features, expression);
+    }
+}
+
+static uint32_t
+parse_expression_strips(struct parser *p)
+{
+    return parse_expression_with(p, 0, parse_expression_strips);
+}
+
+static uint32_t
+parse_expression_literals(struct parser *p)
+{
+    return parse_expression_with(p, PARSE_LITERALS, parse_expression_literals);
+}
+
+static uint32_t
+parse_expression_adl(struct parser *p)
+{
+    return parse_expression_with(p, PARSE_ADL | PARSE_LITERALS, parse_expression_adl);
+}
+
+// everything else checks the features as it goes, which also covers
+// parsing that isn't strict.
+static uint32_t
+parse_expression_checked(struct parser *p)
+{
+    return parse_expression_with(p, p->features, parse_expression_checked);
+}
+
+static uint32_t
+parse_expression(struct parser *p)
+{
+    return p->expression(p);
+}
+
+// adds the features `requirements` allow, and picks the instance for them.
+static void
+parse_enable(struct parser *p, uint64_t requirements)
+{
+    p->features |= parse_features(requirements);
+
+    if (p->features == 0)
+        p->expression = parse_expression_strips;
+    else if (p->features == PARSE_LITERALS)
+        p->expression = parse_expression_literals;
+    else if (p->features == (PARSE_ADL | PARSE_LITERALS))
+        p->expression = parse_expression_adl;
+    else
+        p->expression = parse_expression_checked;
+}
+
+// formulas that are not inside an action see no variables.
+static uint32_t
+parse_toplevel_expression(struct parser *p)
+{
+    p->scope_count = 0;
+    uint32_t node = parse_expression(p);
+    parse_expect(p, PDDLP_TOKEN_RPAREN, "expected ')'");
+    return node;
+}
+
+static uint64_t
+parse_requirements(struct parser *p)
+{
+    uint64_t requirements = 0;
+
+    for (;;) {
+        struct pddlp_token token = parse_next(p);
+        if (token.token_type == PDDLP_TOKEN_RPAREN)
+            return requirements;
+
+        if (token.token_type < PDDLP_TOKEN_SYM_ACTION || token.token_type > PDDLP_TOKEN_SYM_VARS)
+            parse_fail(p, token, "expected a requirement");
+
+        requirements |= PDDLP_REQUIREMENT(token.token_type);
+    }
+}
+
+// walks up from each type once, so asking whether a type is a subtype of
+// another is a single bit test afterwards.
+static void
+parse_type_closure(struct parser *p)
+{
+    struct pddlp_domain *d = &p->domain->base;
+    uint32_t words = (d->type_count + 63) / 64;
+
+    d->type_words = words;
+    d->supertypes = parse_calloc(p, (size_t)d->type_count * words, sizeof(*d->supertypes));
+
+    // either can make the hierarchy a dag, and careless declarations a
+    // cycle. a type is only pushed the first time its bit is set, so the
+    // walk ends either way.
+    uint32_t *stack = parse_calloc(p, d->type_count, sizeof(*stack));
+
+    for (uint32_t type = 0; type < d->type_count; ++type) {
+        uint64_t *row = d->supertypes + (size_t)type * words;
+        uint32_t stack_count = 0;
+
+        row[type / 64] |= UINT64_C(1) << (type % 64);
+        stack[stack_count++] = type;
+
+        while (stack_count > 0) {
+            const struct pddlp_typed_name *t = &d->types[stack[--stack_count]];
+
+            for (uint32_t i = 0; i < t->type_count; ++i) {
+                uint32_t parent = d->type_refs[t->type_first + i];
+                if (row[parent / 64] & (UINT64_C(1) << (parent % 64)))
+                    continue;
+
+                row[parent / 64] |= UINT64_C(1) << (parent % 64);
+                stack[stack_count++] = parent;
+            }
+        }
+    }
+
+    mem_free(stack);
+}
+
+static void
+parse_object_types(struct parser *p)
+{
+    const struct pddlp_domain *d = &p->domain->base;
+    struct pddlp_problem *pr = &p->problem->base;
+    uint32_t words = d->type_words;
+
+    pr->object_types = parse_calloc(p, (size_t)pr->object_count * words, sizeof(*pr->object_types));
+    pr->type_objects_first = parse_calloc(p, d->type_count + 1, sizeof(*pr->type_objects_first));
+
+    uint64_t membership_count = 0;
+
+    for (uint32_t object = 0; object < pr->object_count; ++object) {
+        const struct pddlp_typed_name *entry = &pr->objects[object];
+        uint64_t *row = pr->object_types + (size_t)object * words;
+
+        for (uint32_t i = 0; i < entry->type_count; ++i) {
+            const uint64_t *supertypes = d->supertypes + (size_t)pr->type_refs[entry->type_first + i] * words;
+            for (uint32_t w = 0; w < words; ++w)
+                row[w] |= supertypes[w];
+        }
+
+        for (uint32_t w = 0; w < words; ++w) {
+            for (uint64_t bits = row[w]; bits; bits &= bits - 1) {
+                pr->type_objects_first[w * 64 + bit_lowest(bits) + 1]++;
+                membership_count++;
+            }
+        }
+    }
+
+    if (membership_count > UINT32_MAX)
+        parse_fail_memory(p);
+
+    p->problem->parsed_object_count = pr->object_count;
+    p->problem->object_capacity = pr->object_count;
+    p->problem->type_object_capacity = membership_count;
+
+    for (uint32_t type = 0; type < d->type_count; ++type)
+        pr->type_objects_first[type + 1] += pr->type_objects_first[type];
+
+    pr->type_objects = parse_calloc(p, membership_count, sizeof(*pr->type_objects));
+
+    // objects are visited in order, so each list comes out sorted.
+    uint32_t *fill = parse_calloc(p, d->type_count, sizeof(*fill));
+    memcpy(fill, pr->type_objects_first, sizeof(*fill) * d->type_count);
+
+    for (uint32_t object = 0; object < pr->object_count; ++object) {
+        const uint64_t *row = pr->object_types + (size_t)object * words;
+
+        for (uint32_t w = 0; w < words; ++w)
+            for (uint64_t bits = row[w]; bits; bits &= bits - 1)
+                pr->type_objects[fill[w * 64 + bit_lowest(bits)]++] = object;
+    }
+
+    mem_free(fill);
+}
+
+// domain
+
+static void
+parse_types(struct parser *p)
+{
+    struct pddlp_domain *d = &p->domain->base;
+
+    parse_typed_list(p, false, true);
+
+    for (uint32_t i = 0; i < p->typed_count; ++i) {
+        uint32_t type = parse_type(p, p->typed_tokens[i], true);
+        if (type == 0)
+            continue;
+
+        d->types[type].type_first = p->typed[i].type_first;
+        d->types[type].type_count = p->typed[i].type_count;
+    }
+}
+
+static void
+parse_constants(struct parser *p)
+{
+    struct domain *d = p->domain;
+
+    parse_typed_list(p, false, false);
+
+    for (uint32_t i = 0; i < p->typed_count; ++i) {
+        struct pddlp_token token = p->typed_tokens[i];
+        if (symbols_find(&d->constant_symbols, token.start, token.length) != PDDLP_NONE)
+            parse_fail(p, token, "duplicate constant");
+
+        uint32_t constant = d->base.constant_count;
+        *PUSH(p, d->base.constants, d->base.constant_count) = p->typed[i];
+        parse_insert(p, &d->constant_symbols, p->typed[i].name, constant);
+    }
+}
+
+// parses `(name ?a - t ...)...)`, the skeletons of :predicates and
+// :functions. functions may be followed by `- number`.
+static void
+parse_skeletons(
+    struct parser *p,
+    struct pddlp_predicate **skeletons,
+    uint32_t *count,
+    struct symbols *symbols,
+    bool functions)
+{
+    for (;;) {
+        struct pddlp_token token = parse_next(p);
+
+        if (token.token_type == PDDLP_TOKEN_RPAREN)
+            return;
+
+        if (functions && token.token_type == PDDLP_TOKEN_MINUS) {
+            parse_expect_name(p);
+            continue;
+        }
+
+        if (token.token_type != PDDLP_TOKEN_LPAREN)
+            parse_fail(p, token, "expected '('");
+
+        struct pddlp_token name = parse_expect_name(p);
+        if (symbols_find(symbols, name.start, name.length) != PDDLP_NONE)
+            parse_fail(p, name, functions ? "duplicate function" : "duplicate predicate");
+
+        parse_typed_list(p, true, false);
+
+        uint32_t index = *count;
+        struct pddlp_predicate *skeleton = PUSH(p, *skeletons, *count);
+        skeleton->name = parse_intern(p, name);
+        skeleton->param_count = p->typed_count;
+        skeleton->param_first = parse_push_variables(p);
+        parse_insert(p, symbols, skeleton->name, index);
+    }
+}
+
+static void
+parse_action(struct parser *p, bool durative)
+{
+    struct domain *d = p->domain;
+    struct pddlp_token name = parse_expect_name(p);
+
+    if (symbols_find(&d->action_symbols, name.start, name.length) != PDDLP_NONE)
+        parse_fail(p, name, "duplicate action");
+
+    struct pddlp_action action = {
+        .name = parse_intern(p, name),
+        .durative = durative,
+        .variable_first = d->base.variable_count,
+        .param_count = 0,
+        .variable_count = 0,
+        .precondition = PDDLP_NONE,
+        .effect = PDDLP_NONE,
+        .duration = PDDLP_NONE,
+    };
+
+    p->scope_count = 0;
+
+    if (parse_peek(p, 0) == PDDLP_TOKEN_SYM_PARAMETERS) {
+        parse_next(p);
+        parse_expect(p, PDDLP_TOKEN_LPAREN, "expected '('");
+        parse_typed_list(p, true, false);
+        parse_push_variables(p);
+        action.param_count = p->typed_count;
+    }
+
+    if (durative) {
+        struct pddlp_typed_name *duration = PUSH(p, d->base.variables, d->base.variable_count);
+        duration->name = "?duration";
+        duration->type_first = 0;
+        duration->type_count = 0;
+        *PUSH(p, p->scope, p->scope_count) = d->base.variable_count - 1;
+    }
+
+    for (;;) {
+        struct pddlp_token token = parse_next(p);
+
+        if (token.token_type == PDDLP_TOKEN_RPAREN)
+            break;
+
+        switch (token.token_type) {
+        case PDDLP_TOKEN_SYM_PRECONDITION:
+            if (durative)
+                parse_fail(p, token, "durative actions use :condition");
+            action.precondition = parse_expression(p);
+            break;
+        case PDDLP_TOKEN_SYM_CONDITION:
+            if (!durative)
+                parse_fail(p, token, "actions use :precondition");
+            action.precondition = parse_expression(p);
+            break;
+        case PDDLP_TOKEN_SYM_DURATION:
+            if (!durative)
+                parse_fail(p, token, "only durative actions have a :duration");
+            action.duration = parse_expression(p);
+            break;
+        case PDDLP_TOKEN_SYM_EFFECT:
+            p->effect = true;
+            action.effect = parse_expression(p);
+            p->effect = false;
+            break;
+        default:
+            parse_fail(p, token, "unexpected action field");
+        }
+    }
+
+    action.variable_count = d->base.variable_count - action.variable_first;
+
+    uint32_t index = d->base.action_count;
+    *PUSH(p, d->base.actions, d->base.action_count) = action;
+    parse_insert(p, &d->action_symbols, action.name, index);
+}
+
+static void
+parse_derived(struct parser *p)
+{
+    struct domain *d = p->domain;
+
+    parse_expect(p, PDDLP_TOKEN_LPAREN, "expected '('");
+    struct pddlp_token name = parse_expect_name(p);
+
+    struct pddlp_derived derived = {
+        .predicate = symbols_find(&d->predicate_symbols, name.start, name.length),
+        .variable_first = d->base.variable_count,
+    };
+
+    if (derived.predicate == PDDLP_NONE)
+        parse_fail(p, name, "undeclared predicate");
+
+    p->scope_count = 0;
+    parse_typed_list(p, true, false);
+    parse_push_variables(p);
+    derived.param_count = p->typed_count;
+
+    if (derived.param_count != d->base.predicates[derived.predicate].param_count)
+        parse_fail(p, name, "wrong number of arguments");
+
+    derived.formula = parse_expression(p);
+    parse_expect(p, PDDLP_TOKEN_RPAREN, "expected ')'");
+
+    derived.variable_count = d->base.variable_count - derived.variable_first;
+    *PUSH(p, d->base.derived, d->base.derived_count) = derived;
+}
+
+static void
+parse_domain_body(struct parser *p)
+{
+    struct domain *d = p->domain;
+
+    parse_expect(p, PDDLP_TOKEN_LPAREN, "expected '('");
+    parse_expect(p, PDDLP_TOKEN_DEFINE, "expected define");
+    parse_expect(p, PDDLP_TOKEN_LPAREN, "expected '('");
+    parse_expect(p, PDDLP_TOKEN_DOMAIN, "expected domain");
+    d->base.name = parse_intern(p, parse_expect_name(p));
+    parse_expect(p, PDDLP_TOKEN_RPAREN, "expected ')'");
+
+    for (;;) {
+        struct pddlp_token token = parse_next(p);
+
+        if (token.token_type == PDDLP_TOKEN_RPAREN)
+            break;
+
+        if (token.token_type != PDDLP_TOKEN_LPAREN)
+            parse_fail(p, token, "expected '('");
+
+        struct pddlp_token section = parse_next(p);
+
+        switch (section.token_type) {
+        case PDDLP_TOKEN_SYM_REQUIREMENTS:
+            d->base.requirements |= parse_requirements(p);
+            parse_enable(p, d->base.requirements);
+            break;
+        case PDDLP_TOKEN_SYM_TYPES:
+            parse_types(p);
+            break;
+        case PDDLP_TOKEN_SYM_CONSTANTS:
+            parse_constants(p);
+            break;
+        case PDDLP_TOKEN_SYM_PREDICATES:
+            parse_skeletons(p, &d->base.predicates, &d->base.predicate_count, &d->predicate_symbols, false);
+            break;
+        case PDDLP_TOKEN_SYM_FUNCTIONS:
+            parse_require(p, p->features, PARSE_NUMERIC, section);
+            parse_skeletons(p, &d->base.functions, &d->base.function_count, &d->function_symbols, true);
+            break;
+        case PDDLP_TOKEN_SYM_CONSTRAINTS:
+            parse_require(p, p->features, PARSE_CONSTRAINTS, section);
+            d->base.constraints = parse_toplevel_expression(p);
+            break;
+        case PDDLP_TOKEN_SYM_ACTION:
+            parse_action(p, false);
+            break;
+        case PDDLP_TOKEN_SYM_DURATIVE_ACTION:
+            parse_require(p, p->features, PARSE_TEMPORAL, section);
+            parse_action(p, true);
+            break;
+        case PDDLP_TOKEN_SYM_DERIVED:
+            parse_require(p, p->features, PARSE_DERIVED, section);
+            parse_derived(p);
+            break;
+        default:
+            parse_fail(p, section, "unexpected domain section");
+        }
+    }
+
+    parse_expect(p, PDDLP_TOKEN_EOF, "expected end of input");
+
+    // types never given a parent are subtypes of object.
+    for (uint32_t i = 1; i < d->base.type_count; ++i) {
+        if (d->base.types[i].type_count == 0) {
+            d->base.types[i].type_first = 0;
+            d->base.types[i].type_count = 1;
+        }
+    }
+
+    parse_type_closure(p);
+}
+
+static void
+parse_init_parser(struct parser *p, const char *source, struct pddlp_error *error)
+{
+    memset(p, 0, sizeof(*p));
+    pddlp_init_tokenizer(&p->tokenizer, source);
+    p->source = source;
+    p->error = error;
+    p->features = PARSE_ALL;
+    p->expression = parse_expression_checked;
+}
+
+static void
+parse_free_parser(struct parser *p)
+{
+    array_free(p->scope);
+    array_free(p->stack);
+    mem_free(p->node_slots);
+    array_free(p->typed);
+    array_free(p->typed_tokens);
+}
+
+static void
+formulas_free(struct pddlp_formulas *f)
+{
+    array_free(f->nodes);
+    array_free(f->children);
+    array_free(f->numbers);
+    array_free(f->names);
+}
+
+static void
+domain_free(struct domain *d)
+{
+    array_free(d->base.types);
+    array_free(d->base.constants);
+    array_free(d->base.predicates);
+    array_free(d->base.functions);
+    array_free(d->base.actions);
+    array_free(d->base.derived);
+    array_free(d->base.variables);
+    array_free(d->base.type_refs);
+    mem_free(d->base.supertypes);
+    formulas_free(&d->base.formulas);
+
+    symbols_free(&d->type_symbols);
+    symbols_free(&d->constant_symbols);
+    symbols_free(&d->predicate_symbols);
+    symbols_free(&d->function_symbols);
+    symbols_free(&d->action_symbols);
+
+    arena_free(&d->arena);
+    mem_free(d);
+}
+
+static struct pddlp_error parse_memory_error = { "out of memory", 0, 0 };
+
+// strict parses start from strips, and :requirements adds to it.
+static struct pddlp_domain *
+parse_domain(const char *source, bool strict, struct pddlp_error *error)
+{
+    struct domain *d = mem_alloc(sizeof(*d));
+    if (d == NULL) {
+        *error = parse_memory_error;
+        return NULL;
+    }
+
+    memset(d, 0, sizeof(*d));
+    d->references = 1;
+    d->base.constraints = PDDLP_NONE;
+
+    struct parser parser;
+    struct parser *p = &parser;
+    parse_init_parser(p, source, error);
+
+    p->domain = d;
+    p->arena = &d->arena;
+    p->formulas = &d->base.formulas;
+    p->variables = &d->base.variables;
+    p->variable_count = &d->base.variable_count;
+    p->type_refs = &d->base.type_refs;
+    p->type_ref_count = &d->base.type_ref_count;
+
+    if (strict) {
+        p->features = 0;
+        parse_enable(p, 0);
+    }
+
+    if (setjmp(p->fail)) {
+        parse_free_parser(p);
+        domain_free(d);
+        return NULL;
+    }
+
+    // type 0 is object, and type_refs[0] points at it so untyped entries
+    // can share it.
+    struct pddlp_token object = { .start = "object", .length = 6 };
+    parse_type(p, object, true);
+    *PUSH(p, d->base.type_refs, d->base.type_ref_count) = 0;
+
+    parse_domain_body(p);
+    parse_free_parser(p);
+
+    d->features = p->features;
+    return &d->base;
+}
+
+struct pddlp_domain *
+pddlp_parse_domain(const char *source, struct pddlp_error *error)
+{
+    enum pddlp_subsystem previous = mem_enter(PDDLP_SUBSYSTEM_PARSER);
+    struct pddlp_domain *domain = parse_domain(source, false, error);
+    mem_leave(previous);
+    return domain;
+}
+
+struct pddlp_domain *
+pddlp_parse_domain_strict(const char *source, struct pddlp_error *error)
+{
+    enum pddlp_subsystem previous = mem_enter(PDDLP_SUBSYSTEM_PARSER);
+    struct pddlp_domain *domain = parse_domain(source, true, error);
+    mem_leave(previous);
+    return domain;
+}
+
+// cache
+
+static pthread_mutex_t cache_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// expected to hold a handful of domains, so lookups just scan it.
+static struct domain **cache_domains;
+static uint32_t cache_count;
+
+static struct domain *
+cache_find(const char *source, uint64_t hash, size_t length)
+{
+    for (uint32_t i = 0; i < cache_count; ++i) {
+        struct domain *d = cache_domains[i];
+        if (d->hash == hash && d->length == length && memcmp(d->source, source, length) == 0)
+            return d;
+    }
+
+    return NULL;
+}
+
+struct pddlp_domain *
+pddlp_load_domain(const char *source, struct pddlp_error *error)
+{
+    size_t length = strlen(source);
+    uint64_t hash = hash64(source, length, 0);
+
+    pthread_mutex_lock(&cache_lock);
+    struct domain *d = cache_find(source, hash, length);
+    if (d)
+        d->references++;
+    pthread_mutex_unlock(&cache_lock);
+
+    if (d)
+        return &d->base;
+
+    // parse without holding the lock, so unrelated loads don't wait.
+    struct domain *parsed = (struct domain *)pddlp_parse_domain(source, error);
+    if (parsed == NULL)
+        return NULL;
+
+    enum pddlp_subsystem previous = mem_enter(PDDLP_SUBSYSTEM_PARSER);
+    parsed->hash = hash;
+    parsed->length = length;
+    parsed->source = arena_strndup(&parsed->arena, source, length);
+    mem_leave(previous);
+
+    pthread_mutex_lock(&cache_lock);
+
+    // another thread may have loaded the same domain in the meantime.
+    d = cache_find(source, hash, length);
+    if (d) {
+        d->references++;
+    } else {
+        // the cache keeps the first reference, and the caller gets another.
+        // when the cache can't grow the domain is just returned uncached.
+        previous = mem_enter(PDDLP_SUBSYSTEM_PARSER);
+        struct domain **domains = parsed->source
+            ? array_reserve(cache_domains, cache_count + 1, sizeof(*cache_domains))
+            : NULL;
+        mem_leave(previous);
+        if (domains) {
+            cache_domains = domains;
+            cache_domains[cache_count++] = parsed;
+            parsed->references++;
+        }
+
+        d = parsed;
+        parsed = NULL;
+    }
+
+    pthread_mutex_unlock(&cache_lock);
+
+    if (parsed)
+        pddlp_release_domain(&parsed->base);
+
+    return &d->base;
+}
+
+void
+pddlp_retain_domain(struct pddlp_domain *domain)
+{
+    struct domain *d = (struct domain *)domain;
+
+    pthread_mutex_lock(&cache_lock);
+    d->references++;
+    pthread_mutex_unlock(&cache_lock);
+}
+
+void
+pddlp_release_domain(struct pddlp_domain *domain)
+{
+    if (domain == NULL)
+        return;
+
+    struct domain *d = (struct domain *)domain;
+
+    pthread_mutex_lock(&cache_lock);
+    bool last = --d->references == 0;
+    pthread_mutex_unlock(&cache_lock);
+
+    if (last)
+        domain_free(d);
+}
+
+void
+pddlp_clear_domain_cache(void)
+{
+    pthread_mutex_lock(&cache_lock);
+    struct domain **domains = cache_domains;
+    uint32_t count = cache_count;
+    cache_domains = NULL;
+    cache_count = 0;
+    pthread_mutex_unlock(&cache_lock);
+
+    for (uint32_t i = 0; i < count; ++i)
+        pddlp_release_domain(&domains[i]->base);
+
+    array_free(domains);
+}
+
+// problem
+
+static void
+parse_objects(struct parser *p)
+{
+    struct problem *pr = p->problem;
+
+    parse_typed_list(p, false, false);
+
+    for (uint32_t i = 0; i < p->typed_count; ++i) {
+        struct pddlp_token token = p->typed_tokens[i];
+        uint32_t hash = hash_name(token.start, token.length);
+
+        if (symbols_find_hashed(&pr->object_symbols, token.start, token.length, hash) != PDDLP_NONE ||
+            symbols_find_hashed(&p->domain->constant_symbols, token.start, token.length, hash) != PDDLP_NONE)
+            parse_fail(p, token, "duplicate object");
+
+        uint32_t object = pr->base.object_count;
+        *PUSH(p, pr->base.objects, pr->base.object_count) = p->typed[i];
+        parse_insert(p, &pr->object_symbols, p->typed[i].name, object);
+    }
+}
+
+// `(= (f args) value)` in :init. object fluents are accepted but not kept.
+static void
+parse_init_fluent(struct parser *p)
+{
+    struct pddlp_problem *pr = &p->problem->base;
+
+    uint32_t function;
+    uint32_t args_first = pr->fact_arg_count;
+    struct pddlp_token name;
+
+    if (parse_peek(p, 0) == PDDLP_TOKEN_LPAREN) {
+        parse_next(p);
+        name = parse_expect_name(p);
+
+        while (parse_peek(p, 0) != PDDLP_TOKEN_RPAREN)
+            *PUSH(p, pr->fact_args, pr->fact_arg_count) = parse_find_object(p, parse_expect_name(p));
+        parse_next(p);
+    } else {
+        name = parse_expect_name(p);
+    }
+
+    function = symbols_find(&p->domain->function_symbols, name.start, name.length);
+    if (function == PDDLP_NONE)
+        parse_fail(p, name, "undeclared function");
+
+    if (pr->fact_arg_count - args_first != pr->domain->functions[function].param_count)
+        parse_fail(p, name, "wrong number of arguments");
+
+    struct pddlp_token value = parse_next(p);
+    if (value.token_type == PDDLP_TOKEN_NUMBER) {
+        uint32_t count = pr->fluent_count;
+        *PUSH(p, pr->fluent_functions, count) = function;
+        count = pr->fluent_count;
+        *PUSH(p, pr->fluent_args_first, count) = args_first;
+        *PUSH(p, pr->fluent_values, pr->fluent_count) = parse_number(value);
+    } else if (parse_is_name(value.token_type)) {
+        parse_find_object(p, value);
+        pr->fact_arg_count = args_first;
+    } else {
+        parse_fail(p, value, "expected a value");
+    }
+
+    parse_expect(p, PDDLP_TOKEN_RPAREN, "expected ')'");
+}
+
+// one :init entry, after its '(' at `open`.
+PARSE_SPECIALIZED void
+parse_init_entry(struct parser *p, uint32_t features, const char *open)
+{
+    struct problem *pr = p->problem;
+    const struct pddlp_domain *d = &p->domain->base;
+    struct pddlp_token head = parse_next(p);
+
+    if (head.token_type == PDDLP_TOKEN_EQ) {
+        parse_require(p, features, PARSE_NUMERIC, head);
+        parse_init_fluent(p);
+        return;
+    }
+
+    // negative literals are implied by the closed world assumption.
+    if (head.token_type == PDDLP_TOKEN_NOT) {
+        parse_skip_list(p);
+        return;
+    }
+
+    if (head.token_type == PDDLP_TOKEN_AT && parse_peek(p, 0) == PDDLP_TOKEN_NUMBER) {
+        parse_require(p, features, PARSE_TEMPORAL, head);
+
+        // these build formulas, which chunks don't have.
+        if (p->chunked)
+            longjmp(p->fail, PARSE_SEQUENTIAL);
+
+        uint32_t base = p->stack_count;
+        *PUSH(p, p->stack, p->stack_count) = parse_add_number(p, parse_next(p));
+        p->effect = true;
+        *PUSH(p, p->stack, p->stack_count) = parse_expression(p);
+        p->effect = false;
+        struct pddlp_token close = parse_expect(p, PDDLP_TOKEN_RPAREN, "expected ')'");
+
+        // kept so pddlp_write_problem can copy them.
+        uint32_t span_count = pr->base.timed_literal_count * 2;
+        *PUSH(p, pr->timed_spans, span_count) = open - p->source;
+        *PUSH(p, pr->timed_spans, span_count) = close.start + 1 - p->source;
+
+        uint32_t count = pr->base.timed_literal_count;
+        *PUSH(p, pr->base.timed_literals, count) =
+            parse_add_node(p, PDDLP_NODE_COMPOUND, PDDLP_TOKEN_AT, PDDLP_NONE, base);
+        pr->base.timed_literal_count = count;
+        return;
+    }
+
+    if (!parse_is_name(head.token_type))
+        parse_fail(p, head, "expected a predicate");
+
+    uint32_t predicate = symbols_find(&p->domain->predicate_symbols, head.start, head.length);
+    if (predicate == PDDLP_NONE)
+        parse_fail(p, head, "undeclared predicate");
+
+    uint32_t args_first = pr->base.fact_arg_count;
+
+    for (;;) {
+        struct pddlp_token arg = parse_next(p);
+        if (arg.token_type == PDDLP_TOKEN_RPAREN)
+            break;
+
+        if (!parse_is_name(arg.token_type))
+            parse_fail(p, arg, "expected an object");
+
+        *PUSH(p, pr->base.fact_args, pr->base.fact_arg_count) = parse_find_object(p, arg);
+    }
+
+    if (pr->base.fact_arg_count - args_first != d->predicates[predicate].param_count)
+        parse_fail(p, head, "wrong number of arguments");
+
+    uint32_t count = pr->base.fact_count;
+    *PUSH(p, pr->base.fact_predicates, count) = predicate;
+    *PUSH(p, pr->base.fact_args_first, pr->base.fact_count) = args_first;
+}
+
+// the entries up to the ')' that closes :init.
+PARSE_SPECIALIZED void
+parse_init_with(struct parser *p, uint32_t features)
+{
+    p->scope_count = 0;
+
+    for (;;) {
+        struct pddlp_token token = parse_next(p);
+
+        if (token.token_type == PDDLP_TOKEN_RPAREN)
+            return;
+
+        if (token.token_type != PDDLP_TOKEN_LPAREN)
+            parse_fail(p, token, "expected '('");
+
+        parse_init_entry(p, features, token.start);
+    }
+}
+
+// the entries that start before `end`.
+PARSE_SPECIALIZED void
+parse_chunk_with(struct parser *p, uint32_t features, const char *end)
+{
+    for (;;) {
+        // error tokens point at their message, and are reported by
+        // parse_next.
+        struct pddlp_token token = pddlp_peek_token(&p->tokenizer, 0);
+        if (token.token_type != PDDLP_TOKEN_ERROR && token.start >= end)
+            return;
+
+        struct pddlp_token open = parse_expect(p, PDDLP_TOKEN_LPAREN, "expected '('");
+        parse_init_entry(p, features, open.start);
+    }
+}
+
+// :init entries don't check negation or equality, so domains that only add
+// those take the strips instances too.
+static void
+parse_init_strips(struct parser *p)
+{
+    parse_init_with(p, 0);
+}
+
+static void
+parse_init_checked(struct parser *p)
+{
+    parse_init_with(p, p->features);
+}
+
+static void
+parse_chunk_strips(struct parser *p, const char *end)
+{
+    parse_chunk_with(p, 0, end);
+}
+
+static void
+parse_chunk_checked(struct parser *p, const char *end)
+{
+    parse_chunk_with(p, p->features, end);
+}
+
+// parallel :init
+//
+// :init is split into chunks at the boundaries between its entries, found
+// by a scan that only tracks parens, comments and lines, which is several
+// times faster than tokenizing. each chunk is parsed into a problem of its
+// own by its own thread, and the facts are appended in order afterwards.
+
+// smaller :init sections aren't worth the threads.
+#define PARSE_PARALLEL_MIN (1 << 20)
+
+// boundaries the scan keeps per chunk, to pick evenly sized chunks from.
+#define PARSE_CANDIDATES 16
+
+struct parse_position {
+    const char *at;
+    uint64_t line;
+    uint64_t column;
+};
+
+struct parse_chunk {
+    const struct parser *parent;
+    struct parse_position start;
+    const char *end;
+
+    // holds the facts of the chunk only.
+    struct problem facts;
+    struct pddlp_error error;
+    int status;
+};
+
+// finds the ')' closing :init, starting right after `(:init`, and up to
+// `capacity` entry boundaries about `stride` bytes apart. returns false when
+// :init isn't closed, which the sequential parser then reports.
+static bool
+parse_scan_init(struct parse_position start, size_t stride, struct parse_position *candidates, uint32_t capacity,
+    uint32_t *candidate_count, struct parse_position *end)
+{
+    const char *line_start = start.at - (start.column - 1);
+    uint64_t line = start.line;
+    const char *next = start.at + stride;
+    uint32_t count = 0;
+    int64_t depth = 0;
+
+    for (const char *c = start.at;; ++c) {
+        switch (*c) {
+        case 0:
+            return false;
+        case '\n':
+            line++;
+            line_start = c + 1;
+            break;
+        case ';':
+            while (c[1] != '\n' && c[1] != 0)
+                c++;
+            break;
+        case '(':
+            depth++;
+            break;
+        case ')':
+            if (depth == 0) {
+                *end = (struct parse_position){c, line, (uint64_t)(c - line_start) + 1};
+                *candidate_count = count;
+                return true;
+            }
+
+            if (--depth == 0 && c + 1 >= next && count < capacity) {
+                candidates[count++] = (struct parse_position){c + 1, line, (uint64_t)(c + 1 - line_start) + 1};
+                next = c + 1 + stride;
+            }
+            break;
+        }
+    }
+}
+
+static void *
+parse_chunk_thread(void *context)
+{
+    struct parse_chunk *chunk = context;
+    const struct parser *parent = chunk->parent;
+    mem_enter(PDDLP_SUBSYSTEM_PARSER);
+
+    struct parser parser;
+    struct parser *p = &parser;
+    parse_init_parser(p, chunk->start.at, &chunk->error);
+    p->tokenizer.line = chunk->start.line;
+    p->tokenizer.column = chunk->start.column;
+    p->domain = parent->domain;
+    p->problem = &chunk->facts;
+    p->features = parent->features;
+    p->chunked = true;
+
+    chunk->status = setjmp(p->fail);
+    if (chunk->status == 0) {
+        if ((p->features & ~PARSE_LITERALS) == 0)
+            parse_chunk_strips(p, chunk->end);
+        else
+            parse_chunk_checked(p, chunk->end);
+    }
+
+    parse_free_parser(p);
+    return NULL;
+}
+
+static void
+parse_free_chunk(struct parse_chunk *chunk)
+{
+    struct pddlp_problem *facts = &chunk->facts.base;
+    array_free(facts->fact_predicates);
+    array_free(facts->fact_args_first);
+    array_free(facts->fact_args);
+    array_free(facts->fluent_functions);
+    array_free(facts->fluent_args_first);
+    array_free(facts->fluent_values);
+}
+
+// appends `count` items of `from` to `*to`, which holds `*to_count`.
+static bool
+parse_append(void *to, uint32_t *to_count, const void *from, uint32_t count, size_t item_size)
+{
+    void **items = to;
+    if (count == 0)
+        return true;
+
+    void *grown = array_reserve(*items, *to_count + count, item_size);
+    if (grown == NULL)
+        return false;
+
+    *items = grown;
+    memcpy((char *)grown + (size_t)*to_count * item_size, from, (size_t)count * item_size);
+    *to_count += count;
+    return true;
+}
+
+static bool
+parse_merge_chunk(struct pddlp_problem *pr, const struct parse_chunk *chunk)
+{
+    const struct pddlp_problem *facts = &chunk->facts.base;
+    uint32_t arg_base = pr->fact_arg_count;
+    uint32_t fact_count = pr->fact_count;
+    uint32_t fluent_count = pr->fluent_count;
+    uint32_t counts[5] = {fact_count, fact_count, fluent_count, fluent_count, fluent_count};
+
+    bool merged = parse_append(&pr->fact_predicates, &counts[0], facts->fact_predicates, facts->fact_count,
+                      sizeof(uint32_t))
+        && parse_append(&pr->fact_args_first, &counts[1], facts->fact_args_first, facts->fact_count,
+            sizeof(uint32_t))
+        && parse_append(&pr->fluent_functions, &counts[2], facts->fluent_functions, facts->fluent_count,
+            sizeof(uint32_t))
+        && parse_append(&pr->fluent_args_first, &counts[3], facts->fluent_args_first, facts->fluent_count,
+            sizeof(uint32_t))
+        && parse_append(&pr->fluent_values, &counts[4], facts->fluent_values, facts->fluent_count, sizeof(double))
+        && parse_append(&pr->fact_args, &pr->fact_arg_count, facts->fact_args, facts->fact_arg_count,
+            sizeof(uint32_t));
+
+    if (!merged)
+        return false;
+
+    pr->fact_count = counts[0];
+    pr->fluent_count = counts[2];
+
+    for (uint32_t i = fact_count; i < pr->fact_count; ++i)
+        pr->fact_args_first[i] += arg_base;
+    for (uint32_t i = fluent_count; i < pr->fluent_count; ++i)
+        pr->fluent_args_first[i] += arg_base;
+
+    return true;
+}
+
+// parses :init on `p->threads` threads, right after `(:init`. returns false
+// without consuming anything when it is better left to the sequential
+// parser: a small :init, one that isn't closed, or timed literals.
+static bool
+parse_init_parallel(struct parser *p)
+{
+    struct pddlp_tokenizer *t = &p->tokenizer;
+    unsigned threads = p->threads;
+
+    if (threads == 0) {
+        long online = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = online > 0 ? (unsigned)online : 1;
+    }
+
+    if (threads < 2 || t->lookahead_count > 0)
+        return false;
+
+    struct parse_position start = {t->current, t->line, t->column};
+    size_t length = strlen(start.at);
+    if (length < PARSE_PARALLEL_MIN)
+        return false;
+
+    uint32_t capacity = threads * PARSE_CANDIDATES;
+    struct parse_position *candidates = mem_alloc(sizeof(*candidates) * capacity);
+    struct parse_chunk *chunks = mem_alloc(sizeof(*chunks) * threads);
+    pthread_t *thread_ids = mem_alloc(sizeof(*thread_ids) * threads);
+    if (candidates == NULL || chunks == NULL || thread_ids == NULL) {
+        mem_free(candidates);
+        mem_free(chunks);
+        mem_free(thread_ids);
+        parse_fail_memory(p);
+    }
+
+    uint32_t candidate_count;
+    struct parse_position end;
+    bool closed = parse_scan_init(start, length / capacity + 1, candidates, capacity, &candidate_count, &end);
+
+    // picks the boundaries closest after even splits of the section.
+    unsigned chunk_count = 0;
+    if (closed && (size_t)(end.at - start.at) >= PARSE_PARALLEL_MIN) {
+        struct parse_position from = start;
+        uint32_t next = 0;
+
+        for (unsigned i = 1; i <= threads; ++i) {
+            struct parse_position to = end;
+            if (i < threads) {
+                const char *target = start.at + (end.at - start.at) / threads * i;
+                while (next < candidate_count && candidates[next].at < target)
+                    next++;
+                if (next == candidate_count || candidates[next].at <= from.at)
+                    continue;
+                to = candidates[next];
+            }
+
+            struct parse_chunk *chunk = &chunks[chunk_count++];
+            memset(chunk, 0, sizeof(*chunk));
+            chunk->parent = p;
+            chunk->start = from;
+            chunk->end = to.at;
+            chunk->facts.base.domain = p->problem->base.domain;
+            chunk->facts.object_symbols = p->problem->object_symbols;
+            from = to;
+        }
+    }
+
+    mem_free(candidates);
+
+    // the calling thread takes the first chunk, and the others the chunks
+    // whose threads couldn't start.
+    unsigned started = 1;
+    for (; started < chunk_count; ++started)
+        if (pthread_create(&thread_ids[started], NULL, parse_chunk_thread, &chunks[started]) != 0)
+            break;
+
+    if (chunk_count > 0)
+        parse_chunk_thread(&chunks[0]);
+    for (unsigned i = started; i < chunk_count; ++i)
+        parse_chunk_thread(&chunks[i]);
+    for (unsigned i = 1; i < started && i < chunk_count; ++i)
+        pthread_join(thread_ids[i], NULL);
+
+    mem_free(thread_ids);
+
+    // the first chunk that stopped decides, as it would have sequentially.
+    struct pddlp_error error = {NULL, 0, 0};
+    int status = chunk_count > 0 ? 0 : PARSE_SEQUENTIAL;
+    for (unsigned i = 0; i < chunk_count && status == 0; ++i) {
+        status = chunks[i].status;
+        error = chunks[i].error;
+    }
+
+    bool merged = true;
+    for (unsigned i = 0; i < chunk_count; ++i) {
+        if (status == 0 && merged)
+            merged = parse_merge_chunk(&p->problem->base, &chunks[i]);
+        parse_free_chunk(&chunks[i]);
+    }
+
+    mem_free(chunks);
+
+    if (!merged)
+        parse_fail_memory(p);
+
+    if (status == PARSE_SEQUENTIAL)
+        return false;
+
+    if (status != 0) {
+        *p->error = error;
+        longjmp(p->fail, 1);
+    }
+
+    // carries on at the ')' closing :init.
+    t->start = end.at;
+    t->current = end.at;
+    t->line = end.line;
+    t->column = end.column;
+    parse_expect(p, PDDLP_TOKEN_RPAREN, "expected ')'");
+    return true;
+}
+
+static void
+parse_init(struct parser *p)
+{
+    if (!parse_init_parallel(p)) {
+        if ((p->features & ~PARSE_LITERALS) == 0)
+            parse_init_strips(p);
+        else
+            parse_init_checked(p);
+    }
+
+    if (!facts_index(p->problem))
+        parse_fail_memory(p);
+}
+
+static void
+parse_metric(struct parser *p)
+{
+    struct pddlp_problem *pr = &p->problem->base;
+    struct pddlp_token direction = parse_next(p);
+
+    if (direction.token_type != PDDLP_TOKEN_MINIMIZE && direction.token_type != PDDLP_TOKEN_MAXIMIZE)
+        parse_fail(p, direction, "expected minimize or maximize");
+
+    pr->metric_op = direction.token_type;
+    pr->metric = parse_toplevel_expression(p);
+}
+
+// the offset right after the ')' of a section, found by stepping back from
+// the token after it over whitespace and comments. there are no strings in
+// pddl, so a ';' before the end of a line starts a comment.
+static size_t
+parse_section_end(struct parser *p, struct pddlp_token next)
+{
+    const char *end = next.start;
+
+    for (;;) {
+        while (end > p->source && (end[-1] == ' ' || (end[-1] >= '\t' && end[-1] <= '\r')))
+            end--;
+
+        const char *line = end;
+        while (line > p->source && line[-1] != '\n')
+            line--;
+
+        const char *comment = memchr(line, ';', end - line);
+        if (comment == NULL)
+            return end - p->source;
+
+        end = comment;
+    }
+}
+
+static void
+parse_problem_body(struct parser *p)
+{
+    struct pddlp_problem *pr = &p->problem->base;
+    size_t *section_end = NULL;
+
+    parse_expect(p, PDDLP_TOKEN_LPAREN, "expected '('");
+    parse_expect(p, PDDLP_TOKEN_DEFINE, "expected define");
+    parse_expect(p, PDDLP_TOKEN_LPAREN, "expected '('");
+    parse_expect(p, PDDLP_TOKEN_PROBLEM, "expected problem");
+    pr->name = parse_intern(p, parse_expect_name(p));
+    parse_expect(p, PDDLP_TOKEN_RPAREN, "expected ')'");
+
+    for (;;) {
+        struct pddlp_token token = parse_next(p);
+
+        if (section_end) {
+            *section_end = parse_section_end(p, token);
+            section_end = NULL;
+        }
+
+        if (token.token_type == PDDLP_TOKEN_RPAREN) {
+            p->problem->body_end = token.start - p->source;
+            break;
+        }
+
+        if (token.token_type != PDDLP_TOKEN_LPAREN)
+            parse_fail(p, token, "expected '('");
+
+        struct pddlp_token section = parse_next(p);
+
+        switch (section.token_type) {
+        case PDDLP_TOKEN_SYM_DOMAIN: {
+            struct pddlp_token name = parse_expect_name(p);
+            const char *domain_name = pr->domain->name;
+            if (strncmp(domain_name, name.start, name.length) != 0 || domain_name[name.length] != 0)
+                parse_fail(p, name, "problem is for another domain");
+            parse_expect(p, PDDLP_TOKEN_RPAREN, "expected ')'");
+            break;
+        }
+        case PDDLP_TOKEN_SYM_REQUIREMENTS:
+            pr->requirements |= parse_requirements(p);
+            parse_enable(p, pr->requirements);
+            break;
+        case PDDLP_TOKEN_SYM_OBJECTS:
+            if (p->problem->objects_end == 0) {
+                p->problem->objects_list = section.start + section.length - p->source;
+                section_end = &p->problem->objects_end;
+            }
+            parse_objects(p);
+            break;
+        case PDDLP_TOKEN_SYM_INIT:
+            if (p->problem->init_end == 0) {
+                p->problem->init_start = token.start - p->source;
+                section_end = &p->problem->init_end;
+            }
+            parse_init(p);
+            break;
+        case PDDLP_TOKEN_SYM_GOAL:
+            pr->goal = parse_toplevel_expression(p);
+            break;
+        case PDDLP_TOKEN_SYM_CONSTRAINTS:
+            parse_require(p, p->features, PARSE_CONSTRAINTS, section);
+            pr->constraints = parse_toplevel_expression(p);
+            break;
+        case PDDLP_TOKEN_SYM_METRIC:
+            parse_require(p, p->features, PARSE_NUMERIC, section);
+            parse_metric(p);
+            break;
+        case PDDLP_TOKEN_SYM_LENGTH:
+            parse_skip_list(p);
+            break;
+        default:
+            parse_fail(p, section, "unexpected problem section");
+        }
+    }
+
+    struct pddlp_token eof = parse_expect(p, PDDLP_TOKEN_EOF, "expected end of input");
+    p->problem->source_length = eof.start - p->source;
+
+    parse_object_types(p);
+}
+
+static void
+problem_free(struct problem *pr)
+{
+    array_free(pr->base.objects);
+    array_free(pr->base.type_refs);
+    mem_free(pr->base.object_types);
+    mem_free(pr->base.type_objects_first);
+    mem_free(pr->base.type_objects);
+    array_free(pr->base.fact_predicates);
+    array_free(pr->base.fact_args_first);
+    array_free(pr->base.fact_args);
+    array_free(pr->base.fluent_functions);
+    array_free(pr->base.fluent_args_first);
+    array_free(pr->base.fluent_values);
+    array_free(pr->base.timed_literals);
+    array_free(pr->base.variables);
+    formulas_free(&pr->base.formulas);
+    array_free(pr->timed_spans);
+
+    facts_free(pr);
+    update_free(pr);
+    pthread_mutex_destroy(&pr->index_lock);
+
+    symbols_free(&pr->object_symbols);
+    arena_free(&pr->arena);
+    mem_free(pr);
+}
+
+static struct pddlp_problem *
+parse_problem(const struct pddlp_domain *domain, const char *source, unsigned threads, struct pddlp_error *error)
+{
+    struct problem *pr = mem_alloc(sizeof(*pr));
+    if (pr == NULL) {
+        *error = parse_memory_error;
+        return NULL;
+    }
+
+    memset(pr, 0, sizeof(*pr));
+    pthread_mutex_init(&pr->index_lock, NULL);
+    pr->base.domain = domain;
+    pr->base.goal = PDDLP_NONE;
+    pr->base.constraints = PDDLP_NONE;
+    pr->base.metric = PDDLP_NONE;
+    pr->base.metric_op = PDDLP_TOKEN_EOF;
+
+    struct parser parser;
+    struct parser *p = &parser;
+    parse_init_parser(p, source, error);
+
+    // the domain is only read from here on.
+    p->domain = (struct domain *)domain;
+    p->problem = pr;
+    p->arena = &pr->arena;
+    p->formulas = &pr->base.formulas;
+    p->variables = &pr->base.variables;
+    p->variable_count = &pr->base.variable_count;
+    p->type_refs = &pr->base.type_refs;
+    p->type_ref_count = &pr->base.type_ref_count;
+    p->threads = threads;
+
+    // problems of strict domains are strict too.
+    p->features = ((const struct domain *)domain)->features;
+    parse_enable(p, 0);
+
+    if (setjmp(p->fail)) {
+        parse_free_parser(p);
+        problem_free(pr);
+        return NULL;
+    }
+
+    // constants keep their ids, so they are copied first along with their
+    // types.
+    *PUSH(p, pr->base.type_refs, pr->base.type_ref_count) = 0;
+
+    for (uint32_t i = 0; i < domain->constant_count; ++i) {
+        struct pddlp_typed_name constant = domain->constants[i];
+        uint32_t first = pr->base.type_ref_count;
+
+        for (uint32_t j = 0; j < constant.type_count; ++j)
+            *PUSH(p, pr->base.type_refs, pr->base.type_ref_count) = domain->type_refs[constant.type_first + j];
+
+        constant.type_first = first;
+        *PUSH(p, pr->base.objects, pr->base.object_count) = constant;
+    }
+
+    parse_problem_body(p);
+    parse_free_parser(p);
+
+    return &pr->base;
+}
+
+struct pddlp_problem *
+pddlp_parse_problem(const struct pddlp_domain *domain, const char *source, struct pddlp_error *error)
+{
+    enum pddlp_subsystem previous = mem_enter(PDDLP_SUBSYSTEM_PARSER);
+    struct pddlp_problem *problem = parse_problem(domain, source, 1, error);
+    mem_leave(previous);
+    return problem;
+}
+
+struct pddlp_problem *
+pddlp_parse_problem_parallel(
+    const struct pddlp_domain *domain, const char *source, unsigned threads, struct pddlp_error *error)
+{
+    enum pddlp_subsystem previous = mem_enter(PDDLP_SUBSYSTEM_PARSER);
+    struct pddlp_problem *problem = parse_problem(domain, source, threads, error);
+    mem_leave(previous);
+    return problem;
+}
+
+void
+pddlp_free_problem(struct pddlp_problem *problem)
+{
+    if (problem)
+        problem_free((struct problem *)problem);
+}
+
+// lookups
+
+uint32_t
+pddlp_find_type(const struct pddlp_domain *domain, const char *name, size_t length)
+{
+    return symbols_find(&((const struct domain *)domain)->type_symbols, name, length);
+}
+
+uint32_t
+pddlp_find_constant(const struct pddlp_domain *domain, const char *name, size_t length)
+{
+    return symbols_find(&((const struct domain *)domain)->constant_symbols, name, length);
+}
+
+uint32_t
+pddlp_find_predicate(const struct pddlp_domain *domain, const char *name, size_t length)
+{
+    return symbols_find(&((const struct domain *)domain)->predicate_symbols, name, length);
+}
+
+uint32_t
+pddlp_find_function(const struct pddlp_domain *domain, const char *name, size_t length)
+{
+    return symbols_find(&((const struct domain *)domain)->function_symbols, name, length);
+}
+
+uint32_t
+pddlp_find_action(const struct pddlp_domain *domain, const char *name, size_t length)
+{
+    return symbols_find(&((const struct domain *)domain)->action_symbols, name, length);
+}
+
+uint32_t
+pddlp_find_object(const struct pddlp_problem *problem, const char *name, size_t length)
+{
+    uint32_t object = symbols_find(&((const struct problem *)problem)->object_symbols, name, length);
+    if (object == PDDLP_NONE)
+        object = pddlp_find_constant(problem->domain, name, length);
+
+    return object;
+}
+
+bool
+pddlp_is_subtype(const struct pddlp_domain *domain, uint32_t type, uint32_t parent)
+{
+    return domain->supertypes[(size_t)type * domain->type_words + parent / 64] & (UINT64_C(1) << (parent % 64));
+}
+
+bool
+pddlp_has_type(const struct pddlp_problem *problem, uint32_t object, uint32_t type)
+{
+    return problem->object_types[(size_t)object * problem->domain->type_words + type / 64] &
+        (UINT64_C(1) << (type % 64));
+}
@@ -1,15 +1,26 @@
 // SPDX-FileCopyrightText: 2023 Guilherme Puida Moreira <guilherme@puida.xyz>
 // SPDX-License-Identifier: BSD-3-Clause
 
+// needed for clock_gettime when collecting stats.
+#define _POSIX_C_SOURCE 200809L
+
 #include "pddlp.h"
 
 #include <stdbool.h>
 #include <string.h>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#ifdef PDDLP_STATS
+#include <time.h>
+#endif
+
 #define __PDDLP_TOKEN_NAME(token_type) \
     [token_type] = #token_type
 
-const char *pddlp_token_type_names[] = {
+PDDLP_DATA const char *pddlp_token_type_names[] = {
     __PDDLP_TOKEN_NAME(PDDLP_TOKEN_LPAREN),
     __PDDLP_TOKEN_NAME(PDDLP_TOKEN_RPAREN),
     __PDDLP_TOKEN_NAME(PDDLP_TOKEN_PLUS),
@@ -55,6 +66,7 @@ const char *pddlp_token_type_names[] = {
     __PDDLP_TOKEN_NAME(PDDLP_TOKEN_OVER),
     __PDDLP_TOKEN_NAME(PDDLP_TOKEN_PREFERENCE),
     __PDDLP_TOKEN_NAME(PDDLP_TOKEN_PROBLEM),
+    __PDDLP_TOKEN_NAME(PDDLP_TOKEN_SCALE_DOWN),
     __PDDLP_TOKEN_NAME(PDDLP_TOKEN_SCALE_UP),
     __PDDLP_TOKEN_NAME(PDDLP_TOKEN_START),
     __PDDLP_TOKEN_NAME(PDDLP_TOKEN_SOMETIME),
@@ -116,6 +128,24 @@ const char *pddlp_token_type_names[] = {
 
 #undef __PDDLP_TOKEN_NAME
 
+PDDLP_DATA const char *pddlp_token_error_messages[] = {
+    [PDDLP_TOKEN_ERROR_UNKNOWN_SYMBOL] = "unknown symbol",
+    [PDDLP_TOKEN_ERROR_VARIABLE_FIRST_CHAR] = "first character of a variable should be a letter",
+    [PDDLP_TOKEN_ERROR_UNRECOGNIZED_CHARACTER] = "unrecognized character",
+    [PDDLP_TOKEN_ERROR_TOO_LONG] = "token is longer than 4GB",
+    [PDDLP_TOKEN_ERROR_LOOKAHEAD] = "peek past the lookahead window",
+};
+
+#ifdef PDDLP_STATS
+#define __PDDLP_STAT(t, ...)                                            \
+do {                                                                    \
+    struct pddlp_stats *stats = (t)->stats;                             \
+    if (stats) { __VA_ARGS__; }                                         \
+} while (0)
+#else
+#define __PDDLP_STAT(t, ...) do { } while (0)
+#endif
+
 static bool
 tok_is_digit(char c)
 {
@@ -173,6 +203,11 @@ tok_match(struct pddlp_tokenizer *t, char expected)
 static void
 tok_skip_whitespace(struct pddlp_tokenizer *t)
 {
+#ifdef PDDLP_STATS
+    const char *skip_start = t->current;
+    const char *comment_start;
+#endif
+
     for (;;) {
         char c = tok_peek(t);
 
@@ -183,25 +218,55 @@ tok_skip_whitespace(struct pddlp_tokenizer *t)
             t->column = 0;
             tok_advance(t);
         } else if (c == ';') {
+#ifdef PDDLP_STATS
+            comment_start = t->current;
+#endif
             while (tok_peek(t) != '\n' && !tok_is_at_end(t))
                 tok_advance(t);
+
+            __PDDLP_STAT(t,
+                stats->comment_bytes += t->current - comment_start;
+                stats->whitespace_bytes -= t->current - comment_start);
         } else {
-            return;
+            break;
         }
 
     }
+
+    __PDDLP_STAT(t, stats->whitespace_bytes += t->current - skip_start);
+}
+
+static struct pddlp_token
+tok_error_token(struct pddlp_tokenizer *t, enum pddlp_token_error error)
+{
+    struct pddlp_token token;
+    const char *message = pddlp_token_error_messages[error];
+
+    __PDDLP_STAT(t, stats->error_counts[error]++);
+
+    token.token_type = PDDLP_TOKEN_ERROR;
+    token.start = message;
+    token.length = strlen(message);
+    token.line = t->line;
+    token.column = t->column - (t->current - t->start);
+
+    return token;
 }
 
 static struct pddlp_token
 tok_make_token(struct pddlp_tokenizer *t, enum pddlp_token_type token_type)
 {
     struct pddlp_token token;
+    size_t length = t->current - t->start;
+
+    if (length > UINT32_MAX)
+        return tok_error_token(t, PDDLP_TOKEN_ERROR_TOO_LONG);
 
     token.token_type = token_type;
     token.start = t->start;
-    token.length = t->current - t->start;
+    token.length = length;
     token.line = t->line;
-    token.column = t->column - token.length;
+    token.column = t->column - length;
 
     return token;
 }
@@ -216,23 +281,10 @@ tok_make_if_match(
     return tok_make_token(t, tok_match(t, expected) ? if_match : if_not_match);
 }
 
-static struct pddlp_token
-tok_error_token(struct pddlp_tokenizer *t, const char *message)
-{
-    struct pddlp_token token;
-
-    token.token_type = PDDLP_TOKEN_ERROR;
-    token.start = message;
-    token.length = strlen(message);
-    token.line = t->line;
-    token.column = t->column - (t->current - t->start);
-
-    return token;
-}
 
 #define __PDDLP_NAME(name, token)                                       \
 do {                                                                    \
-    int name_length = sizeof(name) - 1;                                 \
+    size_t name_length = sizeof(name) - 1;                              \
     if (token_length == name_length && t->start[1] == name[1] &&        \
         (name_length <= 2 || t->start[2] == name[2]) &&                 \
         (name_length <= 3 || t->start[3] == name[3]) &&                 \
@@ -254,7 +306,7 @@ static enum pddlp_token_type
 tok_name_type(struct pddlp_tokenizer *t)
 {
 
-    int token_length = t->current - t->start;
+    size_t token_length = t->current - t->start;
 
     // user-defined names can be any length, but language
     // keywords are only >= 2 (at, or) and <= 15 (sometime-before).
@@ -315,6 +367,7 @@ tok_name_type(struct pddlp_tokenizer *t)
         __PDDLP_NAME("problem", PDDLP_TOKEN_PROBLEM);
         break;
     case 's':
+        __PDDLP_NAME("scale-down", PDDLP_TOKEN_SCALE_DOWN);
         __PDDLP_NAME("scale-up", PDDLP_TOKEN_SCALE_UP);
         __PDDLP_NAME("start", PDDLP_TOKEN_START);
         __PDDLP_NAME("sometime", PDDLP_TOKEN_SOMETIME);
@@ -341,7 +394,7 @@ tok_name_type(struct pddlp_tokenizer *t)
 
 #define __PDDLP_SYM(symbol, token)                                      \
 do {                                                                    \
-    int symbol_length = sizeof(symbol) - 1;                             \
+    size_t symbol_length = sizeof(symbol) - 1;                          \
     if (token_length == symbol_length && start[1] == symbol[1] &&       \
         (symbol_length <= 2 || start[2] == symbol[2]) &&                \
         (symbol_length <= 3 || start[3] == symbol[3]) &&                \
@@ -375,7 +428,7 @@ tok_symbol_type(struct pddlp_tokenizer *t)
     // we skip one character to avoid dealing with ':'
     const char *start = t->start + 1;
 
-    int token_length = t->current - start;
+    size_t token_length = t->current - start;
 
     // symbols can have length of >= 3 (adl) and <= 25 (disjunctive-preconditions)
     if (token_length < 3 || token_length > 25)
@@ -495,7 +548,19 @@ tok_tokenize_name(struct pddlp_tokenizer *t)
 {
     while (tok_is_any_char(tok_peek(t))) tok_advance(t);
 
-    return tok_make_token(t, tok_name_type(t));
+    enum pddlp_token_type token_type = tok_name_type(t);
+
+    __PDDLP_STAT(t,
+        if (token_type != PDDLP_TOKEN_NAME) {
+            stats->keyword_hits++;
+        } else {
+            size_t length = t->current - t->start;
+            stats->keyword_misses++;
+            stats->name_lengths[length < PDDLP_STATS_NAME_LENGTHS
+                ? length : PDDLP_STATS_NAME_LENGTHS - 1]++;
+        });
+
+    return tok_make_token(t, token_type);
 }
 
 static struct pddlp_token
@@ -505,7 +570,7 @@ tok_tokenize_symbol(struct pddlp_tokenizer *t)
 
     enum pddlp_token_type token_type = tok_symbol_type(t);
     if (token_type == PDDLP_TOKEN_ERROR)
-        return tok_error_token(t, "unknown symbol");
+        return tok_error_token(t, PDDLP_TOKEN_ERROR_UNKNOWN_SYMBOL);
 
     return tok_make_token(t, token_type);
 }
@@ -520,7 +585,7 @@ tok_tokenize_variable(struct pddlp_tokenizer *t)
     while (tok_is_any_char(tok_peek(t))) tok_advance(t);
 
     if (should_error)
-        return tok_error_token(t, "first character of a variable should be a letter");
+        return tok_error_token(t, PDDLP_TOKEN_ERROR_VARIABLE_FIRST_CHAR);
 
     return tok_make_token(t, PDDLP_TOKEN_VARIABLE);
 }
@@ -532,10 +597,21 @@ pddlp_init_tokenizer(struct pddlp_tokenizer *t, const char *source)
     t->current = source;
     t->line = 1;
     t->column = 1;
+
+    t->lookahead_head = 0;
+    t->lookahead_count = 0;
+
+#ifdef PDDLP_STATS
+    t->stats = NULL;
+    t->stats_depth = 0;
+    t->stats_section = -1;
+    t->stats_previous = PDDLP_TOKEN_EOF;
+    t->stats_section_start = 0;
+#endif
 }
 
-struct pddlp_token
-pddlp_scan_token(struct pddlp_tokenizer *t)
+static struct pddlp_token
+tok_scan_token(struct pddlp_tokenizer *t)
 {
     tok_skip_whitespace(t);
     t->start = t->current;
@@ -563,5 +639,515 @@ pddlp_scan_token(struct pddlp_tokenizer *t)
     case '#': if (tok_match(t, 't')) return tok_make_token(t, PDDLP_TOKEN_HASH_T);
     }
 
-    return tok_error_token(t, "unrecognized character");
+    return tok_error_token(t, PDDLP_TOKEN_ERROR_UNRECOGNIZED_CHARACTER);
+}
+
+#ifdef PDDLP_STATS
+static uint64_t
+tok_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// top-level sections are the lists directly inside `(define ...)`, so they
+// open at depth 2 and are named by the token right after their '('.
+static void
+tok_record_token(struct pddlp_tokenizer *t, struct pddlp_stats *stats, struct pddlp_token token)
+{
+    enum pddlp_token_type token_type = token.token_type;
+
+    stats->token_counts[token_type]++;
+
+    if (token_type == PDDLP_TOKEN_LPAREN) {
+        t->stats_depth++;
+    } else if (token_type == PDDLP_TOKEN_RPAREN) {
+        if (t->stats_depth == 2 && t->stats_section >= 0) {
+            stats->section_nanoseconds[t->stats_section] += tok_now() - t->stats_section_start;
+            t->stats_section = -1;
+        }
+        t->stats_depth--;
+    } else if (t->stats_depth == 2 && t->stats_previous == PDDLP_TOKEN_LPAREN) {
+        t->stats_section = token_type;
+        t->stats_section_start = tok_now();
+    }
+
+    t->stats_previous = token_type;
+}
+
+void
+pddlp_attach_stats(struct pddlp_tokenizer *t, struct pddlp_stats *stats)
+{
+    t->stats = stats;
+}
+#endif
+
+void
+pddlp_init_stats(struct pddlp_stats *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+}
+
+struct pddlp_token
+pddlp_scan_token(struct pddlp_tokenizer *t)
+{
+#ifdef PDDLP_STATS
+    struct pddlp_token token = tok_scan_token(t);
+
+    __PDDLP_STAT(t,
+        if (token.token_type != PDDLP_TOKEN_ERROR)
+            stats->token_bytes += token.length;
+        tok_record_token(t, stats, token));
+
+    return token;
+#else
+    return tok_scan_token(t);
+#endif
+}
+
+// scans until the ring is full, stopping early at the end of the input.
+static void
+tok_fill_lookahead(struct pddlp_tokenizer *t)
+{
+    while (t->lookahead_count < PDDLP_LOOKAHEAD) {
+        struct pddlp_token token = pddlp_scan_token(t);
+        uint32_t index = (t->lookahead_head + t->lookahead_count) & (PDDLP_LOOKAHEAD - 1);
+
+        t->lookahead[index] = token;
+        t->lookahead_count++;
+
+        if (token.token_type == PDDLP_TOKEN_EOF)
+            break;
+    }
+}
+
+struct pddlp_token
+pddlp_peek_token(struct pddlp_tokenizer *t, unsigned k)
+{
+    struct pddlp_token last;
+
+    if (k >= t->lookahead_count)
+        tok_fill_lookahead(t);
+
+    if (k < t->lookahead_count)
+        return t->lookahead[(t->lookahead_head + k) & (PDDLP_LOOKAHEAD - 1)];
+
+    // the ring is either full or ends in EOF. past the end of the input,
+    // every token is EOF, but a full ring doesn't know the k-th token, so
+    // report the misuse at the last buffered one instead of guessing.
+    last = t->lookahead[(t->lookahead_head + t->lookahead_count - 1) & (PDDLP_LOOKAHEAD - 1)];
+    if (last.token_type != PDDLP_TOKEN_EOF) {
+        const char *message = pddlp_token_error_messages[PDDLP_TOKEN_ERROR_LOOKAHEAD];
+
+        last.token_type = PDDLP_TOKEN_ERROR;
+        last.start = message;
+        last.length = strlen(message);
+    }
+
+    return last;
+}
+
+struct pddlp_token
+pddlp_next_token(struct pddlp_tokenizer *t)
+{
+    if (t->lookahead_count == 0)
+        tok_fill_lookahead(t);
+
+    struct pddlp_token token = t->lookahead[t->lookahead_head];
+
+    t->lookahead_head = (t->lookahead_head + 1) & (PDDLP_LOOKAHEAD - 1);
+    t->lookahead_count--;
+
+    return token;
+}
+
+// token estimation
+//
+// pddlp_estimate_tokens counts what pddlp_scan_token would return without
+// building any tokens. blocks of 64 bytes are classified into masks with a
+// bit per byte, and the tokens between the first and the last blank of a
+// block are counted with bit arithmetic. the bytes around them, which can
+// belong to tokens crossing into the neighbouring blocks, go through a state
+// machine a byte at a time, as do the few blocks the masks can't decide.
+
+// the masks can start a block in any state up to TOK_ESTIMATE_FRACTION.
+enum tok_estimate_state {
+    TOK_ESTIMATE_BLANK,     // between tokens.
+    TOK_ESTIMATE_COMMENT,
+    TOK_ESTIMATE_WORD,      // in a name, symbol or variable.
+    TOK_ESTIMATE_INTEGER,
+    TOK_ESTIMATE_FRACTION,
+    TOK_ESTIMATE_FORCED,    // right after '?', which takes any next byte.
+    TOK_ESTIMATE_COMPARE,   // right after '<' or '>'.
+    TOK_ESTIMATE_HASH,
+};
+
+static void
+tok_estimate_byte(enum tok_estimate_state *state, uint64_t *count, char c, char next)
+{
+    switch (*state) {
+    case TOK_ESTIMATE_BLANK:
+        break;
+    case TOK_ESTIMATE_COMMENT:
+        if (c == '\n')
+            *state = TOK_ESTIMATE_BLANK;
+        return;
+    case TOK_ESTIMATE_WORD:
+        if (tok_is_any_char(c))
+            return;
+        break;
+    case TOK_ESTIMATE_FORCED:
+        *state = TOK_ESTIMATE_WORD;
+        return;
+    case TOK_ESTIMATE_INTEGER:
+        if (tok_is_digit(c))
+            return;
+        if (c == '.' && tok_is_digit(next)) {
+            *state = TOK_ESTIMATE_FRACTION;
+            return;
+        }
+        break;
+    case TOK_ESTIMATE_FRACTION:
+        if (tok_is_digit(c))
+            return;
+        break;
+    case TOK_ESTIMATE_COMPARE:
+        *state = TOK_ESTIMATE_BLANK;
+        if (c == '=')
+            return;
+        break;
+    case TOK_ESTIMATE_HASH:
+        *state = TOK_ESTIMATE_BLANK;
+        if (c == 't')
+            return;
+        break;
+    }
+
+    *state = TOK_ESTIMATE_BLANK;
+
+    if (c == ' ' || c == '\t' || c == '\r' || c == '\n')
+        return;
+
+    if (c == ';') {
+        *state = TOK_ESTIMATE_COMMENT;
+        return;
+    }
+
+    (*count)++;
+
+    if (tok_is_letter(c) || c == ':')
+        *state = TOK_ESTIMATE_WORD;
+    else if (c == '?')
+        *state = TOK_ESTIMATE_FORCED;
+    else if (tok_is_digit(c))
+        *state = TOK_ESTIMATE_INTEGER;
+    else if (c == '<' || c == '>')
+        *state = TOK_ESTIMATE_COMPARE;
+    else if (c == '#')
+        *state = TOK_ESTIMATE_HASH;
+}
+
+// runs the state machine over source[from, to), stopping early once the
+// masks can take over when `settle` is set. returns where it stopped.
+static size_t
+tok_estimate_bytes(const char *source, size_t length, size_t from, size_t to, bool settle,
+    enum tok_estimate_state *state, uint64_t *count)
+{
+    size_t i = from;
+    for (; i < to; ++i) {
+        if (settle && *state <= TOK_ESTIMATE_FRACTION)
+            break;
+        tok_estimate_byte(state, count, source[i], i + 1 < length ? source[i + 1] : 0);
+    }
+
+    return i;
+}
+
+// a bit per byte of a block for each class of character.
+struct tok_masks {
+    uint64_t blank;
+    uint64_t newline;
+    uint64_t semicolon;
+    uint64_t letter;
+    uint64_t digit;
+    uint64_t dash;          // '-' and '_'.
+    uint64_t prefix;        // ':' and '?'.
+    uint64_t question;
+    uint64_t dot;
+    uint64_t hash;
+    uint64_t t;
+    uint64_t compare;       // '<' and '>'.
+    uint64_t eq;
+};
+
+#ifdef __SSE2__
+
+static uint64_t
+tok_movemask(const __m128i *x)
+{
+    return (uint64_t)(uint16_t)_mm_movemask_epi8(x[0]) | (uint64_t)(uint16_t)_mm_movemask_epi8(x[1]) << 16
+        | (uint64_t)(uint16_t)_mm_movemask_epi8(x[2]) << 32 | (uint64_t)(uint16_t)_mm_movemask_epi8(x[3]) << 48;
+}
+
+static uint64_t
+tok_equal(const __m128i *v, char c)
+{
+    __m128i x = _mm_set1_epi8(c);
+    __m128i equal[4];
+
+    for (int i = 0; i < 4; ++i)
+        equal[i] = _mm_cmpeq_epi8(v[i], x);
+
+    return tok_movemask(equal);
+}
+
+// bytes in [low, high]. the comparisons are signed, which is fine as long as
+// both bounds are ascii.
+static __m128i
+tok_between(__m128i v, char low, char high)
+{
+    return _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8((char)(low - 1))),
+        _mm_cmplt_epi8(v, _mm_set1_epi8((char)(high + 1))));
+}
+
+static __m128i
+tok_either(__m128i v, char a, char b)
+{
+    return _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(a)), _mm_cmpeq_epi8(v, _mm_set1_epi8(b)));
+}
+
+static uint64_t
+tok_lane_bits(__m128i x, int lane)
+{
+    return (uint64_t)(uint16_t)_mm_movemask_epi8(x) << (16 * lane);
+}
+
+// each class is combined in vectors before taking its bits, a lane of 16
+// bytes at a time. the characters that only matter to a few tokens are
+// checked together first, and are usually absent from a block.
+static void
+tok_classify(const char *block, struct tok_masks *m)
+{
+    __m128i v[4];
+    __m128i rare = _mm_setzero_si128();
+
+    memset(m, 0, sizeof(*m));
+
+    for (int i = 0; i < 4; ++i) {
+        v[i] = _mm_loadu_si128((const __m128i *)(block + 16 * i));
+
+        __m128i newline = _mm_cmpeq_epi8(v[i], _mm_set1_epi8('\n'));
+        __m128i blank = _mm_or_si128(tok_either(v[i], ' ', '\t'), tok_either(v[i], '\r', '\n'));
+        __m128i letter = tok_between(_mm_or_si128(v[i], _mm_set1_epi8(0x20)), 'a', 'z');
+        __m128i semicolon = _mm_cmpeq_epi8(v[i], _mm_set1_epi8(';'));
+
+        m->newline |= tok_lane_bits(newline, i);
+        m->blank |= tok_lane_bits(blank, i);
+        m->semicolon |= tok_lane_bits(semicolon, i);
+        m->letter |= tok_lane_bits(letter, i);
+        m->digit |= tok_lane_bits(tok_between(v[i], '0', '9'), i);
+        m->dash |= tok_lane_bits(tok_either(v[i], '-', '_'), i);
+
+        // ':' to '?' are ":;<=>?".
+        __m128i punctuation = _mm_andnot_si128(semicolon, tok_between(v[i], ':', '?'));
+        rare = _mm_or_si128(rare, _mm_or_si128(punctuation, tok_either(v[i], '.', '#')));
+    }
+
+    if (_mm_movemask_epi8(rare) == 0)
+        return;
+
+    m->question = tok_equal(v, '?');
+    m->prefix = tok_equal(v, ':') | m->question;
+    m->dot = tok_equal(v, '.');
+    m->hash = tok_equal(v, '#');
+    m->t = m->hash ? tok_equal(v, 't') : 0;
+    m->compare = tok_equal(v, '<') | tok_equal(v, '>');
+    m->eq = tok_equal(v, '=');
+}
+
+#else
+
+static void
+tok_classify(const char *block, struct tok_masks *m)
+{
+    memset(m, 0, sizeof(*m));
+
+    for (int i = 0; i < 64; ++i) {
+        char c = block[i];
+        uint64_t bit = (uint64_t)1 << i;
+
+        if (tok_is_letter(c)) m->letter |= bit;
+        if (tok_is_digit(c)) m->digit |= bit;
+        if (c == 't') m->t |= bit;
+
+        switch (c) {
+        case '\n': m->newline |= bit; m->blank |= bit; break;
+        case ' ': case '\t': case '\r': m->blank |= bit; break;
+        case ';': m->semicolon |= bit; break;
+        case '-': case '_': m->dash |= bit; break;
+        case '?': m->question |= bit; m->prefix |= bit; break;
+        case ':': m->prefix |= bit; break;
+        case '.': m->dot |= bit; break;
+        case '#': m->hash |= bit; break;
+        case '<': case '>': m->compare |= bit; break;
+        case '=': m->eq |= bit; break;
+        }
+    }
+}
+
+#endif
+
+static uint32_t
+tok_popcount(uint64_t bits)
+{
+#ifdef __GNUC__
+    return __builtin_popcountll(bits);
+#else
+    uint32_t count = 0;
+    for (; bits; bits &= bits - 1)
+        count++;
+    return count;
+#endif
+}
+
+// the bytes of the comments starting from `start`, a single bit that is
+// either the ';' of the first comment or the start of the block when a
+// comment runs into it. a comment takes every byte up to its newline.
+static uint64_t
+tok_comments(uint64_t semicolons, uint64_t newlines, uint64_t start)
+{
+    uint64_t comments = 0;
+
+    while (start) {
+        uint64_t after = newlines & ~(start - 1);
+        uint64_t end = after & -after;
+        if (end == 0)
+            return comments | ~(start - 1);
+
+        comments |= end - start;
+        semicolons &= ~(end - 1);
+        start = semicolons & -semicolons;
+    }
+
+    return comments;
+}
+
+// fills each run of `bits` holding a bit of `seeds` at its lowest position.
+static uint64_t
+tok_fill_runs(uint64_t seeds, uint64_t bits)
+{
+    return ((seeds + bits) ^ bits) & bits;
+}
+
+// counts the tokens starting in `range`, which runs from the byte the block
+// is entered at in `*state` to its end, and leaves the state at the end of
+// the block in `*state`. `next` is the byte after the block, or 0. returns
+// false, counting nothing, for what masks can't decide: a '?' takes the next
+// byte whatever it is, and in "1.2.3" whether the second '.' is part of a
+// number depends on the first.
+static bool
+tok_estimate_masks(const struct tok_masks *m, uint64_t range, char next, enum tok_estimate_state *state,
+    uint64_t *count)
+{
+    const uint64_t last = (uint64_t)1 << 63;
+    uint64_t first = range & -range;
+    enum tok_estimate_state entry = *state;
+    bool in_number = entry == TOK_ESTIMATE_INTEGER || entry == TOK_ESTIMATE_FRACTION;
+
+    uint64_t start = entry == TOK_ESTIMATE_COMMENT ? first : m->semicolon & range & -(m->semicolon & range);
+    uint64_t comments = tok_comments(m->semicolon & range, m->newline, start);
+    uint64_t live = range & ~m->blank & ~comments;
+
+    uint64_t any = m->letter | m->digit | m->dash;
+    uint64_t next_any = any >> 1 | (tok_is_any_char(next) ? last : 0);
+    uint64_t next_digit = m->digit >> 1 | (tok_is_digit(next) ? last : 0);
+    if (m->question & live & ~next_any)
+        return false;
+
+    uint64_t dot = m->dot & live;
+    uint64_t digit = m->digit & live;
+    uint64_t after_dot = digit & (dot << 1 | (entry == TOK_ESTIMATE_FRACTION ? first : 0));
+    if (dot & tok_fill_runs(after_dot, digit) << 1 & next_digit)
+        return false;
+
+    // the 't' of "#t" ends its token.
+    uint64_t hash_t = m->t & (m->hash & live) << 1;
+    uint64_t word = any & live & ~hash_t;
+
+    // runs of name characters right after ':' or '?' are part of their
+    // symbol or variable, as is one running into the block from a word. the
+    // others start a token, or go on with a number, and their characters up
+    // to the first letter are each '-' and '_' on their own and numbers.
+    // the first letter starts a name that takes the rest of the run.
+    uint64_t before = entry >= TOK_ESTIMATE_WORD ? first : 0;
+    uint64_t seeds = (word & ~(word << 1 | before) & ~((m->prefix & live) << 1)) | (in_number ? word & first : 0);
+    uint64_t non_letter = word & ~m->letter;
+    uint64_t before_letter = tok_fill_runs(seeds & non_letter, non_letter);
+    uint64_t first_letter = m->letter & word & (before_letter << 1 | seeds);
+
+    uint64_t integer = before_letter & m->digit;
+    uint64_t decimal = dot & (integer << 1 | (entry == TOK_ESTIMATE_INTEGER ? first : 0)) & next_digit;
+    uint64_t number_before = m->digit << 1 | (in_number ? first : 0) | decimal << 1;
+    uint64_t word_starts = first_letter | (before_letter & m->dash) | (integer & ~number_before);
+
+    uint64_t compare_eq = m->eq & (m->compare & live) << 1;
+    uint64_t other_starts = live & ~word & ~hash_t & ~compare_eq & ~decimal;
+
+    *count += tok_popcount(word_starts | other_starts);
+
+    // the state after the last byte.
+    if (comments & last) {
+        *state = TOK_ESTIMATE_COMMENT;
+    } else if (!(live & last) || hash_t & last || compare_eq & last) {
+        *state = TOK_ESTIMATE_BLANK;
+    } else if (word & last) {
+        uint64_t fraction = tok_fill_runs(digit & (decimal << 1 | (entry == TOK_ESTIMATE_FRACTION ? first : 0)), digit);
+        if (!(before_letter & last))
+            *state = TOK_ESTIMATE_WORD;
+        else if (!(integer & last))
+            *state = TOK_ESTIMATE_BLANK;
+        else
+            *state = fraction & last ? TOK_ESTIMATE_FRACTION : TOK_ESTIMATE_INTEGER;
+    } else if (decimal & last) {
+        *state = TOK_ESTIMATE_FRACTION;
+    } else if (m->question & last) {
+        *state = TOK_ESTIMATE_FORCED;
+    } else if (m->prefix & last) {
+        *state = TOK_ESTIMATE_WORD;
+    } else if (m->compare & last) {
+        *state = TOK_ESTIMATE_COMPARE;
+    } else if (m->hash & last) {
+        *state = TOK_ESTIMATE_HASH;
+    } else {
+        *state = TOK_ESTIMATE_BLANK;
+    }
+
+    return true;
+}
+
+uint64_t
+pddlp_estimate_tokens(const char *source, size_t length)
+{
+    enum tok_estimate_state state = TOK_ESTIMATE_BLANK;
+    uint64_t count = 0;
+    size_t block = 0;
+
+    for (; block + 64 <= length; block += 64) {
+        // finishes "<=", "#t" and the byte after '?'.
+        size_t from = tok_estimate_bytes(source, length, block, block + 64, true, &state, &count);
+        if (from == block + 64)
+            continue;
+
+        struct tok_masks m;
+        tok_classify(source + block, &m);
+
+        uint64_t range = ~(uint64_t)0 << (from - block);
+        char next = block + 64 < length ? source[block + 64] : 0;
+        if (!tok_estimate_masks(&m, range, next, &state, &count))
+            tok_estimate_bytes(source, length, from, block + 64, false, &state, &count);
+    }
+
+    tok_estimate_bytes(source, length, block, length, false, &state, &count);
+    return count;
 }
@@ -4,6 +4,29 @@
 #ifndef PDDLP_H_
 #define PDDLP_H_
 
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// every public function is declared with PDDLP_API, and every public table
+// is defined with PDDLP_DATA. the single-header build (pddlp_impl.h) defines
+// PDDLP_STATIC so both get internal linkage, which lets the compiler inline
+// the tokenizer straight into the caller's loop.
+#ifdef PDDLP_STATIC
+#define PDDLP_API static inline
+#ifdef __GNUC__
+#define PDDLP_DATA static __attribute__((unused))
+#else
+#define PDDLP_DATA static
+#endif
+#else
+#define PDDLP_API
+#define PDDLP_DATA
+#endif
+
+// the version of the library, the same as in meson.build.
+#define PDDLP_VERSION "0.1"
+
 enum pddlp_token_type {
     PDDLP_TOKEN_LPAREN,
     PDDLP_TOKEN_RPAREN,
@@ -50,6 +73,7 @@ enum pddlp_token_type {
     PDDLP_TOKEN_OVER,
     PDDLP_TOKEN_PREFERENCE,
     PDDLP_TOKEN_PROBLEM,
+    PDDLP_TOKEN_SCALE_DOWN,
     PDDLP_TOKEN_SCALE_UP,
     PDDLP_TOKEN_START,
     PDDLP_TOKEN_SOMETIME,
@@ -109,29 +133,1111 @@ enum pddlp_token_type {
     PDDLP_TOKEN_ERROR,
 };
 
+#define PDDLP_TOKEN_TYPE_COUNT (PDDLP_TOKEN_ERROR + 1)
+
+#ifndef PDDLP_STATIC
 extern const char *pddlp_token_type_names[];
+#endif
+
+// error tokens point `start` at one of these messages.
+enum pddlp_token_error {
+    PDDLP_TOKEN_ERROR_UNKNOWN_SYMBOL,
+    PDDLP_TOKEN_ERROR_VARIABLE_FIRST_CHAR,
+    PDDLP_TOKEN_ERROR_UNRECOGNIZED_CHARACTER,
+    PDDLP_TOKEN_ERROR_TOO_LONG,
+    PDDLP_TOKEN_ERROR_LOOKAHEAD,
+
+    PDDLP_TOKEN_ERROR_COUNT,
+};
+
+#ifndef PDDLP_STATIC
+extern const char *pddlp_token_error_messages[];
+#endif
 
+// names longer than this are counted in the last histogram bucket.
+#define PDDLP_STATS_NAME_LENGTHS 32
+
+// tokenizer instrumentation. only collected when the library is built with
+// the `with_stats` meson option, which defines PDDLP_STATS. otherwise the
+// collection code is compiled out entirely.
+struct pddlp_stats {
+    uint64_t token_counts[PDDLP_TOKEN_TYPE_COUNT];
+    uint64_t error_counts[PDDLP_TOKEN_ERROR_COUNT];
+
+    uint64_t token_bytes;
+    uint64_t whitespace_bytes;
+    uint64_t comment_bytes;
+
+    uint64_t name_lengths[PDDLP_STATS_NAME_LENGTHS];
+
+    // names that matched / did not match a language keyword.
+    uint64_t keyword_hits;
+    uint64_t keyword_misses;
+
+    // wall time spent inside each top-level section, keyed by the token
+    // that opens it (PDDLP_TOKEN_SYM_INIT for `(:init ...)`, and so on).
+    uint64_t section_nanoseconds[PDDLP_TOKEN_TYPE_COUNT];
+};
+
+// positions are 64-bit so inputs of any size can be tokenized. the length
+// is kept at 32 bits, which keeps the struct at 32 bytes; a single token
+// longer than UINT32_MAX bytes is reported as PDDLP_TOKEN_ERROR_TOO_LONG.
 struct pddlp_token {
     enum pddlp_token_type token_type;
+    uint32_t length;
     const char *start;
-    int length;
 
-    int line;
-    int column;
+    uint64_t line;
+    uint64_t column;
 };
 
+// how many tokens pddlp_peek_token can look ahead. must be a power of two.
+#define PDDLP_LOOKAHEAD 16
+
 struct pddlp_tokenizer {
     const char *start;
     const char *current;
 
-    int line;
-    int column;
+    uint64_t line;
+    uint64_t column;
+
+    // ring of tokens already scanned by pddlp_peek_token/pddlp_next_token,
+    // but not yet consumed.
+    struct pddlp_token lookahead[PDDLP_LOOKAHEAD];
+    uint32_t lookahead_head;
+    uint32_t lookahead_count;
+
+#ifdef PDDLP_STATS
+    struct pddlp_stats *stats;
+
+    // bookkeeping used to detect section boundaries. it follows this
+    // tokenizer's input, so it is kept here rather than in the stats.
+    int stats_depth;
+    int stats_section;
+    enum pddlp_token_type stats_previous;
+    uint64_t stats_section_start;
+#endif
 };
 
-void
+PDDLP_API void
 pddlp_init_tokenizer(struct pddlp_tokenizer *, const char *source);
 
-struct pddlp_token
+PDDLP_API struct pddlp_token
 pddlp_scan_token(struct pddlp_tokenizer *);
 
+// buffered alternatives to pddlp_scan_token. pddlp_peek_token returns the
+// k-th token after the current one (0 is the token pddlp_next_token would
+// return) without consuming anything. past the end of the input it returns
+// EOF, and a k of PDDLP_LOOKAHEAD or more that doesn't reach the end gets a
+// PDDLP_TOKEN_ERROR_LOOKAHEAD error token. tokens are scanned into the ring
+// in batches, so peeking never rescans. don't mix these with
+// pddlp_scan_token on the same tokenizer, since that would skip the
+// buffered tokens.
+PDDLP_API struct pddlp_token
+pddlp_peek_token(struct pddlp_tokenizer *, unsigned k);
+
+PDDLP_API struct pddlp_token
+pddlp_next_token(struct pddlp_tokenizer *);
+
+// counts the tokens pddlp_scan_token returns for the first `length` bytes of
+// source, EOF aside, without scanning them, so token arrays can be allocated
+// once. the count is exact unless there is a zero byte among them, where the
+// tokenizer would stop early, and is an upper bound then.
+PDDLP_API uint64_t
+pddlp_estimate_tokens(const char *source, size_t length);
+
+PDDLP_API void
+pddlp_init_stats(struct pddlp_stats *);
+
+#ifdef PDDLP_STATS
+// starts collecting into `stats`, which must outlive the tokenizer. the same
+// stats can be attached to several tokenizers to aggregate their counts,
+// interleaved or one after another, as long as they run on one thread.
+PDDLP_API void
+pddlp_attach_stats(struct pddlp_tokenizer *, struct pddlp_stats *);
+#endif
+
+// parser
+//
+// domains and problems are parsed into flat arrays of interned entries. ids
+// are indexes into those arrays, and PDDLP_NONE marks a missing id. all the
+// arrays are owned by the domain or problem and must be treated as
+// read-only.
+
+#define PDDLP_NONE UINT32_MAX
+
+// bit of a requirement symbol (PDDLP_TOKEN_SYM_STRIPS, ...) in a requirement
+// mask.
+#define PDDLP_REQUIREMENT(token_type) (UINT64_C(1) << ((token_type) - PDDLP_TOKEN_SYM_ACTION))
+
+struct pddlp_error {
+    const char *message;
+    uint64_t line;
+    uint64_t column;
+};
+
+// an entry of a typed list, like `truck1 - truck` or `?x - (either a b)`.
+// types are stored in the `type_refs` array of the owner.
+struct pddlp_typed_name {
+    const char *name;
+    uint32_t type_first;
+    uint32_t type_count;
+};
+
+enum pddlp_node_type {
+    PDDLP_NODE_ATOM,            // `value` is a predicate, children are terms.
+    PDDLP_NODE_FUNCTION,        // `value` is a function, children are terms.
+    PDDLP_NODE_OBJECT,          // `value` is an object (a constant in domains).
+    PDDLP_NODE_VARIABLE,        // `value` indexes the owner's `variables`.
+    PDDLP_NODE_NUMBER,          // `value` indexes `numbers`.
+    PDDLP_NODE_COMPOUND,        // `op` is the keyword or operator.
+};
+
+// compound nodes keep their keyword in `op`, and their operands as children:
+//
+//   AND, OR, NOT, IMPLY, WHEN       subformulas or effects.
+//   FORALL, EXISTS                  the bound VARIABLE nodes, then the body.
+//   EQ, LT, LTE, GT, GTE            two terms or numeric expressions.
+//   PLUS, MINUS, STAR, SLASH        numeric expressions. MINUS may be unary.
+//   ASSIGN, INCREASE, DECREASE,
+//   SCALE_UP, SCALE_DOWN            the function term, then the expression.
+//   AT                              `value` is START or END, with one child.
+//                                   timed initial literals have `value` set
+//                                   to PDDLP_NONE, with a NUMBER child first.
+//   OVER                            `value` is ALL, with one child.
+//   PREFERENCE, IS_VIOLATED         `value` indexes `names`, or PDDLP_NONE.
+//   ALWAYS, SOMETIME, WITHIN, ...   operands in order, numbers as NUMBER.
+//   TOTAL_TIME                      no children.
+struct pddlp_node {
+    enum pddlp_node_type node_type;
+    enum pddlp_token_type op;
+    uint32_t value;
+    uint32_t first;
+    uint32_t count;
+};
+
+// nodes come after their children, and equal subformulas are the same
+// node, so the nodes form a DAG and can be compared by id.
+struct pddlp_formulas {
+    struct pddlp_node *nodes;
+    uint32_t node_count;
+
+    // children of node n are children[n.first .. n.first + n.count).
+    uint32_t *children;
+    uint32_t child_count;
+
+    double *numbers;
+    uint32_t number_count;
+
+    // preference names.
+    const char **names;
+    uint32_t name_count;
+};
+
+struct pddlp_predicate {
+    const char *name;
+    uint32_t param_first;       // into `variables`.
+    uint32_t param_count;
+};
+
+// the variables of an action are variables[variable_first ..
+// variable_first + variable_count). the first `param_count` are its
+// parameters, the rest are bound by quantifiers (and ?duration).
+struct pddlp_action {
+    const char *name;
+    bool durative;
+
+    uint32_t variable_first;
+    uint32_t param_count;
+    uint32_t variable_count;
+
+    // root nodes, or PDDLP_NONE. durative actions keep their :condition
+    // in `precondition`.
+    uint32_t precondition;
+    uint32_t effect;
+    uint32_t duration;
+};
+
+struct pddlp_derived {
+    uint32_t predicate;
+
+    uint32_t variable_first;
+    uint32_t param_count;
+    uint32_t variable_count;
+
+    uint32_t formula;
+};
+
+// domains are immutable once parsed, so any number of threads may read them
+// and parse problems against them without locking.
+struct pddlp_domain {
+    const char *name;
+    uint64_t requirements;
+
+    // type 0 is always `object`. the type_refs of a type are its parents.
+    struct pddlp_typed_name *types;
+    uint32_t type_count;
+
+    struct pddlp_typed_name *constants;
+    uint32_t constant_count;
+
+    struct pddlp_predicate *predicates;
+    uint32_t predicate_count;
+
+    struct pddlp_predicate *functions;
+    uint32_t function_count;
+
+    struct pddlp_action *actions;
+    uint32_t action_count;
+
+    struct pddlp_derived *derived;
+    uint32_t derived_count;
+
+    struct pddlp_typed_name *variables;
+    uint32_t variable_count;
+
+    uint32_t *type_refs;
+    uint32_t type_ref_count;
+
+    // the transitive closure of the hierarchy: bit u of
+    // supertypes[t * type_words ..] is set when t is u or one of its
+    // subtypes.
+    uint64_t *supertypes;
+    uint32_t type_words;
+
+    uint32_t constraints;
+
+    struct pddlp_formulas formulas;
+};
+
+struct pddlp_problem {
+    const struct pddlp_domain *domain;
+    const char *name;
+    uint64_t requirements;
+
+    // the domain constants come first, with the same ids they have in the
+    // domain. types are domain type ids.
+    struct pddlp_typed_name *objects;
+    uint32_t object_count;
+
+    uint32_t *type_refs;
+    uint32_t type_ref_count;
+
+    // bit t of object_types[o * domain->type_words ..] is set when object o
+    // is of type t, directly or through a subtype. the objects of type t are
+    // type_objects[type_objects_first[t] .. type_objects_first[t + 1]), in
+    // increasing order.
+    uint64_t *object_types;
+    uint32_t *type_objects_first;
+    uint32_t *type_objects;
+
+    // ground atoms of :init, stored column-wise. the arguments of fact i are
+    // fact_args[fact_args_first[i] ..] and there are as many as the arity of
+    // its predicate.
+    uint32_t *fact_predicates;
+    uint32_t *fact_args_first;
+    uint32_t fact_count;
+
+    uint32_t *fact_args;
+    uint32_t fact_arg_count;
+
+    // numeric :init entries, `(= (f args) value)`. arguments are also stored
+    // in fact_args.
+    uint32_t *fluent_functions;
+    uint32_t *fluent_args_first;
+    double *fluent_values;
+    uint32_t fluent_count;
+
+    // `(at time literal)` entries of :init, as AT nodes.
+    uint32_t *timed_literals;
+    uint32_t timed_literal_count;
+
+    struct pddlp_typed_name *variables;
+    uint32_t variable_count;
+
+    uint32_t goal;
+    uint32_t constraints;
+
+    // MINIMIZE or MAXIMIZE when there is a :metric.
+    enum pddlp_token_type metric_op;
+    uint32_t metric;
+
+    struct pddlp_formulas formulas;
+};
+
+// returns NULL and fills `error` when the source is not a valid domain.
+// domains are reference counted, and this returns the first reference.
+PDDLP_API struct pddlp_domain *
+pddlp_parse_domain(const char *source, struct pddlp_error *error);
+
+// like pddlp_parse_domain, but only accepts the constructs the :requirements
+// of the domain enable, starting from :strips and :typing, and rejects the
+// rest as errors. the :requirements must come before the sections that use
+// them. parsing takes a path specialized for the requirements, which for
+// strips domains leaves out numeric, temporal, preference and constraint
+// handling altogether. problems of such a domain are parsed the same way,
+// with their own :requirements added.
+PDDLP_API struct pddlp_domain *
+pddlp_parse_domain_strict(const char *source, struct pddlp_error *error);
+
+// like pddlp_parse_domain, but keeps the domain in a process-wide cache
+// keyed by the text of `source`, so loading the same text again just returns
+// another reference. safe to call from any thread.
+PDDLP_API struct pddlp_domain *
+pddlp_load_domain(const char *source, struct pddlp_error *error);
+
+PDDLP_API void
+pddlp_retain_domain(struct pddlp_domain *);
+
+PDDLP_API void
+pddlp_release_domain(struct pddlp_domain *);
+
+// drops the references held by the cache. domains still referenced
+// elsewhere stay alive.
+PDDLP_API void
+pddlp_clear_domain_cache(void);
+
+// the domain must outlive the problem.
+PDDLP_API struct pddlp_problem *
+pddlp_parse_problem(const struct pddlp_domain *, const char *source, struct pddlp_error *error);
+
+// like pddlp_parse_problem, but parses a large :init section on `threads`
+// threads, or one per CPU when 0. the result is the same: facts keep their
+// order, and errors are the first the sequential parser would have found.
+PDDLP_API struct pddlp_problem *
+pddlp_parse_problem_parallel(
+    const struct pddlp_domain *, const char *source, unsigned threads, struct pddlp_error *error);
+
+PDDLP_API void
+pddlp_free_problem(struct pddlp_problem *);
+
+// lookups by name. return PDDLP_NONE when there is no such entry.
+PDDLP_API uint32_t
+pddlp_find_type(const struct pddlp_domain *, const char *name, size_t length);
+
+PDDLP_API uint32_t
+pddlp_find_constant(const struct pddlp_domain *, const char *name, size_t length);
+
+PDDLP_API uint32_t
+pddlp_find_predicate(const struct pddlp_domain *, const char *name, size_t length);
+
+PDDLP_API uint32_t
+pddlp_find_function(const struct pddlp_domain *, const char *name, size_t length);
+
+PDDLP_API uint32_t
+pddlp_find_action(const struct pddlp_domain *, const char *name, size_t length);
+
+PDDLP_API uint32_t
+pddlp_find_object(const struct pddlp_problem *, const char *name, size_t length);
+
+// whether `type` is `parent` or one of its subtypes.
+PDDLP_API bool
+pddlp_is_subtype(const struct pddlp_domain *, uint32_t type, uint32_t parent);
+
+PDDLP_API bool
+pddlp_has_type(const struct pddlp_problem *, uint32_t object, uint32_t type);
+
+// :init facts
+//
+// a fact that appears more than once in :init is stored once. the lists
+// returned below are in increasing fact order, and stay valid as long as the
+// problem, until it is updated. they are built the first time they are
+// asked for, so the first call for a predicate or position costs a pass over
+// its facts. all of these are safe to call from any thread.
+
+// returns the id of the fact, or PDDLP_NONE when it is not in :init. `args`
+// has as many objects as the arity of the predicate.
+PDDLP_API uint32_t
+pddlp_find_fact(const struct pddlp_problem *, uint32_t predicate, const uint32_t *args);
+
+// the facts of `predicate`. returns NULL when out of memory.
+PDDLP_API const uint32_t *
+pddlp_predicate_facts(const struct pddlp_problem *, uint32_t predicate, uint32_t *count);
+
+// the facts of `predicate` that have `object` as argument `position`.
+// returns NULL when out of memory.
+PDDLP_API const uint32_t *
+pddlp_position_facts(const struct pddlp_problem *, uint32_t predicate, uint32_t position, uint32_t object,
+    uint32_t *count);
+
+// finds the facts of `predicate` whose arguments match `pattern`, where
+// PDDLP_NONE matches any object. writes up to `capacity` of them to `facts`
+// and returns how many there are, or PDDLP_NONE when out of memory. takes
+// time proportional to the facts that share the rarest bound argument.
+PDDLP_API uint32_t
+pddlp_match_facts(const struct pddlp_problem *, uint32_t predicate, const uint32_t *pattern, uint32_t *facts,
+    uint32_t capacity);
+
+// normalization
+//
+// pddlp_normalize rewrites a domain or problem in a canonical minified form:
+// comments are dropped, tokens are separated by single spaces (none after
+// '(' or before ')'), everything is lowercased, since pddl names are not
+// case sensitive, and the entries of `:objects` and `:init` are put in a
+// fixed order with duplicates removed. objects are sorted by type and name,
+// and facts by their hash, which is cheaper on large problems. files that
+// differ only in those ways normalize to the same text. this works on
+// tokens, so the input doesn't have to be a valid domain or problem, only
+// balanced.
+
+struct pddlp_hash128 {
+    uint64_t low;
+    uint64_t high;
+};
+
+// receives the output in pieces. returns false to stop normalizing.
+typedef bool (*pddlp_write_fn)(void *context, const char *data, size_t length);
+
+// writes the canonical form of `source` through `write`, which may be NULL,
+// and stores the hash of that form in `hash`. returns false and fills
+// `error` when the source can't be tokenized or `write` fails.
+PDDLP_API bool
+pddlp_normalize(const char *source, pddlp_write_fn write, void *context, struct pddlp_hash128 *hash,
+    struct pddlp_error *error);
+
+// updates
+//
+// a parsed problem can be changed in place, as a replanning loop does
+// between rounds, at a cost that depends on the size of the change rather
+// than that of the problem. the facts, the lists above and the objects are
+// kept up to date, but lists and arrays taken from the problem before an
+// update may have moved, and the lists lose their order. updates must not
+// run alongside any other call on the same problem.
+
+enum pddlp_change_type {
+    PDDLP_CHANGE_ADD,       // adds a fact, unless it is in :init already.
+    PDDLP_CHANGE_REMOVE,    // removes a fact, if it is in :init.
+    PDDLP_CHANGE_ASSIGN,    // sets a numeric fluent, adding it if needed.
+};
+
+struct pddlp_change {
+    enum pddlp_change_type change_type;
+
+    // a predicate, or a function for ASSIGN, and as many objects as its
+    // arity.
+    uint32_t symbol;
+    const uint32_t *args;
+
+    // the value of the fluent, for ASSIGN.
+    double value;
+};
+
+// adds an object of `type`, which is 0 for untyped ones, and returns its
+// id. returns PDDLP_NONE and fills `error` when the name is taken or out of
+// memory. adding an object moves the lists of type_objects after those of
+// its types.
+PDDLP_API uint32_t
+pddlp_add_object(struct pddlp_problem *, const char *name, size_t length, uint32_t type,
+    struct pddlp_error *error);
+
+// applies `changes` in order. removing a fact gives its id to the last one.
+// returns false and fills `error` when a change has an unknown symbol or
+// object, or out of memory, with the changes before it applied.
+PDDLP_API bool
+pddlp_apply_changes(struct pddlp_problem *, const struct pddlp_change *changes, uint32_t count,
+    struct pddlp_error *error);
+
+// writes the problem as it is now through `write`. `source` is the text it
+// was parsed from, which is copied as is except for :init, written from the
+// facts, fluents and timed literals, and the objects added since, which go
+// into :objects. returns false and fills `error` when `source` isn't that
+// text or `write` fails.
+PDDLP_API bool
+pddlp_write_problem(const struct pddlp_problem *, const char *source, pddlp_write_fn write, void *context,
+    struct pddlp_error *error);
+
+// checking
+//
+// pddlp_new_checker and pddlp_check_problem check that a domain and its
+// problems are consistent without parsing them: names are declared before
+// they are used, atoms and function terms have as many arguments as their
+// declarations, and objects and constants are of the types their positions
+// ask for. variables only have to share some object with those types, and
+// `either` types aren't checked. this works in a single pass over the tokens
+// with tables of the declared names, so it runs at close to the speed of
+// the tokenizer, and it carries on after each mistake to report the next
+// one. what the parser would reject for other reasons, like constructs the
+// :requirements don't enable, isn't looked at.
+
+struct pddlp_checker;
+
+// receives each mistake, with the position of its token. returns false to
+// stop checking.
+typedef bool (*pddlp_report_fn)(void *context, const struct pddlp_error *error);
+
+// checks `source` as a domain, through `report`, which may be NULL, and
+// returns a checker for its problems. `valid` is set to whether nothing was
+// reported. returns NULL when out of memory.
+PDDLP_API struct pddlp_checker *
+pddlp_new_checker(const char *source, pddlp_report_fn report, void *context, bool *valid);
+
+PDDLP_API void
+pddlp_free_checker(struct pddlp_checker *);
+
+// returns whether `source` is a problem of the checker's domain with
+// nothing to report. the checker is only read, so many problems can be
+// checked against it at once from different threads.
+PDDLP_API bool
+pddlp_check_problem(const struct pddlp_checker *, const char *source, pddlp_report_fn report, void *context);
+
+// conditions
+//
+// pddlp_compile_conditions rewrites the preconditions of the actions and the
+// goal of a problem into negation normal form: `imply` becomes `or`, `not`
+// is pushed down to the atoms, `forall` and `exists` are expanded into an
+// `and` or an `or` over the objects of their types, and nested `and`s and
+// `or`s are flattened into a single list of operands. the nodes are
+// hash-consed, so identical subformulas, across all the conditions, are the
+// same node. each condition is also laid out as a list of steps that test
+// one atom and jump forward to the next step to test, so it is evaluated in
+// a single loop, stopping as soon as the result is known. numeric
+// comparisons, preferences and durative actions are not supported.
+
+enum pddlp_condition_type {
+    PDDLP_CONDITION_TRUE,
+    PDDLP_CONDITION_FALSE,
+    PDDLP_CONDITION_ATOM,       // `value` is a predicate, terms are its arguments.
+    PDDLP_CONDITION_EQUAL,      // two terms.
+    PDDLP_CONDITION_AND,        // operands are nodes.
+    PDDLP_CONDITION_OR,
+};
+
+// terms with this bit set are parameters of the action, the others are
+// objects.
+#define PDDLP_CONDITION_PARAM 0x80000000u
+
+// atoms and equalities may be negated. the terms or operands of a node are
+// terms[first ..] or operands[first ..], `count` of them. operands are
+// sorted and unique.
+struct pddlp_condition_node {
+    enum pddlp_condition_type type;
+    bool negated;
+    uint32_t value;
+    uint32_t first;
+    uint32_t count;
+};
+
+// tests the atom or equality `node`, and goes on to step `on_true` or
+// `on_false`, or stops at one of these.
+#define PDDLP_CONDITION_HOLDS 0xfffffffeu
+#define PDDLP_CONDITION_FAILS 0xffffffffu
+
+struct pddlp_condition_step {
+    uint32_t node;
+    uint32_t on_true;
+    uint32_t on_false;
+};
+
+// the steps of a condition are steps[first .. first + count), starting at
+// the first one. a condition without steps is the constant at `root`.
+struct pddlp_condition {
+    uint32_t root;
+    uint32_t first;
+    uint32_t count;
+};
+
+struct pddlp_conditions {
+    const struct pddlp_problem *problem;
+
+    struct pddlp_condition_node *nodes;
+    uint32_t node_count;
+
+    uint32_t *operands;
+    uint32_t operand_count;
+
+    uint32_t *terms;
+    uint32_t term_count;
+
+    struct pddlp_condition_step *steps;
+    uint32_t step_count;
+
+    // one per action.
+    struct pddlp_condition *preconditions;
+    struct pddlp_condition goal;
+
+    // the scratch pddlp_condition_holds needs, in words.
+    uint32_t scratch_count;
+
+    // bytes held by the arrays above.
+    size_t memory;
+};
+
+// the problem must outlive the result.
+PDDLP_API struct pddlp_conditions *
+pddlp_compile_conditions(const struct pddlp_problem *, struct pddlp_error *error);
+
+PDDLP_API void
+pddlp_free_conditions(struct pddlp_conditions *);
+
+// whether the atom of `predicate` with `args` holds, for
+// pddlp_condition_holds.
+typedef bool (*pddlp_holds_fn)(void *context, uint32_t predicate, const uint32_t *args);
+
+// evaluates `condition` with the action's parameters bound to `params`,
+// calling `holds` for each atom. `scratch` has room for scratch_count words,
+// so threads with their own scratch can evaluate at once.
+PDDLP_API bool
+pddlp_condition_holds(const struct pddlp_conditions *, const struct pddlp_condition *condition,
+    const uint32_t *params, pddlp_holds_fn holds, void *context, uint32_t *scratch);
+
+// grounding
+//
+// pddlp_ground instantiates the actions of a strips problem into operators
+// over a dense numbering of the facts they mention. predicates that no
+// action changes are static: they are evaluated while grounding and don't
+// get facts. numeric comparisons and effects are left out of the
+// operators, for pddlp_compile_numeric.
+
+// the facts of an operator are operator_facts[pre .. add) for its
+// preconditions, [add .. del) for its add effects and [del .. end) for its
+// delete effects, each sorted. the parameters it was grounded with are
+// operator_args[args ..].
+struct pddlp_operator {
+    uint32_t action;
+    uint32_t args;
+    uint32_t pre;
+    uint32_t add;
+    uint32_t del;
+    uint32_t end;
+};
+
+struct pddlp_strips {
+    const struct pddlp_problem *problem;
+
+    // fact i is fact_predicates[i] applied to fact_args[fact_args_first[i] ..].
+    uint32_t *fact_predicates;
+    uint32_t *fact_args_first;
+    uint32_t *fact_args;
+    uint32_t fact_count;
+
+    struct pddlp_operator *operators;
+    uint32_t operator_count;
+
+    uint32_t *operator_args;
+    uint32_t operator_arg_count;
+
+    uint32_t *operator_facts;
+    uint32_t operator_fact_count;
+
+    uint32_t *init;
+    uint32_t init_count;
+
+    uint32_t *goal;
+    uint32_t goal_count;
+
+    // bytes held by the arrays above.
+    size_t memory;
+};
+
+// states are bitsets of this many words, with fact i at bit i % 64 of word
+// i / 64.
+#define PDDLP_STATE_WORDS(fact_count) (((size_t)(fact_count) + 63) / 64)
+
+// grounds each action schema on its own thread, up to `threads` of them at
+// once. 0 uses one thread per online cpu. the result doesn't depend on the
+// number of threads. the problem must outlive the result.
+PDDLP_API struct pddlp_strips *
+pddlp_ground(const struct pddlp_problem *, unsigned threads, struct pddlp_error *error);
+
+// grounds only the operators that are reachable from :init when delete
+// effects are ignored, which no plan can do without. the reachable facts are
+// found with a fixpoint on the calling thread, joining each new fact with the
+// fluent preconditions it matches, and only the bindings that join are
+// grounded. facts keep their meaning, but not their numbering, across the
+// two groundings.
+PDDLP_API struct pddlp_strips *
+pddlp_ground_reachable(const struct pddlp_problem *, struct pddlp_error *error);
+
+PDDLP_API void
+pddlp_free_strips(struct pddlp_strips *);
+
+PDDLP_API void
+pddlp_strips_init_state(const struct pddlp_strips *, uint64_t *state);
+
+PDDLP_API bool
+pddlp_strips_applicable(const struct pddlp_strips *, uint32_t op, const uint64_t *state);
+
+PDDLP_API void
+pddlp_strips_apply(const struct pddlp_strips *, uint32_t op, uint64_t *state);
+
+// plan validation
+//
+// a plan is a sequence of steps, one `(action arg ...)` each. a step may be
+// preceded by a `time:` prefix and followed by a `[duration]`, which are
+// both ignored, and `;` starts a comment. steps are matched against the
+// operators of a grounded problem and simulated on a bitset state.
+
+struct pddlp_validator;
+
+struct pddlp_plan_result {
+    // the failed step, counting from 0, or the number of steps when the goal
+    // doesn't hold at the end. PDDLP_NONE when the plan is valid.
+    uint32_t step;
+
+    // how many steps were applied.
+    uint32_t step_count;
+
+    // when a precondition doesn't hold, the first such fact. PDDLP_NONE
+    // otherwise.
+    uint32_t fact;
+
+    // what failed, and where: the step, or the end of the plan.
+    const char *message;
+    uint64_t line;
+    uint64_t column;
+};
+
+// `strips` must outlive the validator.
+PDDLP_API struct pddlp_validator *
+pddlp_new_validator(const struct pddlp_strips *, struct pddlp_error *error);
+
+PDDLP_API void
+pddlp_free_validator(struct pddlp_validator *);
+
+// returns whether `plan` is applicable from the initial state and reaches
+// the goal. the validator is only read, so many plans can be validated
+// against it at once from different threads.
+PDDLP_API bool
+pddlp_validate_plan(const struct pddlp_validator *, const char *plan, struct pddlp_plan_result *result);
+
+// the operator grounded from `action` with `args`, or PDDLP_NONE when there
+// is none.
+PDDLP_API uint32_t
+pddlp_find_operator(const struct pddlp_validator *, uint32_t action, const uint32_t *args);
+
+// translation
+//
+// pddlp_translate turns a grounded problem into a finite-domain task, where
+// a variable stands for a group of facts of which at most one holds in any
+// reachable state. the groups come from invariants checked against the
+// operators, like `at most one at fact for each truck`, and each fact ends
+// up in exactly one variable. facts outside of any group get a variable of
+// their own, with two values.
+
+struct pddlp_sas {
+    const struct pddlp_strips *strips;
+
+    // fact i is value fact_values[i] of variable fact_variables[i].
+    uint32_t *fact_variables;
+    uint32_t *fact_values;
+
+    // the values of variable v are the facts variable_facts[variable_first[v]
+    // .. variable_first[v + 1]), in order, and then one more for none of
+    // them holding when variable_none[v] is set. the variables of one fact
+    // always have it, as its negation.
+    uint32_t *variable_first;
+    uint32_t *variable_facts;
+    bool *variable_none;
+    uint32_t variable_count;
+
+    // the value of each variable in the initial state.
+    uint32_t *init;
+
+    // the groups the invariants gave, whether they became variables or not:
+    // group g is group_facts[group_first[g] .. group_first[g + 1]).
+    uint32_t *group_first;
+    uint32_t *group_facts;
+    uint32_t group_count;
+    uint32_t invariant_count;
+
+    // the operators of the task. those whose preconditions put a variable at
+    // two values never apply, and are left out.
+    uint32_t *operators;
+    uint32_t operator_count;
+
+    // bytes held by the arrays above.
+    size_t memory;
+};
+
+// the strips problem must outlive the result.
+PDDLP_API struct pddlp_sas *
+pddlp_translate(const struct pddlp_strips *, struct pddlp_error *error);
+
+PDDLP_API void
+pddlp_free_sas(struct pddlp_sas *);
+
+// writes the task through `write` in the text format fast downward's
+// translator produces (version 3, unit costs, no axioms). returns false and
+// fills `error` when `write` fails.
+PDDLP_API bool
+pddlp_write_sas(const struct pddlp_sas *, pddlp_write_fn write, void *context, struct pddlp_error *error);
+
+// numeric expressions
+//
+// pddlp_compile_numeric compiles the numeric parts of a grounded problem,
+// the comparisons in the preconditions of each operator, its numeric effects
+// and the :metric, into programs for a small stack machine over a dense
+// numbering of the ground fluents. constant subexpressions are folded while
+// compiling, and the constants of a sum or a product are gathered into one,
+// so `(+ (f) 1 (g) 2)` adds 3 once. identical programs are stored once.
+// states are vectors of fluent values, NaN where a fluent is undefined, and
+// pddlp_evaluate_batch runs a program over many states at once, each
+// instruction across a block of them, in loops the compiler can vectorize.
+// numeric effects under `when` or `forall` are not supported.
+
+enum pddlp_numeric_code {
+    PDDLP_NUMERIC_CONSTANT,     // pushes constants[operand].
+    PDDLP_NUMERIC_FLUENT,       // pushes the value of fluent `operand`.
+    PDDLP_NUMERIC_NEGATE,       // replaces the top with its negation.
+    PDDLP_NUMERIC_ADD,          // pops b, then a, and pushes a + b.
+    PDDLP_NUMERIC_SUBTRACT,
+    PDDLP_NUMERIC_MULTIPLY,
+    PDDLP_NUMERIC_DIVIDE,
+    PDDLP_NUMERIC_LESS,         // pops b, then a, and pushes 1 when a < b, 0 otherwise.
+    PDDLP_NUMERIC_LESS_EQUAL,
+    PDDLP_NUMERIC_GREATER,
+    PDDLP_NUMERIC_GREATER_EQUAL,
+    PDDLP_NUMERIC_EQUAL,
+    PDDLP_NUMERIC_NOT_EQUAL,
+};
+
+struct pddlp_numeric_op {
+    enum pddlp_numeric_code code;
+    uint32_t operand;
+};
+
+// the ops of a program are ops[first .. first + count). it leaves a single
+// value, and needs `depth` slots of stack to do so.
+struct pddlp_numeric_program {
+    uint32_t first;
+    uint32_t count;
+    uint32_t depth;
+};
+
+// sets `fluent` to the value of `program`, or combines it with the value of
+// `program` when `op` is INCREASE, DECREASE, SCALE_UP or SCALE_DOWN.
+struct pddlp_numeric_effect {
+    enum pddlp_token_type op;
+    uint32_t fluent;
+    uint32_t program;
+};
+
+struct pddlp_numeric {
+    const struct pddlp_strips *strips;
+
+    // fluent i is fluent_functions[i] applied to
+    // fluent_args[fluent_args_first[i] ..]. the fluents of :init come first,
+    // and initial_values has the value :init gives each fluent, NaN for the
+    // others.
+    uint32_t *fluent_functions;
+    uint32_t *fluent_args_first;
+    uint32_t *fluent_args;
+    uint32_t fluent_count;
+    double *initial_values;
+
+    struct pddlp_numeric_op *ops;
+    uint32_t op_count;
+
+    double *constants;
+    uint32_t constant_count;
+
+    struct pddlp_numeric_program *programs;
+    uint32_t program_count;
+
+    // the comparisons of operator o are the programs
+    // conditions[condition_first[o] .. condition_first[o + 1]), each giving 1
+    // when it holds. its effects are effects[effect_first[o] ..
+    // effect_first[o + 1]).
+    uint32_t *condition_first;
+    uint32_t *conditions;
+    uint32_t *effect_first;
+    struct pddlp_numeric_effect *effects;
+
+    // the program of the :metric, or PDDLP_NONE when there is none or it
+    // uses total-time or preferences.
+    uint32_t metric;
+
+    // the most stack any program needs.
+    uint32_t depth;
+
+    // bytes held by the arrays above.
+    size_t memory;
+};
+
+// states are evaluated in blocks of this many by pddlp_evaluate_batch.
+#define PDDLP_NUMERIC_LANES 64
+
+// the strips problem must outlive the result.
+PDDLP_API struct pddlp_numeric *
+pddlp_compile_numeric(const struct pddlp_strips *, struct pddlp_error *error);
+
+PDDLP_API void
+pddlp_free_numeric(struct pddlp_numeric *);
+
+// the value of `program` in the state `values`. `stack` has room for `depth`
+// values, so threads with their own stack can evaluate at once.
+PDDLP_API double
+pddlp_evaluate(const struct pddlp_numeric *, uint32_t program, const double *values, double *stack);
+
+// evaluates `program` in `count` states, where the value of fluent f in
+// state i is values[f * stride + i], into results[i]. `stack` has room for
+// depth * PDDLP_NUMERIC_LANES values.
+PDDLP_API void
+pddlp_evaluate_batch(const struct pddlp_numeric *, uint32_t program, const double *values, size_t stride,
+    uint32_t count, double *results, double *stack);
+
+// whether the numeric comparisons of `op` hold in `values`. comparisons with
+// an undefined fluent don't.
+PDDLP_API bool
+pddlp_numeric_applicable(const struct pddlp_numeric *, uint32_t op, const double *values, double *stack);
+
+// writes the fluents `op` changes in `values` to `next`, which must be
+// another vector, so all the effects see the values from before any of
+// them. the other fluents of `next` are left alone.
+PDDLP_API void
+pddlp_numeric_apply(const struct pddlp_numeric *, uint32_t op, const double *values, double *next, double *stack);
+
+// result cache
+//
+// a file of results that tools keep across runs, so files that haven't
+// changed since the last run aren't processed again. results are keyed by a
+// 64-bit hash of the contents of the file, which pddlp_hasher computes as the
+// file is read, and by a `kind` that tells apart the results of different
+// tools on the same file. the cache only holds results of the version of the
+// library that wrote it: a cache from another version, or one that can't be
+// read, starts out empty. like the hash, the file assumes a little-endian
+// host.
+
+// hashes data that arrives in pieces. the digest is the same as for all the
+// pieces at once, and is xxh64 with `seed`. do not touch the fields.
+struct pddlp_hasher {
+    uint64_t seed;
+    uint64_t v1, v2, v3, v4;
+    uint64_t length;
+    unsigned char buffer[32];
+    uint32_t buffered;
+};
+
+PDDLP_API void
+pddlp_hasher_init(struct pddlp_hasher *, uint64_t seed);
+
+PDDLP_API void
+pddlp_hasher_update(struct pddlp_hasher *, const void *data, size_t length);
+
+PDDLP_API uint64_t
+pddlp_hasher_digest(const struct pddlp_hasher *);
+
+struct pddlp_cache;
+
+// the kinds of result the tools that come with the library keep. other
+// tools sharing a cache with them use kinds from PDDLP_CACHE_USER on.
+enum pddlp_cache_kind {
+    PDDLP_CACHE_TOKENS,         // token and error counts of pddlp-count-tokens.
+    PDDLP_CACHE_STATS,          // the same, with tokenizer stats.
+    PDDLP_CACHE_CHECK,          // the errors pddlp-check reports for a file.
+    PDDLP_CACHE_USER = 1024,
+};
+
+// loads the cache at `path`, which doesn't have to exist yet. returns NULL
+// and fills `error` only when out of memory.
+PDDLP_API struct pddlp_cache *
+pddlp_open_cache(const char *path, struct pddlp_error *error);
+
+// writes the cache back to its path when it changed, through a temporary
+// file that is renamed over it, so a run that is interrupted leaves the old
+// cache behind. when runs save at once, the last one wins.
+PDDLP_API bool
+pddlp_save_cache(struct pddlp_cache *, struct pddlp_error *error);
+
+PDDLP_API void
+pddlp_free_cache(struct pddlp_cache *);
+
+// the result stored for `hash` and `kind`, and its size, or NULL when there
+// is none. it stays valid until the next store.
+PDDLP_API const void *
+pddlp_cache_find(const struct pddlp_cache *, uint64_t hash, uint32_t kind, uint32_t *size);
+
+// stores a copy of `data` as the result for `hash` and `kind`, replacing
+// the one there was. returns false when out of memory.
+PDDLP_API bool
+pddlp_cache_store(struct pddlp_cache *, uint64_t hash, uint32_t kind, const void *data, uint32_t size);
+
+// memory
+//
+// every allocation of the library goes through one process-wide allocator,
+// malloc, realloc and free unless another one is set. when an allocation
+// fails the call that made it fails with "out of memory", so an allocator
+// that refuses requests past some limit bounds what a single input can take.
+
+struct pddlp_allocator {
+    // same contract as malloc, realloc and free. `context` is passed along.
+    void *(*alloc)(void *context, size_t size);
+    void *(*realloc)(void *context, void *pointer, size_t size);
+    void (*free)(void *context, void *pointer);
+    void *context;
+};
+
+// NULL goes back to malloc. nothing allocated by the library may be alive
+// when the allocator changes, since it would be freed by the new one.
+PDDLP_API void
+pddlp_set_allocator(const struct pddlp_allocator *);
+
+// what an allocation was made for.
+enum pddlp_subsystem {
+    PDDLP_SUBSYSTEM_OTHER,
+    PDDLP_SUBSYSTEM_PARSER,
+    PDDLP_SUBSYSTEM_FACTS,
+    PDDLP_SUBSYSTEM_GROUND,
+    PDDLP_SUBSYSTEM_VALIDATOR,
+    PDDLP_SUBSYSTEM_NORMALIZE,
+    PDDLP_SUBSYSTEM_CONDITIONS,
+    PDDLP_SUBSYSTEM_CHECKER,
+    PDDLP_SUBSYSTEM_TRANSLATE,
+    PDDLP_SUBSYSTEM_NUMERIC,
+    PDDLP_SUBSYSTEM_CACHE,
+    PDDLP_SUBSYSTEM_COUNT,
+};
+
+#ifndef PDDLP_STATIC
+extern const char *pddlp_subsystem_names[];
+#endif
+
+// the accounting allocator sits on top of another one and counts the bytes
+// it hands out, in total and by subsystem. with a budget, requests that would
+// take the total past it fail. it is safe to use from many threads, and to
+// read the counters while it is in use.
+struct pddlp_accounting;
+
+struct pddlp_memory {
+    size_t current;
+    size_t peak;
+    size_t subsystem_current[PDDLP_SUBSYSTEM_COUNT];
+    size_t subsystem_peak[PDDLP_SUBSYSTEM_COUNT];
+
+    // 0 when there is none.
+    size_t budget;
+
+    uint64_t allocations;
+    // requests refused because of the budget.
+    uint64_t refused;
+};
+
+// `base` may be NULL for malloc. returns NULL when out of memory.
+PDDLP_API struct pddlp_accounting *
+pddlp_new_accounting(const struct pddlp_allocator *base, size_t budget);
+
+// the allocator to pass to pddlp_set_allocator. the accounting allocator must
+// outlive every allocation made through it.
+PDDLP_API struct pddlp_allocator
+pddlp_accounting_allocator(struct pddlp_accounting *);
+
+PDDLP_API void
+pddlp_free_accounting(struct pddlp_accounting *);
+
+// a lower budget doesn't free anything, it only refuses what would go past.
+PDDLP_API void
+pddlp_set_budget(struct pddlp_accounting *, size_t budget);
+
+// caps what the calling thread allocates through accounting allocators, from
+// now on, at `budget` bytes more than it frees, or lifts the cap when 0. the
+// budget of the accounting still applies on top. each thread has a budget of
+// its own, so a server can give each request one by setting it before the
+// request, and a request that goes past it fails without failing the
+// requests other threads are serving. refusals are counted in `refused`.
+PDDLP_API void
+pddlp_set_thread_budget(size_t budget);
+
+PDDLP_API void
+pddlp_memory_usage(struct pddlp_accounting *, struct pddlp_memory *usage);
+
 #endif // PDDLP_H_
@@ -0,0 +1,1124 @@
+// SPDX-FileCopyrightText: 2024 Guilherme Puida Moreira <guilherme@puida.xyz>
+// SPDX-License-Identifier: BSD-3-Clause
+
+// translation of a grounded problem into a finite-domain task. an invariant
+// pass finds groups of facts of which at most one holds in any reachable
+// state, the largest groups become multi-valued variables, and the task is
+// written in the text format of fast downward's translator.
+//
+// a candidate invariant is a set of predicates, each with the same number of
+// parameters at fixed argument positions, and at most one more position that
+// is counted. an instance fixes the parameters, and the invariant says that
+// at most one fact of each instance holds. candidates are checked against
+// the grounded operators instead of the schemas: an operator that adds a
+// fact of an instance must add only that one, and either require it already
+// or require and delete another fact of the instance. a candidate that fails
+// on an operator is refined with each other predicate the operator requires
+// and deletes, the way fast downward's synthesis refines them on the
+// schemas.
+
+#include "internal.h"
+
+#include <setjmp.h>
+
+#define TRANSLATE_BUFFER_SIZE (64 * 1024)
+
+// limits of the invariant search. candidates past these are not tried.
+#define TRANSLATE_PARAMS 3
+#define TRANSLATE_PARTS 8
+#define TRANSLATE_CANDIDATES 1024
+
+struct translate_part {
+    uint32_t predicate;
+    // the argument positions of the parameters, and the one that is counted,
+    // or PDDLP_NONE.
+    uint32_t positions[TRANSLATE_PARAMS];
+    uint32_t counted;
+};
+
+// parts are sorted by predicate, and unused fields are zero, so equal
+// candidates compare equal with memcmp.
+struct translate_invariant {
+    struct translate_part parts[TRANSLATE_PARTS];
+    uint32_t part_count;
+    uint32_t param_count;
+};
+
+// an add effect: operator_facts[index] of operator `op`.
+struct translate_add {
+    uint32_t op;
+    uint32_t index;
+};
+
+struct translator {
+    const struct pddlp_strips *strips;
+    const struct pddlp_domain *domain;
+    struct pddlp_error *error;
+    jmp_buf fail;
+
+    // the facts of predicate p are facts[fact_first[p] .. fact_first[p + 1]),
+    // and the add effects that make them true are adds[add_first[p] ..
+    // add_first[p + 1]).
+    uint32_t *fact_first;
+    uint32_t *facts;
+    uint32_t *add_first;
+    struct translate_add *adds;
+
+    struct translate_invariant *candidates;
+    uint32_t candidate_count;
+
+    uint32_t *proven;
+    uint32_t proven_count;
+
+    // the instances of the proven invariants, keyed by the invariant and its
+    // parameters, and the instance of each of their facts.
+    struct atoms instances;
+    uint32_t *members;
+    uint32_t *member_instances;
+    uint32_t member_count;
+
+    // groups by how many of their facts have no variable yet, as that count
+    // in the high half and the inverted group in the low one.
+    uint64_t *heap;
+    uint32_t heap_count;
+
+    // scratch values of each variable, which are set when the stamp of
+    // the variable is the current one.
+    uint32_t *values;
+    uint32_t *stamps;
+
+    struct pddlp_sas *sas;
+};
+
+static void
+translate_fail(struct translator *t, const char *message)
+{
+    t->error->message = message;
+    t->error->line = 0;
+    t->error->column = 0;
+    longjmp(t->fail, 1);
+}
+
+static void *
+translate_reserve(struct translator *t, void *items, uint32_t needed, size_t item_size)
+{
+    void *result = array_reserve(items, needed, item_size);
+    if (result == NULL && needed > 0)
+        translate_fail(t, "out of memory");
+
+    return result;
+}
+
+#define TRANSLATE_PUSH(t, items, count) \
+    ((items) = translate_reserve((t), (items), (count) + 1, sizeof(*(items))), &(items)[(count)++])
+
+static const uint32_t *
+translate_args(const struct pddlp_strips *s, uint32_t fact)
+{
+    return s->fact_args + s->fact_args_first[fact];
+}
+
+// whether operator_facts[first .. end) hold `fact`. the lists of an
+// operator are short, so they are just scanned.
+static bool
+translate_contains(const struct pddlp_strips *s, uint32_t first, uint32_t end, uint32_t fact)
+{
+    for (uint32_t i = first; i < end; ++i)
+        if (s->operator_facts[i] == fact)
+            return true;
+
+    return false;
+}
+
+// indexes the facts and the add effects by predicate.
+
+static void
+translate_index(struct translator *t)
+{
+    const struct pddlp_strips *s = t->strips;
+    uint32_t predicate_count = t->domain->predicate_count;
+
+    t->fact_first = translate_reserve(t, NULL, predicate_count + 1, sizeof(*t->fact_first));
+    t->add_first = translate_reserve(t, NULL, predicate_count + 1, sizeof(*t->add_first));
+    memset(t->fact_first, 0, sizeof(*t->fact_first) * (predicate_count + 1));
+    memset(t->add_first, 0, sizeof(*t->add_first) * (predicate_count + 1));
+
+    uint32_t add_count = 0;
+    for (uint32_t i = 0; i < s->fact_count; ++i)
+        t->fact_first[s->fact_predicates[i] + 1]++;
+    for (uint32_t op = 0; op < s->operator_count; ++op) {
+        const struct pddlp_operator *o = &s->operators[op];
+        for (uint32_t i = o->add; i < o->del; ++i)
+            t->add_first[s->fact_predicates[s->operator_facts[i]] + 1]++;
+        add_count += o->del - o->add;
+    }
+
+    for (uint32_t p = 0; p < predicate_count; ++p) {
+        t->fact_first[p + 1] += t->fact_first[p];
+        t->add_first[p + 1] += t->add_first[p];
+    }
+
+    t->facts = translate_reserve(t, NULL, s->fact_count, sizeof(*t->facts));
+    t->adds = translate_reserve(t, NULL, add_count, sizeof(*t->adds));
+
+    // the starts move to the ends as the lists fill up, and are moved back
+    // afterwards.
+    for (uint32_t i = 0; i < s->fact_count; ++i)
+        t->facts[t->fact_first[s->fact_predicates[i]]++] = i;
+    for (uint32_t op = 0; op < s->operator_count; ++op) {
+        const struct pddlp_operator *o = &s->operators[op];
+        for (uint32_t i = o->add; i < o->del; ++i) {
+            uint32_t p = s->fact_predicates[s->operator_facts[i]];
+            t->adds[t->add_first[p]++] = (struct translate_add){op, i};
+        }
+    }
+
+    for (uint32_t p = predicate_count; p > 0; --p) {
+        t->fact_first[p] = t->fact_first[p - 1];
+        t->add_first[p] = t->add_first[p - 1];
+    }
+    t->fact_first[0] = 0;
+    t->add_first[0] = 0;
+}
+
+// candidates
+
+static const struct translate_part *
+translate_find_part(const struct translate_invariant *inv, uint32_t predicate)
+{
+    for (uint32_t i = 0; i < inv->part_count; ++i)
+        if (inv->parts[i].predicate == predicate)
+            return &inv->parts[i];
+
+    return NULL;
+}
+
+// the parameters of the instance `fact` is in. returns false when its
+// predicate isn't part of the invariant.
+static bool
+translate_key(const struct pddlp_strips *s, const struct translate_invariant *inv, uint32_t fact, uint32_t *key)
+{
+    const struct translate_part *part = translate_find_part(inv, s->fact_predicates[fact]);
+    if (part == NULL)
+        return false;
+
+    const uint32_t *args = translate_args(s, fact);
+    for (uint32_t i = 0; i < inv->param_count; ++i)
+        key[i] = args[part->positions[i]];
+
+    return true;
+}
+
+// adds `inv` with `part`, unless it was already tried or there are too many.
+static void
+translate_add_candidate(struct translator *t, const struct translate_invariant *inv, const struct translate_part *part)
+{
+    if (t->candidate_count == TRANSLATE_CANDIDATES || inv->part_count == TRANSLATE_PARTS)
+        return;
+
+    struct translate_invariant candidate = *inv;
+    uint32_t i = candidate.part_count++;
+    while (i > 0 && candidate.parts[i - 1].predicate > part->predicate) {
+        candidate.parts[i] = candidate.parts[i - 1];
+        i--;
+    }
+    candidate.parts[i] = *part;
+
+    for (uint32_t c = 0; c < t->candidate_count; ++c)
+        if (memcmp(&t->candidates[c], &candidate, sizeof(candidate)) == 0)
+            return;
+
+    *TRANSLATE_PUSH(t, t->candidates, t->candidate_count) = candidate;
+}
+
+// every predicate with facts, counting each of its positions in turn.
+static void
+translate_initial_candidates(struct translator *t)
+{
+    for (uint32_t p = 0; p < t->domain->predicate_count; ++p) {
+        uint32_t arity = t->domain->predicates[p].param_count;
+        if (t->fact_first[p] == t->fact_first[p + 1] || arity == 0 || arity > TRANSLATE_PARAMS + 1)
+            continue;
+
+        struct translate_invariant empty;
+        memset(&empty, 0, sizeof(empty));
+        empty.param_count = arity - 1;
+
+        for (uint32_t counted = 0; counted < arity; ++counted) {
+            struct translate_part part;
+            memset(&part, 0, sizeof(part));
+            part.predicate = p;
+            part.counted = counted;
+
+            uint32_t param = 0;
+            for (uint32_t i = 0; i < arity; ++i)
+                if (i != counted)
+                    part.positions[param++] = i;
+
+            translate_add_candidate(t, &empty, &part);
+        }
+    }
+}
+
+// maps parameter `param` and the ones after it to the positions of `args`
+// that hold their objects, and adds a candidate for each way to do it.
+// `used` has a bit for each position taken.
+static void
+translate_map(struct translator *t, const struct translate_invariant *inv, struct translate_part *part,
+    const uint32_t *key, const uint32_t *args, uint32_t arity, uint32_t param, uint32_t used)
+{
+    if (param == inv->param_count) {
+        part->counted = PDDLP_NONE;
+        for (uint32_t i = 0; i < arity; ++i)
+            if (!(used >> i & 1))
+                part->counted = i;
+
+        translate_add_candidate(t, inv, part);
+        return;
+    }
+
+    for (uint32_t i = 0; i < arity; ++i) {
+        if (used >> i & 1 || args[i] != key[param])
+            continue;
+
+        part->positions[param] = i;
+        translate_map(t, inv, part, key, args, arity, param + 1, used | 1u << i);
+        part->positions[param] = 0;
+    }
+}
+
+// `inv` failed on operator `op`, which adds a fact of the instance `key`
+// without deleting another. each fact the operator requires and deletes
+// could be the one that goes away, when its predicate joins the invariant.
+static void
+translate_refine(struct translator *t, const struct translate_invariant *inv, uint32_t op, const uint32_t *key)
+{
+    const struct pddlp_strips *s = t->strips;
+    const struct pddlp_operator *o = &s->operators[op];
+
+    for (uint32_t i = o->del; i < o->end; ++i) {
+        uint32_t fact = s->operator_facts[i];
+        uint32_t predicate = s->fact_predicates[fact];
+        uint32_t arity = t->domain->predicates[predicate].param_count;
+
+        if (arity < inv->param_count || arity > inv->param_count + 1 || translate_find_part(inv, predicate) ||
+            !translate_contains(s, o->pre, o->add, fact))
+            continue;
+
+        struct translate_part part;
+        memset(&part, 0, sizeof(part));
+        part.predicate = predicate;
+        translate_map(t, inv, &part, key, translate_args(s, fact), arity, 0, 0);
+    }
+}
+
+// whether `add` keeps at most one fact of its instance true. refines the
+// invariant when it could be fixed by adding a predicate.
+static bool
+translate_balanced(struct translator *t, const struct translate_invariant *inv, const struct translate_add *add)
+{
+    const struct pddlp_strips *s = t->strips;
+    const struct pddlp_operator *o = &s->operators[add->op];
+    uint32_t added = s->operator_facts[add->index];
+    uint32_t key[TRANSLATE_PARAMS], other[TRANSLATE_PARAMS];
+    size_t key_size = sizeof(*key) * inv->param_count;
+
+    translate_key(s, inv, added, key);
+
+    for (uint32_t i = o->add; i < o->del; ++i)
+        if (i != add->index && translate_key(s, inv, s->operator_facts[i], other) && memcmp(key, other, key_size) == 0)
+            return false;
+
+    if (translate_contains(s, o->pre, o->add, added))
+        return true;
+
+    for (uint32_t i = o->del; i < o->end; ++i) {
+        uint32_t fact = s->operator_facts[i];
+        if (translate_key(s, inv, fact, other) && memcmp(key, other, key_size) == 0 &&
+            translate_contains(s, o->pre, o->add, fact))
+            return true;
+    }
+
+    translate_refine(t, inv, add->op, key);
+    return false;
+}
+
+static bool
+translate_prove(struct translator *t, const struct translate_invariant *inv)
+{
+    const struct pddlp_strips *s = t->strips;
+
+    for (uint32_t i = 0; i < inv->part_count; ++i) {
+        uint32_t p = inv->parts[i].predicate;
+        for (uint32_t a = t->add_first[p]; a < t->add_first[p + 1]; ++a)
+            if (!translate_balanced(t, inv, &t->adds[a]))
+                return false;
+    }
+
+    // the operators keep it, so it holds when it holds in :init.
+    struct atoms seen;
+    memset(&seen, 0, sizeof(seen));
+    bool holds = true;
+
+    for (uint32_t i = 0; i < s->init_count && holds; ++i) {
+        uint32_t key[TRANSLATE_PARAMS];
+        if (!translate_key(s, inv, s->init[i], key))
+            continue;
+
+        if (atoms_find(&seen, 0, key, inv->param_count) != PDDLP_NONE) {
+            holds = false;
+        } else if (atoms_intern(&seen, 0, key, inv->param_count) == PDDLP_NONE) {
+            atoms_free(&seen);
+            translate_fail(t, "out of memory");
+        }
+    }
+
+    atoms_free(&seen);
+    return holds;
+}
+
+// candidates are proven in the order they were found, and refinements go to
+// the back of the list, so this is a breadth-first search over them.
+static void
+translate_invariants(struct translator *t)
+{
+    translate_initial_candidates(t);
+
+    for (uint32_t c = 0; c < t->candidate_count; ++c) {
+        // refining may move the candidates.
+        struct translate_invariant inv = t->candidates[c];
+        if (translate_prove(t, &inv))
+            *TRANSLATE_PUSH(t, t->proven, t->proven_count) = c;
+    }
+}
+
+// groups
+
+// the facts of each instance of a proven invariant. instances with a single
+// fact say nothing, and are left out.
+static void
+translate_groups(struct translator *t)
+{
+    const struct pddlp_strips *s = t->strips;
+    struct pddlp_sas *sas = t->sas;
+
+    for (uint32_t i = 0; i < t->proven_count; ++i) {
+        const struct translate_invariant *inv = &t->candidates[t->proven[i]];
+        for (uint32_t j = 0; j < inv->part_count; ++j) {
+            uint32_t p = inv->parts[j].predicate;
+            for (uint32_t f = t->fact_first[p]; f < t->fact_first[p + 1]; ++f) {
+                uint32_t key[TRANSLATE_PARAMS];
+                translate_key(s, inv, t->facts[f], key);
+
+                uint32_t instance = atoms_intern(&t->instances, i, key, inv->param_count);
+                if (instance == PDDLP_NONE)
+                    translate_fail(t, "out of memory");
+
+                t->members = translate_reserve(t, t->members, t->member_count + 1, sizeof(*t->members));
+                t->member_instances = translate_reserve(t, t->member_instances, t->member_count + 1,
+                    sizeof(*t->member_instances));
+                t->members[t->member_count] = t->facts[f];
+                t->member_instances[t->member_count++] = instance;
+            }
+        }
+    }
+
+    // the size of each instance, and then the group it becomes, or
+    // PDDLP_NONE.
+    uint32_t instance_count = t->instances.count;
+    uint32_t *groups = translate_reserve(t, NULL, instance_count + 1, sizeof(*groups));
+    memset(groups, 0, sizeof(*groups) * (instance_count + 1));
+    for (uint32_t i = 0; i < t->member_count; ++i)
+        groups[t->member_instances[i]]++;
+
+    uint32_t fact_count = 0;
+    for (uint32_t i = 0; i < instance_count; ++i)
+        if (groups[i] >= 2)
+            sas->group_count++;
+
+    sas->group_first = translate_reserve(t, NULL, sas->group_count + 1, sizeof(*sas->group_first));
+    uint32_t group = 0;
+    for (uint32_t i = 0; i < instance_count; ++i) {
+        uint32_t size = groups[i];
+        groups[i] = PDDLP_NONE;
+        if (size < 2)
+            continue;
+
+        groups[i] = group;
+        sas->group_first[group++] = fact_count;
+        fact_count += size;
+    }
+    sas->group_first[group] = fact_count;
+
+    // the starts move to the ends as the groups fill up.
+    sas->group_facts = translate_reserve(t, NULL, fact_count, sizeof(*sas->group_facts));
+    for (uint32_t i = 0; i < t->member_count; ++i) {
+        uint32_t g = groups[t->member_instances[i]];
+        if (g != PDDLP_NONE)
+            sas->group_facts[sas->group_first[g]++] = t->members[i];
+    }
+
+    for (uint32_t g = sas->group_count; g > 0; --g)
+        sas->group_first[g] = sas->group_first[g - 1];
+    sas->group_first[0] = 0;
+
+    array_free(groups);
+}
+
+// variables
+
+static void
+translate_heap_push(struct translator *t, uint64_t item)
+{
+    uint32_t i = t->heap_count;
+    *TRANSLATE_PUSH(t, t->heap, t->heap_count) = item;
+
+    while (i > 0 && t->heap[(i - 1) / 2] < item) {
+        t->heap[i] = t->heap[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    t->heap[i] = item;
+}
+
+static uint64_t
+translate_heap_pop(struct translator *t)
+{
+    uint64_t top = t->heap[0];
+    uint64_t item = t->heap[--t->heap_count];
+    uint32_t i = 0;
+
+    for (;;) {
+        uint32_t child = 2 * i + 1;
+        if (child >= t->heap_count)
+            break;
+        if (child + 1 < t->heap_count && t->heap[child + 1] > t->heap[child])
+            child++;
+        if (t->heap[child] <= item)
+            break;
+
+        t->heap[i] = t->heap[child];
+        i = child;
+    }
+
+    if (t->heap_count > 0)
+        t->heap[i] = item;
+    return top;
+}
+
+static void
+translate_add_value(struct translator *t, uint32_t fact)
+{
+    struct pddlp_sas *sas = t->sas;
+    uint32_t variable = sas->variable_count - 1;
+    uint32_t count = sas->variable_first[variable + 1]++;
+
+    sas->fact_variables[fact] = variable;
+    sas->fact_values[fact] = count - sas->variable_first[variable];
+    sas->variable_facts[count] = fact;
+}
+
+static void
+translate_new_variable(struct translator *t)
+{
+    struct pddlp_sas *sas = t->sas;
+    sas->variable_first = translate_reserve(t, sas->variable_first, sas->variable_count + 2,
+        sizeof(*sas->variable_first));
+    sas->variable_first[sas->variable_count + 1] = sas->variable_first[sas->variable_count];
+    sas->variable_count++;
+}
+
+// picks the group with the most facts that have no variable yet, and makes
+// those a variable, until no group has two of them left, like fast
+// downward does. the other facts get a variable each.
+static void
+translate_variables(struct translator *t)
+{
+    const struct pddlp_strips *s = t->strips;
+    struct pddlp_sas *sas = t->sas;
+
+    sas->fact_variables = translate_reserve(t, NULL, s->fact_count, sizeof(*sas->fact_variables));
+    sas->fact_values = translate_reserve(t, NULL, s->fact_count, sizeof(*sas->fact_values));
+    sas->variable_facts = translate_reserve(t, NULL, s->fact_count, sizeof(*sas->variable_facts));
+    sas->variable_first = translate_reserve(t, NULL, 1, sizeof(*sas->variable_first));
+    sas->variable_first[0] = 0;
+    for (uint32_t i = 0; i < s->fact_count; ++i)
+        sas->fact_variables[i] = PDDLP_NONE;
+
+    for (uint32_t g = 0; g < sas->group_count; ++g) {
+        uint64_t size = sas->group_first[g + 1] - sas->group_first[g];
+        translate_heap_push(t, size << 32 | (UINT32_MAX - g));
+    }
+
+    // counts only go down, so a group whose count is still right when it
+    // gets to the top is the largest one.
+    while (t->heap_count > 0) {
+        uint64_t top = translate_heap_pop(t);
+        uint32_t g = UINT32_MAX - (uint32_t)top;
+
+        uint32_t left = 0;
+        for (uint32_t i = sas->group_first[g]; i < sas->group_first[g + 1]; ++i)
+            left += sas->fact_variables[sas->group_facts[i]] == PDDLP_NONE;
+
+        if (left < 2)
+            continue;
+
+        if (left < top >> 32) {
+            translate_heap_push(t, (uint64_t)left << 32 | (UINT32_MAX - g));
+            continue;
+        }
+
+        translate_new_variable(t);
+        for (uint32_t i = sas->group_first[g]; i < sas->group_first[g + 1]; ++i)
+            if (sas->fact_variables[sas->group_facts[i]] == PDDLP_NONE)
+                translate_add_value(t, sas->group_facts[i]);
+    }
+
+    for (uint32_t i = 0; i < s->fact_count; ++i) {
+        if (sas->fact_variables[i] != PDDLP_NONE)
+            continue;
+
+        translate_new_variable(t);
+        translate_add_value(t, i);
+    }
+}
+
+// a variable needs a value for none of its facts holding when that is how
+// it starts, or when an operator deletes one of its facts without adding
+// another. single facts always have it, as their negation.
+static void
+translate_values(struct translator *t)
+{
+    const struct pddlp_strips *s = t->strips;
+    struct pddlp_sas *sas = t->sas;
+
+    sas->variable_none = translate_reserve(t, NULL, sas->variable_count, sizeof(*sas->variable_none));
+    sas->init = translate_reserve(t, NULL, sas->variable_count, sizeof(*sas->init));
+    uint32_t *values = t->values = translate_reserve(t, NULL, sas->variable_count, sizeof(*values));
+    uint32_t *stamps = t->stamps = translate_reserve(t, NULL, sas->variable_count, sizeof(*stamps));
+
+    for (uint32_t v = 0; v < sas->variable_count; ++v) {
+        sas->variable_none[v] = sas->variable_first[v + 1] - sas->variable_first[v] == 1;
+        sas->init[v] = PDDLP_NONE;
+        stamps[v] = 0;
+    }
+
+    for (uint32_t i = 0; i < s->init_count; ++i)
+        sas->init[sas->fact_variables[s->init[i]]] = sas->fact_values[s->init[i]];
+
+    for (uint32_t v = 0; v < sas->variable_count; ++v) {
+        if (sas->init[v] != PDDLP_NONE)
+            continue;
+
+        sas->variable_none[v] = true;
+        sas->init[v] = sas->variable_first[v + 1] - sas->variable_first[v];
+    }
+
+    // operators whose preconditions put a variable at two values never
+    // apply, and are left out.
+
+    for (uint32_t op = 0; op < s->operator_count; ++op) {
+        const struct pddlp_operator *o = &s->operators[op];
+        uint32_t stamp = 2 * op + 1;
+        bool applicable = true;
+
+        for (uint32_t i = o->pre; i < o->add && applicable; ++i) {
+            uint32_t fact = s->operator_facts[i];
+            uint32_t v = sas->fact_variables[fact];
+            applicable = stamps[v] != stamp || values[v] == sas->fact_values[fact];
+            stamps[v] = stamp;
+            values[v] = sas->fact_values[fact];
+        }
+
+        if (!applicable)
+            continue;
+
+        *TRANSLATE_PUSH(t, sas->operators, sas->operator_count) = op;
+
+        for (uint32_t i = o->add; i < o->del; ++i)
+            stamps[sas->fact_variables[s->operator_facts[i]]] = stamp + 1;
+        for (uint32_t i = o->del; i < o->end; ++i) {
+            uint32_t v = sas->fact_variables[s->operator_facts[i]];
+            if (stamps[v] != stamp + 1)
+                sas->variable_none[v] = true;
+        }
+    }
+
+    // a goal that puts a variable at two values can't be written.
+    uint32_t stamp = 2 * s->operator_count + 1;
+    for (uint32_t i = 0; i < s->goal_count; ++i) {
+        uint32_t v = sas->fact_variables[s->goal[i]];
+        if (stamps[v] == stamp && values[v] != sas->fact_values[s->goal[i]])
+            translate_fail(t, "the goal facts are mutually exclusive");
+
+        stamps[v] = stamp;
+        values[v] = sas->fact_values[s->goal[i]];
+    }
+}
+
+static void
+translate_free(struct translator *t)
+{
+    array_free(t->fact_first);
+    array_free(t->facts);
+    array_free(t->add_first);
+    array_free(t->adds);
+    array_free(t->candidates);
+    array_free(t->proven);
+    atoms_free(&t->instances);
+    array_free(t->members);
+    array_free(t->member_instances);
+    array_free(t->heap);
+    array_free(t->values);
+    array_free(t->stamps);
+}
+
+static size_t
+translate_memory(const struct pddlp_sas *sas)
+{
+    return sizeof(*sas) +
+        (size_t)array_capacity(sas->fact_variables) * sizeof(*sas->fact_variables) +
+        (size_t)array_capacity(sas->fact_values) * sizeof(*sas->fact_values) +
+        (size_t)array_capacity(sas->variable_first) * sizeof(*sas->variable_first) +
+        (size_t)array_capacity(sas->variable_facts) * sizeof(*sas->variable_facts) +
+        (size_t)array_capacity(sas->variable_none) * sizeof(*sas->variable_none) +
+        (size_t)array_capacity(sas->init) * sizeof(*sas->init) +
+        (size_t)array_capacity(sas->group_first) * sizeof(*sas->group_first) +
+        (size_t)array_capacity(sas->group_facts) * sizeof(*sas->group_facts) +
+        (size_t)array_capacity(sas->operators) * sizeof(*sas->operators);
+}
+
+struct pddlp_sas *
+pddlp_translate(const struct pddlp_strips *strips, struct pddlp_error *error)
+{
+    struct translator translator;
+    struct translator *t = &translator;
+    memset(t, 0, sizeof(*t));
+    t->strips = strips;
+    t->domain = strips->problem->domain;
+    t->error = error;
+
+    enum pddlp_subsystem previous = mem_enter(PDDLP_SUBSYSTEM_TRANSLATE);
+    t->sas = mem_alloc(sizeof(*t->sas));
+    if (t->sas == NULL) {
+        mem_leave(previous);
+        error->message = "out of memory";
+        error->line = 0;
+        error->column = 0;
+        return NULL;
+    }
+
+    memset(t->sas, 0, sizeof(*t->sas));
+    t->sas->strips = strips;
+
+    if (setjmp(t->fail)) {
+        pddlp_free_sas(t->sas);
+        translate_free(t);
+        mem_leave(previous);
+        return NULL;
+    }
+
+    translate_index(t);
+    translate_invariants(t);
+    translate_groups(t);
+    translate_variables(t);
+    translate_values(t);
+
+    t->sas->invariant_count = t->proven_count;
+    t->sas->memory = translate_memory(t->sas);
+    translate_free(t);
+    mem_leave(previous);
+
+    return t->sas;
+}
+
+void
+pddlp_free_sas(struct pddlp_sas *sas)
+{
+    if (sas == NULL)
+        return;
+
+    array_free(sas->fact_variables);
+    array_free(sas->fact_values);
+    array_free(sas->variable_first);
+    array_free(sas->variable_facts);
+    array_free(sas->variable_none);
+    array_free(sas->init);
+    array_free(sas->group_first);
+    array_free(sas->group_facts);
+    array_free(sas->operators);
+    mem_free(sas);
+}
+
+// output
+
+// an effect setting `variable` from `pre`, or from anything when that is
+// PDDLP_NONE, to `post`, when `condition` has the value `condition_value`,
+// or always when it is PDDLP_NONE.
+struct translate_effect {
+    uint32_t condition;
+    uint32_t condition_value;
+    uint32_t variable;
+    uint32_t pre;
+    uint32_t post;
+};
+
+struct translate_writer {
+    const struct pddlp_sas *sas;
+    struct pddlp_error *error;
+    jmp_buf fail;
+
+    pddlp_write_fn write;
+    void *context;
+    char *buffer;
+    size_t buffered;
+
+    // the precondition on each variable of the operator being written is
+    // values[v] when stamps[v] is the operator's stamp, and the variable has
+    // an effect when it is one past that.
+    uint32_t *values;
+    uint32_t *stamps;
+
+    uint32_t *prevail;
+    uint32_t prevail_count;
+    struct translate_effect *effects;
+    uint32_t effect_count;
+};
+
+static void
+translate_writer_fail(struct translate_writer *w, const char *message)
+{
+    w->error->message = message;
+    w->error->line = 0;
+    w->error->column = 0;
+    longjmp(w->fail, 1);
+}
+
+static void
+translate_flush(struct translate_writer *w)
+{
+    if (w->buffered > 0 && !w->write(w->context, w->buffer, w->buffered))
+        translate_writer_fail(w, "couldn't write the output");
+
+    w->buffered = 0;
+}
+
+static void
+translate_write(struct translate_writer *w, const char *data, size_t length)
+{
+    while (length > 0) {
+        if (w->buffered == TRANSLATE_BUFFER_SIZE)
+            translate_flush(w);
+
+        size_t chunk = TRANSLATE_BUFFER_SIZE - w->buffered;
+        if (chunk > length)
+            chunk = length;
+
+        memcpy(w->buffer + w->buffered, data, chunk);
+        w->buffered += chunk;
+        data += chunk;
+        length -= chunk;
+    }
+}
+
+static void
+translate_write_string(struct translate_writer *w, const char *text)
+{
+    translate_write(w, text, strlen(text));
+}
+
+// writes `number` and then `separator`, or -1 for PDDLP_NONE.
+static void
+translate_write_number(struct translate_writer *w, uint32_t number, char separator)
+{
+    char digits[12];
+    char *end = digits + sizeof(digits);
+    char *start = end;
+
+    *--start = separator;
+    if (number == PDDLP_NONE) {
+        *--start = '1';
+        *--start = '-';
+    } else {
+        do {
+            *--start = '0' + number % 10;
+            number /= 10;
+        } while (number > 0);
+    }
+
+    translate_write(w, start, end - start);
+}
+
+static void
+translate_write_fact(struct translate_writer *w, uint32_t fact)
+{
+    const struct pddlp_strips *s = w->sas->strips;
+    const struct pddlp_problem *problem = s->problem;
+    uint32_t predicate = s->fact_predicates[fact];
+    uint32_t arity = problem->domain->predicates[predicate].param_count;
+    const uint32_t *args = translate_args(s, fact);
+
+    translate_write_string(w, problem->domain->predicates[predicate].name);
+    translate_write(w, "(", 1);
+    for (uint32_t i = 0; i < arity; ++i) {
+        if (i > 0)
+            translate_write(w, ", ", 2);
+        translate_write_string(w, problem->objects[args[i]].name);
+    }
+    translate_write(w, ")\n", 2);
+}
+
+static void
+translate_write_variables(struct translate_writer *w)
+{
+    const struct pddlp_sas *sas = w->sas;
+
+    translate_write_number(w, sas->variable_count, '\n');
+    for (uint32_t v = 0; v < sas->variable_count; ++v) {
+        uint32_t first = sas->variable_first[v];
+        uint32_t count = sas->variable_first[v + 1] - first;
+
+        translate_write_string(w, "begin_variable\nvar");
+        translate_write_number(w, v, '\n');
+        translate_write_string(w, "-1\n");
+        translate_write_number(w, count + sas->variable_none[v], '\n');
+
+        for (uint32_t i = 0; i < count; ++i) {
+            translate_write_string(w, "Atom ");
+            translate_write_fact(w, sas->variable_facts[first + i]);
+        }
+
+        if (sas->variable_none[v] && count == 1) {
+            translate_write_string(w, "NegatedAtom ");
+            translate_write_fact(w, sas->variable_facts[first]);
+        } else if (sas->variable_none[v]) {
+            translate_write_string(w, "<none of those>\n");
+        }
+
+        translate_write_string(w, "end_variable\n");
+    }
+}
+
+static void
+translate_write_pair(struct translate_writer *w, uint32_t fact)
+{
+    translate_write_number(w, w->sas->fact_variables[fact], ' ');
+    translate_write_number(w, w->sas->fact_values[fact], '\n');
+}
+
+static void
+translate_write_groups(struct translate_writer *w)
+{
+    const struct pddlp_sas *sas = w->sas;
+
+    translate_write_number(w, sas->group_count, '\n');
+    for (uint32_t g = 0; g < sas->group_count; ++g) {
+        translate_write_string(w, "begin_mutex_group\n");
+        translate_write_number(w, sas->group_first[g + 1] - sas->group_first[g], '\n');
+        for (uint32_t i = sas->group_first[g]; i < sas->group_first[g + 1]; ++i)
+            translate_write_pair(w, sas->group_facts[i]);
+        translate_write_string(w, "end_mutex_group\n");
+    }
+}
+
+static void
+translate_write_goal(struct translate_writer *w)
+{
+    const struct pddlp_sas *sas = w->sas;
+    const struct pddlp_strips *s = sas->strips;
+
+    translate_write_string(w, "begin_state\n");
+    for (uint32_t v = 0; v < sas->variable_count; ++v)
+        translate_write_number(w, sas->init[v], '\n');
+    translate_write_string(w, "end_state\n");
+
+    // the goal may name a fact twice, but never two values of a variable.
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < s->goal_count; ++i) {
+        uint32_t v = sas->fact_variables[s->goal[i]];
+        count += w->stamps[v] != 1;
+        w->stamps[v] = 1;
+    }
+
+    translate_write_string(w, "begin_goal\n");
+    translate_write_number(w, count, '\n');
+    for (uint32_t i = 0; i < s->goal_count; ++i) {
+        uint32_t v = sas->fact_variables[s->goal[i]];
+        if (w->stamps[v] == 2)
+            continue;
+
+        w->stamps[v] = 2;
+        translate_write_pair(w, s->goal[i]);
+    }
+    translate_write_string(w, "end_goal\n");
+}
+
+static void
+translate_push_effect(struct translate_writer *w, struct translate_effect effect)
+{
+    struct translate_effect *effects = array_reserve(w->effects, w->effect_count + 1, sizeof(*effects));
+    if (effects == NULL)
+        translate_writer_fail(w, "out of memory");
+
+    w->effects = effects;
+    w->effects[w->effect_count++] = effect;
+}
+
+// works out the prevail conditions and effects of operator `op`, which is
+// the index-th written. add effects win over deletes of the same variable,
+// like they do in strips. a delete of a fact the operator doesn't require
+// only applies when the fact holds, which takes a condition unless the
+// variable has no other value.
+static void
+translate_convert(struct translate_writer *w, uint32_t op, uint32_t index)
+{
+    const struct pddlp_sas *sas = w->sas;
+    const struct pddlp_strips *s = sas->strips;
+    const struct pddlp_operator *o = &s->operators[op];
+    uint32_t stamp = 2 * index + 3;
+
+    w->prevail_count = 0;
+    w->effect_count = 0;
+
+    for (uint32_t i = o->pre; i < o->add; ++i) {
+        uint32_t fact = s->operator_facts[i];
+        w->stamps[sas->fact_variables[fact]] = stamp;
+        w->values[sas->fact_variables[fact]] = sas->fact_values[fact];
+    }
+
+    for (uint32_t i = o->add; i < o->del; ++i) {
+        uint32_t fact = s->operator_facts[i];
+        uint32_t v = sas->fact_variables[fact];
+        uint32_t pre = w->stamps[v] == stamp ? w->values[v] : PDDLP_NONE;
+
+        translate_push_effect(w, (struct translate_effect){PDDLP_NONE, 0, v, pre, sas->fact_values[fact]});
+        w->stamps[v] = stamp + 1;
+    }
+
+    for (uint32_t i = o->del; i < o->end; ++i) {
+        uint32_t fact = s->operator_facts[i];
+        uint32_t v = sas->fact_variables[fact];
+        uint32_t value = sas->fact_values[fact];
+        uint32_t none = sas->variable_first[v + 1] - sas->variable_first[v];
+
+        if (w->stamps[v] == stamp + 1)
+            continue;
+
+        if (w->stamps[v] == stamp) {
+            // otherwise the fact doesn't hold, and deleting it does nothing.
+            if (w->values[v] == value) {
+                translate_push_effect(w, (struct translate_effect){PDDLP_NONE, 0, v, value, none});
+                w->stamps[v] = stamp + 1;
+            }
+        } else if (none == 1) {
+            translate_push_effect(w, (struct translate_effect){PDDLP_NONE, 0, v, PDDLP_NONE, none});
+        } else {
+            translate_push_effect(w, (struct translate_effect){v, value, v, PDDLP_NONE, none});
+        }
+    }
+
+    for (uint32_t i = o->pre; i < o->add; ++i) {
+        if (w->stamps[sas->fact_variables[s->operator_facts[i]]] == stamp)
+            w->prevail[w->prevail_count++] = s->operator_facts[i];
+    }
+}
+
+static void
+translate_write_operators(struct translate_writer *w)
+{
+    const struct pddlp_sas *sas = w->sas;
+    const struct pddlp_strips *s = sas->strips;
+    const struct pddlp_problem *problem = s->problem;
+
+    translate_write_number(w, sas->operator_count, '\n');
+    for (uint32_t i = 0; i < sas->operator_count; ++i) {
+        uint32_t op = sas->operators[i];
+        const struct pddlp_operator *o = &s->operators[op];
+        const struct pddlp_action *action = &problem->domain->actions[o->action];
+
+        translate_convert(w, op, i);
+
+        translate_write_string(w, "begin_operator\n");
+        translate_write_string(w, action->name);
+        for (uint32_t j = 0; j < action->param_count; ++j) {
+            translate_write(w, " ", 1);
+            translate_write_string(w, problem->objects[s->operator_args[o->args + j]].name);
+        }
+        translate_write(w, "\n", 1);
+
+        translate_write_number(w, w->prevail_count, '\n');
+        for (uint32_t j = 0; j < w->prevail_count; ++j)
+            translate_write_pair(w, w->prevail[j]);
+
+        translate_write_number(w, w->effect_count, '\n');
+        for (uint32_t j = 0; j < w->effect_count; ++j) {
+            const struct translate_effect *e = &w->effects[j];
+            if (e->condition == PDDLP_NONE) {
+                translate_write_string(w, "0 ");
+            } else {
+                translate_write_string(w, "1 ");
+                translate_write_number(w, e->condition, ' ');
+                translate_write_number(w, e->condition_value, ' ');
+            }
+            translate_write_number(w, e->variable, ' ');
+            translate_write_number(w, e->pre, ' ');
+            translate_write_number(w, e->post, '\n');
+        }
+
+        // unit costs, there is no metric.
+        translate_write_string(w, "1\nend_operator\n");
+    }
+}
+
+bool
+pddlp_write_sas(const struct pddlp_sas *sas, pddlp_write_fn write, void *context, struct pddlp_error *error)
+{
+    struct translate_writer writer;
+    struct translate_writer *w = &writer;
+    memset(w, 0, sizeof(*w));
+    w->sas = sas;
+    w->error = error;
+    w->write = write;
+    w->context = context;
+
+    uint32_t max_pre = 0;
+    for (uint32_t i = 0; i < sas->strips->operator_count; ++i) {
+        const struct pddlp_operator *o = &sas->strips->operators[i];
+        if (o->add - o->pre > max_pre)
+            max_pre = o->add - o->pre;
+    }
+
+    enum pddlp_subsystem previous = mem_enter(PDDLP_SUBSYSTEM_TRANSLATE);
+    size_t words = (size_t)sas->variable_count + 1;
+    w->buffer = mem_alloc(TRANSLATE_BUFFER_SIZE);
+    w->values = words <= SIZE_MAX / sizeof(*w->values) ? mem_alloc(sizeof(*w->values) * words) : NULL;
+    w->stamps = words <= SIZE_MAX / sizeof(*w->stamps) ? mem_alloc(sizeof(*w->stamps) * words) : NULL;
+    w->prevail = mem_alloc(sizeof(*w->prevail) * ((size_t)max_pre + 1));
+
+    bool written = w->buffer && w->values && w->stamps && w->prevail;
+    if (!written) {
+        error->message = "out of memory";
+        error->line = 0;
+        error->column = 0;
+    } else if (setjmp(w->fail)) {
+        written = false;
+    } else {
+        memset(w->stamps, 0, sizeof(*w->stamps) * words);
+        translate_write_string(w, "begin_version\n3\nend_version\nbegin_metric\n0\nend_metric\n");
+        translate_write_variables(w);
+        translate_write_groups(w);
+        translate_write_goal(w);
+        translate_write_operators(w);
+        // no axioms.
+        translate_write_string(w, "0\n");
+        translate_flush(w);
+    }
+
+    mem_free(w->buffer);
+    mem_free(w->values);
+    mem_free(w->stamps);
+    mem_free(w->prevail);
+    array_free(w->effects);
+    mem_leave(previous);
+
+    return written;
+}
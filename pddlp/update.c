@@ -0,0 +1,626 @@
+// SPDX-FileCopyrightText: 2024 Guilherme Puida Moreira <guilherme@puida.xyz>
+// SPDX-License-Identifier: BSD-3-Clause
+
+// changes to a parsed problem, and writing it back out. facts go through
+// facts_add and facts_remove, and numeric fluents through a set of their
+// own like that of the facts, built the first time one is assigned. the
+// text is written by copying the source around :objects and :init, so only
+// what can have changed is written anew.
+
+#include "internal.h"
+
+#include <setjmp.h>
+#include <stdio.h>
+
+#define UPDATE_BUFFER_SIZE (64 * 1024)
+
+static bool
+update_fail(struct pddlp_error *error, const char *message)
+{
+    error->message = message;
+    error->line = 0;
+    error->column = 0;
+    return false;
+}
+
+PDDLP_INTERNAL void
+update_free(struct problem *pr)
+{
+    mem_free(pr->fluent_slots);
+}
+
+// numeric fluents. slots are the hash in the high half and fluent + 1 in
+// the low half, like those of the facts.
+
+static uint32_t
+update_arity(const struct problem *pr, uint32_t function)
+{
+    return pr->base.domain->functions[function].param_count;
+}
+
+static uint32_t
+update_fluent_hash(uint32_t function, const uint32_t *args, uint32_t arity)
+{
+    return (uint32_t)(hash64(args, sizeof(*args) * arity, function) >> 32);
+}
+
+static uint32_t
+update_find_fluent(const struct problem *pr, uint32_t function, const uint32_t *args)
+{
+    const struct pddlp_problem *base = &pr->base;
+    uint32_t arity = update_arity(pr, function);
+    uint32_t hash = update_fluent_hash(function, args, arity);
+    uint32_t mask = pr->fluent_capacity - 1;
+
+    for (uint32_t i = hash & mask;; i = (i + 1) & mask) {
+        uint64_t slot = pr->fluent_slots[i];
+        if (slot == 0)
+            return PDDLP_NONE;
+
+        uint32_t fluent = (uint32_t)slot - 1;
+        if ((uint32_t)(slot >> 32) == hash && base->fluent_functions[fluent] == function &&
+            (arity == 0 ||
+                memcmp(base->fact_args + base->fluent_args_first[fluent], args, sizeof(*args) * arity) == 0))
+            return fluent;
+    }
+}
+
+// puts `fluent` in the set. when :init assigns the same fluent twice, the
+// last one counts, so it takes the place of the earlier one.
+static void
+update_insert_fluent(struct problem *pr, uint32_t fluent)
+{
+    const struct pddlp_problem *base = &pr->base;
+    uint32_t function = base->fluent_functions[fluent];
+    uint32_t arity = update_arity(pr, function);
+    const uint32_t *args = base->fact_args + base->fluent_args_first[fluent];
+    uint32_t hash = update_fluent_hash(function, args, arity);
+    uint32_t mask = pr->fluent_capacity - 1;
+
+    uint32_t i = hash & mask;
+    for (; pr->fluent_slots[i]; i = (i + 1) & mask) {
+        uint32_t other = (uint32_t)pr->fluent_slots[i] - 1;
+        if ((uint32_t)(pr->fluent_slots[i] >> 32) == hash && base->fluent_functions[other] == function &&
+            (arity == 0 || memcmp(base->fact_args + base->fluent_args_first[other], args, sizeof(*args) * arity) == 0))
+            break;
+    }
+
+    pr->fluent_slots[i] = (uint64_t)hash << 32 | (fluent + 1);
+}
+
+// keeps the set at most half full with `count` fluents, building it the
+// first time.
+static bool
+update_grow_fluents(struct problem *pr, uint32_t count)
+{
+    if (pr->fluent_slots && (uint64_t)count * 2 <= pr->fluent_capacity)
+        return true;
+
+    uint64_t capacity = 64;
+    while (capacity < (uint64_t)count * 2)
+        capacity *= 2;
+
+    if (capacity > UINT32_MAX || capacity > SIZE_MAX / sizeof(uint64_t))
+        return false;
+
+    uint64_t *slots = mem_alloc(sizeof(*slots) * capacity);
+    if (slots == NULL)
+        return false;
+
+    memset(slots, 0, sizeof(*slots) * capacity);
+    mem_free(pr->fluent_slots);
+    pr->fluent_slots = slots;
+    pr->fluent_capacity = capacity;
+
+    for (uint32_t i = 0; i < pr->base.fluent_count; ++i)
+        update_insert_fluent(pr, i);
+
+    return true;
+}
+
+static bool
+update_assign(struct problem *pr, uint32_t function, const uint32_t *args, double value)
+{
+    struct pddlp_problem *base = &pr->base;
+    uint32_t fluent = base->fluent_count;
+    uint32_t arity = update_arity(pr, function);
+
+    if (fluent == PDDLP_NONE - 1 || base->fact_arg_count > UINT32_MAX - arity || !update_grow_fluents(pr, fluent + 1))
+        return false;
+
+    uint32_t found = update_find_fluent(pr, function, args);
+    if (found != PDDLP_NONE) {
+        base->fluent_values[found] = value;
+        return true;
+    }
+
+    uint32_t *functions = array_reserve(base->fluent_functions, fluent + 1, sizeof(*functions));
+    if (functions == NULL)
+        return false;
+    base->fluent_functions = functions;
+
+    uint32_t *args_first = array_reserve(base->fluent_args_first, fluent + 1, sizeof(*args_first));
+    if (args_first == NULL)
+        return false;
+    base->fluent_args_first = args_first;
+
+    double *values = array_reserve(base->fluent_values, fluent + 1, sizeof(*values));
+    if (values == NULL)
+        return false;
+    base->fluent_values = values;
+
+    if (arity > 0) {
+        uint32_t *fact_args = array_reserve(base->fact_args, base->fact_arg_count + arity, sizeof(*fact_args));
+        if (fact_args == NULL)
+            return false;
+        base->fact_args = fact_args;
+        memcpy(fact_args + base->fact_arg_count, args, sizeof(*args) * arity);
+    }
+
+    functions[fluent] = function;
+    args_first[fluent] = base->fact_arg_count;
+    values[fluent] = value;
+    base->fact_arg_count += arity;
+    base->fluent_count++;
+
+    update_insert_fluent(pr, fluent);
+    return true;
+}
+
+static bool
+update_check_args(const struct pddlp_problem *problem, const uint32_t *args, uint32_t arity,
+    struct pddlp_error *error)
+{
+    for (uint32_t i = 0; i < arity; ++i)
+        if (args[i] >= problem->object_count)
+            return update_fail(error, "unknown object");
+
+    return true;
+}
+
+static bool
+update_apply(struct problem *pr, const struct pddlp_change *change, struct pddlp_error *error)
+{
+    const struct pddlp_domain *d = pr->base.domain;
+
+    if (change->change_type == PDDLP_CHANGE_ASSIGN) {
+        if (change->symbol >= d->function_count)
+            return update_fail(error, "undeclared function");
+
+        if (!update_check_args(&pr->base, change->args, update_arity(pr, change->symbol), error))
+            return false;
+
+        if (!update_assign(pr, change->symbol, change->args, change->value))
+            return update_fail(error, "out of memory");
+
+        return true;
+    }
+
+    if (change->change_type != PDDLP_CHANGE_ADD && change->change_type != PDDLP_CHANGE_REMOVE)
+        return update_fail(error, "unknown change");
+
+    if (change->symbol >= d->predicate_count)
+        return update_fail(error, "undeclared predicate");
+
+    if (!update_check_args(&pr->base, change->args, d->predicates[change->symbol].param_count, error))
+        return false;
+
+    if (change->change_type == PDDLP_CHANGE_ADD) {
+        if (facts_add(pr, change->symbol, change->args) == PDDLP_NONE)
+            return update_fail(error, "out of memory");
+
+        return true;
+    }
+
+    uint32_t fact = pddlp_find_fact(&pr->base, change->symbol, change->args);
+    if (fact != PDDLP_NONE && !facts_remove(pr, fact))
+        return update_fail(error, "out of memory");
+
+    return true;
+}
+
+// objects. new ones go after the rest, so the rows of object_types only
+// grow at the end, and in each list of type_objects they come last.
+
+// makes room for one more object that belongs to `membership_count` types.
+static bool
+update_reserve_object(struct problem *pr, uint32_t membership_count)
+{
+    struct pddlp_problem *base = &pr->base;
+    uint32_t words = base->domain->type_words;
+    uint32_t object = base->object_count;
+    uint32_t total = base->type_objects_first[base->domain->type_count];
+
+    if (object == PDDLP_NONE - 1 || total > UINT32_MAX - membership_count)
+        return false;
+
+    struct pddlp_typed_name *objects = array_reserve(base->objects, object + 1, sizeof(*objects));
+    if (objects == NULL)
+        return false;
+    base->objects = objects;
+
+    uint32_t *type_refs = array_reserve(base->type_refs, base->type_ref_count + 1, sizeof(*type_refs));
+    if (type_refs == NULL)
+        return false;
+    base->type_refs = type_refs;
+
+    if (object + 1 > pr->object_capacity) {
+        uint64_t capacity = (uint64_t)pr->object_capacity * 2 + 16;
+        if (capacity > UINT32_MAX || capacity * words > SIZE_MAX / sizeof(uint64_t))
+            return false;
+
+        uint64_t *object_types = mem_realloc(base->object_types, sizeof(*object_types) * capacity * words);
+        if (object_types == NULL)
+            return false;
+
+        base->object_types = object_types;
+        pr->object_capacity = capacity;
+    }
+
+    if (total + membership_count > pr->type_object_capacity) {
+        uint64_t capacity = (uint64_t)pr->type_object_capacity * 2 + membership_count + 16;
+        if (capacity > UINT32_MAX || capacity > SIZE_MAX / sizeof(uint32_t))
+            return false;
+
+        uint32_t *type_objects = mem_realloc(base->type_objects, sizeof(*type_objects) * capacity);
+        if (type_objects == NULL)
+            return false;
+
+        base->type_objects = type_objects;
+        pr->type_object_capacity = capacity;
+    }
+
+    return true;
+}
+
+static uint32_t
+update_add_object(struct problem *pr, const char *name, size_t length, uint32_t type, struct pddlp_error *error)
+{
+    struct pddlp_problem *base = &pr->base;
+    const struct pddlp_domain *d = base->domain;
+    const struct domain *domain = (const struct domain *)d;
+    uint32_t words = d->type_words;
+    uint32_t object = base->object_count;
+
+    if (type >= d->type_count) {
+        update_fail(error, "undeclared type");
+        return PDDLP_NONE;
+    }
+
+    if (length == 0 || length > UINT32_MAX) {
+        update_fail(error, "expected a name");
+        return PDDLP_NONE;
+    }
+
+    uint32_t hash = hash_name(name, length);
+    if (symbols_find_hashed(&pr->object_symbols, name, length, hash) != PDDLP_NONE ||
+        symbols_find_hashed(&domain->constant_symbols, name, length, hash) != PDDLP_NONE) {
+        update_fail(error, "duplicate object");
+        return PDDLP_NONE;
+    }
+
+    const uint64_t *row = d->supertypes + (size_t)type * words;
+    uint32_t membership_count = 0;
+    for (uint32_t w = 0; w < words; ++w)
+        for (uint64_t bits = row[w]; bits; bits &= bits - 1)
+            membership_count++;
+
+    // everything that can fail comes first.
+    char *copy = NULL;
+    if (update_reserve_object(pr, membership_count))
+        copy = arena_strndup(&pr->arena, name, length);
+
+    if (copy == NULL || !symbols_insert(&pr->object_symbols, copy, length, object)) {
+        update_fail(error, "out of memory");
+        return PDDLP_NONE;
+    }
+
+    struct pddlp_typed_name *objects = base->objects;
+    uint32_t *type_refs = base->type_refs;
+    uint32_t *type_objects_first = base->type_objects_first;
+    uint32_t total = type_objects_first[d->type_count];
+
+    type_refs[base->type_ref_count] = type;
+    objects[object].name = copy;
+    objects[object].type_first = base->type_ref_count;
+    objects[object].type_count = 1;
+    base->type_ref_count++;
+    base->object_count++;
+
+    memcpy(base->object_types + (size_t)object * words, row, sizeof(*row) * words);
+
+    // walks the lists from the last, moving each one up by the number of
+    // lists before it that get the object, and appending it where it goes.
+    uint32_t shift = membership_count;
+    uint32_t end = total;
+    type_objects_first[d->type_count] = total + membership_count;
+
+    for (uint32_t t = d->type_count; t-- > 0 && shift > 0;) {
+        uint32_t start = type_objects_first[t];
+        bool member = (row[t / 64] >> (t % 64)) & 1;
+
+        if (member)
+            base->type_objects[end + shift - 1] = object;
+        shift -= member;
+
+        memmove(base->type_objects + start + shift, base->type_objects + start,
+            sizeof(*base->type_objects) * (end - start));
+        type_objects_first[t] = start + shift;
+        end = start;
+    }
+
+    return object;
+}
+
+// writing. pddlp_write_problem copies the source up to each of the places
+// below, writes what goes there, and carries on from its end.
+
+enum update_edit_type {
+    UPDATE_EDIT_TYPED,      // objects with a type, at the start of :objects.
+    UPDATE_EDIT_UNTYPED,    // objects without one, at its end.
+    UPDATE_EDIT_OBJECTS,    // a whole :objects section.
+    UPDATE_EDIT_INIT,       // a whole :init section.
+};
+
+struct update_edit {
+    enum update_edit_type edit_type;
+    size_t start;
+    size_t end;
+};
+
+struct update_writer {
+    const struct problem *pr;
+    const char *source;
+    struct pddlp_error *error;
+    jmp_buf fail;
+
+    pddlp_write_fn write;
+    void *context;
+    char *buffer;
+    size_t buffered;
+};
+
+static void
+update_writer_fail(struct update_writer *w, const char *message)
+{
+    update_fail(w->error, message);
+    longjmp(w->fail, 1);
+}
+
+static void
+update_flush(struct update_writer *w)
+{
+    if (w->buffered > 0 && !w->write(w->context, w->buffer, w->buffered))
+        update_writer_fail(w, "couldn't write the output");
+
+    w->buffered = 0;
+}
+
+static void
+update_write(struct update_writer *w, const char *data, size_t length)
+{
+    // long stretches of the source skip the buffer.
+    if (length >= UPDATE_BUFFER_SIZE) {
+        update_flush(w);
+        if (!w->write(w->context, data, length))
+            update_writer_fail(w, "couldn't write the output");
+        return;
+    }
+
+    if (w->buffered + length > UPDATE_BUFFER_SIZE)
+        update_flush(w);
+
+    memcpy(w->buffer + w->buffered, data, length);
+    w->buffered += length;
+}
+
+static void
+update_write_string(struct update_writer *w, const char *text)
+{
+    update_write(w, text, strlen(text));
+}
+
+// ` a b c`, the names of `count` objects.
+static void
+update_write_objects(struct update_writer *w, const uint32_t *args, uint32_t count)
+{
+    const struct pddlp_typed_name *objects = w->pr->base.objects;
+
+    for (uint32_t i = 0; i < count; ++i) {
+        update_write(w, " ", 1);
+        update_write_string(w, objects[args[i]].name);
+    }
+}
+
+// the shortest of the usual forms that reads back as the same number.
+static void
+update_write_value(struct update_writer *w, double value)
+{
+    char text[32];
+    int length = snprintf(text, sizeof(text), "%.15g", value);
+    if (strtod(text, NULL) != value)
+        length = snprintf(text, sizeof(text), "%.17g", value);
+
+    update_write(w, text, length);
+}
+
+// the objects added since parsing, with or without a type.
+static void
+update_write_added(struct update_writer *w, bool typed)
+{
+    const struct pddlp_problem *base = &w->pr->base;
+
+    for (uint32_t o = w->pr->parsed_object_count; o < base->object_count; ++o) {
+        uint32_t type = base->type_refs[base->objects[o].type_first];
+        if ((type != 0) != typed)
+            continue;
+
+        update_write_objects(w, &o, 1);
+        if (typed) {
+            update_write(w, " - ", 3);
+            update_write_string(w, base->domain->types[type].name);
+        }
+    }
+}
+
+static void
+update_write_init(struct update_writer *w)
+{
+    const struct problem *pr = w->pr;
+    const struct pddlp_problem *base = &pr->base;
+    const struct pddlp_domain *d = base->domain;
+
+    update_write_string(w, "(:init");
+
+    for (uint32_t i = 0; i < base->fact_count; ++i) {
+        uint32_t predicate = base->fact_predicates[i];
+        update_write(w, "\n    (", 6);
+        update_write_string(w, d->predicates[predicate].name);
+        update_write_objects(w, base->fact_args + base->fact_args_first[i], d->predicates[predicate].param_count);
+        update_write(w, ")", 1);
+    }
+
+    for (uint32_t i = 0; i < base->fluent_count; ++i) {
+        uint32_t function = base->fluent_functions[i];
+        update_write(w, "\n    (= (", 9);
+        update_write_string(w, d->functions[function].name);
+        update_write_objects(w, base->fact_args + base->fluent_args_first[i], d->functions[function].param_count);
+        update_write(w, ") ", 2);
+        update_write_value(w, base->fluent_values[i]);
+        update_write(w, ")", 1);
+    }
+
+    for (uint32_t i = 0; i < base->timed_literal_count; ++i) {
+        update_write(w, "\n    ", 5);
+        update_write(w, w->source + pr->timed_spans[2 * i], pr->timed_spans[2 * i + 1] - pr->timed_spans[2 * i]);
+    }
+
+    update_write(w, ")", 1);
+}
+
+static void
+update_write_edit(struct update_writer *w, enum update_edit_type edit_type)
+{
+    switch (edit_type) {
+    case UPDATE_EDIT_TYPED:
+        update_write_added(w, true);
+        break;
+    case UPDATE_EDIT_UNTYPED:
+        update_write_added(w, false);
+        break;
+    case UPDATE_EDIT_OBJECTS:
+        update_write_string(w, "(:objects");
+        update_write_added(w, true);
+        update_write_added(w, false);
+        update_write_string(w, ")\n  ");
+        break;
+    case UPDATE_EDIT_INIT:
+        update_write_init(w);
+        break;
+    }
+}
+
+static void
+update_write_problem(struct update_writer *w)
+{
+    const struct problem *pr = w->pr;
+    struct update_edit edits[3];
+    uint32_t edit_count = 0;
+
+    // the edits are in the order of the source, as long as :objects comes
+    // before :init.
+    if (pr->base.object_count > pr->parsed_object_count) {
+        if (pr->objects_end) {
+            edits[edit_count++] = (struct update_edit) { UPDATE_EDIT_TYPED, pr->objects_list, pr->objects_list };
+            edits[edit_count++] =
+                (struct update_edit) { UPDATE_EDIT_UNTYPED, pr->objects_end - 1, pr->objects_end - 1 };
+        } else {
+            size_t at = pr->init_end ? pr->init_start : pr->body_end;
+            edits[edit_count++] = (struct update_edit) { UPDATE_EDIT_OBJECTS, at, at };
+        }
+    }
+
+    if (pr->init_end)
+        edits[edit_count++] = (struct update_edit) { UPDATE_EDIT_INIT, pr->init_start, pr->init_end };
+    else
+        edits[edit_count++] = (struct update_edit) { UPDATE_EDIT_INIT, pr->body_end, pr->body_end };
+
+    // which pddl doesn't ask for.
+    if (edit_count == 3 && edits[2].start < edits[0].start) {
+        struct update_edit init = edits[2];
+        edits[2] = edits[1];
+        edits[1] = edits[0];
+        edits[0] = init;
+    }
+
+    size_t position = 0;
+    for (uint32_t i = 0; i < edit_count; ++i) {
+        update_write(w, w->source + position, edits[i].start - position);
+        update_write_edit(w, edits[i].edit_type);
+        position = edits[i].end;
+    }
+
+    update_write(w, w->source + position, pr->source_length - position);
+    update_flush(w);
+}
+
+// api
+
+uint32_t
+pddlp_add_object(struct pddlp_problem *problem, const char *name, size_t length, uint32_t type,
+    struct pddlp_error *error)
+{
+    enum pddlp_subsystem previous = mem_enter(PDDLP_SUBSYSTEM_FACTS);
+    uint32_t object = update_add_object((struct problem *)problem, name, length, type, error);
+    mem_leave(previous);
+    return object;
+}
+
+bool
+pddlp_apply_changes(struct pddlp_problem *problem, const struct pddlp_change *changes, uint32_t count,
+    struct pddlp_error *error)
+{
+    enum pddlp_subsystem previous = mem_enter(PDDLP_SUBSYSTEM_FACTS);
+
+    bool applied = true;
+    for (uint32_t i = 0; i < count && applied; ++i)
+        applied = update_apply((struct problem *)problem, &changes[i], error);
+
+    mem_leave(previous);
+    return applied;
+}
+
+bool
+pddlp_write_problem(const struct pddlp_problem *problem, const char *source, pddlp_write_fn write, void *context,
+    struct pddlp_error *error)
+{
+    const struct problem *pr = (const struct problem *)problem;
+
+    // a cheap check that this is the text the offsets are into.
+    if (strlen(source) != pr->source_length || (pr->init_end && source[pr->init_start] != '('))
+        return update_fail(error, "not the source of the problem");
+
+    struct update_writer writer;
+    struct update_writer *w = &writer;
+    memset(w, 0, sizeof(*w));
+    w->pr = pr;
+    w->source = source;
+    w->error = error;
+    w->write = write;
+    w->context = context;
+
+    enum pddlp_subsystem previous = mem_enter(PDDLP_SUBSYSTEM_FACTS);
+    w->buffer = mem_alloc(UPDATE_BUFFER_SIZE);
+    mem_leave(previous);
+
+    bool written = w->buffer != NULL;
+    if (!written)
+        update_fail(error, "out of memory");
+    else if (setjmp(w->fail))
+        written = false;
+    else
+        update_write_problem(w);
+
+    mem_free(w->buffer);
+    return written;
+}
@@ -0,0 +1,321 @@
+// SPDX-FileCopyrightText: 2024 Guilherme Puida Moreira <guilherme@puida.xyz>
+// SPDX-License-Identifier: BSD-3-Clause
+
+// plan validation over a grounded problem. the validator maps each
+// (action, args) to its operator through a hash table, and a plan is then
+// just a lookup and a few bit operations per step.
+
+#include "internal.h"
+
+struct pddlp_validator {
+    const struct pddlp_strips *strips;
+    uint32_t max_arity;
+
+    // the hash of the operator in the high half and operator + 1 in the low
+    // half, or 0 when empty.
+    uint64_t *slots;
+    uint32_t capacity;
+};
+
+static uint32_t
+validate_hash(uint32_t action, const uint32_t *args, uint32_t arity)
+{
+    return (uint32_t)(hash64(args, sizeof(*args) * arity, action) >> 32);
+}
+
+struct pddlp_validator *
+pddlp_new_validator(const struct pddlp_strips *strips, struct pddlp_error *error)
+{
+    const struct pddlp_domain *d = strips->problem->domain;
+
+    enum pddlp_subsystem previous = mem_enter(PDDLP_SUBSYSTEM_VALIDATOR);
+    struct pddlp_validator *v = mem_alloc(sizeof(*v));
+    uint64_t capacity = 64;
+    while (capacity < (uint64_t)strips->operator_count * 2)
+        capacity *= 2;
+
+    uint64_t *slots = NULL;
+    if (v && capacity <= UINT32_MAX && capacity <= SIZE_MAX / sizeof(*slots))
+        slots = mem_alloc(sizeof(*slots) * capacity);
+    mem_leave(previous);
+
+    if (slots == NULL) {
+        mem_free(v);
+        error->message = "out of memory";
+        error->line = 0;
+        error->column = 0;
+        return NULL;
+    }
+
+    memset(slots, 0, sizeof(*slots) * capacity);
+    v->strips = strips;
+    v->max_arity = 0;
+    v->slots = slots;
+    v->capacity = capacity;
+
+    for (uint32_t i = 0; i < d->action_count; ++i)
+        if (d->actions[i].param_count > v->max_arity)
+            v->max_arity = d->actions[i].param_count;
+
+    // the grounder never emits the same operator twice.
+    uint32_t mask = capacity - 1;
+    for (uint32_t op = 0; op < strips->operator_count; ++op) {
+        const struct pddlp_operator *o = &strips->operators[op];
+        uint32_t hash = validate_hash(o->action, strips->operator_args + o->args, d->actions[o->action].param_count);
+
+        uint32_t i = hash & mask;
+        while (slots[i])
+            i = (i + 1) & mask;
+        slots[i] = (uint64_t)hash << 32 | (op + 1);
+    }
+
+    return v;
+}
+
+void
+pddlp_free_validator(struct pddlp_validator *v)
+{
+    if (v == NULL)
+        return;
+
+    mem_free(v->slots);
+    mem_free(v);
+}
+
+uint32_t
+pddlp_find_operator(const struct pddlp_validator *v, uint32_t action, const uint32_t *args)
+{
+    const struct pddlp_strips *strips = v->strips;
+    uint32_t arity = strips->problem->domain->actions[action].param_count;
+    uint32_t hash = validate_hash(action, args, arity);
+    uint32_t mask = v->capacity - 1;
+
+    for (uint32_t i = hash & mask;; i = (i + 1) & mask) {
+        uint64_t slot = v->slots[i];
+        if (slot == 0)
+            return PDDLP_NONE;
+
+        uint32_t op = (uint32_t)slot - 1;
+        const struct pddlp_operator *o = &strips->operators[op];
+        if ((uint32_t)(slot >> 32) == hash && o->action == action &&
+            (arity == 0 || memcmp(strips->operator_args + o->args, args, sizeof(*args) * arity) == 0))
+            return op;
+    }
+}
+
+// plan text
+
+struct validate_scanner {
+    const char *current;
+    uint64_t line;
+    uint64_t column;
+};
+
+static void
+validate_advance(struct validate_scanner *s)
+{
+    if (*s->current == '\n') {
+        s->line++;
+        s->column = 1;
+    } else {
+        s->column++;
+    }
+
+    s->current++;
+}
+
+static void
+validate_skip_space(struct validate_scanner *s)
+{
+    for (;;) {
+        char c = *s->current;
+        if (c == ' ' || c == '\t' || c == '\r' || c == '\n') {
+            validate_advance(s);
+        } else if (c == ';') {
+            while (*s->current && *s->current != '\n')
+                validate_advance(s);
+        } else {
+            return;
+        }
+    }
+}
+
+static bool
+validate_is_name(char c)
+{
+    return c && c != ' ' && c != '\t' && c != '\r' && c != '\n' && c != '(' && c != ')' && c != ';';
+}
+
+static bool
+validate_fail(struct pddlp_plan_result *result, const struct validate_scanner *s, const char *message)
+{
+    result->message = message;
+    result->line = s->line;
+    result->column = s->column;
+    return false;
+}
+
+bool
+pddlp_validate_plan(const struct pddlp_validator *v, const char *plan, struct pddlp_plan_result *result)
+{
+    const struct pddlp_strips *strips = v->strips;
+    const struct pddlp_problem *pr = strips->problem;
+    const struct pddlp_domain *d = pr->domain;
+
+    struct validate_scanner scanner = { plan, 1, 1 };
+    struct validate_scanner *s = &scanner;
+
+    result->step = 0;
+    result->step_count = 0;
+    result->fact = PDDLP_NONE;
+
+    enum pddlp_subsystem previous = mem_enter(PDDLP_SUBSYSTEM_VALIDATOR);
+    uint64_t *state = mem_alloc(sizeof(*state) * (PDDLP_STATE_WORDS(strips->fact_count) + 1));
+    uint32_t *args = mem_alloc(sizeof(*args) * ((size_t)v->max_arity + 1));
+    mem_leave(previous);
+    if (state == NULL || args == NULL) {
+        mem_free(state);
+        mem_free(args);
+        return validate_fail(result, s, "out of memory");
+    }
+
+    pddlp_strips_init_state(strips, state);
+    bool valid = false;
+
+    for (;; result->step++) {
+        validate_skip_space(s);
+        if (*s->current == 0)
+            break;
+
+        // an optional `time:` prefix.
+        if ((*s->current >= '0' && *s->current <= '9') || *s->current == '.') {
+            while ((*s->current >= '0' && *s->current <= '9') || *s->current == '.')
+                validate_advance(s);
+
+            validate_skip_space(s);
+            if (*s->current != ':') {
+                validate_fail(result, s, "expected ':' after the time of a step");
+                goto done;
+            }
+
+            validate_advance(s);
+            validate_skip_space(s);
+        }
+
+        struct validate_scanner step = *s;
+        if (*s->current != '(') {
+            validate_fail(result, s, "expected '('");
+            goto done;
+        }
+
+        validate_advance(s);
+        validate_skip_space(s);
+
+        const char *name = s->current;
+        while (validate_is_name(*s->current))
+            validate_advance(s);
+
+        uint32_t action = pddlp_find_action(d, name, s->current - name);
+        if (action == PDDLP_NONE) {
+            validate_fail(result, &step, "unknown action");
+            goto done;
+        }
+
+        uint32_t arity = d->actions[action].param_count;
+        uint32_t arg_count = 0;
+
+        for (;;) {
+            validate_skip_space(s);
+            if (*s->current == ')')
+                break;
+
+            struct validate_scanner arg = *s;
+            name = s->current;
+            while (validate_is_name(*s->current))
+                validate_advance(s);
+
+            if (s->current == name) {
+                validate_fail(result, s, *s->current ? "expected an object" : "unexpected end of input");
+                goto done;
+            }
+
+            uint32_t object = pddlp_find_object(pr, name, s->current - name);
+            if (object == PDDLP_NONE) {
+                validate_fail(result, &arg, "unknown object");
+                goto done;
+            }
+
+            if (arg_count == arity) {
+                validate_fail(result, &step, "wrong number of arguments");
+                goto done;
+            }
+
+            args[arg_count++] = object;
+        }
+
+        validate_advance(s);
+
+        if (arg_count != arity) {
+            validate_fail(result, &step, "wrong number of arguments");
+            goto done;
+        }
+
+        // an optional `[duration]`.
+        validate_skip_space(s);
+        if (*s->current == '[') {
+            while (*s->current && *s->current != ']')
+                validate_advance(s);
+
+            if (*s->current == 0) {
+                validate_fail(result, s, "unexpected end of input");
+                goto done;
+            }
+
+            validate_advance(s);
+        }
+
+        // the grounder only keeps the operators whose parameters have the
+        // right types and whose static preconditions hold.
+        uint32_t op = pddlp_find_operator(v, action, args);
+        if (op == PDDLP_NONE) {
+            validate_fail(result, &step, "the action doesn't apply to these objects");
+            goto done;
+        }
+
+        const struct pddlp_operator *o = &strips->operators[op];
+        for (uint32_t i = o->pre; i < o->add; ++i) {
+            uint32_t fact = strips->operator_facts[i];
+            if (!(state[fact / 64] & (UINT64_C(1) << (fact % 64)))) {
+                result->fact = fact;
+                validate_fail(result, &step, "precondition doesn't hold");
+                goto done;
+            }
+        }
+
+        pddlp_strips_apply(strips, op, state);
+    }
+
+    for (uint32_t i = 0; i < strips->goal_count; ++i) {
+        uint32_t fact = strips->goal[i];
+        if (!(state[fact / 64] & (UINT64_C(1) << (fact % 64)))) {
+            result->fact = fact;
+            validate_fail(result, s, "goal doesn't hold");
+            goto done;
+        }
+    }
+
+    result->step_count = result->step;
+    result->step = PDDLP_NONE;
+    result->message = NULL;
+    result->line = 0;
+    result->column = 0;
+    valid = true;
+
+done:
+    if (!valid)
+        result->step_count = result->step;
+
+    mem_free(state);
+    mem_free(args);
+    return valid;
+}
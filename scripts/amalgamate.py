@@ -0,0 +1,103 @@
+#!/usr/bin/env python3
+# SPDX-FileCopyrightText: 2024 Guilherme Puida Moreira <guilherme@puida.xyz>
+# SPDX-License-Identifier: BSD-3-Clause
+
+"""Generates the single-header build of pddlp.
+
+usage: amalgamate.py <output> <pddlp.h> <sources...>
+
+The header is emitted as-is. The sources follow it, guarded by
+PDDLP_IMPLEMENTATION. Local includes ("...") are inlined the first time they
+are seen and dropped afterwards. Feature test macros are hoisted to the top,
+since they must come before any system header.
+"""
+
+import os
+import re
+import sys
+
+INCLUDE = re.compile(r'^\s*#\s*include\s+"([^"]+)"')
+FEATURE = re.compile(r'^\s*#\s*define\s+(_POSIX_C_SOURCE|_XOPEN_SOURCE|_DEFAULT_SOURCE|_GNU_SOURCE|_FILE_OFFSET_BITS)\b(.*)$')
+
+
+def expand(path, seen, features):
+    lines = []
+    directory = os.path.dirname(path)
+
+    with open(path) as file:
+        for line in file:
+            include = INCLUDE.match(line)
+            if include:
+                target = os.path.normpath(os.path.join(directory, include.group(1)))
+                if target not in seen:
+                    seen.add(target)
+                    lines += expand(target, seen, features)
+                continue
+
+            feature = FEATURE.match(line)
+            if feature:
+                features.setdefault(feature.group(1), feature.group(2).strip())
+                # the comment explaining the macro moves away with it.
+                while lines and lines[-1].lstrip().startswith('//'):
+                    lines.pop()
+                continue
+
+            if line.startswith('// SPDX-'):
+                continue
+
+            lines.append(line)
+
+    return lines
+
+
+def main():
+    output, header, sources = sys.argv[1], sys.argv[2], sys.argv[3:]
+
+    seen = {os.path.normpath(header)}
+    features = {}
+
+    header_lines = expand(header, seen, features)
+    source_lines = []
+    for source in sources:
+        source = os.path.normpath(source)
+        seen.add(source)
+        source_lines += ['\n', '// ' + os.path.basename(source) + '\n']
+        source_lines += expand(source, seen, features)
+
+    with open(output, 'w') as file:
+        file.write('// SPDX-FileCopyrightText: 2024 Guilherme Puida Moreira <guilherme@puida.xyz>\n')
+        file.write('// SPDX-License-Identifier: BSD-3-Clause\n')
+        file.write('//\n')
+        file.write('// single-header build of pddlp, generated by scripts/amalgamate.py.\n')
+        file.write('// do not edit.\n')
+        file.write('//\n')
+        file.write('// without PDDLP_IMPLEMENTATION this only declares the api, and the\n')
+        file.write('// library must be linked as usual. with it, the whole implementation is\n')
+        file.write('// compiled into the including file with internal linkage:\n')
+        file.write('//\n')
+        file.write('//     #define PDDLP_IMPLEMENTATION\n')
+        file.write('//     #include "pddlp_impl.h"\n')
+        file.write('\n')
+        file.write('#ifndef PDDLP_IMPL_H_\n')
+        file.write('#define PDDLP_IMPL_H_\n')
+        file.write('\n')
+        file.write('#ifdef PDDLP_IMPLEMENTATION\n')
+        for name, value in features.items():
+            file.write('#ifndef ' + name + '\n')
+            file.write('#define ' + name + (' ' + value if value else '') + '\n')
+            file.write('#endif\n')
+        file.write('#define PDDLP_STATIC\n')
+        file.write('#endif\n')
+        file.write('\n')
+        file.writelines(header_lines)
+        file.write('\n')
+        file.write('#ifdef PDDLP_IMPLEMENTATION\n')
+        file.writelines(source_lines)
+        file.write('\n')
+        file.write('#endif // PDDLP_IMPLEMENTATION\n')
+        file.write('\n')
+        file.write('#endif // PDDLP_IMPL_H_\n')
+
+
+if __name__ == '__main__':
+    main()
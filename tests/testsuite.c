@@ -1,11 +1,21 @@
 // SPDX-FileCopyrightText: 2024 Guilherme Puida Moreira <guilherme@puida.xyz>
 // SPDX-License-Identifier: BSD-3-Clause
 
+// needed for ftruncate and mmap in the large input test, and mkstemp in the
+// cache test.
+#define _POSIX_C_SOURCE 200809L
+
 #include "pddlp.h"
 
 #include <criterion/criterion.h>
 #include <criterion/new/assert.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
 
 #define LEN(x) (sizeof(x)/sizeof(*(x)))
 
@@ -17,22 +27,22 @@ token_eq(struct pddlp_token expected, struct pddlp_token got)
         pddlp_token_type_names[expected.token_type],
         pddlp_token_type_names[got.token_type]);
 
-    cr_expect(eq(int, expected.line, got.line),
-        "expected line to be %d, got %d",
+    cr_expect(eq(u64, expected.line, got.line),
+        "expected line to be %" PRIu64 ", got %" PRIu64,
         expected.line, got.line);
 
-    cr_expect(eq(int, expected.column, got.column),
-        "expected column to be %d, got %d",
+    cr_expect(eq(u64, expected.column, got.column),
+        "expected column to be %" PRIu64 ", got %" PRIu64,
         expected.column, got.column);
 
-    cr_expect(eq(int, expected.length, got.length),
-        "expected length to be %d, got %d",
+    cr_expect(eq(u32, expected.length, got.length),
+        "expected length to be %" PRIu32 ", got %" PRIu32,
         expected.length, got.length);
 
     cr_expect(eq(int, strncmp(expected.start, got.start, expected.length), 0),
         "expected content to be '%.*s', got '%.*s'",
-        expected.length, expected.start,
-        got.length, got.start);
+        (int)expected.length, expected.start,
+        (int)got.length, got.start);
 }
 
 static void
@@ -54,8 +64,8 @@ Test(tokenizer, init) {
     struct pddlp_tokenizer tokenizer;
     pddlp_init_tokenizer(&tokenizer, "");
 
-    cr_expect(eq(int, tokenizer.line, 1));
-    cr_expect(eq(int, tokenizer.column, 1));
+    cr_expect(eq(u64, tokenizer.line, 1));
+    cr_expect(eq(u64, tokenizer.column, 1));
     cr_expect(eq(tokenizer.start, tokenizer.current));
 
     struct pddlp_token expected = mktoken(PDDLP_TOKEN_EOF, "", 1, 1);
@@ -201,7 +211,8 @@ Test(tokenizer, keywords) {
         "total-time\n"
         "undefined\n"
         "when\n"
-        "within\n";
+        "within\n"
+        "scale-down\n";
 
     pddlp_init_tokenizer(&tokenizer, source);
 
@@ -242,6 +253,7 @@ Test(tokenizer, keywords) {
         mktoken(PDDLP_TOKEN_UNDEFINED, "undefined", 34, 1),
         mktoken(PDDLP_TOKEN_WHEN, "when", 35, 1),
         mktoken(PDDLP_TOKEN_WITHIN, "within", 36, 1),
+        mktoken(PDDLP_TOKEN_SCALE_DOWN, "scale-down", 37, 1),
     };
 
     expect_list(&tokenizer, expected, LEN(expected));
@@ -378,3 +390,2009 @@ Test(tokenizer, variable) {
 
     expect_list(&tokenizer, expected, LEN(expected));
 }
+
+// maps the same 1MB chunk over and over to build a source larger than 4GB
+// without touching more than a couple of pages of memory. the input is a
+// single line, so columns must go past UINT32_MAX.
+static uint64_t
+count_tokens(const char *source)
+{
+    struct pddlp_tokenizer tokenizer;
+    pddlp_init_tokenizer(&tokenizer, source);
+
+    uint64_t count = 0;
+    while (pddlp_scan_token(&tokenizer).token_type != PDDLP_TOKEN_EOF)
+        count++;
+
+    return count;
+}
+
+Test(tokenizer, estimate) {
+    static const char *cases[] = {
+        "(:init (at t1 a) (= (f a) 2.5)) ; (not a token\n",
+        "-1.5 1.2.3 1..2 12ab a1.5 --x _y pos-1-2",
+        "?x ?1 ? x ??y ?;x\n ?(",
+        "<= >= < = #t #tx ## #a :requirements :foo",
+        "\t\r\n;;\n; ; ;\n@$ \x80 +*/",
+    };
+
+    // at every offset, so each construct also crosses a block.
+    static char source[256];
+    for (size_t i = 0; i < LEN(cases); ++i) {
+        for (size_t offset = 0; offset < 64; ++offset) {
+            memset(source, ' ', offset);
+            strcpy(source + offset, cases[i]);
+            cr_expect(eq(u64, pddlp_estimate_tokens(source, strlen(source)), count_tokens(source)),
+                "case %zu at %zu", i, offset);
+        }
+    }
+
+    // random sources over the characters the tokenizer treats specially.
+    static const char alphabet[] = " \n\t;?:.#t<>=-_()a1Z9+";
+    uint64_t seed = 88172645463325252u;
+
+    for (int i = 0; i < 20000; ++i) {
+        size_t length = i % 200;
+        for (size_t j = 0; j < length; ++j) {
+            seed ^= seed << 13;
+            seed ^= seed >> 7;
+            seed ^= seed << 17;
+            source[j] = alphabet[seed % (sizeof(alphabet) - 1)];
+        }
+
+        // '?' takes the next byte, even the terminator.
+        source[length] = ' ';
+        source[length + 1] = 0;
+        cr_assert(eq(u64, pddlp_estimate_tokens(source, length + 1), count_tokens(source)), "source %s", source);
+    }
+
+    // the tokenizer stops at a zero byte, which the estimate counts as an
+    // unrecognized character.
+    cr_expect(eq(u64, count_tokens("(a)\0(b)"), 3));
+    cr_expect(eq(u64, pddlp_estimate_tokens("(a)\0(b)", 7), 7));
+    cr_expect(eq(u64, pddlp_estimate_tokens("", 0), 0));
+}
+
+Test(tokenizer, large_input, .timeout = 600) {
+    if (sizeof(void *) < 8)
+        cr_skip_test("needs a 64-bit address space");
+
+    const char chunk_start[] = "(at a b)";
+    const size_t chunk_size = 1 << 20;
+    const size_t chunk_count = 4097;
+    const size_t total_size = chunk_size * chunk_count;
+
+    FILE *file = tmpfile();
+    cr_assert(file != NULL);
+    int fd = fileno(file);
+
+    // the second chunk is the last one of the source, and ends in a 0.
+    static char chunk[1 << 20];
+    memset(chunk, ' ', sizeof(chunk));
+    memcpy(chunk, chunk_start, sizeof(chunk_start) - 1);
+    cr_assert(eq(sz, fwrite(chunk, 1, sizeof(chunk), file), sizeof(chunk)));
+    chunk[sizeof(chunk) - 1] = 0;
+    cr_assert(eq(sz, fwrite(chunk, 1, sizeof(chunk), file), sizeof(chunk)));
+    cr_assert(eq(int, fflush(file), 0));
+
+    char *source = mmap(NULL, total_size, PROT_NONE, MAP_SHARED, fd, 0);
+    cr_assert(ne(ptr, source, MAP_FAILED));
+
+    for (size_t i = 0; i < chunk_count; ++i) {
+        off_t offset = i == chunk_count - 1 ? (off_t)chunk_size : 0;
+        void *mapped = mmap(source + i * chunk_size, chunk_size, PROT_READ,
+            MAP_SHARED | MAP_FIXED, fd, offset);
+        cr_assert(ne(ptr, mapped, MAP_FAILED));
+    }
+
+    struct pddlp_tokenizer tokenizer;
+    pddlp_init_tokenizer(&tokenizer, source);
+
+    uint64_t token_count = 0;
+    struct pddlp_token last = {0};
+
+    for (;;) {
+        struct pddlp_token token = pddlp_scan_token(&tokenizer);
+        if (token.token_type == PDDLP_TOKEN_EOF)
+            break;
+
+        cr_assert(ne(int, token.token_type, PDDLP_TOKEN_ERROR));
+        token_count++;
+        last = token;
+    }
+
+    cr_expect(eq(u64, token_count, 5 * chunk_count));
+    cr_expect(eq(int, last.token_type, PDDLP_TOKEN_RPAREN));
+    cr_expect(eq(u64, last.line, 1));
+    cr_expect(eq(u64, last.column, total_size - chunk_size + sizeof(chunk_start) - 1));
+    cr_expect(gt(u64, last.column, UINT32_MAX));
+
+    munmap(source, total_size);
+    fclose(file);
+}
+
+Test(lookahead, peek_and_next) {
+    struct pddlp_tokenizer tokenizer;
+    const char *source = "(:init (= (f a) 1) (at a b))";
+
+    pddlp_init_tokenizer(&tokenizer, source);
+
+    struct pddlp_token expected[] = {
+        mktoken(PDDLP_TOKEN_LPAREN, "(", 1, 1),
+        mktoken(PDDLP_TOKEN_SYM_INIT, ":init", 1, 2),
+        mktoken(PDDLP_TOKEN_LPAREN, "(", 1, 8),
+        mktoken(PDDLP_TOKEN_EQ, "=", 1, 9),
+        mktoken(PDDLP_TOKEN_LPAREN, "(", 1, 11),
+        mktoken(PDDLP_TOKEN_NAME, "f", 1, 12),
+        mktoken(PDDLP_TOKEN_NAME, "a", 1, 14),
+        mktoken(PDDLP_TOKEN_RPAREN, ")", 1, 15),
+        mktoken(PDDLP_TOKEN_NUMBER, "1", 1, 17),
+        mktoken(PDDLP_TOKEN_RPAREN, ")", 1, 18),
+        mktoken(PDDLP_TOKEN_LPAREN, "(", 1, 20),
+        mktoken(PDDLP_TOKEN_AT, "at", 1, 21),
+        mktoken(PDDLP_TOKEN_NAME, "a", 1, 24),
+        mktoken(PDDLP_TOKEN_NAME, "b", 1, 26),
+        mktoken(PDDLP_TOKEN_RPAREN, ")", 1, 27),
+        mktoken(PDDLP_TOKEN_RPAREN, ")", 1, 28),
+        mktoken(PDDLP_TOKEN_EOF, "", 1, 29),
+    };
+
+    token_eq(expected[3], pddlp_peek_token(&tokenizer, 3));
+    token_eq(expected[0], pddlp_peek_token(&tokenizer, 0));
+    token_eq(expected[15], pddlp_peek_token(&tokenizer, 15));
+
+    for (int i = 0; i < (int)LEN(expected); ++i) {
+        for (int k = 0; i + k < (int)LEN(expected) && k < PDDLP_LOOKAHEAD; ++k)
+            token_eq(expected[i + k], pddlp_peek_token(&tokenizer, k));
+
+        token_eq(expected[i], pddlp_next_token(&tokenizer));
+    }
+
+    token_eq(expected[16], pddlp_peek_token(&tokenizer, PDDLP_LOOKAHEAD - 1));
+    token_eq(expected[16], pddlp_next_token(&tokenizer));
+    token_eq(expected[16], pddlp_next_token(&tokenizer));
+}
+
+Test(lookahead, past_eof) {
+    struct pddlp_tokenizer tokenizer;
+    pddlp_init_tokenizer(&tokenizer, "a b");
+
+    struct pddlp_token eof = mktoken(PDDLP_TOKEN_EOF, "", 1, 4);
+
+    token_eq(eof, pddlp_peek_token(&tokenizer, 2));
+    token_eq(eof, pddlp_peek_token(&tokenizer, 9));
+    cr_expect(eq(int, pddlp_next_token(&tokenizer).token_type, PDDLP_TOKEN_NAME));
+    cr_expect(eq(int, pddlp_next_token(&tokenizer).token_type, PDDLP_TOKEN_NAME));
+    token_eq(eof, pddlp_peek_token(&tokenizer, 0));
+    token_eq(eof, pddlp_next_token(&tokenizer));
+    token_eq(eof, pddlp_next_token(&tokenizer));
+}
+
+Test(lookahead, out_of_range) {
+    struct pddlp_tokenizer tokenizer;
+    pddlp_init_tokenizer(&tokenizer,
+        "t0 t1 t2 t3 t4 t5 t6 t7 t8 t9 t10 t11 t12 t13 t14 t15 t16 t17");
+
+    struct pddlp_token token = pddlp_peek_token(&tokenizer, PDDLP_LOOKAHEAD);
+    cr_expect(eq(int, token.token_type, PDDLP_TOKEN_ERROR));
+    cr_expect(eq(str, (char *)token.start,
+        (char *)pddlp_token_error_messages[PDDLP_TOKEN_ERROR_LOOKAHEAD]));
+
+    // the ring is untouched.
+    struct pddlp_token first = mktoken(PDDLP_TOKEN_NAME, "t0", 1, 1);
+    struct pddlp_token last = mktoken(PDDLP_TOKEN_NAME, "t15", 1, 51);
+
+    token_eq(last, pddlp_peek_token(&tokenizer, 15));
+    token_eq(first, pddlp_next_token(&tokenizer));
+
+    // near the end, peeking past the window still reaches EOF.
+    for (int i = 0; i < 10; i++)
+        pddlp_next_token(&tokenizer);
+    cr_expect(eq(int, pddlp_peek_token(&tokenizer, PDDLP_LOOKAHEAD + 4).token_type,
+        PDDLP_TOKEN_EOF));
+}
+
+static const char *logistics_domain =
+    "(define (domain logistics)\n"
+    "  (:requirements :strips :typing)\n"
+    "  (:types truck airplane - vehicle package vehicle - physobj\n"
+    "          airport - location city place)\n"
+    "  (:constants hub - location)\n"
+    "  (:predicates (at ?x - physobj ?l - location) (in ?p - package ?v - vehicle))\n"
+    "  (:functions (distance ?a ?b - location) - number)\n"
+    "  (:action drive\n"
+    "    :parameters (?t - truck ?from ?to - location)\n"
+    "    :precondition (and (at ?t ?from) (not (at ?t hub)))\n"
+    "    :effect (and (not (at ?t ?from)) (at ?t ?to)))\n"
+    "  (:action unload-all\n"
+    "    :parameters (?v - vehicle ?l - location)\n"
+    "    :precondition ()\n"
+    "    :effect (forall (?p - package) (when (in ?p ?v) (at ?p ?l)))))\n";
+
+static const char *logistics_problem =
+    "(define (problem deliver)\n"
+    "  (:domain logistics)\n"
+    "  (:objects t1 - truck p1 p2 - package a b - location)\n"
+    "  (:init (at t1 a) (at p1 hub) (in p2 t1) (= (distance a b) 2.5)\n"
+    "         (not (at t1 b)) (at 10 (at p2 b)))\n"
+    "  (:goal (and (at p1 b) (exists (?x - truck) (at ?x hub))))\n"
+    "  (:metric minimize (total-time)))\n";
+
+Test(parser, domain) {
+    struct pddlp_error error;
+    struct pddlp_domain *domain = pddlp_parse_domain(logistics_domain, &error);
+    cr_assert(ne(ptr, domain, NULL), "%s at %" PRIu64 ":%" PRIu64, error.message, error.line, error.column);
+
+    cr_expect(eq(str, (char *)domain->name, "logistics"));
+    cr_expect(eq(u64, domain->requirements,
+        PDDLP_REQUIREMENT(PDDLP_TOKEN_SYM_STRIPS) | PDDLP_REQUIREMENT(PDDLP_TOKEN_SYM_TYPING)));
+
+    // object, truck, airplane, vehicle, package, physobj, airport, location,
+    // city, place.
+    cr_expect(eq(u32, domain->type_count, 10));
+    cr_expect(eq(str, (char *)domain->types[0].name, "object"));
+
+    uint32_t truck = pddlp_find_type(domain, "truck", 5);
+    uint32_t vehicle = pddlp_find_type(domain, "vehicle", 7);
+    uint32_t city = pddlp_find_type(domain, "city", 4);
+    cr_assert(ne(u32, truck, PDDLP_NONE));
+    cr_expect(eq(u32, domain->types[truck].type_count, 1));
+    cr_expect(eq(u32, domain->type_refs[domain->types[truck].type_first], vehicle));
+    cr_expect(eq(u32, domain->type_refs[domain->types[city].type_first], 0));
+    cr_expect(eq(u32, pddlp_find_type(domain, "boat", 4), PDDLP_NONE));
+
+    cr_expect(eq(u32, domain->constant_count, 1));
+    cr_expect(eq(u32, pddlp_find_constant(domain, "hub", 3), 0));
+
+    uint32_t at = pddlp_find_predicate(domain, "at", 2);
+    cr_assert(ne(u32, at, PDDLP_NONE));
+    cr_expect(eq(u32, domain->predicates[at].param_count, 2));
+    cr_expect(eq(str, (char *)domain->variables[domain->predicates[at].param_first].name, "?x"));
+
+    uint32_t distance = pddlp_find_function(domain, "distance", 8);
+    cr_assert(ne(u32, distance, PDDLP_NONE));
+    cr_expect(eq(u32, domain->functions[distance].param_count, 2));
+
+    cr_assert(eq(u32, domain->action_count, 2));
+    const struct pddlp_action *drive = &domain->actions[pddlp_find_action(domain, "drive", 5)];
+    cr_expect(eq(u32, drive->param_count, 3));
+    cr_expect(eq(u32, drive->variable_count, 3));
+
+    const struct pddlp_formulas *f = &domain->formulas;
+    const struct pddlp_node *pre = &f->nodes[drive->precondition];
+    cr_expect(eq(int, pre->node_type, PDDLP_NODE_COMPOUND));
+    cr_expect(eq(int, pre->op, PDDLP_TOKEN_AND));
+    cr_assert(eq(u32, pre->count, 2));
+
+    const struct pddlp_node *atom = &f->nodes[f->children[pre->first]];
+    cr_expect(eq(int, atom->node_type, PDDLP_NODE_ATOM));
+    cr_expect(eq(u32, atom->value, at));
+    cr_assert(eq(u32, atom->count, 2));
+    cr_expect(eq(int, f->nodes[f->children[atom->first]].node_type, PDDLP_NODE_VARIABLE));
+    cr_expect(eq(u32, f->nodes[f->children[atom->first]].value, drive->variable_first));
+
+    const struct pddlp_node *negated = &f->nodes[f->children[pre->first + 1]];
+    const struct pddlp_node *hub = &f->nodes[f->children[f->nodes[f->children[negated->first]].first + 1]];
+    cr_expect(eq(int, hub->node_type, PDDLP_NODE_OBJECT));
+    cr_expect(eq(u32, hub->value, 0));
+
+    const struct pddlp_action *unload = &domain->actions[1];
+    cr_expect(eq(u32, unload->precondition, PDDLP_NONE));
+    cr_expect(eq(u32, unload->param_count, 2));
+    cr_expect(eq(u32, unload->variable_count, 3));
+
+    const struct pddlp_node *forall = &f->nodes[unload->effect];
+    cr_expect(eq(int, forall->op, PDDLP_TOKEN_FORALL));
+    cr_assert(eq(u32, forall->count, 2));
+    cr_expect(eq(u32, f->nodes[f->children[forall->first]].value, unload->variable_first + 2));
+
+    pddlp_release_domain(domain);
+}
+
+Test(parser, problem) {
+    struct pddlp_error error;
+    struct pddlp_domain *domain = pddlp_parse_domain(logistics_domain, &error);
+    cr_assert(ne(ptr, domain, NULL));
+
+    struct pddlp_problem *problem = pddlp_parse_problem(domain, logistics_problem, &error);
+    cr_assert(ne(ptr, problem, NULL), "%s at %" PRIu64 ":%" PRIu64, error.message, error.line, error.column);
+
+    cr_expect(eq(str, (char *)problem->name, "deliver"));
+
+    // hub comes first, with its domain id.
+    cr_expect(eq(u32, problem->object_count, 6));
+    cr_expect(eq(str, (char *)problem->objects[0].name, "hub"));
+    cr_expect(eq(u32, pddlp_find_object(problem, "hub", 3), 0));
+
+    uint32_t t1 = pddlp_find_object(problem, "t1", 2);
+    uint32_t a = pddlp_find_object(problem, "a", 1);
+    cr_expect(eq(u32, t1, 1));
+    cr_expect(eq(u32, problem->type_refs[problem->objects[t1].type_first], pddlp_find_type(domain, "truck", 5)));
+
+    cr_assert(eq(u32, problem->fact_count, 3));
+    cr_expect(eq(u32, problem->fact_predicates[0], pddlp_find_predicate(domain, "at", 2)));
+    cr_expect(eq(u32, problem->fact_args[problem->fact_args_first[0]], t1));
+    cr_expect(eq(u32, problem->fact_args[problem->fact_args_first[0] + 1], a));
+    cr_expect(eq(u32, problem->fact_args[problem->fact_args_first[1] + 1], 0));
+
+    cr_assert(eq(u32, problem->fluent_count, 1));
+    cr_expect(eq(dbl, problem->fluent_values[0], 2.5));
+    cr_expect(eq(u32, problem->fact_args[problem->fluent_args_first[0]], a));
+
+    cr_assert(eq(u32, problem->timed_literal_count, 1));
+    const struct pddlp_formulas *f = &problem->formulas;
+    const struct pddlp_node *timed = &f->nodes[problem->timed_literals[0]];
+    cr_expect(eq(int, timed->op, PDDLP_TOKEN_AT));
+    cr_expect(eq(dbl, f->numbers[f->nodes[f->children[timed->first]].value], 10));
+
+    const struct pddlp_node *goal = &f->nodes[problem->goal];
+    cr_expect(eq(int, goal->op, PDDLP_TOKEN_AND));
+    cr_expect(eq(u32, problem->variable_count, 1));
+
+    cr_expect(eq(int, problem->metric_op, PDDLP_TOKEN_MINIMIZE));
+    cr_expect(eq(int, f->nodes[problem->metric].op, PDDLP_TOKEN_TOTAL_TIME));
+
+    pddlp_free_problem(problem);
+    pddlp_release_domain(domain);
+}
+
+Test(parser, shared_subformulas) {
+    struct pddlp_error error;
+    struct pddlp_domain *domain = pddlp_parse_domain(logistics_domain, &error);
+    cr_assert(ne(ptr, domain, NULL));
+
+    struct pddlp_problem *problem = pddlp_parse_problem(domain,
+        "(define (problem shared) (:domain logistics)\n"
+        "  (:objects p1 - package a b - location)\n"
+        "  (:init (at p1 a))\n"
+        "  (:goal (and (at p1 b) (preference p (at p1 b)) (preference p (at p1 b))\n"
+        "              (> (distance a b) 2.5) (< (distance a b) 2.50)))\n"
+        "  (:constraints (and (always (not (at p1 b))) (sometime (at p1 b)) (always (not (at p1 b))))))\n",
+        &error);
+    cr_assert(ne(ptr, problem, NULL), "%s at %" PRIu64 ":%" PRIu64, error.message, error.line, error.column);
+
+    const struct pddlp_formulas *f = &problem->formulas;
+    const struct pddlp_node *goal = &f->nodes[problem->goal];
+    cr_assert(eq(u32, goal->count, 5));
+
+    // the atom is built once, and each preference keeps its own name.
+    uint32_t atom = f->children[goal->first];
+    const struct pddlp_node *first = &f->nodes[f->children[goal->first + 1]];
+    const struct pddlp_node *second = &f->nodes[f->children[goal->first + 2]];
+    cr_expect(ne(u32, f->children[goal->first + 1], f->children[goal->first + 2]));
+    cr_expect(eq(u32, f->children[first->first], atom));
+    cr_expect(eq(u32, f->children[second->first], atom));
+
+    // so are the function and the number, however it is written.
+    const struct pddlp_node *gt = &f->nodes[f->children[goal->first + 3]];
+    const struct pddlp_node *lt = &f->nodes[f->children[goal->first + 4]];
+    cr_expect(eq(u32, f->children[gt->first], f->children[lt->first]));
+    cr_expect(eq(u32, f->children[gt->first + 1], f->children[lt->first + 1]));
+    cr_expect(eq(u32, f->number_count, 1));
+
+    // repeated operands stay, as the same node, across the goal and the
+    // constraints.
+    const struct pddlp_node *constraints = &f->nodes[problem->constraints];
+    cr_assert(eq(u32, constraints->count, 3));
+    cr_expect(eq(u32, f->children[constraints->first], f->children[constraints->first + 2]));
+    const struct pddlp_node *always = &f->nodes[f->children[constraints->first]];
+    const struct pddlp_node *sometime = &f->nodes[f->children[constraints->first + 1]];
+    cr_expect(eq(u32, f->nodes[f->children[always->first]].op, PDDLP_TOKEN_NOT));
+    cr_expect(eq(u32, f->children[f->nodes[f->children[always->first]].first], atom));
+    cr_expect(eq(u32, f->children[sometime->first], atom));
+
+    // p1, b, a, the atom, two preferences, distance, 2.5, >, <, not, always,
+    // sometime and the two ands.
+    cr_expect(eq(u32, f->node_count, 15));
+
+    pddlp_free_problem(problem);
+    pddlp_release_domain(domain);
+}
+
+Test(parser, errors) {
+    struct pddlp_error error;
+    struct pddlp_domain *domain = pddlp_parse_domain(logistics_domain, &error);
+    cr_assert(ne(ptr, domain, NULL));
+
+    static const struct {
+        const char *source;
+        const char *message;
+        uint64_t line;
+        uint64_t column;
+    } cases[] = {
+        { "(define (problem p) (:domain other))", "problem is for another domain", 1, 30 },
+        { "(define (problem p) (:objects a - boat))", "undeclared type", 1, 35 },
+        { "(define (problem p) (:init (at nowhere hub)))", "undeclared object", 1, 32 },
+        { "(define (problem p) (:init (at hub)))", "wrong number of arguments", 1, 29 },
+        { "(define (problem p) (:goal (at ?x hub)))", "undeclared variable", 1, 32 },
+        { "(define (problem p) (:objects a a))", "duplicate object", 1, 33 },
+        { "(define (problem p) (:init (at hub hub))", "unexpected end of input", 1, 41 },
+        { "(define (problem p) (:init (at hub ?)))", "first character of a variable should be a letter", 1, 36 },
+    };
+
+    for (size_t i = 0; i < LEN(cases); ++i) {
+        struct pddlp_problem *problem = pddlp_parse_problem(domain, cases[i].source, &error);
+        cr_expect(eq(ptr, problem, NULL));
+        cr_expect(eq(str, (char *)error.message, (char *)cases[i].message), "case %zu", i);
+        cr_expect(eq(u64, error.line, cases[i].line), "case %zu", i);
+        cr_expect(eq(u64, error.column, cases[i].column), "case %zu", i);
+    }
+
+    pddlp_release_domain(domain);
+
+    cr_expect(eq(ptr, pddlp_parse_domain("(define (domain d) (:predicates (p ?x) (p ?y)))", &error), NULL));
+    cr_expect(eq(str, (char *)error.message, "duplicate predicate"));
+}
+
+// what pddlp_check_problem reported, stopping after `limit`.
+struct check_reports {
+    struct pddlp_error errors[8];
+    size_t count;
+    size_t limit;
+};
+
+static bool
+collect_report(void *context, const struct pddlp_error *error)
+{
+    struct check_reports *reports = context;
+    if (reports->count < LEN(reports->errors))
+        reports->errors[reports->count] = *error;
+
+    return ++reports->count < reports->limit;
+}
+
+Test(check, problems) {
+    struct check_reports reports = { .limit = LEN(reports.errors) };
+    bool valid;
+    struct pddlp_checker *checker = pddlp_new_checker(logistics_domain, collect_report, &reports, &valid);
+    cr_assert(ne(ptr, checker, NULL));
+    cr_expect(valid);
+    cr_expect(eq(sz, reports.count, 0));
+    cr_expect(pddlp_check_problem(checker, logistics_problem, collect_report, &reports));
+    cr_expect(eq(sz, reports.count, 0));
+
+    // the mistakes the parser stops at, in the same places.
+    static const struct {
+        const char *source;
+        const char *message;
+        uint64_t line;
+        uint64_t column;
+    } cases[] = {
+        { "(define (problem p) (:domain other))", "problem is for another domain", 1, 30 },
+        { "(define (problem p) (:objects a - boat))", "undeclared type", 1, 35 },
+        { "(define (problem p) (:init (at nowhere hub)))", "undeclared object", 1, 32 },
+        { "(define (problem p) (:objects t - truck) (:init (at t)))", "wrong number of arguments", 1, 50 },
+        { "(define (problem p) (:goal (at ?x hub)))", "undeclared variable", 1, 32 },
+        { "(define (problem p) (:objects a a))", "duplicate object", 1, 33 },
+        { "(define (problem p) (:init (and)", "unexpected end of input", 1, 33 },
+        { "(define (problem p) (:goal (and ?1 )))", "first character of a variable should be a letter", 1, 33 },
+        { "(define (problem p) (:objects t - truck) (:init (at t t)))", "argument of the wrong type", 1, 55 },
+    };
+
+    for (size_t i = 0; i < LEN(cases); ++i) {
+        reports.count = 0;
+        cr_expect(not(pddlp_check_problem(checker, cases[i].source, collect_report, &reports)));
+        cr_assert(eq(sz, reports.count, 1), "case %zu", i);
+        cr_expect(eq(str, (char *)reports.errors[0].message, (char *)cases[i].message), "case %zu", i);
+        cr_expect(eq(u64, reports.errors[0].line, cases[i].line), "case %zu", i);
+        cr_expect(eq(u64, reports.errors[0].column, cases[i].column), "case %zu", i);
+    }
+
+    // unlike the parser, it carries on after each, until told to stop.
+    const char *mistakes =
+        "(define (problem p) (:domain logistics) (:objects t - truck a - location)\n"
+        "  (:init (at t a) (in t t) (on t a) (at t))\n"
+        "  (:goal (forall (?p - package) (at ?p t))))\n";
+
+    reports.count = 0;
+    cr_expect(not(pddlp_check_problem(checker, mistakes, collect_report, &reports)));
+    cr_assert(eq(sz, reports.count, 4));
+    cr_expect(eq(str, (char *)reports.errors[0].message, "argument of the wrong type"));
+    cr_expect(eq(u64, reports.errors[0].column, 23));
+    cr_expect(eq(str, (char *)reports.errors[1].message, "undeclared predicate or function"));
+    cr_expect(eq(u64, reports.errors[1].column, 29));
+    cr_expect(eq(str, (char *)reports.errors[2].message, "wrong number of arguments"));
+    cr_expect(eq(u64, reports.errors[2].column, 38));
+    cr_expect(eq(str, (char *)reports.errors[3].message, "argument of the wrong type"));
+    cr_expect(eq(u64, reports.errors[3].line, 3));
+
+    reports = (struct check_reports){ .limit = 2 };
+    cr_expect(not(pddlp_check_problem(checker, mistakes, collect_report, &reports)));
+    cr_expect(eq(sz, reports.count, 2));
+
+    pddlp_free_checker(checker);
+
+    // the domain is checked the same way, and still gives a checker.
+    reports = (struct check_reports){ .limit = LEN(reports.errors) };
+    checker = pddlp_new_checker("(define (domain d) (:predicates (p ?x) (p ?y)) (:action a :effect (q)))",
+        collect_report, &reports, &valid);
+    cr_assert(ne(ptr, checker, NULL));
+    cr_expect(not(valid));
+    cr_assert(eq(sz, reports.count, 2));
+    cr_expect(eq(str, (char *)reports.errors[0].message, "duplicate predicate"));
+    cr_expect(eq(str, (char *)reports.errors[1].message, "undeclared predicate"));
+    pddlp_free_checker(checker);
+}
+
+// a strips domain with negative preconditions and equality, under
+// `requirements`.
+#define DRIVE_DOMAIN(requirements) \
+    "(define (domain drive)\n" \
+    "  (:requirements " requirements ")\n" \
+    "  (:types truck location)\n" \
+    "  (:predicates (at ?t - truck ?l - location))\n" \
+    "  (:action drive\n" \
+    "    :parameters (?t - truck ?from ?to - location)\n" \
+    "    :precondition (and (at ?t ?from) (not (= ?from ?to)))\n" \
+    "    :effect (and (not (at ?t ?from)) (at ?t ?to))))\n"
+
+Test(parser, strict) {
+    struct pddlp_error error;
+
+    // logistics_domain only declares :strips and :typing.
+    cr_expect(eq(ptr, pddlp_parse_domain_strict(logistics_domain, &error), NULL));
+    cr_expect(eq(str, (char *)error.message, "not enabled by the :requirements"));
+    cr_expect(eq(u64, error.line, 7));
+    cr_expect(eq(u64, error.column, 4));
+
+    // `not` in a precondition needs :negative-preconditions, and `=` needs
+    // :equality.
+    static const struct {
+        const char *source;
+        uint64_t column;
+    } literals[] = {
+        { DRIVE_DOMAIN(":strips :typing"), 39 },
+        { DRIVE_DOMAIN(":strips :typing :negative-preconditions"), 44 },
+        { DRIVE_DOMAIN(":strips :typing :equality"), 39 },
+    };
+
+    for (size_t i = 0; i < LEN(literals); ++i) {
+        cr_expect(eq(ptr, pddlp_parse_domain_strict(literals[i].source, &error), NULL), "case %zu", i);
+        cr_expect(eq(str, (char *)error.message, "not enabled by the :requirements"), "case %zu", i);
+        cr_expect(eq(u64, error.line, 7), "case %zu", i);
+        cr_expect(eq(u64, error.column, literals[i].column), "case %zu", i);
+    }
+
+    // the delete effect is plain strips.
+    struct pddlp_domain *domain = pddlp_parse_domain_strict(
+        DRIVE_DOMAIN(":strips :typing :negative-preconditions :equality"), &error);
+    cr_assert(ne(ptr, domain, NULL), "%s at %" PRIu64 ":%" PRIu64, error.message, error.line, error.column);
+
+    struct pddlp_problem *problem = pddlp_parse_problem(domain,
+        "(define (problem p) (:domain drive) (:objects t - truck a b - location)\n"
+        "  (:init (at t a)) (:goal (at t b)))", &error);
+    cr_expect(ne(ptr, problem, NULL), "%s", error.message);
+    pddlp_free_problem(problem);
+
+    static const struct {
+        const char *source;
+        uint64_t column;
+    } rejected[] = {
+        { "(define (problem p) (:domain drive) (:init (= (total-cost) 0)))", 45 },
+        { "(define (problem p) (:domain drive) (:objects t - truck) (:goal (or (at t t))))", 66 },
+        { "(define (problem p) (:domain drive) (:goal (preference p (and))))", 45 },
+        { "(define (problem p) (:domain drive) (:metric minimize (total-time)))", 38 },
+    };
+
+    for (size_t i = 0; i < LEN(rejected); ++i) {
+        cr_expect(eq(ptr, pddlp_parse_problem(domain, rejected[i].source, &error), NULL), "case %zu", i);
+        cr_expect(eq(str, (char *)error.message, "not enabled by the :requirements"), "case %zu", i);
+        cr_expect(eq(u64, error.column, rejected[i].column), "case %zu", i);
+    }
+
+    // a problem can add requirements of its own.
+    problem = pddlp_parse_problem(domain,
+        "(define (problem p) (:domain drive) (:requirements :disjunctive-preconditions)\n"
+        "  (:objects t - truck a b - location) (:goal (or (at t a) (at t b))))", &error);
+    cr_expect(ne(ptr, problem, NULL), "%s", error.message);
+    pddlp_free_problem(problem);
+    pddlp_release_domain(domain);
+
+    domain = pddlp_parse_domain_strict(
+        "(define (domain d) (:requirements :adl) (:predicates (p ?x))\n"
+        "  (:action a :parameters (?x) :effect (forall (?y) (when (p ?y) (not (p ?x))))))", &error);
+    cr_expect(ne(ptr, domain, NULL), "%s", error.message);
+    pddlp_release_domain(domain);
+
+    // the condition of a conditional effect is not an effect.
+    domain = pddlp_parse_domain_strict(
+        "(define (domain d) (:requirements :conditional-effects) (:predicates (p ?x))\n"
+        "  (:action a :parameters (?x) :effect (when (p ?x) (not (p ?x)))))", &error);
+    cr_expect(ne(ptr, domain, NULL), "%s", error.message);
+    pddlp_release_domain(domain);
+
+    domain = pddlp_parse_domain_strict(
+        "(define (domain d) (:requirements :conditional-effects) (:predicates (p ?x))\n"
+        "  (:action a :parameters (?x) :effect (when (not (p ?x)) (p ?x))))", &error);
+    cr_expect(eq(ptr, domain, NULL));
+    cr_expect(eq(u64, error.column, 46));
+
+    domain = pddlp_parse_domain_strict(
+        "(define (domain d) (:requirements :adl) (:predicates (p ?x))\n"
+        "  (:action a :parameters (?x) :precondition (> 1 0)))", &error);
+    cr_expect(eq(ptr, domain, NULL));
+    cr_expect(eq(u64, error.column, 46));
+}
+
+// a problem with an :init large enough to be split, and mistakes in it.
+static char *
+parallel_problem(size_t entries, const char *last)
+{
+    char *source = malloc(entries * 48 + 1024);
+    cr_assert(ne(ptr, source, NULL));
+
+    size_t n = sprintf(source,
+        "(define (problem large) (:domain logistics)\n"
+        "  (:objects t1 - truck p0 p1 p2 p3 p4 p5 p6 p7 - package a b - location)\n"
+        "  (:init\n");
+
+    for (size_t i = 0; i < entries; ++i) {
+        switch (i % 4) {
+        case 0: n += sprintf(source + n, "    (at p%zu a) ; (a comment\n", i % 8); break;
+        case 1: n += sprintf(source + n, "    (= (distance a b) %zu)\n", i); break;
+        case 2: n += sprintf(source + n, "    (not (at t1 b)) (in p%zu t1)\n", i % 8); break;
+        case 3: n += sprintf(source + n, "    (at p%zu b)\n", i % 8); break;
+        }
+    }
+
+    sprintf(source + n, "    %s)\n  (:goal (at p1 b)))\n", last);
+    return source;
+}
+
+Test(parser, parallel_init) {
+    struct pddlp_error error;
+    struct pddlp_domain *domain = pddlp_parse_domain(logistics_domain, &error);
+    cr_assert(ne(ptr, domain, NULL));
+
+    char *source = parallel_problem(100000, "(at t1 a)");
+    cr_assert(gt(sz, strlen(source), 1 << 21));
+
+    struct pddlp_problem *sequential = pddlp_parse_problem(domain, source, &error);
+    struct pddlp_problem *parallel = pddlp_parse_problem_parallel(domain, source, 4, &error);
+    cr_assert(ne(ptr, sequential, NULL));
+    cr_assert(ne(ptr, parallel, NULL), "%s at %" PRIu64 ":%" PRIu64, error.message, error.line, error.column);
+
+    cr_assert(eq(u32, parallel->fact_count, sequential->fact_count));
+    cr_assert(eq(u32, parallel->fluent_count, sequential->fluent_count));
+    cr_expect(eq(u32, parallel->fluent_count, 25000));
+
+    for (uint32_t i = 0; i < sequential->fact_count; ++i) {
+        cr_assert(eq(u32, parallel->fact_predicates[i], sequential->fact_predicates[i]));
+        for (uint32_t j = 0; j < 2; ++j)
+            cr_assert(eq(u32, parallel->fact_args[parallel->fact_args_first[i] + j],
+                sequential->fact_args[sequential->fact_args_first[i] + j]));
+    }
+
+    for (uint32_t i = 0; i < sequential->fluent_count; ++i) {
+        cr_assert(eq(dbl, parallel->fluent_values[i], sequential->fluent_values[i]));
+        cr_assert(eq(u32, parallel->fact_args[parallel->fluent_args_first[i] + 1],
+            sequential->fact_args[sequential->fluent_args_first[i] + 1]));
+    }
+
+    pddlp_free_problem(sequential);
+    pddlp_free_problem(parallel);
+    free(source);
+
+    // errors are reported where the sequential parser finds them, even with
+    // a later chunk failing too.
+    source = parallel_problem(100000, "(at t1 c)");
+    char *early = strstr(source, "(at p0 a)");
+    memcpy(early, "(at q0 a)", 9);
+
+    struct pddlp_error expected;
+    cr_expect(eq(ptr, pddlp_parse_problem(domain, source, &expected), NULL));
+    cr_expect(eq(ptr, pddlp_parse_problem_parallel(domain, source, 4, &error), NULL));
+    cr_expect(eq(str, (char *)error.message, "undeclared object"));
+    cr_expect(eq(u64, error.line, expected.line));
+    cr_expect(eq(u64, error.column, expected.column));
+    cr_expect(eq(u64, error.line, 4));
+
+    memcpy(early, "(at p0 a)", 9);
+    cr_expect(eq(ptr, pddlp_parse_problem(domain, source, &expected), NULL));
+    cr_expect(eq(ptr, pddlp_parse_problem_parallel(domain, source, 0, &error), NULL));
+    cr_expect(eq(u64, error.line, expected.line));
+    cr_expect(eq(u64, error.column, expected.column));
+    free(source);
+
+    // timed literals are left to the sequential parser.
+    source = parallel_problem(100000, "(at 10 (at p1 b))");
+    parallel = pddlp_parse_problem_parallel(domain, source, 4, &error);
+    cr_assert(ne(ptr, parallel, NULL), "%s", error.message);
+    cr_expect(eq(u32, parallel->timed_literal_count, 1));
+    pddlp_free_problem(parallel);
+    free(source);
+
+    pddlp_release_domain(domain);
+}
+
+Test(parser, domain_cache) {
+    struct pddlp_error error;
+    struct pddlp_domain *first = pddlp_load_domain(logistics_domain, &error);
+    struct pddlp_domain *second = pddlp_load_domain(logistics_domain, &error);
+
+    cr_assert(ne(ptr, first, NULL));
+    cr_expect(eq(ptr, first, second));
+
+    // the cache holds its own reference, so the domain outlives clearing it.
+    pddlp_release_domain(second);
+    pddlp_clear_domain_cache();
+    cr_expect(eq(str, (char *)first->name, "logistics"));
+
+    struct pddlp_domain *third = pddlp_load_domain(logistics_domain, &error);
+    cr_expect(ne(ptr, first, third));
+
+    // sources of the same length are compared, not just hashed.
+    struct pddlp_domain *a = pddlp_load_domain("(define (domain a))", &error);
+    struct pddlp_domain *b = pddlp_load_domain("(define (domain b))", &error);
+    cr_assert(ne(ptr, a, NULL));
+    cr_assert(ne(ptr, b, NULL));
+    cr_expect(ne(ptr, a, b));
+    cr_expect(eq(str, (char *)b->name, "b"));
+
+    pddlp_release_domain(a);
+    pddlp_release_domain(b);
+    pddlp_release_domain(first);
+    pddlp_release_domain(third);
+    pddlp_clear_domain_cache();
+}
+
+static void *
+parse_problems(void *domain)
+{
+    uintptr_t failures = 0;
+
+    for (int i = 0; i < 100; ++i) {
+        struct pddlp_error error;
+        struct pddlp_problem *problem = pddlp_parse_problem(domain, logistics_problem, &error);
+        if (problem == NULL || problem->fact_count != 3)
+            failures++;
+        pddlp_free_problem(problem);
+    }
+
+    return (void *)failures;
+}
+
+Test(parser, shared_domain) {
+    struct pddlp_error error;
+    struct pddlp_domain *domain = pddlp_load_domain(logistics_domain, &error);
+    cr_assert(ne(ptr, domain, NULL));
+
+    pthread_t threads[4];
+    for (size_t i = 0; i < LEN(threads); ++i)
+        pthread_create(&threads[i], NULL, parse_problems, domain);
+
+    for (size_t i = 0; i < LEN(threads); ++i) {
+        void *failures;
+        pthread_join(threads[i], &failures);
+        cr_expect(eq(ptr, failures, NULL));
+    }
+
+    pddlp_release_domain(domain);
+    pddlp_clear_domain_cache();
+}
+
+Test(types, closure) {
+    static const char *domain_source =
+        "(define (domain hierarchy)\n"
+        "  (:types car truck - vehicle vehicle - movable crate - movable\n"
+        "         amphibian - (either car boat) boat - vehicle))\n";
+
+    static const char *problem_source =
+        "(define (problem p)\n"
+        "  (:domain hierarchy)\n"
+        "  (:objects c1 c2 - car t1 - truck x - crate a - amphibian other))\n";
+
+    struct pddlp_error error;
+    struct pddlp_domain *domain = pddlp_parse_domain(domain_source, &error);
+    cr_assert(ne(ptr, domain, NULL), "%s", error.message);
+    struct pddlp_problem *problem = pddlp_parse_problem(domain, problem_source, &error);
+    cr_assert(ne(ptr, problem, NULL), "%s", error.message);
+
+    uint32_t object = 0;
+    uint32_t car = pddlp_find_type(domain, "car", 3);
+    uint32_t boat = pddlp_find_type(domain, "boat", 4);
+    uint32_t vehicle = pddlp_find_type(domain, "vehicle", 7);
+    uint32_t movable = pddlp_find_type(domain, "movable", 7);
+    uint32_t amphibian = pddlp_find_type(domain, "amphibian", 9);
+    uint32_t crate = pddlp_find_type(domain, "crate", 5);
+
+    cr_expect(eq(int, pddlp_is_subtype(domain, amphibian, car), 1));
+    cr_expect(eq(int, pddlp_is_subtype(domain, amphibian, boat), 1));
+    cr_expect(eq(int, pddlp_is_subtype(domain, amphibian, movable), 1));
+    cr_expect(eq(int, pddlp_is_subtype(domain, amphibian, object), 1));
+    cr_expect(eq(int, pddlp_is_subtype(domain, car, car), 1));
+    cr_expect(eq(int, pddlp_is_subtype(domain, car, amphibian), 0));
+    cr_expect(eq(int, pddlp_is_subtype(domain, crate, vehicle), 0));
+
+    uint32_t a = pddlp_find_object(problem, "a", 1);
+    uint32_t x = pddlp_find_object(problem, "x", 1);
+    uint32_t other = pddlp_find_object(problem, "other", 5);
+
+    cr_expect(eq(int, pddlp_has_type(problem, a, boat), 1));
+    cr_expect(eq(int, pddlp_has_type(problem, a, movable), 1));
+    cr_expect(eq(int, pddlp_has_type(problem, x, vehicle), 0));
+    cr_expect(eq(int, pddlp_has_type(problem, other, object), 1));
+    cr_expect(eq(int, pddlp_has_type(problem, other, movable), 0));
+
+    // c1 c2 t1 a, in id order.
+    const uint32_t *vehicles = problem->type_objects + problem->type_objects_first[vehicle];
+    cr_assert(eq(u32, problem->type_objects_first[vehicle + 1] - problem->type_objects_first[vehicle], 4));
+    cr_expect(eq(u32, vehicles[0], pddlp_find_object(problem, "c1", 2)));
+    cr_expect(eq(u32, vehicles[1], pddlp_find_object(problem, "c2", 2)));
+    cr_expect(eq(u32, vehicles[2], pddlp_find_object(problem, "t1", 2)));
+    cr_expect(eq(u32, vehicles[3], a));
+
+    cr_expect(eq(u32, problem->type_objects_first[object + 1] - problem->type_objects_first[object], 6));
+
+    pddlp_free_problem(problem);
+    pddlp_release_domain(domain);
+}
+
+Test(facts, store) {
+    static const char *domain_source =
+        "(define (domain graph)\n"
+        "  (:predicates (edge ?a ?b) (marked ?a) (done) (label ?a ?b)))\n";
+
+    static const char *problem_source =
+        "(define (problem p)\n"
+        "  (:domain graph)\n"
+        "  (:objects a b c d)\n"
+        "  (:init (edge a b) (edge a c) (edge b c) (edge a b) (marked c) (edge c a)\n"
+        "         (done) (done) (edge d c)\n"
+        "         (label a a) (label a b) (label a c) (label a d) (label b a) (label b b)\n"
+        "         (label b c) (label b d) (label c a) (label c b) (label c c) (label a b)))\n";
+
+    struct pddlp_error error;
+    struct pddlp_domain *domain = pddlp_parse_domain(domain_source, &error);
+    cr_assert(ne(ptr, domain, NULL), "%s", error.message);
+    struct pddlp_problem *problem = pddlp_parse_problem(domain, problem_source, &error);
+    cr_assert(ne(ptr, problem, NULL), "%s", error.message);
+
+    uint32_t edge = pddlp_find_predicate(domain, "edge", 4);
+    uint32_t marked = pddlp_find_predicate(domain, "marked", 6);
+    uint32_t done = pddlp_find_predicate(domain, "done", 4);
+    uint32_t a = pddlp_find_object(problem, "a", 1);
+    uint32_t b = pddlp_find_object(problem, "b", 1);
+    uint32_t c = pddlp_find_object(problem, "c", 1);
+    uint32_t d = pddlp_find_object(problem, "d", 1);
+
+    // the repeated (edge a b), (done) and (label a b) are dropped.
+    cr_expect(eq(u32, problem->fact_count, 18));
+    cr_expect(eq(u32, problem->fact_arg_count, 33));
+
+    for (uint32_t i = 0; i < problem->fact_count; ++i)
+        cr_expect(eq(u32, pddlp_find_fact(problem, problem->fact_predicates[i],
+            problem->fact_args + problem->fact_args_first[i]), i));
+
+    uint32_t ab[2] = { a, b };
+    uint32_t ba[2] = { b, a };
+    uint32_t dc[2] = { d, c };
+    cr_expect(eq(u32, pddlp_find_fact(problem, edge, ab), 0));
+    cr_expect(eq(u32, pddlp_find_fact(problem, edge, ba), PDDLP_NONE));
+    cr_expect(eq(u32, pddlp_find_fact(problem, edge, dc), 6));
+    cr_expect(eq(u32, pddlp_find_fact(problem, done, NULL), 5));
+    cr_expect(eq(u32, pddlp_find_fact(problem, marked, ab + 1), PDDLP_NONE));
+
+    uint32_t count;
+    const uint32_t *facts = pddlp_predicate_facts(problem, edge, &count);
+    cr_assert(ne(ptr, (void *)facts, NULL));
+    cr_assert(eq(u32, count, 5));
+    cr_expect(eq(u32, facts[0], 0));
+    cr_expect(eq(u32, facts[4], 6));
+
+    // the edges into c, found through the second position.
+    facts = pddlp_position_facts(problem, edge, 1, c, &count);
+    cr_assert(ne(ptr, (void *)facts, NULL));
+    cr_assert(eq(u32, count, 3));
+    cr_expect(eq(u32, facts[0], 1));
+    cr_expect(eq(u32, facts[1], 2));
+    cr_expect(eq(u32, facts[2], 6));
+
+    // later calls return the same list.
+    cr_expect(eq(ptr, (void *)pddlp_position_facts(problem, edge, 1, c, &count), (void *)facts));
+
+    pddlp_position_facts(problem, edge, 0, d, &count);
+    cr_expect(eq(u32, count, 1));
+    pddlp_position_facts(problem, marked, 0, a, &count);
+    cr_expect(eq(u32, count, 0));
+
+    uint32_t out[4];
+    uint32_t from_a[2] = { a, PDDLP_NONE };
+    cr_assert(eq(u32, pddlp_match_facts(problem, edge, from_a, out, 4), 2));
+    cr_expect(eq(u32, out[0], 0));
+    cr_expect(eq(u32, out[1], 1));
+
+    // the total is returned even when only part of it fits.
+    uint32_t any[2] = { PDDLP_NONE, PDDLP_NONE };
+    cr_expect(eq(u32, pddlp_match_facts(problem, edge, any, out, 1), 5));
+    cr_expect(eq(u32, out[0], 0));
+
+    uint32_t ac[2] = { a, c };
+    cr_expect(eq(u32, pddlp_match_facts(problem, edge, ac, out, 4), 1));
+    cr_expect(eq(u32, out[0], 1));
+
+    uint32_t ca[2] = { c, PDDLP_NONE };
+    uint32_t da[2] = { d, a };
+    cr_expect(eq(u32, pddlp_match_facts(problem, edge, ca, out, 4), 1));
+    cr_expect(eq(u32, pddlp_match_facts(problem, edge, da, out, 4), 0));
+
+    pddlp_free_problem(problem);
+    pddlp_release_domain(domain);
+}
+
+Test(facts, fluents) {
+    static const char *domain_source =
+        "(define (domain roads)\n"
+        "  (:predicates (road ?a ?b))\n"
+        "  (:functions (length ?a ?b)))\n";
+
+    // the fluents sit between repeated facts, so removing those mustn't
+    // move anything over their arguments.
+    static const char *problem_source =
+        "(define (problem p)\n"
+        "  (:domain roads)\n"
+        "  (:objects a b c)\n"
+        "  (:init (road a b) (road a b) (= (length a b) 3) (road b c) (road a b)\n"
+        "         (= (length b c) 4) (road c a) (= (length c a) 5)))\n";
+
+    struct pddlp_error error;
+    struct pddlp_domain *domain = pddlp_parse_domain(domain_source, &error);
+    cr_assert(ne(ptr, domain, NULL), "%s", error.message);
+    struct pddlp_problem *problem = pddlp_parse_problem(domain, problem_source, &error);
+    cr_assert(ne(ptr, problem, NULL), "%s", error.message);
+
+    uint32_t road = pddlp_find_predicate(domain, "road", 4);
+    uint32_t a = pddlp_find_object(problem, "a", 1);
+    uint32_t b = pddlp_find_object(problem, "b", 1);
+    uint32_t c = pddlp_find_object(problem, "c", 1);
+
+    cr_expect(eq(u32, problem->fact_count, 3));
+    uint32_t ab[2] = { a, b };
+    uint32_t bc[2] = { b, c };
+    uint32_t ca[2] = { c, a };
+    cr_expect(eq(u32, pddlp_find_fact(problem, road, ab), 0));
+    cr_expect(eq(u32, pddlp_find_fact(problem, road, bc), 1));
+    cr_expect(eq(u32, pddlp_find_fact(problem, road, ca), 2));
+
+    const uint32_t *expected[3] = { ab, bc, ca };
+    cr_assert(eq(u32, problem->fluent_count, 3));
+    for (uint32_t i = 0; i < 3; ++i) {
+        const uint32_t *args = problem->fact_args + problem->fluent_args_first[i];
+        cr_expect(eq(dbl, problem->fluent_values[i], 3.0 + i));
+        cr_expect(eq(u32, args[0], expected[i][0]));
+        cr_expect(eq(u32, args[1], expected[i][1]));
+    }
+
+    pddlp_free_problem(problem);
+    pddlp_release_domain(domain);
+}
+
+static const char *drive_domain =
+    "(define (domain drive)\n"
+    "  (:requirements :strips :typing :equality)\n"
+    "  (:types truck place)\n"
+    "  (:predicates (at ?t - truck ?p - place) (road ?a ?b - place) (visited ?p - place))\n"
+    "  (:action drive\n"
+    "    :parameters (?t - truck ?from ?to - place)\n"
+    "    :precondition (and (at ?t ?from) (road ?from ?to) (not (= ?from ?to)))\n"
+    "    :effect (and (not (at ?t ?from)) (at ?t ?to) (visited ?to)))\n"
+    "  (:action wait\n"
+    "    :parameters (?t - truck ?p - place)\n"
+    "    :precondition (at ?t ?p)\n"
+    "    :effect (and (at ?t ?p) (not (at ?t ?p)))))\n";
+
+static const char *drive_problem =
+    "(define (problem loop)\n"
+    "  (:domain drive)\n"
+    "  (:objects t1 t2 - truck a b c - place)\n"
+    "  (:init (at t1 a) (at t2 c) (road a b) (road b c) (road c a) (road a a))\n"
+    "  (:goal (and (visited b) (road a b))))\n";
+
+static uint32_t
+find_fact(const struct pddlp_strips *strips, const char *predicate, const char *a, const char *b)
+{
+    const struct pddlp_problem *problem = strips->problem;
+    uint32_t p = pddlp_find_predicate(problem->domain, predicate, strlen(predicate));
+    uint32_t args[2] = {
+        pddlp_find_object(problem, a, strlen(a)),
+        b ? pddlp_find_object(problem, b, strlen(b)) : PDDLP_NONE,
+    };
+
+    for (uint32_t i = 0; i < strips->fact_count; ++i) {
+        if (strips->fact_predicates[i] != p)
+            continue;
+
+        const uint32_t *fact_args = strips->fact_args + strips->fact_args_first[i];
+        if (fact_args[0] == args[0] && (b == NULL || fact_args[1] == args[1]))
+            return i;
+    }
+
+    return PDDLP_NONE;
+}
+
+Test(ground, operators) {
+    struct pddlp_error error;
+    struct pddlp_domain *domain = pddlp_parse_domain(drive_domain, &error);
+    cr_assert(ne(ptr, domain, NULL));
+    struct pddlp_problem *problem = pddlp_parse_problem(domain, drive_problem, &error);
+    cr_assert(ne(ptr, problem, NULL));
+
+    struct pddlp_strips *strips = pddlp_ground(problem, 2, &error);
+    cr_assert(ne(ptr, strips, NULL), "%s", error.message);
+
+    // drive follows the three roads between distinct places for each
+    // truck, and wait works anywhere.
+    cr_expect(eq(u32, strips->operator_count, 2 * 3 + 2 * 3));
+
+    // 6 at facts and the 3 visited ones. road is static.
+    cr_expect(eq(u32, strips->fact_count, 9));
+    cr_expect(eq(u32, find_fact(strips, "road", "a", "b"), PDDLP_NONE));
+
+    cr_assert(eq(u32, strips->init_count, 2));
+    cr_expect(eq(u32, strips->init[0], find_fact(strips, "at", "t1", "a")));
+    cr_expect(eq(u32, strips->init[1], find_fact(strips, "at", "t2", "c")));
+
+    // (road a b) holds, so only (visited b) is left of the goal.
+    cr_assert(eq(u32, strips->goal_count, 1));
+    cr_expect(eq(u32, strips->goal[0], find_fact(strips, "visited", "b", NULL)));
+
+    const struct pddlp_operator *op = &strips->operators[0];
+    cr_expect(eq(u32, op->action, pddlp_find_action(domain, "drive", 5)));
+    cr_expect(eq(u32, op->add - op->pre, 1));
+    cr_expect(eq(u32, op->del - op->add, 2));
+    cr_expect(eq(u32, op->end - op->del, 1));
+
+    // an add effect cancels the delete of the same fact.
+    const struct pddlp_operator *wait = &strips->operators[strips->operator_count - 1];
+    cr_expect(eq(u32, wait->action, pddlp_find_action(domain, "wait", 4)));
+    cr_expect(eq(u32, wait->end - wait->del, 0));
+
+    pddlp_free_strips(strips);
+    pddlp_free_problem(problem);
+    pddlp_release_domain(domain);
+}
+
+Test(ground, states) {
+    struct pddlp_error error;
+    struct pddlp_domain *domain = pddlp_parse_domain(drive_domain, &error);
+    struct pddlp_problem *problem = pddlp_parse_problem(domain, drive_problem, &error);
+    struct pddlp_strips *strips = pddlp_ground(problem, 1, &error);
+    cr_assert(ne(ptr, strips, NULL));
+
+    uint64_t state[PDDLP_STATE_WORDS(64)];
+    cr_assert(le(sz, PDDLP_STATE_WORDS(strips->fact_count), LEN(state)));
+    pddlp_strips_init_state(strips, state);
+
+    uint32_t t1_a = find_fact(strips, "at", "t1", "a");
+    uint32_t t1_b = find_fact(strips, "at", "t1", "b");
+    uint32_t visited_b = find_fact(strips, "visited", "b", NULL);
+
+    uint32_t applicable = 0, drive_ab = PDDLP_NONE;
+    for (uint32_t i = 0; i < strips->operator_count; ++i) {
+        if (!pddlp_strips_applicable(strips, i, state))
+            continue;
+
+        applicable++;
+        const struct pddlp_operator *op = &strips->operators[i];
+        if (strips->operator_facts[op->pre] == t1_a && op->del > op->add && strips->operator_facts[op->add] == t1_b)
+            drive_ab = i;
+    }
+
+    // t1 drives a to b, t2 drives c to a, and both wait.
+    cr_expect(eq(u32, applicable, 4));
+    cr_assert(ne(u32, drive_ab, PDDLP_NONE));
+
+    pddlp_strips_apply(strips, drive_ab, state);
+    cr_expect(eq(u64, state[0] >> t1_a & 1, 0));
+    cr_expect(eq(u64, state[0] >> t1_b & 1, 1));
+    cr_expect(eq(u64, state[0] >> visited_b & 1, 1));
+
+    pddlp_free_strips(strips);
+    pddlp_free_problem(problem);
+    pddlp_release_domain(domain);
+}
+
+Test(ground, thread_count) {
+    struct pddlp_error error;
+    struct pddlp_domain *domain = pddlp_parse_domain(drive_domain, &error);
+    struct pddlp_problem *problem = pddlp_parse_problem(domain, drive_problem, &error);
+
+    struct pddlp_strips *one = pddlp_ground(problem, 1, &error);
+    struct pddlp_strips *many = pddlp_ground(problem, 0, &error);
+    cr_assert(ne(ptr, one, NULL));
+    cr_assert(ne(ptr, many, NULL));
+
+    cr_assert(eq(u32, one->operator_count, many->operator_count));
+    cr_assert(eq(u32, one->operator_fact_count, many->operator_fact_count));
+    cr_expect(eq(int, memcmp(one->operators, many->operators, sizeof(*one->operators) * one->operator_count), 0));
+    cr_expect(eq(int, memcmp(one->operator_facts, many->operator_facts,
+        sizeof(*one->operator_facts) * one->operator_fact_count), 0));
+
+    pddlp_free_strips(one);
+    pddlp_free_strips(many);
+    pddlp_free_problem(problem);
+    pddlp_release_domain(domain);
+}
+
+// the operators of `strips` that apply once everything that can be added
+// ignoring deletes has been.
+static bool *
+relaxed_operators(const struct pddlp_strips *strips)
+{
+    uint64_t *state = calloc(PDDLP_STATE_WORDS(strips->fact_count) + 1, sizeof(*state));
+    bool *applicable = calloc(strips->operator_count + 1, sizeof(*applicable));
+    cr_assert(ne(ptr, state, NULL));
+    cr_assert(ne(ptr, applicable, NULL));
+    pddlp_strips_init_state(strips, state);
+
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (uint32_t op = 0; op < strips->operator_count; ++op) {
+            if (applicable[op] || !pddlp_strips_applicable(strips, op, state))
+                continue;
+
+            applicable[op] = changed = true;
+            const struct pddlp_operator *o = &strips->operators[op];
+            for (uint32_t i = o->add; i < o->del; ++i)
+                state[strips->operator_facts[i] / 64] |= UINT64_C(1) << (strips->operator_facts[i] % 64);
+        }
+    }
+
+    free(state);
+    return applicable;
+}
+
+Test(ground, reachable) {
+    struct pddlp_error error;
+    struct pddlp_domain *domain = pddlp_parse_domain(drive_domain, &error);
+    struct pddlp_problem *problem = pddlp_parse_problem(domain,
+        "(define (problem island) (:domain drive)\n"
+        "  (:objects t1 t2 - truck a b c d - place)\n"
+        "  (:init (at t1 a) (at t2 c) (road a b) (road b c) (road c a) (road a a) (road d a))\n"
+        "  (:goal (visited b)))\n", &error);
+    cr_assert(ne(ptr, problem, NULL), "%s", error.message);
+
+    struct pddlp_strips *all = pddlp_ground(problem, 1, &error);
+    struct pddlp_strips *reachable = pddlp_ground_reachable(problem, &error);
+    cr_assert(ne(ptr, all, NULL), "%s", error.message);
+    cr_assert(ne(ptr, reachable, NULL), "%s", error.message);
+
+    // no truck ever gets to d, so neither driving from it nor waiting there
+    // is reachable.
+    cr_expect(eq(u32, all->operator_count, 2 * 4 + 2 * 4));
+    cr_expect(eq(u32, reachable->operator_count, 2 * 3 + 2 * 3));
+    cr_expect(eq(u32, find_fact(reachable, "at", "t1", "d"), PDDLP_NONE));
+
+    // the same operators the relaxed fixpoint over all of them applies.
+    bool *applicable = relaxed_operators(all);
+    uint32_t count = 0;
+    for (uint32_t op = 0; op < all->operator_count; ++op) {
+        if (!applicable[op])
+            continue;
+
+        const struct pddlp_operator *o = &all->operators[op];
+        uint32_t param_count = domain->actions[o->action].param_count;
+        bool found = false;
+        for (uint32_t other = 0; other < reachable->operator_count && !found; ++other) {
+            const struct pddlp_operator *r = &reachable->operators[other];
+            found = r->action == o->action && memcmp(reachable->operator_args + r->args, all->operator_args + o->args,
+                sizeof(*all->operator_args) * param_count) == 0;
+        }
+
+        cr_expect(found);
+        count++;
+    }
+    cr_expect(eq(u32, count, reachable->operator_count));
+    free(applicable);
+
+    struct pddlp_validator *validator = pddlp_new_validator(reachable, &error);
+    cr_assert(ne(ptr, validator, NULL));
+    struct pddlp_plan_result result;
+    cr_expect(eq(int, pddlp_validate_plan(validator, "(drive t2 c a) (drive t2 a b)", &result), 1), "%s",
+        result.message);
+
+    pddlp_free_validator(validator);
+    pddlp_free_strips(reachable);
+    pddlp_free_strips(all);
+    pddlp_free_problem(problem);
+    pddlp_release_domain(domain);
+}
+
+Test(ground, unsupported) {
+    struct pddlp_error error;
+    struct pddlp_domain *domain = pddlp_parse_domain(logistics_domain, &error);
+    struct pddlp_problem *problem = pddlp_parse_problem(domain, logistics_problem, &error);
+    cr_assert(ne(ptr, problem, NULL));
+
+    cr_expect(eq(ptr, pddlp_ground(problem, 1, &error), NULL));
+    cr_expect(eq(str, (char *)error.message, "grounding doesn't support negative preconditions on fluents"));
+
+    pddlp_free_problem(problem);
+    pddlp_release_domain(domain);
+}
+
+Test(validate, plans) {
+    struct pddlp_error error;
+    struct pddlp_domain *domain = pddlp_parse_domain(drive_domain, &error);
+    struct pddlp_problem *problem = pddlp_parse_problem(domain, drive_problem, &error);
+    struct pddlp_strips *strips = pddlp_ground(problem, 1, &error);
+    cr_assert(ne(ptr, strips, NULL), "%s", error.message);
+    struct pddlp_validator *validator = pddlp_new_validator(strips, &error);
+    cr_assert(ne(ptr, validator, NULL), "%s", error.message);
+
+    struct pddlp_plan_result result;
+    cr_expect(eq(int, pddlp_validate_plan(validator, "(drive t1 a b)\n", &result), 1));
+    cr_expect(eq(u32, result.step, PDDLP_NONE));
+    cr_expect(eq(u32, result.step_count, 1));
+
+    cr_expect(eq(int, pddlp_validate_plan(validator,
+        "0.000: (wait t2 c) [1.000]\n"
+        "1.000: (drive t1 a b) [1.000]\n"
+        "; cost = 2 (unit cost)\n", &result), 1));
+    cr_expect(eq(u32, result.step_count, 2));
+
+    // t1 is not at b yet.
+    cr_expect(eq(int, pddlp_validate_plan(validator, "(drive t1 a a)\n(drive t1 b c)\n", &result), 0));
+    cr_expect(eq(u32, result.step, 0));
+    cr_expect(eq(str, (char *)result.message, "the action doesn't apply to these objects"));
+
+    cr_expect(eq(int, pddlp_validate_plan(validator, "(drive t2 c a)\n(drive t1 b c)\n", &result), 0));
+    cr_expect(eq(u32, result.step, 1));
+    cr_expect(eq(u32, result.step_count, 1));
+    cr_expect(eq(u32, result.fact, find_fact(strips, "at", "t1", "b")));
+    cr_expect(eq(str, (char *)result.message, "precondition doesn't hold"));
+    cr_expect(eq(u64, result.line, 2));
+    cr_expect(eq(u64, result.column, 1));
+
+    cr_expect(eq(int, pddlp_validate_plan(validator, "(wait t1 a)\n", &result), 0));
+    cr_expect(eq(u32, result.step, 1));
+    cr_expect(eq(u32, result.fact, find_fact(strips, "visited", "b", NULL)));
+    cr_expect(eq(str, (char *)result.message, "goal doesn't hold"));
+
+    cr_expect(eq(int, pddlp_validate_plan(validator, "(drive t1 a b)\n  (fly t1 b c)", &result), 0));
+    cr_expect(eq(str, (char *)result.message, "unknown action"));
+    cr_expect(eq(u64, result.line, 2));
+    cr_expect(eq(u64, result.column, 3));
+
+    cr_expect(eq(int, pddlp_validate_plan(validator, "(drive t1 a x)", &result), 0));
+    cr_expect(eq(str, (char *)result.message, "unknown object"));
+    cr_expect(eq(u64, result.column, 13));
+
+    cr_expect(eq(int, pddlp_validate_plan(validator, "(drive t1 a)", &result), 0));
+    cr_expect(eq(str, (char *)result.message, "wrong number of arguments"));
+
+    cr_expect(eq(int, pddlp_validate_plan(validator, "(drive t1 a b", &result), 0));
+    cr_expect(eq(str, (char *)result.message, "unexpected end of input"));
+
+    cr_expect(eq(int, pddlp_validate_plan(validator, "1.0 (drive t1 a b)", &result), 0));
+    cr_expect(eq(str, (char *)result.message, "expected ':' after the time of a step"));
+
+    uint32_t args[3] = {
+        pddlp_find_object(problem, "t1", 2),
+        pddlp_find_object(problem, "a", 1),
+        pddlp_find_object(problem, "b", 1),
+    };
+    uint32_t op = pddlp_find_operator(validator, pddlp_find_action(domain, "drive", 5), args);
+    cr_assert(ne(u32, op, PDDLP_NONE));
+    cr_expect(eq(u32, strips->operator_args[strips->operators[op].args + 2], args[2]));
+
+    pddlp_free_validator(validator);
+    pddlp_free_strips(strips);
+    pddlp_free_problem(problem);
+    pddlp_release_domain(domain);
+}
+
+static bool
+init_holds(void *context, uint32_t predicate, const uint32_t *args)
+{
+    return pddlp_find_fact(context, predicate, args) != PDDLP_NONE;
+}
+
+Test(conditions, normal_form) {
+    struct pddlp_error error;
+    struct pddlp_domain *domain = pddlp_parse_domain(
+        "(define (domain blocks)\n"
+        "  (:requirements :adl)\n"
+        "  (:types block)\n"
+        "  (:predicates (on ?x ?y - block) (clear ?x - block) (red ?x - block) (table ?x - block))\n"
+        "  (:action move\n"
+        "    :parameters (?x ?y - block)\n"
+        "    :precondition (and (clear ?x) (not (= ?x ?y))\n"
+        "                       (not (exists (?z - block) (on ?z ?y)))\n"
+        "                       (imply (red ?x) (red ?y)))\n"
+        "    :effect (on ?x ?y))\n"
+        "  (:action stack\n"
+        "    :parameters (?x ?y - block)\n"
+        "    :precondition (and (or (red ?y) (not (red ?x))) (and (forall (?z - block) (not (on ?z ?y)))\n"
+        "                       (clear ?x) (not (= ?y ?x)) (= ?x ?x)))\n"
+        "    :effect (on ?x ?y)))\n", &error);
+    cr_assert(ne(ptr, domain, NULL), "%s", error.message);
+    struct pddlp_problem *problem = pddlp_parse_problem(domain,
+        "(define (problem p) (:domain blocks)\n"
+        "  (:objects a b c d - block)\n"
+        "  (:init (clear a) (red a) (red c) (on b c) (clear d) (red d))\n"
+        "  (:goal (forall (?b - block) (imply (red ?b) (or (table ?b) (clear ?b))))))\n", &error);
+    cr_assert(ne(ptr, problem, NULL), "%s", error.message);
+
+    struct pddlp_conditions *conditions = pddlp_compile_conditions(problem, &error);
+    cr_assert(ne(ptr, conditions, NULL), "%s", error.message);
+
+    // the same precondition, written two ways, is the same node: one `and`
+    // of the clear, the inequality, an atom for each block that could be on
+    // ?y and the `or`.
+    const struct pddlp_condition *move = &conditions->preconditions[0];
+    const struct pddlp_condition *stack = &conditions->preconditions[1];
+    cr_expect(eq(u32, move->root, stack->root));
+    const struct pddlp_condition_node *root = &conditions->nodes[move->root];
+    cr_expect(eq(int, root->type, PDDLP_CONDITION_AND));
+    cr_expect(eq(u32, root->count, 7));
+
+    const struct pddlp_condition_node *goal = &conditions->nodes[conditions->goal.root];
+    cr_expect(eq(int, goal->type, PDDLP_CONDITION_AND));
+    cr_expect(eq(u32, goal->count, 4));
+
+    // operands come before the nodes that use them, and steps only test
+    // atoms and jump forward.
+    for (uint32_t i = 0; i < conditions->node_count; ++i) {
+        const struct pddlp_condition_node *n = &conditions->nodes[i];
+        if (n->type == PDDLP_CONDITION_AND || n->type == PDDLP_CONDITION_OR)
+            for (uint32_t j = 0; j < n->count; ++j)
+                cr_expect(lt(u32, conditions->operands[n->first + j], i));
+    }
+    cr_expect(eq(u32, move->count, 8));
+    for (uint32_t i = 0; i < conditions->step_count; ++i) {
+        const struct pddlp_condition_step *step = &conditions->steps[i];
+        enum pddlp_condition_type type = conditions->nodes[step->node].type;
+        cr_expect(type == PDDLP_CONDITION_ATOM || type == PDDLP_CONDITION_EQUAL);
+        cr_expect(gt(u32, step->on_true, i));
+        cr_expect(gt(u32, step->on_false, i));
+    }
+
+    uint32_t *scratch = calloc(conditions->scratch_count, sizeof(*scratch));
+    uint32_t a = pddlp_find_object(problem, "a", 1);
+    uint32_t b = pddlp_find_object(problem, "b", 1);
+    uint32_t c = pddlp_find_object(problem, "c", 1);
+    uint32_t d = pddlp_find_object(problem, "d", 1);
+
+    // c is red and neither on the table nor clear.
+    cr_expect(eq(int, pddlp_condition_holds(conditions, &conditions->goal, NULL, init_holds, problem, scratch), 0));
+
+    struct {
+        uint32_t x, y;
+        bool holds;
+    } cases[] = {
+        {a, a, false}, // ?x and ?y are the same.
+        {a, b, false}, // a is red, b is not.
+        {a, c, false}, // b is on c.
+        {c, a, false}, // c is not clear.
+        {a, d, true},
+    };
+    for (size_t i = 0; i < sizeof(cases) / sizeof(*cases); ++i) {
+        uint32_t params[2] = {cases[i].x, cases[i].y};
+        cr_expect(eq(int, pddlp_condition_holds(conditions, move, params, init_holds, problem, scratch),
+            cases[i].holds));
+    }
+
+    free(scratch);
+    pddlp_free_conditions(conditions);
+    pddlp_free_problem(problem);
+    pddlp_release_domain(domain);
+}
+
+static bool
+append_output(void *context, const char *data, size_t length)
+{
+    char *output = context;
+    size_t used = strlen(output);
+    memcpy(output + used, data, length);
+    output[used + length] = '\0';
+    return true;
+}
+
+Test(normalize, canonical) {
+    const char *a =
+        "(define (problem p) ; two trucks\n"
+        "  (:domain drive)\n"
+        "  (:objects b a - location t2 t1 - truck)\n"
+        "  (:init (at t1 a) (AT t2 c) (road a b)\n"
+        "         (at t1 a))\n"
+        "  (:goal (and (at t1 b))))\n";
+    const char *b =
+        "(DEFINE (PROBLEM P)\n"
+        "(:DOMAIN DRIVE)\n"
+        "(:OBJECTS T1 - TRUCK A - LOCATION T2 - TRUCK B - LOCATION)\n"
+        "(:INIT (ROAD A B) (AT T2 C) (AT T1 A))\n"
+        "(:GOAL (AND (AT T1 B))))";
+
+    static char output_a[1024];
+    static char output_b[1024];
+    struct pddlp_hash128 hash_a, hash_b;
+    struct pddlp_error error;
+
+    cr_assert(eq(int, pddlp_normalize(a, append_output, output_a, &hash_a, &error), 1), "%s", error.message);
+    cr_assert(eq(int, pddlp_normalize(b, append_output, output_b, &hash_b, &error), 1), "%s", error.message);
+    cr_expect(eq(str, output_a, output_b));
+    cr_expect(eq(u64, hash_a.low, hash_b.low));
+    cr_expect(eq(u64, hash_a.high, hash_b.high));
+    cr_expect(eq(str, output_a, "(define (problem p) (:domain drive) (:objects a b - location t1 t2 - truck) "
+        "(:init (at t1 a) (at t2 c) (road a b)) (:goal (and (at t1 b))))"));
+
+    // the same hash with no writer.
+    struct pddlp_hash128 hash;
+    cr_assert(eq(int, pddlp_normalize(a, NULL, NULL, &hash, &error), 1));
+    cr_expect(eq(u64, hash.low, hash_a.low));
+    cr_expect(eq(u64, hash.high, hash_a.high));
+
+    cr_assert(eq(int, pddlp_normalize("(define (problem p) (:init (at t1 b)))", NULL, NULL, &hash, &error), 1));
+    cr_expect(hash.low != hash_a.low || hash.high != hash_a.high);
+
+    cr_expect(eq(int, pddlp_normalize("(define (problem p)))", NULL, NULL, &hash, &error), 0));
+    cr_expect(eq(str, (char *)error.message, "unbalanced ')'"));
+    cr_expect(eq(int, pddlp_normalize("(define (problem p) (:init (at t1 a)", NULL, NULL, &hash, &error), 0));
+    cr_expect(eq(str, (char *)error.message, "unexpected end of input"));
+}
+
+Test(update, changes) {
+    static const char *domain_source =
+        "(define (domain fleet)\n"
+        "  (:requirements :typing :numeric-fluents :timed-initial-literals)\n"
+        "  (:types truck place)\n"
+        "  (:predicates (at ?t - truck ?p - place) (road ?a ?b - place) (open))\n"
+        "  (:functions (fuel ?t - truck) (total-cost)))\n";
+
+    static const char *problem_source =
+        "(define (problem p)\n"
+        "  (:domain fleet)\n"
+        "  ; two trucks\n"
+        "  (:objects t1 t2 - truck a b c - place)\n"
+        "  (:init (at t1 a) (at t2 b) (road a b) (road b c) (road c a) (open)\n"
+        "         (= (fuel t1) 10) (= (total-cost) 0) (at 5 (not (open))))\n"
+        "  (:goal (at t1 c)))\n";
+
+    struct pddlp_error error;
+    struct pddlp_domain *domain = pddlp_parse_domain(domain_source, &error);
+    cr_assert(ne(ptr, domain, NULL), "%s", error.message);
+    struct pddlp_problem *problem = pddlp_parse_problem(domain, problem_source, &error);
+    cr_assert(ne(ptr, problem, NULL), "%s", error.message);
+
+    uint32_t at = pddlp_find_predicate(domain, "at", 2);
+    uint32_t road = pddlp_find_predicate(domain, "road", 4);
+    uint32_t fuel = pddlp_find_function(domain, "fuel", 4);
+    uint32_t t1 = pddlp_find_object(problem, "t1", 2);
+    uint32_t t2 = pddlp_find_object(problem, "t2", 2);
+    uint32_t a = pddlp_find_object(problem, "a", 1);
+    uint32_t b = pddlp_find_object(problem, "b", 1);
+    uint32_t c = pddlp_find_object(problem, "c", 1);
+
+    // the lists are built before the changes, so they have to follow them.
+    uint32_t count;
+    pddlp_predicate_facts(problem, at, &count);
+    pddlp_position_facts(problem, road, 0, a, &count);
+    pddlp_position_facts(problem, at, 1, b, &count);
+    cr_expect(eq(u32, count, 1));
+
+    uint32_t t1_a[2] = { t1, a };
+    uint32_t t1_b[2] = { t1, b };
+    uint32_t a_b[2] = { a, b };
+    uint32_t b_a[2] = { b, a };
+    struct pddlp_change changes[] = {
+        { PDDLP_CHANGE_REMOVE, at, t1_a, 0 },
+        { PDDLP_CHANGE_ADD, at, t1_b, 0 },
+        { PDDLP_CHANGE_ADD, road, a_b, 0 },
+        { PDDLP_CHANGE_REMOVE, road, b_a, 0 },
+        { PDDLP_CHANGE_ASSIGN, fuel, &t1, 7.5 },
+        { PDDLP_CHANGE_ASSIGN, fuel, &t2, 3 },
+    };
+    cr_assert(eq(int, pddlp_apply_changes(problem, changes, 6, &error), 1), "%s", error.message);
+
+    cr_expect(eq(u32, problem->fact_count, 6));
+    cr_expect(eq(u32, pddlp_find_fact(problem, at, t1_a), PDDLP_NONE));
+    cr_expect(ne(u32, pddlp_find_fact(problem, at, t1_b), PDDLP_NONE));
+    for (uint32_t i = 0; i < problem->fact_count; ++i)
+        cr_expect(eq(u32, pddlp_find_fact(problem, problem->fact_predicates[i],
+            problem->fact_args + problem->fact_args_first[i]), i));
+
+    pddlp_predicate_facts(problem, at, &count);
+    cr_expect(eq(u32, count, 2));
+    pddlp_position_facts(problem, at, 1, b, &count);
+    cr_expect(eq(u32, count, 2));
+    pddlp_position_facts(problem, at, 1, a, &count);
+    cr_expect(eq(u32, count, 0));
+
+    cr_assert(eq(u32, problem->fluent_count, 3));
+    cr_expect(eq(dbl, problem->fluent_values[0], 7.5));
+    cr_expect(eq(u32, problem->fluent_functions[2], fuel));
+    cr_expect(eq(dbl, problem->fluent_values[2], 3));
+
+    // a new place, which the lists built so far know nothing of yet.
+    uint32_t place = pddlp_find_type(domain, "place", 5);
+    uint32_t d = pddlp_add_object(problem, "d", 1, place, &error);
+    cr_assert(ne(u32, d, PDDLP_NONE), "%s", error.message);
+    cr_expect(eq(u32, pddlp_find_object(problem, "d", 1), d));
+    cr_expect(eq(int, pddlp_has_type(problem, d, place), 1));
+    cr_expect(eq(u32, problem->type_objects_first[place + 1] - problem->type_objects_first[place], 4));
+    cr_expect(eq(u32, problem->type_objects[problem->type_objects_first[place + 1] - 1], d));
+    cr_expect(eq(u32, pddlp_add_object(problem, "a", 1, place, &error), PDDLP_NONE));
+
+    pddlp_position_facts(problem, road, 0, d, &count);
+    cr_expect(eq(u32, count, 0));
+
+    // (road a b) isn't the last fact, so the last one takes its id.
+    uint32_t c_d[2] = { c, d };
+    struct pddlp_change more[] = {
+        { PDDLP_CHANGE_ADD, road, c_d, 0 },
+        { PDDLP_CHANGE_REMOVE, road, a_b, 0 },
+    };
+    cr_assert(eq(int, pddlp_apply_changes(problem, more, 2, &error), 1), "%s", error.message);
+
+    cr_expect(eq(u32, problem->fact_count, 6));
+    for (uint32_t i = 0; i < problem->fact_count; ++i)
+        cr_expect(eq(u32, pddlp_find_fact(problem, problem->fact_predicates[i],
+            problem->fact_args + problem->fact_args_first[i]), i));
+
+    const uint32_t *facts = pddlp_position_facts(problem, road, 1, d, &count);
+    cr_assert(eq(u32, count, 1));
+    cr_expect(eq(u32, facts[0], pddlp_find_fact(problem, road, c_d)));
+    pddlp_position_facts(problem, road, 0, a, &count);
+    cr_expect(eq(u32, count, 0));
+
+    uint32_t bad[2] = { a, 99 };
+    struct pddlp_change wrong = { PDDLP_CHANGE_ADD, road, bad, 0 };
+    cr_expect(eq(int, pddlp_apply_changes(problem, &wrong, 1, &error), 0));
+    cr_expect(eq(str, (char *)error.message, "unknown object"));
+
+    // the text around :objects and :init is copied, comments and all.
+    char output[2048] = { 0 };
+    cr_assert(eq(int, pddlp_write_problem(problem, problem_source, append_output, output, &error), 1), "%s",
+        error.message);
+    cr_expect(ne(ptr, strstr(output, "; two trucks\n  (:objects d - place t1 t2"), NULL), "%s", output);
+    cr_expect(ne(ptr, strstr(output, "(= (fuel t1) 7.5)"), NULL), "%s", output);
+    cr_expect(ne(ptr, strstr(output, "(at 5 (not (open))))\n  (:goal (at t1 c)))\n"), NULL), "%s", output);
+    cr_expect(eq(int, pddlp_write_problem(problem, "(define)", append_output, output, &error), 0));
+
+    struct pddlp_problem *written = pddlp_parse_problem(domain, output, &error);
+    cr_assert(ne(ptr, written, NULL), "%s", error.message);
+    cr_expect(eq(u32, written->fact_count, problem->fact_count));
+    cr_expect(eq(u32, written->fluent_count, problem->fluent_count));
+    cr_expect(eq(u32, written->timed_literal_count, 1));
+
+    for (uint32_t i = 0; i < problem->fact_count; ++i) {
+        uint32_t args[2];
+        uint32_t predicate = problem->fact_predicates[i];
+        for (uint32_t j = 0; j < domain->predicates[predicate].param_count; ++j) {
+            const char *name = problem->objects[problem->fact_args[problem->fact_args_first[i] + j]].name;
+            args[j] = pddlp_find_object(written, name, strlen(name));
+        }
+        cr_expect(ne(u32, pddlp_find_fact(written, predicate, args), PDDLP_NONE));
+    }
+
+    pddlp_free_problem(written);
+    pddlp_free_problem(problem);
+    pddlp_release_domain(domain);
+}
+
+Test(translate, variables) {
+    struct pddlp_error error;
+    struct pddlp_domain *domain = pddlp_parse_domain(drive_domain, &error);
+    struct pddlp_problem *problem = pddlp_parse_problem(domain, drive_problem, &error);
+    struct pddlp_strips *strips = pddlp_ground(problem, 1, &error);
+    cr_assert(ne(ptr, strips, NULL), "%s", error.message);
+
+    struct pddlp_sas *sas = pddlp_translate(strips, &error);
+    cr_assert(ne(ptr, sas, NULL), "%s", error.message);
+
+    // each truck is at one place at a time, and each visited fact is a
+    // variable of its own.
+    cr_expect(eq(u32, sas->invariant_count, 1));
+    cr_expect(eq(u32, sas->group_count, 2));
+    cr_assert(eq(u32, sas->variable_count, 2 + 3));
+
+    uint32_t t1_a = find_fact(strips, "at", "t1", "a");
+    uint32_t t1_b = find_fact(strips, "at", "t1", "b");
+    uint32_t t2_a = find_fact(strips, "at", "t2", "a");
+    uint32_t visited_b = find_fact(strips, "visited", "b", NULL);
+
+    uint32_t t1 = sas->fact_variables[t1_a];
+    cr_expect(eq(u32, sas->fact_variables[t1_b], t1));
+    cr_expect(ne(u32, sas->fact_variables[t2_a], t1));
+    cr_expect(eq(u32, sas->variable_first[t1 + 1] - sas->variable_first[t1], 3));
+    cr_expect(eq(int, sas->variable_none[t1], 0));
+    cr_expect(eq(u32, sas->init[t1], sas->fact_values[t1_a]));
+
+    // visited b starts out false, which is its second value.
+    uint32_t visited = sas->fact_variables[visited_b];
+    cr_expect(eq(int, sas->variable_none[visited], 1));
+    cr_expect(eq(u32, sas->init[visited], 1));
+    cr_expect(eq(u32, sas->operator_count, strips->operator_count));
+
+    char *output = calloc(1 << 16, 1);
+    cr_assert(ne(ptr, output, NULL));
+    cr_assert(eq(int, pddlp_write_sas(sas, append_output, output, &error), 1), "%s", error.message);
+
+    cr_expect(eq(int, strncmp(output, "begin_version\n3\nend_version\n", 28), 0));
+    cr_expect(ne(ptr, strstr(output, "3\nAtom at(t1, a)\nAtom at(t1, b)\nAtom at(t1, c)\nend_variable\n"), NULL));
+    cr_expect(ne(ptr, strstr(output, "2\nAtom visited(b)\nNegatedAtom visited(b)\nend_variable\n"), NULL));
+
+    // driving moves the truck from where it is, and visits without looking.
+    char drive[128];
+    sprintf(drive, "begin_operator\ndrive t1 a b\n0\n2\n0 %u %u %u\n0 %u -1 0\n1\nend_operator\n", t1,
+        sas->fact_values[t1_a], sas->fact_values[t1_b], visited);
+    cr_expect(ne(ptr, strstr(output, drive), NULL), "%s", output);
+    cr_expect(eq(str, output + strlen(output) - 15, "end_operator\n0\n"));
+
+    free(output);
+    pddlp_free_sas(sas);
+    pddlp_free_strips(strips);
+    pddlp_free_problem(problem);
+    pddlp_release_domain(domain);
+}
+
+static const char *fuel_domain =
+    "(define (domain fuel)\n"
+    "  (:requirements :typing :negative-preconditions :numeric-fluents)\n"
+    "  (:types truck place)\n"
+    "  (:predicates (at ?t - truck ?p - place))\n"
+    "  (:functions (fuel ?t - truck) (distance ?a ?b - place) (total-cost))\n"
+    "  (:action drive\n"
+    "    :parameters (?t - truck ?from ?to - place)\n"
+    "    :precondition (and (at ?t ?from) (>= (fuel ?t) (* (distance ?from ?to) (+ 1 1)))\n"
+    "                       (not (< (fuel ?t) 1)) (< 1 2))\n"
+    "    :effect (and (not (at ?t ?from)) (at ?t ?to)\n"
+    "                 (decrease (fuel ?t) (* 2 (distance ?from ?to)))\n"
+    "                 (increase (total-cost) (+ (distance ?from ?to) (* 3 (- 2 1)) 0)))))\n";
+
+static const char *fuel_problem =
+    "(define (problem fuel-1) (:domain fuel)\n"
+    "  (:objects t - truck a b - place)\n"
+    "  (:init (= (distance a b) 3) (at t a) (= (fuel t) 10) (= (distance b a) 4) (= (total-cost) 0))\n"
+    "  (:goal (at t b))\n"
+    "  (:metric minimize (total-cost)))\n";
+
+Test(numeric, programs) {
+    struct pddlp_error error;
+    struct pddlp_domain *domain = pddlp_parse_domain(fuel_domain, &error);
+    cr_assert(ne(ptr, domain, NULL), "%s", error.message);
+    struct pddlp_problem *problem = pddlp_parse_problem(domain, fuel_problem, &error);
+    cr_assert(ne(ptr, problem, NULL), "%s", error.message);
+    struct pddlp_strips *strips = pddlp_ground(problem, 1, &error);
+    cr_assert(ne(ptr, strips, NULL), "%s", error.message);
+
+    struct pddlp_numeric *numeric = pddlp_compile_numeric(strips, &error);
+    cr_assert(ne(ptr, numeric, NULL), "%s", error.message);
+
+    // the fluents of :init come first, in order, and keep their arguments
+    // with facts in between.
+    cr_assert(ge(u32, numeric->fluent_count, 4));
+    cr_expect(eq(dbl, numeric->initial_values[0], 3));
+    cr_expect(eq(dbl, numeric->initial_values[1], 10));
+    cr_expect(eq(dbl, numeric->initial_values[3], 0));
+    cr_expect(eq(u32, numeric->fluent_args[numeric->fluent_args_first[0]], 1));
+    cr_expect(eq(u32, numeric->fluent_args[numeric->fluent_args_first[0] + 1], 2));
+
+    uint32_t a_b = PDDLP_NONE, a_a = PDDLP_NONE;
+    for (uint32_t o = 0; o < strips->operator_count; ++o) {
+        const uint32_t *args = strips->operator_args + strips->operators[o].args;
+        if (args[1] == 1 && args[2] == 2)
+            a_b = o;
+        if (args[1] == 1 && args[2] == 1)
+            a_a = o;
+    }
+    cr_assert(ne(u32, a_b, PDDLP_NONE));
+    cr_assert(ne(u32, a_a, PDDLP_NONE));
+
+    // `(< 1 2)` always holds and is left out, and `(+ 1 1)` is folded.
+    cr_assert(eq(u32, numeric->condition_first[a_b + 1] - numeric->condition_first[a_b], 2));
+    const struct pddlp_numeric_program *p = &numeric->programs[numeric->conditions[numeric->condition_first[a_b]]];
+    cr_expect(eq(u32, p->count, 5));
+    cr_expect(eq(u32, p->depth, 3));
+    cr_expect(eq(int, numeric->ops[p->first + 4].code, PDDLP_NUMERIC_GREATER_EQUAL));
+
+    // the constants of the sum are gathered into a single 3.
+    cr_assert(eq(u32, numeric->effect_first[a_b + 1] - numeric->effect_first[a_b], 2));
+    const struct pddlp_numeric_effect *cost = &numeric->effects[numeric->effect_first[a_b] + 1];
+    p = &numeric->programs[cost->program];
+    cr_expect(eq(int, cost->op, PDDLP_TOKEN_INCREASE));
+    cr_expect(eq(u32, cost->fluent, 3));
+    cr_expect(eq(u32, p->count, 3));
+    cr_expect(eq(dbl, numeric->constants[numeric->ops[p->first + 1].operand], 3));
+
+    double *stack = calloc(numeric->depth * PDDLP_NUMERIC_LANES, sizeof(*stack));
+    double *values = malloc(sizeof(*values) * numeric->fluent_count);
+    double *next = malloc(sizeof(*next) * numeric->fluent_count);
+    cr_assert(ne(ptr, stack, NULL));
+    memcpy(values, numeric->initial_values, sizeof(*values) * numeric->fluent_count);
+    memcpy(next, values, sizeof(*next) * numeric->fluent_count);
+
+    // the distance from a to a is undefined.
+    cr_expect(eq(int, pddlp_numeric_applicable(numeric, a_b, values, stack), 1));
+    cr_expect(eq(int, pddlp_numeric_applicable(numeric, a_a, values, stack), 0));
+
+    pddlp_numeric_apply(numeric, a_b, values, next, stack);
+    cr_expect(eq(dbl, next[1], 4));
+    cr_expect(eq(dbl, next[3], 6));
+    cr_assert(ne(u32, numeric->metric, PDDLP_NONE));
+    cr_expect(eq(dbl, pddlp_evaluate(numeric, numeric->metric, next, stack), 6));
+    cr_expect(eq(int, pddlp_numeric_applicable(numeric, a_b, next, stack), 0));
+
+    // a batch crosses blocks of lanes, with a fuel of i in state i.
+    uint32_t count = PDDLP_NUMERIC_LANES + 6;
+    double *states = malloc(sizeof(*states) * numeric->fluent_count * count);
+    double *results = malloc(sizeof(*results) * count);
+    cr_assert(ne(ptr, states, NULL));
+    for (uint32_t f = 0; f < numeric->fluent_count; ++f)
+        for (uint32_t i = 0; i < count; ++i)
+            states[f * count + i] = f == 1 ? i : numeric->initial_values[f];
+
+    pddlp_evaluate_batch(numeric, numeric->conditions[numeric->condition_first[a_b]], states, count, count, results,
+        stack);
+    for (uint32_t i = 0; i < count; ++i)
+        cr_expect(eq(dbl, results[i], i >= 6), "state %u", i);
+
+    free(results);
+    free(states);
+    free(next);
+    free(values);
+    free(stack);
+    pddlp_free_numeric(numeric);
+    pddlp_free_strips(strips);
+    pddlp_free_problem(problem);
+    pddlp_release_domain(domain);
+
+    // a comparison of three expressions is rejected, not skipped.
+    static const char *chained_domain =
+        "(define (domain fuel)\n"
+        "  (:requirements :typing :numeric-fluents)\n"
+        "  (:types truck place)\n"
+        "  (:predicates (at ?t - truck ?p - place))\n"
+        "  (:functions (fuel ?t - truck) (distance ?a ?b - place) (total-cost))\n"
+        "  (:action drive\n"
+        "    :parameters (?t - truck ?from ?to - place)\n"
+        "    :precondition (and (at ?t ?from) (< 0 (fuel ?t) 100))\n"
+        "    :effect (and (not (at ?t ?from)) (at ?t ?to))))\n";
+
+    domain = pddlp_parse_domain(chained_domain, &error);
+    cr_assert(ne(ptr, domain, NULL), "%s", error.message);
+    problem = pddlp_parse_problem(domain, fuel_problem, &error);
+    cr_assert(ne(ptr, problem, NULL), "%s", error.message);
+    cr_expect(eq(ptr, pddlp_ground(problem, 1, &error), NULL));
+    cr_expect(eq(str, (char *)error.message, "numeric comparisons support only two operands"));
+
+    pddlp_free_problem(problem);
+    pddlp_release_domain(domain);
+}
+
+Test(cache, results) {
+    // the hash doesn't depend on how the data is split.
+    const char text[] = "(define (problem p) (:domain d) (:init) (:goal (and)))";
+    struct pddlp_hasher whole, split;
+    pddlp_hasher_init(&whole, 7);
+    pddlp_hasher_update(&whole, text, sizeof(text) - 1);
+    pddlp_hasher_init(&split, 7);
+    for (size_t i = 0; i < sizeof(text) - 1; i += 5)
+        pddlp_hasher_update(&split, text + i, sizeof(text) - 1 - i < 5 ? sizeof(text) - 1 - i : 5);
+    cr_expect(eq(u64, pddlp_hasher_digest(&whole), pddlp_hasher_digest(&split)));
+
+    pddlp_hasher_init(&split, 8);
+    pddlp_hasher_update(&split, text, sizeof(text) - 1);
+    cr_expect(ne(u64, pddlp_hasher_digest(&whole), pddlp_hasher_digest(&split)));
+
+    char path[] = "/tmp/pddlp-cache-XXXXXX";
+    int fd = mkstemp(path);
+    cr_assert(ne(int, fd, -1));
+    close(fd);
+    remove(path);
+
+    // a missing file is an empty cache.
+    struct pddlp_error error;
+    struct pddlp_cache *cache = pddlp_open_cache(path, &error);
+    cr_assert(ne(ptr, cache, NULL), "%s", error.message);
+
+    uint32_t size;
+    uint64_t hash = pddlp_hasher_digest(&whole);
+    cr_expect(eq(ptr, (void *)pddlp_cache_find(cache, hash, PDDLP_CACHE_TOKENS, &size), NULL));
+
+    uint64_t tokens[2] = { 17, 0 };
+    cr_assert(pddlp_cache_store(cache, hash, PDDLP_CACHE_TOKENS, tokens, sizeof(tokens)));
+    cr_assert(pddlp_cache_store(cache, hash, PDDLP_CACHE_CHECK, "abc", 3));
+    for (uint64_t i = 0; i < 1000; ++i)
+        cr_assert(pddlp_cache_store(cache, i, PDDLP_CACHE_USER, &i, sizeof(i)));
+
+    // a result of another size takes the place of the old one.
+    cr_assert(pddlp_cache_store(cache, hash, PDDLP_CACHE_CHECK, "abcdefghij", 10));
+    cr_assert(pddlp_save_cache(cache, &error), "%s", error.message);
+    pddlp_free_cache(cache);
+
+    cache = pddlp_open_cache(path, &error);
+    cr_assert(ne(ptr, cache, NULL), "%s", error.message);
+
+    const uint64_t *found = pddlp_cache_find(cache, hash, PDDLP_CACHE_TOKENS, &size);
+    cr_assert(ne(ptr, (void *)found, NULL));
+    cr_expect(eq(u32, size, sizeof(tokens)));
+    cr_expect(eq(u64, found[0], 17));
+
+    const char *check = pddlp_cache_find(cache, hash, PDDLP_CACHE_CHECK, &size);
+    cr_assert(ne(ptr, (void *)check, NULL));
+    cr_expect(eq(u32, size, 10));
+    cr_expect(eq(int, memcmp(check, "abcdefghij", 10), 0));
+
+    for (uint64_t i = 0; i < 1000; ++i) {
+        found = pddlp_cache_find(cache, i, PDDLP_CACHE_USER, &size);
+        cr_assert(ne(ptr, (void *)found, NULL));
+        cr_expect(eq(u64, *found, i));
+    }
+
+    cr_expect(eq(ptr, (void *)pddlp_cache_find(cache, hash, PDDLP_CACHE_STATS, &size), NULL));
+    pddlp_free_cache(cache);
+
+    // a cut off file is dropped, rather than trusted in part.
+    FILE *file = fopen(path, "r+b");
+    cr_assert(ne(ptr, file, NULL));
+    cr_assert(eq(int, ftruncate(fileno(file), 100), 0));
+    fclose(file);
+
+    cache = pddlp_open_cache(path, &error);
+    cr_assert(ne(ptr, cache, NULL), "%s", error.message);
+    cr_expect(eq(ptr, (void *)pddlp_cache_find(cache, hash, PDDLP_CACHE_TOKENS, &size), NULL));
+    pddlp_free_cache(cache);
+
+    // and so is one from another version of the library.
+    file = fopen(path, "wb");
+    cr_assert(ne(ptr, file, NULL));
+    fwrite("pddlpc1\n0.0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0", 1, 32, file);
+    fclose(file);
+
+    cache = pddlp_open_cache(path, &error);
+    cr_assert(ne(ptr, cache, NULL), "%s", error.message);
+    cr_expect(eq(ptr, (void *)pddlp_cache_find(cache, hash, PDDLP_CACHE_TOKENS, &size), NULL));
+    pddlp_free_cache(cache);
+
+    remove(path);
+}
+
+static void *
+parse_large_problem(void *context)
+{
+    void **job = context;
+    struct pddlp_error error;
+    return pddlp_parse_problem(job[0], job[1], &error);
+}
+
+Test(memory, accounting) {
+    struct pddlp_accounting *accounting = pddlp_new_accounting(NULL, 0);
+    cr_assert(ne(ptr, accounting, NULL));
+    struct pddlp_allocator allocator = pddlp_accounting_allocator(accounting);
+    pddlp_set_allocator(&allocator);
+
+    struct pddlp_error error;
+    struct pddlp_memory usage;
+    struct pddlp_domain *domain = pddlp_parse_domain(drive_domain, &error);
+    struct pddlp_problem *problem = pddlp_parse_problem(domain, drive_problem, &error);
+    struct pddlp_strips *strips = pddlp_ground(problem, 2, &error);
+    cr_assert(ne(ptr, strips, NULL), "%s", error.message);
+
+    pddlp_memory_usage(accounting, &usage);
+    cr_expect(gt(sz, usage.current, 0));
+    cr_expect(ge(sz, usage.peak, usage.current));
+    cr_expect(gt(sz, usage.subsystem_current[PDDLP_SUBSYSTEM_PARSER], 0));
+    cr_expect(gt(sz, usage.subsystem_current[PDDLP_SUBSYSTEM_FACTS], 0));
+    cr_expect(gt(sz, usage.subsystem_current[PDDLP_SUBSYSTEM_GROUND], 0));
+    cr_expect(eq(sz, usage.subsystem_peak[PDDLP_SUBSYSTEM_OTHER], 0));
+
+    pddlp_free_strips(strips);
+    pddlp_free_problem(problem);
+    pddlp_memory_usage(accounting, &usage);
+    size_t domain_size = usage.current;
+    cr_expect(eq(sz, domain_size, usage.subsystem_current[PDDLP_SUBSYSTEM_PARSER]));
+
+    // a problem that doesn't fit fails cleanly, and leaves nothing behind.
+    static char large[32 * 1024];
+    size_t n = sprintf(large, "(define (problem large) (:domain drive) (:objects t - truck a b - place) (:init");
+    for (int i = 0; i < 2000; ++i)
+        n += sprintf(large + n, " (road a b)");
+    sprintf(large + n, ") (:goal (visited b)))");
+
+    pddlp_set_budget(accounting, domain_size + 1024);
+    cr_expect(eq(ptr, pddlp_parse_problem(domain, large, &error), NULL));
+    cr_expect(eq(str, (char *)error.message, "out of memory"));
+
+    pddlp_memory_usage(accounting, &usage);
+    cr_expect(eq(sz, usage.current, domain_size));
+    cr_expect(gt(u64, usage.refused, 0));
+
+    pddlp_set_budget(accounting, 0);
+    problem = pddlp_parse_problem(domain, large, &error);
+    cr_expect(ne(ptr, problem, NULL), "%s", error.message);
+    pddlp_free_problem(problem);
+
+    // a thread budget only holds back the thread that set it.
+    pddlp_set_thread_budget(1024);
+    cr_expect(eq(ptr, pddlp_parse_problem(domain, large, &error), NULL));
+    cr_expect(eq(str, (char *)error.message, "out of memory"));
+
+    pthread_t thread;
+    void *job[2] = { domain, large };
+    cr_assert(eq(int, pthread_create(&thread, NULL, parse_large_problem, job), 0));
+    pthread_join(thread, (void **)&problem);
+    cr_expect(ne(ptr, problem, NULL));
+    pddlp_free_problem(problem);
+
+    pddlp_set_thread_budget(0);
+    problem = pddlp_parse_problem(domain, large, &error);
+    cr_expect(ne(ptr, problem, NULL), "%s", error.message);
+    pddlp_free_problem(problem);
+
+    pddlp_release_domain(domain);
+    pddlp_memory_usage(accounting, &usage);
+    cr_expect(eq(sz, usage.current, 0));
+
+    pddlp_set_allocator(NULL);
+    pddlp_free_accounting(accounting);
+}
+
+#ifdef PDDLP_STATS
+Test(stats, counts) {
+    struct pddlp_tokenizer tokenizer;
+    struct pddlp_stats stats;
+    const char *source =
+        "; comment\n"
+        "(define (problem p) ?1\n"
+        "  (:objects truck1 a)\n"
+        "  (:init (at truck1 a)))\n";
+
+    pddlp_init_tokenizer(&tokenizer, source);
+    pddlp_init_stats(&stats);
+    pddlp_attach_stats(&tokenizer, &stats);
+
+    while (pddlp_scan_token(&tokenizer).token_type != PDDLP_TOKEN_EOF)
+        ;
+
+    cr_expect(eq(u64, stats.token_counts[PDDLP_TOKEN_LPAREN], 5));
+    cr_expect(eq(u64, stats.token_counts[PDDLP_TOKEN_RPAREN], 5));
+    cr_expect(eq(u64, stats.token_counts[PDDLP_TOKEN_NAME], 5));
+    cr_expect(eq(u64, stats.token_counts[PDDLP_TOKEN_EOF], 1));
+    cr_expect(eq(u64, stats.error_counts[PDDLP_TOKEN_ERROR_VARIABLE_FIRST_CHAR], 1));
+
+    cr_expect(eq(u64, stats.comment_bytes, 9));
+    cr_expect(eq(u64, stats.token_bytes + stats.whitespace_bytes + stats.comment_bytes + 2,
+        strlen(source)));
+
+    cr_expect(eq(u64, stats.keyword_hits, 3));
+    cr_expect(eq(u64, stats.keyword_misses, 5));
+    cr_expect(eq(u64, stats.name_lengths[1], 3));
+    cr_expect(eq(u64, stats.name_lengths[6], 2));
+
+    cr_expect(eq(int, tokenizer.stats_depth, 0));
+    cr_expect(eq(int, tokenizer.stats_section, -1));
+}
+
+// each tokenizer follows its own sections, so interleaving two on the same
+// stats doesn't mix them up.
+Test(stats, shared) {
+    struct pddlp_tokenizer first;
+    struct pddlp_tokenizer second;
+    struct pddlp_stats stats;
+    const char *source = "(define (problem p) (:init (a) (b)))";
+
+    pddlp_init_stats(&stats);
+    pddlp_init_tokenizer(&first, source);
+    pddlp_init_tokenizer(&second, source);
+    pddlp_attach_stats(&first, &stats);
+    pddlp_attach_stats(&second, &stats);
+
+    // up to `:init`.
+    for (int i = 0; i < 8; ++i)
+        pddlp_scan_token(&first);
+    cr_expect(eq(int, first.stats_depth, 2));
+    cr_expect(eq(int, first.stats_section, PDDLP_TOKEN_SYM_INIT));
+
+    while (pddlp_scan_token(&second).token_type != PDDLP_TOKEN_EOF)
+        ;
+    cr_expect(eq(int, first.stats_section, PDDLP_TOKEN_SYM_INIT));
+
+    while (pddlp_scan_token(&first).token_type != PDDLP_TOKEN_EOF)
+        ;
+    cr_expect(eq(int, first.stats_depth, 0));
+    cr_expect(eq(int, second.stats_depth, 0));
+    cr_expect(eq(u64, stats.token_counts[PDDLP_TOKEN_LPAREN], 10));
+}
+#endif